@@ -0,0 +1,604 @@
+/**
+ * @file bench_compare.c
+ * @brief Compares bench_extract, bench_store and bench_load JSON results against a
+ *        stored baseline and exits non-zero when a metric regressed significantly.
+ *
+ * Build (from the repository root):
+ *   gcc -O2 -std=gnu11 bench/bench_compare.c -o bench_compare -ljansson -lm
+ *
+ * Run:
+ *   ./bench_compare baseline/extract.json extract.json
+ *   ./bench_compare --threshold 3 base-1.json base-2.json -- new-1.json new-2.json
+ *
+ * Files before "--" (or the first of exactly two files) are the baseline, the rest the
+ * candidate. Results of the same metric given several times on one side are pooled, so
+ * single-number metrics (throughput, peak RSS) get a distribution from repeated runs.
+ *
+ * Each metric is tested with a two-sided Mann-Whitney U test (normal approximation
+ * with tie correction) and gets a seeded bootstrap confidence interval for the relative
+ * change of the median. A metric is a regression when the change is significant at
+ * --alpha and the median moved in the bad direction by at least its threshold. Metrics
+ * with too few samples for the test to reach --alpha are only compared by point value
+ * and fail the run only with --fail-unsampled. Exit status: 0 clean, 1 regression,
+ * 2 usage or input error.
+ */
+
+#include <fnmatch.h>
+#include <jansson.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define COMPARE_MAX_FILES 64      //** Result files per side
+#define COMPARE_MAX_RULES 32      //** --metric-threshold rules
+#define COMPARE_KEY_BYTES 256     //** Metric name length limit
+
+typedef enum {
+    LOWER_IS_BETTER,
+    HIGHER_IS_BETTER
+} MetricDirection;
+
+typedef enum {
+    VERDICT_UNCHANGED,
+    VERDICT_IMPROVED,
+    VERDICT_WORSE,      //* Significant but below the threshold
+    VERDICT_REGRESSION,
+    VERDICT_UNSAMPLED,  //* Too few samples to test and the point change exceeds the threshold
+    VERDICT_MISSING     //* Present on one side only
+} Verdict;
+
+static const char *VERDICT_NAMES[] = {"unchanged", "improved", "worse", "REGRESSION", "unsampled", "missing"};
+
+/**
+ * @brief One named metric with the pooled samples of both sides (0 = baseline, 1 = candidate).
+ */
+typedef struct {
+    char key[COMPARE_KEY_BYTES];
+    MetricDirection direction;
+    double *values[2];
+    int counts[2];
+    int capacities[2];
+} Metric;
+
+/**
+ * @brief Per-metric threshold override: fnmatch pattern and percentage (negative = ignore metric).
+ */
+typedef struct {
+    const char *pattern;
+    double percent;
+} ThresholdRule;
+
+/**
+ * @brief Comparison knobs (see usage()).
+ */
+typedef struct {
+    double threshold_percent;
+    double alpha;
+    int bootstrap_rounds;
+    uint64_t seed;
+    int fail_unsampled;
+    const char *only_pattern;
+    ThresholdRule rules[COMPARE_MAX_RULES];
+    int rule_count;
+} CompareOptions;
+
+/**
+ * @brief Statistics for one metric.
+ */
+typedef struct {
+    double median[2];
+    double change;        //* Relative change of the median, candidate vs baseline
+    double ci_low, ci_high;
+    double p_value;
+    double threshold;     //* Percent
+    Verdict verdict;
+} MetricResult;
+
+static CompareOptions options;
+static Metric *metrics = NULL;
+static int metric_count = 0;
+static int metric_capacity = 0;
+static json_t *configs[2][3]; //* First config seen per side for extract, store, load
+
+//* =============== METRICS ===============
+
+static Metric *metric_find(const char *key, MetricDirection direction) {
+    for (int i = 0; i < metric_count; i++)
+        if (strcmp(metrics[i].key, key) == 0)
+            return &metrics[i];
+    if (metric_count == metric_capacity) {
+        int capacity = metric_capacity ? metric_capacity * 2 : 64;
+        Metric *grown = realloc(metrics, sizeof(Metric) * capacity);
+        if (!grown)
+            return NULL;
+        metrics = grown;
+        metric_capacity = capacity;
+    }
+    Metric *metric = &metrics[metric_count++];
+    memset(metric, 0, sizeof(*metric));
+    snprintf(metric->key, sizeof(metric->key), "%s", key);
+    metric->direction = direction;
+    return metric;
+}
+
+static int metric_add(int side, const char *key, MetricDirection direction, double value) {
+    Metric *metric = metric_find(key, direction);
+    if (!metric)
+        return 0;
+    if (metric->counts[side] == metric->capacities[side]) {
+        int capacity = metric->capacities[side] ? metric->capacities[side] * 2 : 16;
+        double *grown = realloc(metric->values[side], sizeof(double) * capacity);
+        if (!grown)
+            return 0;
+        metric->values[side] = grown;
+        metric->capacities[side] = capacity;
+    }
+    metric->values[side][metric->counts[side]++] = value;
+    return 1;
+}
+
+//* Adds every number of a "samples" array, or the fallback summary value when there is none
+static void metric_add_samples(int side, const char *key, MetricDirection direction, json_t *samples, json_t *fallback) {
+    if (json_is_array(samples) && json_array_size(samples) > 0) {
+        size_t index;
+        json_t *value;
+        json_array_foreach(samples, index, value) {
+            if (json_is_number(value))
+                metric_add(side, key, direction, json_number_value(value));
+        }
+    } else if (json_is_number(fallback)) {
+        metric_add(side, key, direction, json_number_value(fallback));
+    }
+}
+
+static void metric_add_number(int side, const char *key, MetricDirection direction, json_t *value) {
+    if (json_is_number(value))
+        metric_add(side, key, direction, json_number_value(value));
+}
+
+static void remember_config(int side, int benchmark, json_t *root, const char *path) {
+    json_t *config = json_object_get(root, "config");
+    if (!config)
+        return;
+    if (!configs[side][benchmark]) {
+        configs[side][benchmark] = json_incref(config);
+    } else if (!json_equal(configs[side][benchmark], config)) {
+        fprintf(stderr, "warning: %s: config differs from the other %s files on this side\n", path,
+                side ? "candidate" : "baseline");
+    }
+}
+
+//* =============== RESULT FILES ===============
+
+static void load_extract(int side, json_t *root) {
+    size_t index;
+    json_t *result;
+    char key[COMPARE_KEY_BYTES];
+    json_array_foreach(json_object_get(root, "results"), index, result) {
+        const char *engine = json_string_value(json_object_get(result, "engine"));
+        const char *input = json_string_value(json_object_get(result, "input"));
+        if (!engine || !input)
+            continue;
+        snprintf(key, sizeof(key), "extract:%s/%s:ns", engine, input);
+        metric_add_samples(side, key, LOWER_IS_BETTER, json_object_get(result, "samples_ns"),
+                           json_object_get(json_object_get(result, "ns"), "median"));
+    }
+}
+
+static void load_store(int side, json_t *root) {
+    static const char *PHASES[] = {"lookup_hit", "lookup_miss", "insert", "commit"};
+    size_t index;
+    json_t *result;
+    char key[COMPARE_KEY_BYTES];
+    json_array_foreach(json_object_get(root, "results"), index, result) {
+        const char *status = json_string_value(json_object_get(result, "status"));
+        if (!status || strcmp(status, "ok") != 0)
+            continue;
+        long long size = json_integer_value(json_object_get(result, "size"));
+        for (size_t p = 0; p < sizeof(PHASES) / sizeof(PHASES[0]); p++) {
+            json_t *phase = json_object_get(result, PHASES[p]);
+            snprintf(key, sizeof(key), "store:%lld/%s:ns", size, PHASES[p]);
+            metric_add_samples(side, key, LOWER_IS_BETTER, json_object_get(phase, "samples_ns"),
+                               json_object_get(phase, "p50_ns"));
+        }
+        snprintf(key, sizeof(key), "store:%lld/commit_candidates_per_s", size);
+        metric_add_number(side, key, HIGHER_IS_BETTER, json_object_get(result, "commit_candidates_per_s"));
+        snprintf(key, sizeof(key), "store:%lld/rss_bytes_per_record", size);
+        metric_add_number(side, key, LOWER_IS_BETTER, json_object_get(result, "rss_bytes_per_record"));
+        json_t *export_ms = json_object_get(result, "export_ms");
+        if (json_is_number(export_ms) && json_number_value(export_ms) >= 0) {
+            snprintf(key, sizeof(key), "store:%lld/export_ms", size);
+            metric_add_number(side, key, LOWER_IS_BETTER, export_ms);
+        }
+    }
+}
+
+static void load_load(int side, json_t *root) {
+    size_t index;
+    json_t *run;
+    char key[COMPARE_KEY_BYTES];
+    json_array_foreach(json_object_get(root, "runs"), index, run) {
+        if (json_integer_value(json_object_get(run, "exit_status")) != 0)
+            continue;
+        long long concurrency = json_integer_value(json_object_get(run, "concurrency"));
+        json_t *cycle_ms = json_object_get(run, "cycle_ms");
+        snprintf(key, sizeof(key), "load:c%lld/cycle_ms", concurrency);
+        metric_add_samples(side, key, LOWER_IS_BETTER, json_object_get(cycle_ms, "samples"),
+                           json_object_get(cycle_ms, "mean"));
+        snprintf(key, sizeof(key), "load:c%lld/sources_per_s", concurrency);
+        metric_add_number(side, key, HIGHER_IS_BETTER, json_object_get(run, "sources_per_s"));
+        snprintf(key, sizeof(key), "load:c%lld/cpu_ms_per_source", concurrency);
+        metric_add_number(side, key, LOWER_IS_BETTER, json_object_get(run, "cpu_ms_per_source"));
+        snprintf(key, sizeof(key), "load:c%lld/peak_rss_kb", concurrency);
+        metric_add_number(side, key, LOWER_IS_BETTER, json_object_get(run, "peak_rss_kb"));
+    }
+}
+
+static int load_result_file(int side, const char *path) {
+    json_error_t error;
+    json_t *root = json_load_file(path, 0, &error);
+    if (!root) {
+        fprintf(stderr, "%s:%d: %s\n", path, error.line, error.text);
+        return 0;
+    }
+    const char *benchmark = json_string_value(json_object_get(root, "benchmark"));
+    int ok = 1;
+    if (benchmark && strcmp(benchmark, "extract") == 0) {
+        remember_config(side, 0, root, path);
+        load_extract(side, root);
+    } else if (benchmark && strcmp(benchmark, "store") == 0) {
+        remember_config(side, 1, root, path);
+        load_store(side, root);
+    } else if (benchmark && strcmp(benchmark, "load") == 0) {
+        remember_config(side, 2, root, path);
+        load_load(side, root);
+    } else {
+        fprintf(stderr, "%s: not a bench_extract/bench_store/bench_load result\n", path);
+        ok = 0;
+    }
+    json_decref(root);
+    return ok;
+}
+
+//* =============== STATISTICS ===============
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+//* Median by quickselect; reorders values
+static double median_select(double *values, int count) {
+    int low = 0, high = count - 1, middle = count / 2;
+    while (low < high) {
+        double pivot = values[(low + high) / 2];
+        int i = low, j = high;
+        while (i <= j) {
+            while (values[i] < pivot)
+                i++;
+            while (values[j] > pivot)
+                j--;
+            if (i <= j) {
+                double swap = values[i];
+                values[i++] = values[j];
+                values[j--] = swap;
+            }
+        }
+        if (middle <= j)
+            high = j;
+        else if (middle >= i)
+            low = i;
+        else
+            break;
+    }
+    double result = values[middle];
+    if (count % 2 == 0) {
+        double below = values[0];
+        for (int k = 1; k < middle; k++)
+            if (values[k] > below)
+                below = values[k];
+        result = (result + below) / 2;
+    }
+    return result;
+}
+
+static double median_of(const double *values, int count, double *scratch) {
+    memcpy(scratch, values, sizeof(double) * count);
+    return median_select(scratch, count);
+}
+
+/**
+ * @brief Two-sided Mann-Whitney U p-value (normal approximation, tie-corrected,
+ *        continuity-corrected).
+ */
+static double mann_whitney_p(const double *a, int n1, const double *b, int n2) {
+    int total = n1 + n2;
+    struct Ranked { double value; int side; } *all = malloc(sizeof(*all) * total);
+    if (!all)
+        return 1.0;
+    for (int i = 0; i < n1; i++)
+        all[i] = (struct Ranked){ a[i], 0 };
+    for (int i = 0; i < n2; i++)
+        all[n1 + i] = (struct Ranked){ b[i], 1 };
+    qsort(all, total, sizeof(*all), compare_double); //* value is the first member
+
+    double rank_sum = 0, tie_term = 0;
+    for (int i = 0; i < total;) {
+        int j = i;
+        while (j + 1 < total && all[j + 1].value == all[i].value)
+            j++;
+        double rank = (i + j) / 2.0 + 1; //* Average rank of the tie group
+        for (int k = i; k <= j; k++)
+            if (all[k].side == 0)
+                rank_sum += rank;
+        double ties = j - i + 1;
+        tie_term += ties * ties * ties - ties;
+        i = j + 1;
+    }
+    free(all);
+
+    double u = rank_sum - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * (double)n2 / 2.0;
+    double variance = n1 * (double)n2 / 12.0 * ((total + 1) - tie_term / ((double)total * (total - 1)));
+    if (variance <= 0)
+        return 1.0; //* Every value identical
+    double distance = fabs(u - mean) - 0.5;
+    if (distance < 0)
+        distance = 0;
+    return erfc(distance / sqrt(variance) / sqrt(2.0));
+}
+
+//* Smallest two-sided p the rank test can produce for these sizes: 2 / C(n1 + n2, n1)
+static double mann_whitney_floor(int n1, int n2) {
+    double log_combinations = lgamma(n1 + n2 + 1.0) - lgamma(n1 + 1.0) - lgamma(n2 + 1.0);
+    return 2.0 * exp(-log_combinations);
+}
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+//* Percentile bootstrap CI for median(candidate) / median(baseline) - 1
+static void bootstrap_interval(const Metric *metric, double confidence, double *low, double *high) {
+    int n1 = metric->counts[0], n2 = metric->counts[1];
+    int rounds = options.bootstrap_rounds;
+    double *changes = malloc(sizeof(double) * rounds);
+    double *resample = malloc(sizeof(double) * (n1 > n2 ? n1 : n2));
+    if (!changes || !resample) {
+        free(changes);
+        free(resample);
+        *low = *high = NAN;
+        return;
+    }
+    uint64_t state = options.seed * 0x9E3779B97F4A7C15ULL + 1;
+    int kept = 0;
+    for (int r = 0; r < rounds; r++) {
+        double medians[2];
+        for (int side = 0; side < 2; side++) {
+            int count = metric->counts[side];
+            for (int i = 0; i < count; i++)
+                resample[i] = metric->values[side][next_random(&state) % count];
+            medians[side] = median_select(resample, count);
+        }
+        if (medians[0] != 0)
+            changes[kept++] = medians[1] / medians[0] - 1;
+    }
+    if (kept == 0) {
+        *low = *high = NAN;
+    } else {
+        qsort(changes, kept, sizeof(double), compare_double);
+        double tail = (1 - confidence) / 2;
+        *low = changes[(int)(tail * (kept - 1))];
+        *high = changes[(int)((1 - tail) * (kept - 1))];
+    }
+    free(changes);
+    free(resample);
+}
+
+static double threshold_for(const char *key) {
+    for (int i = 0; i < options.rule_count; i++)
+        if (fnmatch(options.rules[i].pattern, key, 0) == 0)
+            return options.rules[i].percent;
+    return options.threshold_percent;
+}
+
+static MetricResult evaluate(const Metric *metric) {
+    MetricResult result = { .median = {NAN, NAN}, .change = NAN, .ci_low = NAN, .ci_high = NAN, .p_value = NAN };
+    result.threshold = threshold_for(metric->key);
+    int n1 = metric->counts[0], n2 = metric->counts[1];
+    if (n1 == 0 || n2 == 0) {
+        result.verdict = VERDICT_MISSING;
+        return result;
+    }
+    double *scratch = malloc(sizeof(double) * (n1 > n2 ? n1 : n2));
+    if (!scratch) {
+        result.verdict = VERDICT_MISSING;
+        return result;
+    }
+    result.median[0] = median_of(metric->values[0], n1, scratch);
+    result.median[1] = median_of(metric->values[1], n2, scratch);
+    free(scratch);
+    if (result.median[0] != 0)
+        result.change = result.median[1] / result.median[0] - 1;
+    else
+        result.change = result.median[1] == 0 ? 0 : INFINITY;
+
+    //* Positive "worse" means the metric moved in its bad direction
+    double worse = metric->direction == LOWER_IS_BETTER ? result.change : -result.change;
+    int beyond_threshold = worse * 100 >= result.threshold;
+
+    if (mann_whitney_floor(n1, n2) >= options.alpha) {
+        result.verdict = beyond_threshold ? VERDICT_UNSAMPLED : VERDICT_UNCHANGED;
+        return result;
+    }
+    result.p_value = mann_whitney_p(metric->values[0], n1, metric->values[1], n2);
+    bootstrap_interval(metric, 1 - options.alpha, &result.ci_low, &result.ci_high);
+    if (result.p_value >= options.alpha)
+        result.verdict = VERDICT_UNCHANGED;
+    else if (worse <= 0)
+        result.verdict = VERDICT_IMPROVED;
+    else
+        result.verdict = beyond_threshold ? VERDICT_REGRESSION : VERDICT_WORSE;
+    return result;
+}
+
+//* =============== REPORT ===============
+
+static void format_value(char *out, size_t size, double value) {
+    if (isnan(value))
+        snprintf(out, size, "-");
+    else
+        snprintf(out, size, "%.4g", value);
+}
+
+static void format_percent(char *out, size_t size, double value) {
+    if (isnan(value))
+        snprintf(out, size, "-");
+    else if (isinf(value))
+        snprintf(out, size, "inf");
+    else
+        snprintf(out, size, "%+.1f%%", value * 100);
+}
+
+static void print_row(const Metric *metric, const MetricResult *result, int color) {
+    char baseline[32], candidate[32], change[32], low[32], high[32], interval[72], p_value[32];
+    format_value(baseline, sizeof(baseline), result->median[0]);
+    format_value(candidate, sizeof(candidate), result->median[1]);
+    format_percent(change, sizeof(change), result->change);
+    format_percent(low, sizeof(low), result->ci_low);
+    format_percent(high, sizeof(high), result->ci_high);
+    if (isnan(result->ci_low))
+        snprintf(interval, sizeof(interval), "-");
+    else
+        snprintf(interval, sizeof(interval), "[%s, %s]", low, high);
+    if (isnan(result->p_value))
+        snprintf(p_value, sizeof(p_value), "-");
+    else
+        snprintf(p_value, sizeof(p_value), "%.2g", result->p_value);
+
+    const char *start = "", *end = "";
+    if (color && result->verdict == VERDICT_REGRESSION)
+        start = "\033[1;31m", end = "\033[0m";
+    else if (color && (result->verdict == VERDICT_WORSE || result->verdict == VERDICT_UNSAMPLED))
+        start = "\033[33m", end = "\033[0m";
+    else if (color && result->verdict == VERDICT_IMPROVED)
+        start = "\033[32m", end = "\033[0m";
+    printf("%s%-44s %5d %5d %11s %11s %8s %20s %8s  %s%s\n", start, metric->key, metric->counts[0], metric->counts[1],
+           baseline, candidate, change, interval, p_value, VERDICT_NAMES[result->verdict], end);
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options] BASELINE.json... -- CANDIDATE.json...\n"
+            "       %s [options] BASELINE.json CANDIDATE.json\n"
+            "  --threshold PCT            Regression threshold on the median change (default 5)\n"
+            "  --metric-threshold GLOB=PCT  Per-metric threshold; first match wins, PCT < 0 ignores the metric\n"
+            "  --alpha A                  Significance level for the rank test and CI (default 0.01)\n"
+            "  --bootstrap N              Bootstrap resamples (default 2000)\n"
+            "  --seed N                   Bootstrap seed (default 1)\n"
+            "  --only GLOB                Only compare metrics matching GLOB (e.g. 'store:*')\n"
+            "  --fail-unsampled           Also fail on point regressions of metrics too small to test\n",
+            program, program);
+}
+
+int main(int argc, char *argv[]) {
+    options = (CompareOptions){ .threshold_percent = 5.0, .alpha = 0.01, .bootstrap_rounds = 2000, .seed = 1 };
+    const char *files[2][COMPARE_MAX_FILES];
+    int file_counts[2] = {0, 0};
+    int side = 0, saw_separator = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--") == 0) {
+            side = 1;
+            saw_separator = 1;
+        } else if (strcmp(argv[i], "--fail-unsampled") == 0) {
+            options.fail_unsampled = 1;
+        } else if (strncmp(argv[i], "--", 2) == 0 && !value) {
+            usage(argv[0]);
+            return 2;
+        } else if (strcmp(argv[i], "--threshold") == 0) {
+            options.threshold_percent = atof(value), i++;
+        } else if (strcmp(argv[i], "--metric-threshold") == 0) {
+            char *equals = strrchr(value, '=');
+            if (!equals || options.rule_count == COMPARE_MAX_RULES) {
+                fprintf(stderr, "--metric-threshold expects GLOB=PCT (at most %d rules)\n", COMPARE_MAX_RULES);
+                return 2;
+            }
+            *equals = '\0';
+            options.rules[options.rule_count++] = (ThresholdRule){ value, atof(equals + 1) };
+            i++;
+        } else if (strcmp(argv[i], "--alpha") == 0) {
+            options.alpha = atof(value), i++;
+        } else if (strcmp(argv[i], "--bootstrap") == 0) {
+            options.bootstrap_rounds = atoi(value), i++;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options.seed = strtoull(value, NULL, 10), i++;
+        } else if (strcmp(argv[i], "--only") == 0) {
+            options.only_pattern = value, i++;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            usage(argv[0]);
+            return 2;
+        } else if (file_counts[side] < COMPARE_MAX_FILES) {
+            files[side][file_counts[side]++] = argv[i];
+        }
+    }
+    if (!saw_separator && file_counts[0] == 2) {
+        files[1][0] = files[0][1];
+        file_counts[0] = file_counts[1] = 1;
+    }
+    if (file_counts[0] == 0 || file_counts[1] == 0 || options.alpha <= 0 || options.alpha >= 1 ||
+        options.bootstrap_rounds < 100) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (int s = 0; s < 2; s++)
+        for (int f = 0; f < file_counts[s]; f++)
+            if (!load_result_file(s, files[s][f]))
+                return 2;
+    for (int b = 0; b < 3; b++) {
+        if (configs[0][b] && configs[1][b] && !json_equal(configs[0][b], configs[1][b]))
+            fprintf(stderr, "warning: %s baseline and candidate were run with different configs\n",
+                    b == 0 ? "extract" : b == 1 ? "store" : "load");
+        for (int s = 0; s < 2; s++)
+            if (configs[s][b])
+                json_decref(configs[s][b]);
+    }
+
+    int color = isatty(STDOUT_FILENO);
+    int counts[VERDICT_MISSING + 1] = {0};
+    int failed = 0;
+    printf("%-44s %5s %5s %11s %11s %8s %20s %8s  %s\n", "metric", "n(b)", "n(c)", "baseline", "candidate",
+           "change", "CI", "p", "verdict");
+    for (int i = 0; i < metric_count; i++) {
+        Metric *metric = &metrics[i];
+        if (options.only_pattern && fnmatch(options.only_pattern, metric->key, 0) != 0)
+            continue;
+        if (threshold_for(metric->key) < 0)
+            continue;
+        MetricResult result = evaluate(metric);
+        print_row(metric, &result, color);
+        counts[result.verdict]++;
+        if (result.verdict == VERDICT_REGRESSION || (options.fail_unsampled && result.verdict == VERDICT_UNSAMPLED))
+            failed = 1;
+    }
+    printf("\n%d regression(s), %d worse below threshold, %d improved, %d unchanged, %d unsampled, %d missing"
+           " (alpha %g, threshold %g%%)\n",
+           counts[VERDICT_REGRESSION], counts[VERDICT_WORSE], counts[VERDICT_IMPROVED], counts[VERDICT_UNCHANGED],
+           counts[VERDICT_UNSAMPLED], counts[VERDICT_MISSING], options.alpha, options.threshold_percent);
+
+    for (int i = 0; i < metric_count; i++) {
+        free(metrics[i].values[0]);
+        free(metrics[i].values[1]);
+    }
+    free(metrics);
+    return failed;
+}
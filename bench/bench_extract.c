@@ -0,0 +1,395 @@
+/**
+ * @file bench_extract.c
+ * @brief Extraction micro-benchmark: runs every engine over a seeded synthetic corpus
+ *        (plus optional files on disk) and prints machine-readable JSON.
+ *
+ * Build (from the repository root):
+ *   gcc -O2 -std=gnu11 bench/bench_extract.c lib/mtparse.c data/data.c -o bench_extract -lpthread -lcurl -lpcre2-8 -ljansson -lz -lm
+ *
+ * The bench includes the parser's main file with MTP_NO_MAIN (libmtparse is
+ * compiled alongside) and calls extract_proxies_from_content() directly.
+ */
+
+#define MTP_NO_MAIN
+#include "../mtproto_parser.c"
+#include "corpus.h"
+
+#include <dirent.h>
+#include <math.h>
+
+#define BENCH_MAX_INPUTS 256 //** Generated kinds + files from --corpus-dir
+#define BENCH_MAX_REPS 1000
+
+/**
+ * @brief One benchmark input (generated document or corpus file).
+ */
+typedef struct {
+    char name[sizeof("file:") + NAME_MAX]; //* Kind name or "file:<basename>"
+    char *data;
+    size_t length;
+    int planted;     //* -1 when unknown (files on disk)
+} BenchInput;
+
+/**
+ * @brief An extraction engine under test. Returns the number of unique proxies found.
+ */
+typedef struct {
+    const char *name;
+    int (*run)(const char *content, size_t length);
+} BenchEngine;
+
+/**
+ * @brief Summary of repeated timings in nanoseconds.
+ */
+typedef struct {
+    double mean;
+    double stddev;
+    double min;
+    double median;
+    double p95;
+    double max;
+} BenchSummary;
+
+//* Empties the store so every repetition commits into the same state
+static void bench_reset_store() {
+    PROFILED_LOCK(&storage_mutex);
+    atomic_store(&stats.total_proxies, 0);
+    PROFILED_UNLOCK(&storage_mutex);
+}
+
+static int engine_pcre2(const char *content, size_t length) {
+    bench_reset_store();
+    extract_proxies_from_content(content, length, "bench://corpus", -1);
+    return (int)atomic_load(&stats.total_proxies);
+}
+
+static const BenchEngine BENCH_ENGINES[] = {
+    {"pcre2", engine_pcre2},
+};
+#define BENCH_ENGINE_COUNT (sizeof(BENCH_ENGINES) / sizeof(BENCH_ENGINES[0]))
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static BenchSummary bench_summarize(double *samples, int count) {
+    BenchSummary summary = {0};
+    if (count <= 0)
+        return summary;
+    qsort(samples, count, sizeof(double), compare_double);
+    double sum = 0;
+    for (int i = 0; i < count; i++)
+        sum += samples[i];
+    summary.mean = sum / count;
+    double squares = 0;
+    for (int i = 0; i < count; i++)
+        squares += (samples[i] - summary.mean) * (samples[i] - summary.mean);
+    summary.stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+    summary.min = samples[0];
+    summary.max = samples[count - 1];
+    summary.median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    summary.p95 = samples[(int)ceil(0.95 * count) - 1];
+    return summary;
+}
+
+static int bench_load_file(const char *path, BenchInput *input) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return 0;
+    }
+    input->data = malloc(size + 1);
+    if (!input->data || fread(input->data, 1, size, file) != (size_t)size) {
+        free(input->data);
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    input->data[size] = '\0';
+    input->length = size;
+    input->planted = -1;
+    return 1;
+}
+
+//* Adds every regular file in `directory` (sorted by name, for stable output order)
+static int bench_load_directory(const char *directory, BenchInput *inputs, int count) {
+    struct dirent **entries = NULL;
+    int entry_count = scandir(directory, &entries, NULL, alphasort);
+    if (entry_count < 0) {
+        fprintf(stderr, "Cannot read corpus directory %s\n", directory);
+        return count;
+    }
+    for (int e = 0; e < entry_count; e++) {
+        char path[4096];
+        struct stat info;
+        snprintf(path, sizeof(path), "%s/%s", directory, entries[e]->d_name);
+        if (count < BENCH_MAX_INPUTS && entries[e]->d_name[0] != '.' &&
+            stat(path, &info) == 0 && S_ISREG(info.st_mode) && bench_load_file(path, &inputs[count])) {
+            snprintf(inputs[count].name, sizeof(inputs[count].name), "file:%s", entries[e]->d_name);
+            count++;
+        }
+        free(entries[e]);
+    }
+    free(entries);
+    return count;
+}
+
+static void bench_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const char *p = text; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            fprintf(out, "\\%c", *p);
+        else if ((unsigned char)*p < 0x20)
+            fprintf(out, "\\u%04x", *p);
+        else
+            fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void bench_json_summary(FILE *out, const char *name, const BenchSummary *summary) {
+    fprintf(out, "\"%s\":{\"mean\":%.1f,\"stddev\":%.1f,\"cv\":%.4f,\"min\":%.1f,\"median\":%.1f,\"p95\":%.1f,\"max\":%.1f}",
+            name, summary->mean, summary->stddev, summary->mean > 0 ? summary->stddev / summary->mean : 0.0,
+            summary->min, summary->median, summary->p95, summary->max);
+}
+
+static void bench_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --seed N          Corpus seed (default 1)\n"
+            "  --size KB         Generated document size (default 256)\n"
+            "  --density D       Proxies per KiB (default 2.0; noisy pages use D/10)\n"
+            "  --noise X         Filler share 0..1 (default 0.3)\n"
+            "  --kinds LIST      Comma-separated subset of tme_html,json,text,markdown,noisy\n"
+            "  --corpus-dir DIR  Also benchmark every file in DIR\n"
+            "  --no-generated    Only use --corpus-dir files\n"
+            "  --engine NAME     Only run this engine\n"
+            "  --warmup N        Untimed runs per input (default 2)\n"
+            "  --reps N          Timed runs per input (default 10)\n"
+            "  --output PATH     Write JSON here instead of stdout\n"
+            "  --write-corpus DIR  Write the generated documents to DIR and exit\n"
+            "  --write-archive PATH  Write all inputs as a --replay archive and exit\n"
+            "  --archive-cycles N  Cycles in that archive, each serving every input (default 3)\n",
+            program);
+}
+
+int main(int argc, char *argv[]) {
+    CorpusOptions options = {1, 256 * 1024, 2.0, 0.3};
+    const char *kinds = "tme_html,json,text,markdown,noisy";
+    const char *corpus_dir = NULL, *engine_filter = NULL, *output_path = NULL, *write_dir = NULL, *archive_path = NULL;
+    int warmup = 2, reps = 10, generated = 1, archive_cycles = 3;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--no-generated") == 0) {
+            generated = 0;
+        } else if (!value) {
+            bench_usage(argv[0]);
+            return 2;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options.seed = strtoull(value, NULL, 10), i++;
+        } else if (strcmp(argv[i], "--size") == 0) {
+            options.target_bytes = strtoull(value, NULL, 10) * 1024, i++;
+        } else if (strcmp(argv[i], "--density") == 0) {
+            options.density = atof(value), i++;
+        } else if (strcmp(argv[i], "--noise") == 0) {
+            options.noise = atof(value), i++;
+        } else if (strcmp(argv[i], "--kinds") == 0) {
+            kinds = value, i++;
+        } else if (strcmp(argv[i], "--corpus-dir") == 0) {
+            corpus_dir = value, i++;
+        } else if (strcmp(argv[i], "--engine") == 0) {
+            engine_filter = value, i++;
+        } else if (strcmp(argv[i], "--warmup") == 0) {
+            warmup = atoi(value), i++;
+        } else if (strcmp(argv[i], "--reps") == 0) {
+            reps = atoi(value), i++;
+        } else if (strcmp(argv[i], "--output") == 0) {
+            output_path = value, i++;
+        } else if (strcmp(argv[i], "--write-corpus") == 0) {
+            write_dir = value, i++;
+        } else if (strcmp(argv[i], "--write-archive") == 0) {
+            archive_path = value, i++;
+        } else if (strcmp(argv[i], "--archive-cycles") == 0) {
+            archive_cycles = atoi(value), i++;
+        } else {
+            bench_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (reps < 1 || reps > BENCH_MAX_REPS || warmup < 0) {
+        fprintf(stderr, "--reps must be 1..%d and --warmup >= 0\n", BENCH_MAX_REPS);
+        return 2;
+    }
+
+    static BenchInput inputs[BENCH_MAX_INPUTS];
+    int input_count = 0;
+    for (int kind = 0; generated && kind < CORPUS_KIND_COUNT; kind++) {
+        char list[256];
+        snprintf(list, sizeof(list), ",%s,", kinds);
+        char needle[64];
+        snprintf(needle, sizeof(needle), ",%s,", CORPUS_KIND_NAMES[kind]);
+        if (!strstr(list, needle))
+            continue;
+        CorpusDocument doc;
+        if (!corpus_generate((CorpusKind)kind, &options, &doc)) {
+            fprintf(stderr, "Corpus generation failed for %s\n", CORPUS_KIND_NAMES[kind]);
+            return 1;
+        }
+        BenchInput *input = &inputs[input_count++];
+        snprintf(input->name, sizeof(input->name), "%s", CORPUS_KIND_NAMES[kind]);
+        input->data = doc.data;
+        input->length = doc.size;
+        input->planted = doc.planted;
+    }
+
+    if (write_dir) {
+        mkdir(write_dir, 0755);
+        for (int i = 0; i < input_count; i++) {
+            char path[PATH_MAX];
+            if (snprintf(path, sizeof(path), "%s/%s-seed%llu.txt", write_dir, inputs[i].name,
+                         (unsigned long long)options.seed) >= (int)sizeof(path)) {
+                fprintf(stderr, "Output path too long: %s\n", write_dir);
+                return 1;
+            }
+            FILE *file = fopen(path, "wb");
+            if (!file || fwrite(inputs[i].data, 1, inputs[i].length, file) != inputs[i].length) {
+                fprintf(stderr, "Cannot write %s\n", path);
+                if (file)
+                    fclose(file);
+                return 1;
+            }
+            fclose(file);
+            fprintf(stderr, "Wrote %s (%zu bytes, %d proxies)\n", path, inputs[i].length, inputs[i].planted);
+        }
+        return 0;
+    }
+    if (corpus_dir)
+        input_count = bench_load_directory(corpus_dir, inputs, input_count);
+    if (input_count == 0) {
+        fprintf(stderr, "No inputs to benchmark\n");
+        return 2;
+    }
+
+    if (archive_path) {
+        //* Same format as --capture, so the parser can replay the corpus (PGO training, regressions)
+        if (archive_cycles < 1 || !capture_open(archive_path)) {
+            fprintf(stderr, "Cannot write archive %s\n", archive_path);
+            return 1;
+        }
+        static HeaderBuffer headers;
+        headers.size = snprintf(headers.data, sizeof(headers.data), "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\n");
+        for (int cycle = 1; cycle <= archive_cycles; cycle++) {
+            atomic_store(&current_cycle, cycle);
+            for (int i = 0; i < input_count; i++) {
+                char url[sizeof("corpus://") + sizeof(inputs[i].name)];
+                snprintf(url, sizeof(url), "corpus://%.*s", (int)sizeof(inputs[i].name) - 1, inputs[i].name);
+                DynamicBuffer body = { inputs[i].data, inputs[i].length, inputs[i].length };
+                capture_record(url, i, 200, CURLE_OK, 0, 0, &headers, &body);
+            }
+        }
+        capture_close();
+        fprintf(stderr, "Wrote %s (%d inputs x %d cycles)\n", archive_path, input_count, archive_cycles);
+        return 0;
+    }
+
+    //* Quiet, single-process setup: no logging, no network, hardware counters if permitted
+    atomic_store(&log_threshold, LOG_LEVEL_ERROR + 1);
+    atomic_store(&hw_counters_enabled, 1);
+    proxy_storage = calloc(PROXY_CAPACITY, sizeof(ProxyRecord));
+    if (!proxy_storage) {
+        fprintf(stderr, "Memory allocation failed for proxy storage\n");
+        return 1;
+    }
+
+    FILE *out = output_path ? fopen(output_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", output_path);
+        return 1;
+    }
+
+    int pattern_count = 0;
+    while (pattern_count < MAX_PATTERNS && PARSE_PATTERNS[pattern_count] != NULL)
+        pattern_count++;
+
+    double *samples = malloc(sizeof(double) * reps);
+    fprintf(out, "{\"benchmark\":\"extract\",\"config\":{\"seed\":%llu,\"size_bytes\":%zu,\"density\":%g,\"noise\":%g,"
+                 "\"warmup\":%d,\"reps\":%d,\"patterns\":%d},\"results\":[",
+            (unsigned long long)options.seed, options.target_bytes, options.density, options.noise, warmup, reps,
+            pattern_count);
+
+    int first_result = 1;
+    for (size_t e = 0; e < BENCH_ENGINE_COUNT; e++) {
+        if (engine_filter && strcmp(engine_filter, BENCH_ENGINES[e].name) != 0)
+            continue;
+        for (int i = 0; i < input_count; i++) {
+            const BenchInput *input = &inputs[i];
+            int found = 0;
+            for (int w = 0; w < warmup; w++)
+                found = BENCH_ENGINES[e].run(input->data, input->length);
+
+            memset(hw_pattern_totals, 0, sizeof(hw_pattern_totals));
+            for (int r = 0; r < reps; r++) {
+                uint64_t start = monotonic_ns();
+                found = BENCH_ENGINES[e].run(input->data, input->length);
+                samples[r] = (double)(monotonic_ns() - start);
+            }
+            BenchSummary summary = bench_summarize(samples, reps);
+
+            fprintf(out, "%s\n{\"engine\":", first_result ? "" : ",");
+            first_result = 0;
+            bench_json_string(out, BENCH_ENGINES[e].name);
+            fprintf(out, ",\"input\":");
+            bench_json_string(out, input->name);
+            fprintf(out, ",\"bytes\":%zu,\"planted\":%d,\"found\":%d,", input->length, input->planted, found);
+            bench_json_summary(out, "ns", &summary);
+            fprintf(out, ",\"samples_ns\":[");
+            for (int r = 0; r < reps; r++)
+                fprintf(out, "%s%.0f", r ? "," : "", samples[r]);
+            fputc(']', out);
+            double seconds = summary.median / 1e9;
+            fprintf(out, ",\"mb_per_s\":%.3f,\"proxies_per_s\":%.1f,\"patterns\":[",
+                    seconds > 0 ? input->length / 1048576.0 / seconds : 0.0, seconds > 0 ? found / seconds : 0.0);
+
+            int first_pattern = 1;
+            for (int p = 0; p < MAX_PATTERNS && PARSE_PATTERNS[p] != NULL; p++) {
+                const HwCounterTotals *totals = &hw_pattern_totals[p];
+                uint64_t passes = atomic_load(&totals->passes);
+                if (passes == 0)
+                    continue;
+                uint64_t ns = atomic_load(&totals->ns);
+                fprintf(out, "%s{\"index\":%d,\"passes\":%llu,\"ns_per_pass\":%.1f,\"share\":%.4f",
+                        first_pattern ? "" : ",", p, (unsigned long long)passes, (double)ns / passes,
+                        summary.mean > 0 ? ns / (summary.mean * reps) : 0.0);
+                uint64_t counted = atomic_load(&totals->counted_passes);
+                if (counted > 0) {
+                    double counted_bytes = (double)input->length * counted;
+                    fprintf(out, ",\"instructions_per_byte\":%.3f,\"ipc\":%.3f,\"cache_misses_per_kb\":%.3f,\"branch_misses_per_kb\":%.3f",
+                            atomic_load(&totals->events[HW_INSTRUCTIONS]) / counted_bytes,
+                            atomic_load(&totals->events[HW_CYCLES]) ?
+                                (double)atomic_load(&totals->events[HW_INSTRUCTIONS]) / atomic_load(&totals->events[HW_CYCLES]) : 0.0,
+                            atomic_load(&totals->events[HW_CACHE_MISSES]) * 1024.0 / counted_bytes,
+                            atomic_load(&totals->events[HW_BRANCH_MISSES]) * 1024.0 / counted_bytes);
+                }
+                fputc('}', out);
+                first_pattern = 0;
+            }
+            fprintf(out, "]}");
+        }
+    }
+    fprintf(out, "\n],\"hw_mode\":\"%s\"}\n", atomic_load(&hw_threads_counted) > 0 ? "hardware" : "timing");
+
+    if (out != stdout)
+        fclose(out);
+    free(samples);
+    for (int i = 0; i < input_count; i++)
+        free(inputs[i].data);
+    free(proxy_storage);
+    return 0;
+}
@@ -0,0 +1,582 @@
+/**
+ * @file bench_load.c
+ * @brief End-to-end load benchmark: serves N synthetic sources from a local HTTP
+ *        stand-in and runs the real parser binary against them at several
+ *        concurrency settings (fetch, extract, dedup and save, no internet).
+ *
+ * Build (from the repository root):
+ *   gcc -O2 -std=gnu11 bench/bench_load.c -o bench_load -lpthread -lz -lm
+ *
+ * Run (after building ./mtproto_parser):
+ *   ./bench_load --parser ./mtproto_parser --sources 200 --cycles 3 --concurrency 5,10,20,40
+ *
+ * Each run executes the parser in its own scratch directory with
+ *   --sources <list> --cycles N --concurrency K --cycle-pause 0 --probe-budget 0
+ *   --no-throttle --cycle-report cycles.jsonl
+ * and combines the per-cycle report with the child's rusage (CPU, peak RSS) and
+ * the server's own request tally.
+ */
+
+#define _GNU_SOURCE //* strcasestr, realpath
+
+#include "corpus.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define LOAD_MAX_SOURCES 799 //** The parser keeps one TARGET_URLS slot for the NULL terminator
+#define LOAD_MAX_RUNS 16    //** Concurrency settings per invocation
+#define LOAD_REQUEST_BYTES 8192 //** Request headers larger than this get a 400
+#define LOAD_PACE_INTERVAL_MS 20 //** Bandwidth shaping granularity
+#define BENCH_MAX_CYCLE_SAMPLES 256 //** Per-cycle durations kept for "cycle_ms.samples"
+
+/**
+ * @brief Behaviour of the stand-in sources.
+ */
+typedef struct {
+    int source_count;
+    CorpusOptions corpus;
+    int latency_ms;        //* Mean time to first byte (uniform jitter of +-50%)
+    int bandwidth_kbps;   //* Per-connection body rate in KiB/s; 0 = unlimited
+    double error_rate;   //* Share of requests answered with 503
+    int gzip;           //* Serve Content-Encoding: gzip when the client accepts it
+} ServerOptions;
+
+/**
+ * @brief One pre-rendered source body (plain and, if enabled, gzip-compressed).
+ */
+typedef struct {
+    char *plain;
+    size_t plain_size;
+    unsigned char *compressed;
+    size_t compressed_size;
+    int planted;
+} SourceBody;
+
+/**
+ * @brief Server-side tally, reset before every run.
+ */
+typedef struct {
+    atomic_ullong requests;
+    atomic_ullong served;          //* 200 responses
+    atomic_ullong failed;         //* Injected 503s
+    atomic_ullong bytes_sent;    //* Body bytes on the wire
+    atomic_ullong planted_served; //* Proxies contained in the bodies served
+} ServerTally;
+
+/**
+ * @brief Result of one parser run at a fixed concurrency.
+ */
+typedef struct {
+    int concurrency;
+    int exit_status;
+    double wall_seconds;
+    double cpu_seconds;
+    long peak_rss_kb;
+    int cycles;
+    double cycle_ms_mean;
+    double cycle_ms_min;
+    double cycle_ms_max;
+    double cycle_ms_samples[BENCH_MAX_CYCLE_SAMPLES];
+    double cycle_seconds_total;
+    unsigned long long fetched;
+    unsigned long long fetch_errors;
+    unsigned long long new_proxies;
+    unsigned long long store_total;
+    unsigned long long requests;
+    unsigned long long served;
+    unsigned long long failed;
+    unsigned long long bytes_sent;
+    unsigned long long planted_served;
+} RunResult;
+
+static ServerOptions server_options;
+static SourceBody *source_bodies = NULL;
+static ServerTally tally;
+static atomic_ullong connection_sequence = 0;
+
+static uint64_t elapsed_ns(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000000ULL + (now.tv_nsec - start->tv_nsec);
+}
+
+static void sleep_ms(int milliseconds) {
+    struct timespec delay = { milliseconds / 1000, (long)(milliseconds % 1000) * 1000000L };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+}
+
+//* =============== SERVER: SOURCE BODIES ===============
+
+static int gzip_body(const char *data, size_t size, unsigned char **out, size_t *out_size) {
+    z_stream stream = {0};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+    size_t capacity = deflateBound(&stream, size);
+    *out = malloc(capacity);
+    if (!*out) {
+        deflateEnd(&stream);
+        return 0;
+    }
+    stream.next_in = (unsigned char *)data;
+    stream.avail_in = size;
+    stream.next_out = *out;
+    stream.avail_out = capacity;
+    int result = deflate(&stream, Z_FINISH);
+    *out_size = stream.total_out;
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+static int prepare_bodies() {
+    source_bodies = calloc(server_options.source_count, sizeof(SourceBody));
+    if (!source_bodies)
+        return 0;
+    for (int i = 0; i < server_options.source_count; i++) {
+        CorpusOptions options = server_options.corpus;
+        options.seed = server_options.corpus.seed * 1000003ULL + i; //* Distinct proxies per source
+        CorpusDocument doc;
+        if (!corpus_generate((CorpusKind)(i % CORPUS_KIND_COUNT), &options, &doc))
+            return 0;
+        source_bodies[i].plain = doc.data;
+        source_bodies[i].plain_size = doc.size;
+        source_bodies[i].planted = doc.planted;
+        if (server_options.gzip &&
+            !gzip_body(doc.data, doc.size, &source_bodies[i].compressed, &source_bodies[i].compressed_size))
+            return 0;
+    }
+    return 1;
+}
+
+//* =============== SERVER: HTTP STAND-IN ===============
+
+static int send_all(int fd, const void *data, size_t size) {
+    const char *cursor = data;
+    while (size > 0) {
+        ssize_t written = send(fd, cursor, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return 0;
+        cursor += written;
+        size -= written;
+    }
+    return 1;
+}
+
+//* Writes the body at bandwidth_kbps, one slice every LOAD_PACE_INTERVAL_MS
+static int send_paced(int fd, const void *data, size_t size) {
+    if (server_options.bandwidth_kbps <= 0)
+        return send_all(fd, data, size);
+    size_t slice = (size_t)server_options.bandwidth_kbps * 1024 * LOAD_PACE_INTERVAL_MS / 1000;
+    if (slice == 0)
+        slice = 1;
+    const char *cursor = data;
+    while (size > 0) {
+        size_t chunk = size < slice ? size : slice;
+        if (!send_all(fd, cursor, chunk))
+            return 0;
+        cursor += chunk;
+        size -= chunk;
+        if (size > 0)
+            sleep_ms(LOAD_PACE_INTERVAL_MS);
+    }
+    return 1;
+}
+
+static void send_status(int fd, int status, const char *reason) {
+    char response[256];
+    int length = snprintf(response, sizeof(response),
+                          "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s\n",
+                          status, reason, strlen(reason) + 1, reason);
+    send_all(fd, response, length);
+}
+
+static void *serve_connection(void *argument) {
+    int fd = (int)(intptr_t)argument;
+    uint64_t rng = server_options.corpus.seed ^ (atomic_fetch_add(&connection_sequence, 1) * 0x9E3779B97F4A7C15ULL) ^ 1;
+
+    char request[LOAD_REQUEST_BYTES + 1];
+    size_t received = 0;
+    while (received < LOAD_REQUEST_BYTES) {
+        ssize_t count = recv(fd, request + received, LOAD_REQUEST_BYTES - received, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        received += count;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n"))
+            break;
+    }
+    request[received] = '\0';
+    atomic_fetch_add(&tally.requests, 1);
+
+    int source = -1;
+    if (!strstr(request, "\r\n\r\n") || sscanf(request, "GET /source/%d", &source) != 1 ||
+        source < 0 || source >= server_options.source_count) {
+        send_status(fd, source < 0 ? 400 : 404, source < 0 ? "Bad Request" : "Not Found");
+        close(fd);
+        return NULL;
+    }
+
+    if (server_options.latency_ms > 0)
+        sleep_ms(server_options.latency_ms / 2 + corpus_range(&rng, server_options.latency_ms + 1));
+
+    if (corpus_unit(&rng) < server_options.error_rate) {
+        atomic_fetch_add(&tally.failed, 1);
+        send_status(fd, 503, "Service Unavailable");
+        close(fd);
+        return NULL;
+    }
+
+    const SourceBody *body = &source_bodies[source];
+    int compressed = body->compressed && strcasestr(request, "accept-encoding:") && strstr(request, "gzip");
+    const void *payload = compressed ? (const void *)body->compressed : body->plain;
+    size_t payload_size = compressed ? body->compressed_size : body->plain_size;
+
+    char headers[256];
+    int header_length = snprintf(headers, sizeof(headers),
+                                 "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\n%sContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                                 compressed ? "Content-Encoding: gzip\r\n" : "", payload_size);
+    if (send_all(fd, headers, header_length) && send_paced(fd, payload, payload_size)) {
+        atomic_fetch_add(&tally.served, 1);
+        atomic_fetch_add(&tally.bytes_sent, payload_size);
+        atomic_fetch_add(&tally.planted_served, body->planted);
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *accept_loop(void *argument) {
+    int listen_fd = (int)(intptr_t)argument;
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+        pthread_t thread;
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attributes, serve_connection, (void *)(intptr_t)fd) != 0)
+            close(fd);
+        pthread_attr_destroy(&attributes);
+    }
+    return NULL;
+}
+
+//* Binds 127.0.0.1:port (0 = ephemeral) and starts accepting; returns the bound port or -1
+static int start_server(int port) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        return -1;
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listen_fd, 512) != 0 ||
+        getsockname(listen_fd, (struct sockaddr *)&address, &length) != 0) {
+        close(listen_fd);
+        return -1;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, accept_loop, (void *)(intptr_t)listen_fd) != 0) {
+        close(listen_fd);
+        return -1;
+    }
+    pthread_detach(thread);
+    return ntohs(address.sin_port);
+}
+
+//* =============== DRIVER: PARSER RUNS ===============
+
+static unsigned long long report_field(const char *line, const char *key) {
+    char needle[64];
+    snprintf(needle, sizeof(needle), "\"%s\":", key);
+    const char *found = strstr(line, needle);
+    return found ? strtoull(found + strlen(needle), NULL, 10) : 0;
+}
+
+static void read_cycle_report(const char *path, RunResult *result) {
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return;
+    char line[1024];
+    double sum = 0;
+    while (fgets(line, sizeof(line), file)) {
+        double milliseconds = report_field(line, "duration_ns") / 1e6;
+        if (result->cycles == 0 || milliseconds < result->cycle_ms_min)
+            result->cycle_ms_min = milliseconds;
+        if (milliseconds > result->cycle_ms_max)
+            result->cycle_ms_max = milliseconds;
+        sum += milliseconds;
+        if (result->cycles < BENCH_MAX_CYCLE_SAMPLES)
+            result->cycle_ms_samples[result->cycles] = milliseconds;
+        result->fetched += report_field(line, "fetched");
+        result->fetch_errors += report_field(line, "errors");
+        result->new_proxies += report_field(line, "new_proxies");
+        result->store_total = report_field(line, "store_total");
+        result->cycles++;
+    }
+    fclose(file);
+    result->cycle_seconds_total = sum / 1000.0;
+    result->cycle_ms_mean = result->cycles ? sum / result->cycles : 0;
+}
+
+static int run_parser(const char *parser, const char *workdir, const char *sources_path, int cycles,
+                      int concurrency, RunResult *result) {
+    char run_dir[4200];
+    snprintf(run_dir, sizeof(run_dir), "%s/c%d", workdir, concurrency);
+    if (mkdir(run_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Cannot create %s: %s\n", run_dir, strerror(errno));
+        return 0;
+    }
+    char report_path[4300];
+    snprintf(report_path, sizeof(report_path), "%s/cycles.jsonl", run_dir);
+    unlink(report_path);
+
+    char cycles_text[16], concurrency_text[16];
+    snprintf(cycles_text, sizeof(cycles_text), "%d", cycles);
+    snprintf(concurrency_text, sizeof(concurrency_text), "%d", concurrency);
+
+    memset(result, 0, sizeof(*result));
+    result->concurrency = concurrency;
+    atomic_store(&tally.requests, 0);
+    atomic_store(&tally.served, 0);
+    atomic_store(&tally.failed, 0);
+    atomic_store(&tally.bytes_sent, 0);
+    atomic_store(&tally.planted_served, 0);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t child = fork();
+    if (child < 0)
+        return 0;
+    if (child == 0) {
+        if (chdir(run_dir) != 0)
+            _exit(126);
+        int log_fd = open("parser.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log_fd >= 0) {
+            dup2(log_fd, STDOUT_FILENO);
+            dup2(log_fd, STDERR_FILENO);
+            close(log_fd);
+        }
+        execl(parser, parser, "--sources", sources_path, "--cycles", cycles_text, "--concurrency", concurrency_text,
+              "--cycle-pause", "0", "--probe-budget", "0", "--no-throttle", "--cycle-report", "cycles.jsonl", (char *)NULL);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    while (wait4(child, &status, 0, &usage) < 0) {
+        if (errno != EINTR)
+            return 0;
+    }
+    result->wall_seconds = elapsed_ns(&start) / 1e9;
+    result->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    result->cpu_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                          usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    result->peak_rss_kb = usage.ru_maxrss;
+    result->requests = atomic_load(&tally.requests);
+    result->served = atomic_load(&tally.served);
+    result->failed = atomic_load(&tally.failed);
+    result->bytes_sent = atomic_load(&tally.bytes_sent);
+    result->planted_served = atomic_load(&tally.planted_served);
+    read_cycle_report(report_path, result);
+    return 1;
+}
+
+static void write_results(FILE *out, const RunResult *results, int run_count, int cycles) {
+    unsigned long long body_bytes = 0;
+    for (int i = 0; i < server_options.source_count; i++)
+        body_bytes += source_bodies[i].plain_size;
+    fprintf(out, "{\"benchmark\":\"load\",\"config\":{\"sources\":%d,\"cycles\":%d,\"seed\":%llu,\"body_bytes_mean\":%llu,"
+                 "\"latency_ms\":%d,\"bandwidth_kbps\":%d,\"error_rate\":%g,\"gzip\":%s},\"runs\":[",
+            server_options.source_count, cycles, (unsigned long long)server_options.corpus.seed,
+            body_bytes / server_options.source_count, server_options.latency_ms, server_options.bandwidth_kbps,
+            server_options.error_rate, server_options.gzip ? "true" : "false");
+    for (int r = 0; r < run_count; r++) {
+        const RunResult *run = &results[r];
+        double active = run->cycle_seconds_total > 0 ? run->cycle_seconds_total : run->wall_seconds;
+        unsigned long long attempts = run->fetched + run->fetch_errors;
+        fprintf(out, "%s\n{\"concurrency\":%d,\"exit_status\":%d,\"cycles\":%d,\"wall_s\":%.3f,"
+                     "\"cycle_ms\":{\"mean\":%.1f,\"min\":%.1f,\"max\":%.1f,\"samples\":[",
+                r ? "," : "", run->concurrency, run->exit_status, run->cycles, run->wall_seconds,
+                run->cycle_ms_mean, run->cycle_ms_min, run->cycle_ms_max);
+        int kept = run->cycles < BENCH_MAX_CYCLE_SAMPLES ? run->cycles : BENCH_MAX_CYCLE_SAMPLES;
+        for (int c = 0; c < kept; c++)
+            fprintf(out, "%s%.3f", c ? "," : "", run->cycle_ms_samples[c]);
+        fprintf(out, "]},"
+                     "\"sources_per_s\":%.2f,\"proxies_per_s\":%.1f,\"cpu_ms_per_source\":%.3f,\"peak_rss_kb\":%ld,"
+                     "\"fetched\":%llu,\"fetch_errors\":%llu,\"new_proxies\":%llu,\"store_total\":%llu,"
+                     "\"server\":{\"requests\":%llu,\"served\":%llu,\"failed\":%llu,\"bytes\":%llu,\"planted\":%llu}}",
+                active > 0 ? attempts / active : 0.0, active > 0 ? run->planted_served / active : 0.0,
+                attempts ? run->cpu_seconds * 1000.0 / attempts : 0.0, run->peak_rss_kb,
+                run->fetched, run->fetch_errors, run->new_proxies, run->store_total,
+                run->requests, run->served, run->failed, run->bytes_sent, run->planted_served);
+    }
+    fprintf(out, "\n]}\n");
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --parser PATH       Parser binary (default ./mtproto_parser)\n"
+            "  --sources N         Stand-in sources (default 100, max %d)\n"
+            "  --cycles N          Parser cycles per run (default 3)\n"
+            "  --concurrency LIST  Comma-separated settings, one run each (default 5,10,20)\n"
+            "  --latency MS        Mean time to first byte (default 50)\n"
+            "  --bandwidth KBPS    Per-connection KiB/s, 0 = unlimited (default 0)\n"
+            "  --error-rate X      Share of 503 responses (default 0.05)\n"
+            "  --gzip              Serve gzip-compressed bodies\n"
+            "  --size KB           Body size per source (default 64)\n"
+            "  --density D         Proxies per KiB (default 2.0)\n"
+            "  --seed N            Corpus and fault seed (default 1)\n"
+            "  --port N            Server port (default ephemeral)\n"
+            "  --workdir DIR       Scratch directory (default: a new /tmp/mtp-load-XXXXXX)\n"
+            "  --output PATH       Write JSON here instead of stdout\n",
+            program, LOAD_MAX_SOURCES);
+}
+
+int main(int argc, char *argv[]) {
+    const char *parser = "./mtproto_parser", *concurrency_list = "5,10,20", *workdir = NULL, *output_path = NULL;
+    int cycles = 3, port = 0;
+    server_options = (ServerOptions){ 100, {1, 64 * 1024, 2.0, 0.3}, 50, 0, 0.05, 0 };
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--gzip") == 0) {
+            server_options.gzip = 1;
+        } else if (!value) {
+            usage(argv[0]);
+            return 2;
+        } else if (strcmp(argv[i], "--parser") == 0) {
+            parser = value, i++;
+        } else if (strcmp(argv[i], "--sources") == 0) {
+            server_options.source_count = atoi(value), i++;
+        } else if (strcmp(argv[i], "--cycles") == 0) {
+            cycles = atoi(value), i++;
+        } else if (strcmp(argv[i], "--concurrency") == 0) {
+            concurrency_list = value, i++;
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            server_options.latency_ms = atoi(value), i++;
+        } else if (strcmp(argv[i], "--bandwidth") == 0) {
+            server_options.bandwidth_kbps = atoi(value), i++;
+        } else if (strcmp(argv[i], "--error-rate") == 0) {
+            server_options.error_rate = atof(value), i++;
+        } else if (strcmp(argv[i], "--size") == 0) {
+            server_options.corpus.target_bytes = strtoull(value, NULL, 10) * 1024, i++;
+        } else if (strcmp(argv[i], "--density") == 0) {
+            server_options.corpus.density = atof(value), i++;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            server_options.corpus.seed = strtoull(value, NULL, 10), i++;
+        } else if (strcmp(argv[i], "--port") == 0) {
+            port = atoi(value), i++;
+        } else if (strcmp(argv[i], "--workdir") == 0) {
+            workdir = value, i++;
+        } else if (strcmp(argv[i], "--output") == 0) {
+            output_path = value, i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (server_options.source_count < 1 || server_options.source_count > LOAD_MAX_SOURCES || cycles < 1) {
+        fprintf(stderr, "--sources must be 1..%d and --cycles >= 1\n", LOAD_MAX_SOURCES);
+        return 2;
+    }
+
+    int concurrency[LOAD_MAX_RUNS], run_count = 0;
+    for (const char *cursor = concurrency_list; *cursor && run_count < LOAD_MAX_RUNS;) {
+        char *end = NULL;
+        long value = strtol(cursor, &end, 10);
+        if (end == cursor || value < 1) {
+            fprintf(stderr, "Invalid --concurrency list: %s\n", concurrency_list);
+            return 2;
+        }
+        concurrency[run_count++] = (int)value;
+        cursor = *end == ',' ? end + 1 : end;
+    }
+
+    char parser_path[4096];
+    if (!realpath(parser, parser_path) || access(parser_path, X_OK) != 0) {
+        fprintf(stderr, "Parser binary not found or not executable: %s\n", parser);
+        return 2;
+    }
+    char scratch[4096];
+    if (workdir) {
+        snprintf(scratch, sizeof(scratch), "%s", workdir);
+        mkdir(scratch, 0755);
+    } else {
+        snprintf(scratch, sizeof(scratch), "/tmp/mtp-load-XXXXXX");
+        if (!mkdtemp(scratch)) {
+            fprintf(stderr, "Cannot create scratch directory: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+
+    if (!prepare_bodies()) {
+        fprintf(stderr, "Source body generation failed\n");
+        return 1;
+    }
+    int bound_port = start_server(port);
+    if (bound_port < 0) {
+        fprintf(stderr, "Cannot start the stand-in server: %s\n", strerror(errno));
+        return 1;
+    }
+
+    char sources_path[4200];
+    snprintf(sources_path, sizeof(sources_path), "%s/sources.txt", scratch);
+    FILE *sources = fopen(sources_path, "w");
+    if (!sources) {
+        fprintf(stderr, "Cannot write %s\n", sources_path);
+        return 1;
+    }
+    for (int i = 0; i < server_options.source_count; i++)
+        fprintf(sources, "http://127.0.0.1:%d/source/%d\n", bound_port, i);
+    fclose(sources);
+    fprintf(stderr, "Serving %d sources on 127.0.0.1:%d, scratch %s\n", server_options.source_count, bound_port, scratch);
+
+    RunResult results[LOAD_MAX_RUNS];
+    int completed = 0;
+    for (int r = 0; r < run_count; r++) {
+        if (!run_parser(parser_path, scratch, sources_path, cycles, concurrency[r], &results[completed])) {
+            fprintf(stderr, "Run at concurrency %d failed to start\n", concurrency[r]);
+            continue;
+        }
+        const RunResult *run = &results[completed++];
+        fprintf(stderr, "concurrency %3d: %d cycles, %.1f ms/cycle, %.3f s wall, %.2f CPU s, peak RSS %ld KiB, exit %d\n",
+                run->concurrency, run->cycles, run->cycle_ms_mean, run->wall_seconds, run->cpu_seconds,
+                run->peak_rss_kb, run->exit_status);
+    }
+
+    FILE *out = output_path ? fopen(output_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", output_path);
+        return 1;
+    }
+    write_results(out, results, completed, cycles);
+    if (out != stdout)
+        fclose(out);
+    return completed == run_count ? 0 : 1;
+}
@@ -0,0 +1,472 @@
+/**
+ * @file bench_store.c
+ * @brief Storage/dedup scaling benchmark: preloads the store to 10k..10M records and
+ *        drives store_lookup() and commit_discovered_proxies() with synthetic candidate
+ *        streams, then writes a JSON baseline for later comparison.
+ *
+ * Build (from the repository root; raise PROXY_CAPACITY to cover the largest size):
+ *   gcc -O2 -std=gnu11 -DPROXY_CAPACITY=10100000 bench/bench_store.c lib/mtparse.c data/data.c -o bench_store \
+ *       -lpthread -lcurl -lpcre2-8 -ljansson -lz -lm
+ *
+ * Every size is filled directly (keys are unique by construction), so only the measured
+ * phases go through the dedup path. Each phase stops at --samples or --time-budget,
+ * whichever comes first, and the store is truncated back to its size afterwards.
+ */
+
+#define MTP_NO_MAIN
+#include "../mtproto_parser.c"
+
+#include <math.h>
+
+#define BENCH_MAX_SIZES 16
+#define BENCH_MAX_THREADS 64
+#define BENCH_SAMPLE_QUANTILES 256 //** Phases keep at most this many evenly spaced order statistics as "samples_ns"
+
+typedef enum {
+    KEYS_UNIFORM,     //* Duplicates hit any stored record equally often
+    KEYS_ZIPF,       //* Hot keys are the oldest records (front of the array)
+    KEYS_ZIPF_RECENT //* Hot keys are the newest records (worst case for a front-to-back scan)
+} KeyDistribution;
+
+static const char *KEY_DISTRIBUTION_NAMES[] = {"uniform", "zipf", "zipf-recent"};
+
+/**
+ * @brief Benchmark knobs (see usage()).
+ */
+typedef struct {
+    long sizes[BENCH_MAX_SIZES];
+    int size_count;
+    int threads;
+    int batch;
+    double duplicate_ratio;
+    KeyDistribution distribution;
+    int samples;
+    double time_budget;
+    long export_max;
+    unsigned long long max_memory;
+    uint64_t seed;
+    const char *output_path;
+} StoreBenchOptions;
+
+/**
+ * @brief Latency percentiles in nanoseconds.
+ */
+typedef struct {
+    int count;
+    double mean;
+    uint64_t p50, p90, p99, p999, max;
+} LatencySummary;
+
+/**
+ * @brief Per-thread state for the concurrent commit phase.
+ */
+typedef struct {
+    int thread_index;
+    long size;
+    uint64_t rng;
+    uint64_t *samples;
+    int sample_count;
+    int sample_capacity;
+    uint64_t candidates;
+    uint64_t added;
+} CommitWorker;
+
+static StoreBenchOptions options;
+static atomic_ullong next_new_key;   //* Keys >= size are never stored at fill time
+static atomic_int commit_phase_open;
+static atomic_long claimed_slots;    //* Store slots reserved by commit workers (bounds them by store_limit)
+static uint64_t phase_deadline_ns;
+static long store_limit;            //* Allocated records for the current size
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double unit_random(uint64_t *state) {
+    return (splitmix64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//* Builds the record for `key` exactly as extraction would (same hash, same derived fields)
+static void bench_make_record(uint64_t key, ProxyRecord *record) {
+    uint64_t state = options.seed ^ (key * 0xD6E8FEB86659FD93ULL);
+    uint64_t a = splitmix64(&state), b = splitmix64(&state), c = splitmix64(&state);
+    memset(record, 0, sizeof(*record));
+    if (key % 3 == 0)
+        snprintf(record->server, sizeof(record->server), "node%llu.proxy-%02llx.net",
+                 (unsigned long long)key, (unsigned long long)(a & 0xff));
+    else
+        snprintf(record->server, sizeof(record->server), "%u.%u.%u.%u", (unsigned)(1 + (a & 0xff) % 223),
+                 (unsigned)((a >> 8) & 0xff), (unsigned)((a >> 16) & 0xff), (unsigned)(1 + ((a >> 24) & 0xff) % 254));
+    snprintf(record->port, sizeof(record->port), "%u", (unsigned)(1024 + (a >> 32) % 64000));
+    snprintf(record->secret, sizeof(record->secret), "dd%016llx%016llx", (unsigned long long)b, (unsigned long long)c);
+    record->hash_value = compute_hash(record->server, record->port, record->secret);
+    record->discovery_time = record->last_verified = time(NULL);
+    atomic_init(&record->active, 1);
+    record->speed_score = 50;
+    record->source_index = -1;
+    snprintf(record->source, sizeof(record->source), "bench://store");
+    strcpy(record->type, key % 3 == 0 ? "Domain" : "IPv4");
+    strcpy(record->country, "UN");
+    mtp_format_url(record->connection_url, sizeof(record->connection_url), record->server, record->port,
+                   record->secret);
+}
+
+//* Picks a stored key according to the configured distribution
+static uint64_t pick_existing_key(uint64_t *rng, long size) {
+    double u = unit_random(rng);
+    long rank;
+    switch (options.distribution) {
+        case KEYS_ZIPF:
+        case KEYS_ZIPF_RECENT:
+            rank = (long)floor(pow((double)size, u)) - 1; //* Log-uniform rank ~ Zipf with s = 1
+            break;
+        default:
+            rank = (long)(u * size);
+            break;
+    }
+    if (rank < 0)
+        rank = 0;
+    if (rank >= size)
+        rank = size - 1;
+    return options.distribution == KEYS_ZIPF_RECENT ? (uint64_t)(size - 1 - rank) : (uint64_t)rank;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static LatencySummary summarize(uint64_t *samples, int count) {
+    LatencySummary summary = {0};
+    summary.count = count;
+    if (count == 0)
+        return summary;
+    qsort(samples, count, sizeof(uint64_t), compare_u64);
+    double total = 0;
+    for (int i = 0; i < count; i++)
+        total += samples[i];
+    summary.mean = total / count;
+    summary.p50 = samples[(int)(0.50 * (count - 1))];
+    summary.p90 = samples[(int)(0.90 * (count - 1))];
+    summary.p99 = samples[(int)(0.99 * (count - 1))];
+    summary.p999 = samples[(int)(0.999 * (count - 1))];
+    summary.max = samples[count - 1];
+    return summary;
+}
+
+//* samples must still be the sorted buffer summarize() produced the summary from
+static void write_summary(FILE *out, const char *name, const LatencySummary *summary, const uint64_t *samples) {
+    fprintf(out, "\"%s\":{\"count\":%d,\"mean_ns\":%.0f,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu,\"samples_ns\":[",
+            name, summary->count, summary->mean, (unsigned long long)summary->p50, (unsigned long long)summary->p90,
+            (unsigned long long)summary->p99, (unsigned long long)summary->p999, (unsigned long long)summary->max);
+    int kept = summary->count < BENCH_SAMPLE_QUANTILES ? summary->count : BENCH_SAMPLE_QUANTILES;
+    for (int i = 0; i < kept; i++) {
+        int index = kept > 1 ? (int)((long long)i * (summary->count - 1) / (kept - 1)) : 0;
+        fprintf(out, "%s%llu", i ? "," : "", (unsigned long long)samples[index]);
+    }
+    fprintf(out, "]}");
+}
+
+static int phase_open(int taken) {
+    return taken < options.samples && monotonic_ns() < phase_deadline_ns;
+}
+
+static void truncate_store(long size) {
+    PROFILED_LOCK(&storage_mutex);
+    atomic_store(&stats.total_proxies, (unsigned)size);
+    PROFILED_UNLOCK(&storage_mutex);
+}
+
+//* =============== PHASES ===============
+
+static LatencySummary measure_lookups(long size, int hits, uint64_t *samples) {
+    uint64_t rng = options.seed + (hits ? 11 : 13);
+    int taken = 0;
+    phase_deadline_ns = monotonic_ns() + (uint64_t)(options.time_budget * 1e9);
+    while (phase_open(taken)) {
+        uint64_t hash_value;
+        if (hits) {
+            hash_value = proxy_storage[pick_existing_key(&rng, size)].hash_value;
+        } else {
+            ProxyRecord probe;
+            bench_make_record(atomic_fetch_add(&next_new_key, 1), &probe);
+            hash_value = probe.hash_value;
+        }
+        PROFILED_LOCK(&storage_mutex);
+        uint64_t start = monotonic_ns();
+        int index = store_lookup(hash_value);
+        samples[taken++] = monotonic_ns() - start;
+        PROFILED_UNLOCK(&storage_mutex);
+        if ((index >= 0) != hits)
+            fprintf(stderr, "warning: lookup %s unexpectedly %s\n", hits ? "hit" : "miss", index >= 0 ? "found" : "missed");
+    }
+    return summarize(samples, taken);
+}
+
+//* Single-record commits of new keys: the per-proxy insert path including the dedup scan
+static LatencySummary measure_inserts(long size, uint64_t *samples) {
+    int taken = 0;
+    phase_deadline_ns = monotonic_ns() + (uint64_t)(options.time_budget * 1e9);
+    ProxyRecord record;
+    while (phase_open(taken) && atomic_load(&stats.total_proxies) < (unsigned)store_limit - 1) {
+        bench_make_record(atomic_fetch_add(&next_new_key, 1), &record);
+        uint64_t start = monotonic_ns();
+        commit_discovered_proxies(&record, 1, 0);
+        samples[taken++] = monotonic_ns() - start;
+    }
+    truncate_store(size);
+    return summarize(samples, taken);
+}
+
+static void *commit_worker(void *argument) {
+    CommitWorker *worker = argument;
+    ProxyRecord *batch = malloc(sizeof(ProxyRecord) * options.batch);
+    if (!batch)
+        return NULL;
+    while (atomic_load(&commit_phase_open) && worker->sample_count < worker->sample_capacity) {
+        //* Reserve room for the whole batch first: commit_discovered_proxies() only checks
+        //* PROXY_CAPACITY, not the store_limit records allocated here
+        if (monotonic_ns() >= phase_deadline_ns ||
+            atomic_fetch_add(&claimed_slots, options.batch) + options.batch > store_limit) {
+            atomic_store(&commit_phase_open, 0);
+            break;
+        }
+        for (int i = 0; i < options.batch; i++) {
+            if (unit_random(&worker->rng) < options.duplicate_ratio)
+                batch[i] = proxy_storage[pick_existing_key(&worker->rng, worker->size)];
+            else
+                bench_make_record(atomic_fetch_add(&next_new_key, 1), &batch[i]);
+        }
+        uint64_t start = monotonic_ns();
+        worker->added += commit_discovered_proxies(batch, options.batch, worker->thread_index % URL_CAPACITY);
+        worker->samples[worker->sample_count++] = monotonic_ns() - start;
+        worker->candidates += options.batch;
+    }
+    free(batch);
+    return NULL;
+}
+
+static LatencySummary measure_commits(long size, uint64_t *samples, double *candidates_per_second, uint64_t *added) {
+    CommitWorker workers[BENCH_MAX_THREADS];
+    pthread_t threads[BENCH_MAX_THREADS];
+    int per_thread = (options.samples + options.threads - 1) / options.threads;
+    atomic_store(&commit_phase_open, 1);
+    atomic_store(&claimed_slots, (long)atomic_load(&stats.total_proxies));
+    phase_deadline_ns = monotonic_ns() + (uint64_t)(options.time_budget * 1e9);
+    uint64_t start = monotonic_ns();
+    int launched = 0;
+    for (int t = 0; t < options.threads; t++) {
+        workers[t] = (CommitWorker){ .thread_index = t, .size = size, .rng = options.seed * 31 + t,
+                                     .samples = samples + (size_t)t * per_thread, .sample_capacity = per_thread };
+        if (pthread_create(&threads[launched], NULL, commit_worker, &workers[t]) == 0)
+            launched++;
+    }
+    uint64_t candidates = 0;
+    int taken = 0;
+    *added = 0;
+    for (int t = 0; t < launched; t++) {
+        pthread_join(threads[t], NULL);
+        memmove(samples + taken, workers[t].samples, sizeof(uint64_t) * workers[t].sample_count);
+        taken += workers[t].sample_count;
+        candidates += workers[t].candidates;
+        *added += workers[t].added;
+    }
+    double seconds = (monotonic_ns() - start) / 1e9;
+    *candidates_per_second = seconds > 0 ? candidates / seconds : 0;
+    truncate_store(size);
+    return summarize(samples, taken);
+}
+
+//* =============== DRIVER ===============
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --sizes LIST         Store sizes (default 10000,100000,1000000,10000000)\n"
+            "  --threads N          Concurrent committers (default 4)\n"
+            "  --batch K            Candidates per commit (default 64)\n"
+            "  --dup-ratio X        Share of candidates already stored (default 0.8)\n"
+            "  --distribution D     uniform | zipf | zipf-recent (default uniform)\n"
+            "  --samples N          Max samples per phase (default 2000)\n"
+            "  --time-budget S      Max seconds per phase (default 5)\n"
+            "  --export-max N       Time save_proxies_to_json() up to this size (default 1000000)\n"
+            "  --max-memory MB      Skip sizes whose store exceeds this (default 75%% of RAM)\n"
+            "  --seed N             Key seed (default 1)\n"
+            "  --output PATH        Baseline file (default store_baseline.json)\n"
+            "Built with PROXY_CAPACITY=%d (sizeof(ProxyRecord)=%zu)\n",
+            program, PROXY_CAPACITY, sizeof(ProxyRecord));
+}
+
+int main(int argc, char *argv[]) {
+    options = (StoreBenchOptions){ .sizes = {10000, 100000, 1000000, 10000000}, .size_count = 4, .threads = 4,
+                                   .batch = 64, .duplicate_ratio = 0.8, .distribution = KEYS_UNIFORM, .samples = 2000,
+                                   .time_budget = 5, .export_max = 1000000, .seed = 1, .output_path = "store_baseline.json" };
+    long pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    options.max_memory = pages > 0 && page_size > 0 ? (unsigned long long)pages * page_size / 4 * 3 : 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            usage(argv[0]);
+            return 2;
+        } else if (strcmp(argv[i], "--sizes") == 0) {
+            options.size_count = 0;
+            for (const char *cursor = value; *cursor && options.size_count < BENCH_MAX_SIZES;) {
+                char *end = NULL;
+                long size = strtol(cursor, &end, 10);
+                if (end == cursor || size < 1) {
+                    fprintf(stderr, "Invalid --sizes list: %s\n", value);
+                    return 2;
+                }
+                options.sizes[options.size_count++] = size;
+                cursor = *end == ',' ? end + 1 : end;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            options.threads = atoi(value), i++;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            options.batch = atoi(value), i++;
+        } else if (strcmp(argv[i], "--dup-ratio") == 0) {
+            options.duplicate_ratio = atof(value), i++;
+        } else if (strcmp(argv[i], "--distribution") == 0) {
+            int found = 0;
+            for (int d = 0; d < 3; d++) {
+                if (strcmp(value, KEY_DISTRIBUTION_NAMES[d]) == 0) {
+                    options.distribution = (KeyDistribution)d;
+                    found = 1;
+                }
+            }
+            if (!found) {
+                usage(argv[0]);
+                return 2;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--samples") == 0) {
+            options.samples = atoi(value), i++;
+        } else if (strcmp(argv[i], "--time-budget") == 0) {
+            options.time_budget = atof(value), i++;
+        } else if (strcmp(argv[i], "--export-max") == 0) {
+            options.export_max = atol(value), i++;
+        } else if (strcmp(argv[i], "--max-memory") == 0) {
+            options.max_memory = strtoull(value, NULL, 10) * 1024 * 1024, i++;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options.seed = strtoull(value, NULL, 10), i++;
+        } else if (strcmp(argv[i], "--output") == 0) {
+            options.output_path = value, i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.threads < 1 || options.threads > BENCH_MAX_THREADS || options.batch < 1 ||
+        options.batch > PROXY_BATCH_SIZE || options.samples < 1) {
+        fprintf(stderr, "--threads must be 1..%d, --batch 1..%d and --samples >= 1\n", BENCH_MAX_THREADS, PROXY_BATCH_SIZE);
+        return 2;
+    }
+
+    atomic_store(&log_threshold, LOG_LEVEL_ERROR + 1);
+    char output_path[4096], cwd[2048];
+    if (options.output_path[0] != '/' && getcwd(cwd, sizeof(cwd)))
+        snprintf(output_path, sizeof(output_path), "%s/%s", cwd, options.output_path);
+    else
+        snprintf(output_path, sizeof(output_path), "%s", options.output_path);
+    FILE *out = fopen(output_path, "w");
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", output_path);
+        return 1;
+    }
+    char scratch[] = "/tmp/mtp-store-XXXXXX";
+    if (!mkdtemp(scratch) || chdir(scratch) != 0) { //* Exports land here, not in the working tree
+        fprintf(stderr, "Cannot create scratch directory\n");
+        return 1;
+    }
+
+    uint64_t *samples = malloc(sizeof(uint64_t) * (options.samples + options.threads));
+    if (!samples) {
+        fprintf(stderr, "Sample buffer allocation failed\n");
+        return 1;
+    }
+    //* Each commit worker takes up to ceil(samples / threads) samples of one batch each
+    long headroom = ((long)options.samples + options.threads) * options.batch + options.samples + 1;
+
+    fprintf(out, "{\"benchmark\":\"store\",\"engine\":\"linear-scan\",\"record_bytes\":%zu,\"proxy_capacity\":%d,"
+                 "\"config\":{\"threads\":%d,\"batch\":%d,\"dup_ratio\":%g,\"distribution\":\"%s\",\"samples\":%d,"
+                 "\"time_budget_s\":%g,\"seed\":%llu},\"results\":[",
+            sizeof(ProxyRecord), PROXY_CAPACITY, options.threads, options.batch, options.duplicate_ratio,
+            KEY_DISTRIBUTION_NAMES[options.distribution], options.samples, options.time_budget,
+            (unsigned long long)options.seed);
+
+    for (int s = 0; s < options.size_count; s++) {
+        long size = options.sizes[s];
+        unsigned long long store_bytes = (unsigned long long)(size + headroom) * sizeof(ProxyRecord);
+        fprintf(out, "%s\n{\"size\":%ld,", s ? "," : "", size);
+        const char *skip = NULL;
+        if (size + headroom > PROXY_CAPACITY)
+            skip = "size + headroom exceeds PROXY_CAPACITY (rebuild with a larger -DPROXY_CAPACITY)";
+        else if (options.max_memory && store_bytes > options.max_memory)
+            skip = "store exceeds --max-memory";
+        if (skip) {
+            fprintf(out, "\"status\":\"skipped\",\"reason\":\"%s\",\"store_bytes\":%llu}", skip, store_bytes);
+            fprintf(stderr, "size %ld: skipped (%s)\n", size, skip);
+            continue;
+        }
+
+        uint64_t rss_before = memory_resident_bytes();
+        store_limit = size + headroom;
+        proxy_storage = calloc(store_limit, sizeof(ProxyRecord));
+        if (!proxy_storage) {
+            fprintf(out, "\"status\":\"skipped\",\"reason\":\"allocation failed\",\"store_bytes\":%llu}", store_bytes);
+            continue;
+        }
+        uint64_t fill_start = monotonic_ns();
+        for (long i = 0; i < size; i++)
+            bench_make_record((uint64_t)i, &proxy_storage[i]);
+        atomic_store(&stats.total_proxies, (unsigned)size);
+        memory_charge(MEMORY_STORE, (long long)size * sizeof(ProxyRecord));
+        double fill_seconds = (monotonic_ns() - fill_start) / 1e9;
+        uint64_t rss_after = memory_resident_bytes();
+        atomic_store(&next_new_key, (unsigned long long)size + 1000000000ULL);
+
+        LatencySummary lookup_hit = measure_lookups(size, 1, samples);
+        fprintf(out, "\"status\":\"ok\",\"fill_s\":%.3f,\"rss_bytes_per_record\":%.1f,", fill_seconds,
+                rss_after > rss_before ? (double)(rss_after - rss_before) / size : 0.0);
+        write_summary(out, "lookup_hit", &lookup_hit, samples);
+        LatencySummary lookup_miss = measure_lookups(size, 0, samples);
+        fputc(',', out);
+        write_summary(out, "lookup_miss", &lookup_miss, samples);
+        LatencySummary insert = measure_inserts(size, samples);
+        fputc(',', out);
+        write_summary(out, "insert", &insert, samples);
+        double candidates_per_second = 0;
+        uint64_t added = 0;
+        LatencySummary commit = measure_commits(size, samples, &candidates_per_second, &added);
+        fputc(',', out);
+        write_summary(out, "commit", &commit, samples);
+        fprintf(out, ",\"commit_candidates_per_s\":%.1f,\"commit_added\":%llu", candidates_per_second,
+                (unsigned long long)added);
+
+        double export_ms = -1;
+        if (size <= options.export_max) {
+            uint64_t export_start = monotonic_ns();
+            save_proxies_to_json();
+            export_ms = (monotonic_ns() - export_start) / 1e6;
+        }
+        fprintf(out, ",\"export_ms\":%.1f}", export_ms);
+        fprintf(stderr, "size %ld: lookup hit p50 %llu ns, miss p50 %llu ns, insert p99 %llu ns, commit p99 %llu ns, export %.1f ms\n",
+                size, (unsigned long long)lookup_hit.p50, (unsigned long long)lookup_miss.p50,
+                (unsigned long long)insert.p99, (unsigned long long)commit.p99, export_ms);
+
+        memory_charge(MEMORY_STORE, -(long long)size * (long long)sizeof(ProxyRecord));
+        atomic_store(&stats.total_proxies, 0);
+        free(proxy_storage);
+        proxy_storage = NULL;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    fprintf(stderr, "Baseline written to %s\n", output_path);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,268 @@
+/**
+ * @file corpus.h
+ * @brief Seeded synthetic corpus generator for the extraction benchmarks.
+ *
+ * Produces documents shaped like the pages the parser actually downloads:
+ * t.me/s channel HTML, JSON lists, plain text lists, markdown tables and noisy
+ * pages where proxies are rare and near-misses are common. The same seed and
+ * options always produce the same bytes, so runs are comparable across builds.
+ */
+
+#ifndef MTP_BENCH_CORPUS_H
+#define MTP_BENCH_CORPUS_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    CORPUS_TME_HTML,   //* t.me/s/<channel> message widgets (labels + tg:// links, &amp; escaped)
+    CORPUS_JSON,      //* [{"server": ..., "port": ..., "secret": ...}, ...]
+    CORPUS_TEXT,     //* One proxy per line, tg:// URLs and host:port:secret mixed
+    CORPUS_MARKDOWN,//* GitHub-style | server | port | secret | tables
+    CORPUS_NOISY,  //* Mostly prose/markup, hex blobs and bare IPs; few real proxies
+    CORPUS_KIND_COUNT
+} CorpusKind;
+
+__attribute__((unused)) static const char *CORPUS_KIND_NAMES[CORPUS_KIND_COUNT] = {"tme_html", "json", "text", "markdown", "noisy"};
+
+/**
+ * @brief Generator knobs.
+ */
+typedef struct {
+    uint64_t seed;         //* Same seed + options => same document
+    size_t target_bytes;  //* Approximate document size
+    double density;      //* Proxies per KiB of output (before noise)
+    double noise;       //* 0..1: share of filler between records (near-misses included)
+} CorpusOptions;
+
+/**
+ * @brief Growable output buffer for one generated document.
+ */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+    int planted; //* Proxies written in a form the parser should accept
+} CorpusDocument;
+
+static uint64_t corpus_next(uint64_t *state) {
+    //* xorshift64*: small, fast and identical on every platform
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static int corpus_range(uint64_t *state, int limit) {
+    return (int)(corpus_next(state) % (uint64_t)limit);
+}
+
+static double corpus_unit(uint64_t *state) {
+    return (corpus_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void corpus_append(CorpusDocument *doc, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void corpus_append(CorpusDocument *doc, const char *format, ...) {
+    va_list args;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t available = doc->capacity - doc->size;
+        va_start(args, format);
+        int needed = vsnprintf(doc->data ? doc->data + doc->size : NULL, doc->data ? available : 0, format, args);
+        va_end(args);
+        if (needed < 0)
+            return;
+        if (doc->data && (size_t)needed < available) {
+            doc->size += needed;
+            return;
+        }
+        size_t new_capacity = (doc->capacity ? doc->capacity * 2 : 4096) + needed + 1;
+        char *new_data = realloc(doc->data, new_capacity);
+        if (!new_data)
+            return;
+        doc->data = new_data;
+        doc->capacity = new_capacity;
+    }
+}
+
+static const char *CORPUS_WORDS[] = {
+    "proxy", "fast", "free", "channel", "join", "telegram", "server", "update", "stable", "new",
+    "today", "connect", "speed", "ping", "best", "list", "working", "daily", "mtproto", "secure",
+    "the", "and", "for", "with", "all", "users", "click", "here", "share", "subscribe"
+};
+#define CORPUS_WORD_COUNT (sizeof(CORPUS_WORDS) / sizeof(CORPUS_WORDS[0]))
+
+static const char *CORPUS_DOMAINS[] = {"cdn", "edge", "mt", "proxy", "tg", "node", "srv", "fast"};
+static const char *CORPUS_TLDS[] = {"com", "net", "org", "ir", "ru", "de", "xyz", "io"};
+
+/**
+ * @brief One random proxy in the forms the sources publish.
+ */
+typedef struct {
+    char server[64];
+    int port;
+    char secret[96];
+} CorpusProxy;
+
+static void corpus_hex(uint64_t *state, char *out, int digits) {
+    static const char HEX[] = "0123456789abcdef";
+    for (int i = 0; i < digits; i++)
+        out[i] = HEX[corpus_range(state, 16)];
+    out[digits] = '\0';
+}
+
+static void corpus_proxy(uint64_t *state, CorpusProxy *proxy) {
+    if (corpus_range(state, 3) == 0) {
+        snprintf(proxy->server, sizeof(proxy->server), "%s%d.%s.%s",
+                 CORPUS_DOMAINS[corpus_range(state, 8)], corpus_range(state, 100),
+                 CORPUS_DOMAINS[corpus_range(state, 8)], CORPUS_TLDS[corpus_range(state, 8)]);
+    } else {
+        snprintf(proxy->server, sizeof(proxy->server), "%d.%d.%d.%d", 1 + corpus_range(state, 223),
+                 corpus_range(state, 256), corpus_range(state, 256), 1 + corpus_range(state, 254));
+    }
+    static const int PORTS[] = {443, 8443, 80, 8080, 2053, 2083, 8888};
+    proxy->port = corpus_range(state, 4) ? PORTS[corpus_range(state, 7)] : 1024 + corpus_range(state, 64000);
+    switch (corpus_range(state, 3)) {
+        case 0: //* Plain 16-byte secret
+            corpus_hex(state, proxy->secret, 32);
+            break;
+        case 1: //* "dd" padded secret
+            proxy->secret[0] = proxy->secret[1] = 'd';
+            corpus_hex(state, proxy->secret + 2, 32);
+            break;
+        default: //* "ee" fake-TLS secret with a hex-encoded domain tail
+            proxy->secret[0] = proxy->secret[1] = 'e';
+            corpus_hex(state, proxy->secret + 2, 32 + 2 * (4 + corpus_range(state, 12)));
+            break;
+    }
+}
+
+//* Filler: words, markup and near-misses (bare IPs, short hex, ports without secrets)
+static void corpus_filler(uint64_t *state, CorpusDocument *doc, CorpusKind kind, int tokens) {
+    for (int t = 0; t < tokens; t++) {
+        int roll = corpus_range(state, 20);
+        if (roll < 14) {
+            corpus_append(doc, "%s ", CORPUS_WORDS[corpus_range(state, CORPUS_WORD_COUNT)]);
+        } else if (roll < 16) {
+            corpus_append(doc, kind == CORPUS_JSON ? "\"%s\" " : "<span class=\"%s\">", CORPUS_WORDS[corpus_range(state, CORPUS_WORD_COUNT)]);
+        } else if (roll < 18) {
+            corpus_append(doc, "%d.%d.%d.%d ", corpus_range(state, 256), corpus_range(state, 256),
+                          corpus_range(state, 256), corpus_range(state, 256));
+        } else {
+            char hex[40];
+            corpus_hex(state, hex, 8 + corpus_range(state, 24));
+            corpus_append(doc, "%s ", hex);
+        }
+    }
+}
+
+static void corpus_record(uint64_t *state, CorpusDocument *doc, CorpusKind kind, const CorpusProxy *proxy, int *first) {
+    switch (kind) {
+        case CORPUS_TME_HTML:
+            if (corpus_range(state, 2)) {
+                corpus_append(doc, "<div class=\"tgme_widget_message_text js-message_text\" dir=\"auto\">"
+                                   "Server: %s<br/>Port: %d<br/>Secret: %s<br/>"
+                                   "<a href=\"tg://proxy?server=%s&amp;port=%d&amp;secret=%s\" target=\"_blank\">Connect</a></div>\n",
+                              proxy->server, proxy->port, proxy->secret, proxy->server, proxy->port, proxy->secret);
+            } else {
+                corpus_append(doc, "<div class=\"tgme_widget_message_text js-message_text\" dir=\"auto\">"
+                                   "<a href=\"https://t.me/proxy?server=%s&port=%d&secret=%s\">Proxy</a></div>\n",
+                              proxy->server, proxy->port, proxy->secret);
+            }
+            break;
+        case CORPUS_JSON:
+            corpus_append(doc, "%s\n  {\"server\": \"%s\", \"port\": %d, \"secret\": \"%s\", \"ping\": %d}",
+                          *first ? "" : ",", proxy->server, proxy->port, proxy->secret, corpus_range(state, 900));
+            *first = 0;
+            break;
+        case CORPUS_TEXT:
+            if (corpus_range(state, 2))
+                corpus_append(doc, "tg://proxy?server=%s&port=%d&secret=%s\n", proxy->server, proxy->port, proxy->secret);
+            else
+                corpus_append(doc, "%s:%d:%s\n", proxy->server, proxy->port, proxy->secret);
+            break;
+        case CORPUS_MARKDOWN:
+            corpus_append(doc, "| %s | %d | %s |\n", proxy->server, proxy->port, proxy->secret);
+            break;
+        case CORPUS_NOISY:
+        default:
+            corpus_append(doc, "\n<p>tg://proxy?server=%s&port=%d&secret=%s</p>\n", proxy->server, proxy->port, proxy->secret);
+            break;
+    }
+    doc->planted++;
+}
+
+/**
+ * @brief Generates one document; returns 0 on allocation failure. Free doc->data.
+ */
+static int corpus_generate(CorpusKind kind, const CorpusOptions *options, CorpusDocument *doc) {
+    uint64_t state = options->seed * 0x9E3779B97F4A7C15ULL + (uint64_t)kind + 1;
+    memset(doc, 0, sizeof(*doc));
+
+    double density = kind == CORPUS_NOISY ? options->density / 10.0 : options->density;
+    double noise = options->noise < 0 ? 0 : options->noise > 1 ? 1 : options->noise;
+    //* Average filler tokens between records, so that ~density records land in each KiB
+    double record_bytes = kind == CORPUS_TME_HTML ? 260 : kind == CORPUS_JSON ? 110 : 90;
+    double gap_bytes = density > 0 ? 1024.0 / density - record_bytes : 1024.0;
+    int gap_tokens = gap_bytes > 0 ? (int)(gap_bytes / 7.0) : 0;
+    gap_tokens += (int)(noise * 40);
+
+    int first = 1;
+    switch (kind) {
+        case CORPUS_TME_HTML:
+            corpus_append(doc, "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Proxy channel</title></head>\n"
+                               "<body class=\"widget_frame_base tgme_widget body_widget_post\">\n");
+            break;
+        case CORPUS_JSON:
+            corpus_append(doc, "[");
+            break;
+        case CORPUS_MARKDOWN:
+            corpus_append(doc, "# MTProto proxies\n\n| Server | Port | Secret |\n|--------|------|--------|\n");
+            break;
+        default:
+            break;
+    }
+
+    while (doc->size < options->target_bytes) {
+        if (kind == CORPUS_JSON) {
+            if (gap_tokens > 0 && corpus_unit(&state) < noise) {
+                corpus_append(doc, "%s\n  {\"note\": \"", first ? "" : ",");
+                corpus_filler(&state, doc, kind, gap_tokens);
+                corpus_append(doc, "\"}");
+                first = 0;
+            }
+        } else if (kind == CORPUS_MARKDOWN) {
+            if (corpus_unit(&state) < noise) {
+                corpus_append(doc, "\n");
+                corpus_filler(&state, doc, kind, gap_tokens);
+                corpus_append(doc, "\n\n| Server | Port | Secret |\n|---|---|---|\n");
+            }
+        } else {
+            corpus_filler(&state, doc, kind, gap_tokens);
+        }
+        CorpusProxy proxy;
+        corpus_proxy(&state, &proxy);
+        corpus_record(&state, doc, kind, &proxy, &first);
+        if (!doc->data)
+            return 0;
+    }
+
+    switch (kind) {
+        case CORPUS_TME_HTML:
+            corpus_append(doc, "</body></html>\n");
+            break;
+        case CORPUS_JSON:
+            corpus_append(doc, "\n]\n");
+            break;
+        default:
+            break;
+    }
+    return doc->data != NULL;
+}
+
+#endif //* MTP_BENCH_CORPUS_H
@@ -1 +1,66 @@
-//* here will be data.c later
+/**
+ * @file data.c
+ * @brief Static data shared by libmtparse and mtproto_parser: the default
+ *        extraction pattern table.
+ */
+
+#include "../headers/mtparse.h"
+
+//* =============== PARSING PATTERNS ===============
+//* Comprehensive regex patterns to extract proxies from diverse formats:
+//* - JSON, INI, plain text, inline, URL parameters, etc.
+//* Every pattern has exactly three groups: server, port, secret (a few list the
+//* secret first; the extractor reads groups 1-3 in order either way).
+
+const char *const mtp_default_patterns[] = {
+    //* Standard labeld format: "Server: ... Port: ... Secret: ..."
+    "Server:[\\s\\r\\n]*([^\\r\\n]+?)[\\s\\r\\n]*Port:[\\s\\r\\n]*([0-9]{1,5})[\\s\\r\\n]*Secret:[\\s\\r\\n]*([0-9a-fA-F=]{16,512})",
+    "server[\\s]*:[\\s]*([^\\r\\n]+?)[\\s]*port[\\s]*:[\\s]*([0-9]{1,5})[\\s]*secret[\\s]*:[\\s]*([0-9a-fA-F=]{16,512})",
+    "Host:[\\s]*([^\\r\\n]+?)[\\s]*Port:[\\s]*([0-9]{1,5})[\\s]*Key:[\\s]*([0-9a-fA-F=]{16,512})",
+
+    "\"server\"[\\s]*:[\\s]*\"([^\"]+?)\"[\\s]*,[\\s]*\"port\"[\\s]*:[\\s]*([0-9]+)[\\s]*,[\\s]*\"secret\"[\\s]*:[\\s]*\"([^\"]+?)\"",
+    "\"host\"[\\s]*:[\\s]*\"([^\"]+?)\"[\\s]*,[\\s]*\"port\"[\\s]*:[\\s]*([0-9]+)[\\s]*,[\\s]*\"secret\"[\\s]*:[\\s]*\"([^\"]+?)\"",
+
+    "tg://proxy\\?server=([^&]+?)&port=([0-9]+?)&secret=([^&\\s]+?)",
+    "tg://socks\\?server=([^&]+?)&port=([0-9]+?)&secret=([^&\\s]+?)",
+
+    "server=([^&\\s]+?)&port=([0-9]+?)&secret=([^&\\s]+?)",
+    "host=([^&\\s]+?)&port=([0-9]+?)&key=([^&\\s]+?)",
+
+    "([0-9a-zA-Z.-]+)[\\s\\-:]+([0-9]{1,5})[\\s\\-:]+([0-9a-fA-F\\s\\-=]{16,512})",
+    "([0-9a-zA-Z._-]+):([0-9]{1,5}):([0-9a-fA-F=]{16,512})",
+
+    "([0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3})[^0-9]*([0-9]{1,5})[^0-9a-fA-F]*([0-9a-fA-F\\s\\-=]{16,512})",
+    "([0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}):([0-9]{1,5}):([0-9a-fA-F=]{16,512})",
+
+    "([0-9a-fA-F]{32,512})[\\s@]+([^:\\s]+):([0-9]{1,5})",
+    "([0-9a-fA-F=]+)[\\s@]+([^:\\s]+):([0-9]{1,5})",
+
+    "address[\\s]*=[\\s]*([^\\r\\n]+?)[\\s]*port[\\s]*=[\\s]*([0-9]+)[\\s]*secret[\\s]*=[\\s]*([0-9a-fA-F=]+)",
+    "Server[\\s]*=[\\s]*([^\\r\\n]+?)[\\s]*Port[\\s]*=[\\s]*([0-9]+)[\\s]*Secret[\\s]*=[\\s]*([0-9a-fA-F=]+)",
+
+    "proxy[\\s]*:[\\s]*([^:]+):([0-9]+)[\\s]*key[\\s]*:[\\s]*([0-9a-fA-F]+)",
+    "mtproto[\\s]*:[\\s]*([^:]+):([0-9]+)[\\s]*secret[\\s]*:[\\s]*([0-9a-fA-F]+)",
+
+    "\"endpoint\"[\\s]*:[\\s]*\"([^:]+):([0-9]+)\"[\\s]*,[\\s]*\"secret\"[\\s]*:[\\s]*\"([^\"]+)\"",
+    "([0-9]+\\.[0-9]+\\.[0-9]+\\.[0-9]+)[\\s|\\-]+([0-9]+)[\\s|\\-]+([0-9a-fA-F]+)",
+    "([a-zA-Z0-9.-]+\\.[a-zA-Z]{2,}):([0-9]+):([0-9a-fA-F]{32,})",
+    "([0-9a-fA-F]{32,})@([0-9a-zA-Z.-]+):([0-9]{1,5})",
+
+    "([A-Za-z0-9+/=]{20,})[\\s@]+([^:\\s]+):([0-9]{1,5})",
+    "([A-Za-z0-9_-]{20,})[\\s@]+([^:\\s]+):([0-9]{1,5})",
+
+    "mtproxy://([^:]+):([0-9]+)\\?secret=([0-9a-fA-F]+)",
+    "socks5://([^:]+):([0-9]+)\\?secret=([0-9a-fA-F]+)",
+    "\\{\\s*\"s\"\\s*:\\s*\"([^\"]+)\"\\s*,\\s*\"p\"\\s*:\\s*([0-9]+)\\s*,\\s*\"k\"\\s*:\\s*\"([^\"]+)\"\\s*\\}",
+    "\\[\\s*\"([^\"]+)\"\\s*,\\s*([0-9]+)\\s*,\\s*\"([^\"]+)\"\\s*\\]",
+
+    "proxy_server[:=]\\s*([^\\s,]+)\\s*proxy_port[:=]\\s*([0-9]+)\\s*proxy_secret[:=]\\s*([^\\s,]+)",
+    "\\|\\s*([^|]+)\\s*\\|\\s*([0-9]+)\\s*\\|\\s*([^|]+)\\s*\\|",
+    "\\b([0-9a-fA-F]{64})\\b[^0-9a-fA-F]*([0-9a-zA-Z.-]+):([0-9]+)",
+
+    "Server\\s*[=:]\\s*([^\\r\\n]+)[\\r\\n]+Port\\s*[=:]\\s*([0-9]+)[\\r\\n]+Secret\\s*[=:]\\s*([0-9a-fA-F=]+)",
+    "Host\\s*[=:]\\s*([^\\r\\n]+)[\\r\\n]+Port\\s*[=:]\\s*([0-9]+)[\\r\\n]+Key\\s*[=:]\\s*([0-9a-fA-F=]+)",
+
+    NULL //* Sentinel
+};
@@ -0,0 +1,127 @@
+/**
+ * @file mtparse.h
+ * @brief libmtparse: MTProto proxy extraction as a reentrant C library.
+ *
+ * An MtpExtractor owns its compiled patterns, match data, stream window and
+ * per-document dedup set; nothing is shared between extractors and the library
+ * keeps no global state, so the rule is one extractor per thread (or a lock
+ * around a shared one). Patterns are compiled once, at creation.
+ *
+ *   static int on_candidate(void *user, const MtpCandidate *candidate) { ...; return 0; }
+ *
+ *   MtpOptions options = {0};
+ *   options.on_candidate = on_candidate;
+ *   options.user = &my_state;
+ *   MtpExtractor *extractor = mtp_extractor_create(&options);
+ *   mtp_extract_buffer(extractor, body, body_length);     // one whole document, or
+ *   mtp_extractor_feed(extractor, chunk, chunk_length);   // any number of chunks,
+ *   mtp_extractor_finish(extractor);                      // then flush
+ *   mtp_extractor_free(extractor);
+ *
+ * Candidates arrive pattern by pattern in document order, already normalized,
+ * validated and unique within the document. mtp_extract_buffer() reads the
+ * caller's bytes in place; streaming copies into a bounded window and scans it
+ * every stream_window bytes, which can split a match longer than stream_overlap.
+ *
+ * MtpStore is an optional dedup store with JSON and text export; it is not
+ * locked either, so keep one per thread or serialize access to it. mtproto_parser
+ * does not use it: its own store also carries probe results and source
+ * attribution, and shares only mtp_hash() and mtp_format_url() with this one.
+ *
+ * Build: lib/mtparse.c + data/data.c (make libmtparse.a); link with -lpcre2-8.
+ */
+
+#ifndef MTPARSE_H
+#define MTPARSE_H
+
+#include <stdio.h>
+#include "struct.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//* Default pattern table (data/data.c), NULL-terminated
+extern const char *const mtp_default_patterns[];
+
+//* Returns MTP_API_VERSION of the library actually linked
+int mtp_api_version(void);
+
+//* =============== EXTRACTOR ===============
+
+//* Compiles the pattern table; patterns that fail to compile are skipped (see
+//* mtp_extractor_pattern_count). Returns NULL on allocation failure or bad options.
+MtpExtractor *mtp_extractor_create(const MtpOptions *options);
+void mtp_extractor_free(MtpExtractor *extractor);
+
+//* Number of patterns that compiled; patterns keep their table index either way
+int mtp_extractor_pattern_count(const MtpExtractor *extractor);
+
+//* Replaces the user pointer passed to the callback and hooks (per-document context)
+void mtp_extractor_set_user(MtpExtractor *extractor, void *user);
+
+//* Extracts one complete document in place. Starts a fresh document (an unfinished
+//* stream is discarded). Returns the candidates accepted, or a negative MtpStatus.
+int mtp_extract_buffer(MtpExtractor *extractor, const char *data, size_t length);
+
+//* Appends a chunk of the current streamed document, scanning whenever a full window
+//* has accumulated. Returns the candidates accepted by this call, or a negative MtpStatus.
+int mtp_extractor_feed(MtpExtractor *extractor, const char *data, size_t length);
+
+//* Scans what is left of the streamed document and starts a new one. Returns the
+//* candidates accepted by this call, or a negative MtpStatus.
+int mtp_extractor_finish(MtpExtractor *extractor);
+
+//* Drops any streamed bytes and the dedup set without scanning
+void mtp_extractor_reset(MtpExtractor *extractor);
+
+//* =============== FIELDS ===============
+
+//* Drops control characters, collapses whitespace runs to one space and trims the ends
+void mtp_sanitize(char *text);
+
+//* Sanitizes the three fields in place and strips stray labels ("Server:", "Port:",
+//* "Key:", ...). Buffers must hold MTP_SERVER_SIZE / MTP_PORT_SIZE / MTP_SECRET_SIZE.
+void mtp_normalize_fields(char *server, char *port, char *secret);
+
+//* 1 when the normalized fields form a plausible MTProto proxy, else 0
+int mtp_validate(const char *server, const char *port, const char *secret);
+
+//* 64-bit FNV-1a of "server:port:secret[0..63]"; the dedup key everywhere
+uint64_t mtp_hash(const char *server, const char *port, const char *secret);
+
+//* 1 when server is dotted-decimal (digits and dots only)
+int mtp_is_ip(const char *server);
+
+//* Writes the tg://proxy link; returns snprintf's result
+int mtp_format_url(char *out, size_t size, const char *server, const char *port, const char *secret);
+
+//* =============== STORE ===============
+
+//* `expected` sizes the initial index (0 = small default); the store grows as needed
+MtpStore *mtp_store_create(size_t expected);
+void mtp_store_free(MtpStore *store);
+
+//* Copies a candidate in. Returns 1 when new, 0 when already stored (its `reports`
+//* count goes up), or a negative MtpStatus.
+int mtp_store_add(MtpStore *store, const MtpCandidate *candidate);
+
+//* Returns the index of the record with `hash`, or -1
+long mtp_store_find(const MtpStore *store, uint64_t hash);
+
+size_t mtp_store_count(const MtpStore *store);
+
+//* Records stay in insertion order; the pointer is valid until the next add
+const MtpProxy *mtp_store_get(const MtpStore *store, size_t index);
+
+//* {"proxies":[{"server","port","secret","url","type","hash","reports"}...]}; returns records written or MTP_ERROR_IO
+long mtp_store_write_json(const MtpStore *store, FILE *out);
+
+//* One tg:// link per line, the format of proxies.txt without its header; returns records written or MTP_ERROR_IO
+long mtp_store_write_text(const MtpStore *store, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
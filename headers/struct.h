@@ -1,6 +1,143 @@
+/**
+ * @file struct.h
+ * @brief Public types of libmtparse, the extraction library behind mtproto_parser.
+ *        Everything here is plain data: no type owns global state, and every
+ *        callback receives the user pointer it was registered with.
+ *        Function declarations live in mtparse.h.
+ */
+
 #ifndef STRUCT_H
 #define STRUCT_H
 
-// todo: structure mtproto_parser.c here
+#include <stddef.h>
+#include <stdint.h>
+
+#define MTP_API_VERSION 1 //** Bumped on any incompatible change to these types or mtparse.h
+
+#define MTP_MAX_PATTERNS 64 //** Patterns one extractor holds (the default table has 34)
+#define MTP_SERVER_SIZE 256 //** Buffer sizes of normalized fields, NUL included
+#define MTP_PORT_SIZE 16
+#define MTP_SECRET_SIZE 512
+#define MTP_URL_SIZE 1024 //** "tg://proxy?server=...&port=...&secret=..." fits the three fields above
+
+#define MTP_DEFAULT_MAX_CANDIDATES 5000 //** Accepted candidates per document before matching stops
+#define MTP_DEFAULT_STREAM_WINDOW (256 * 1024) //** Streamed bytes buffered before a scan pass
+#define MTP_DEFAULT_STREAM_OVERLAP 4096 //** Tail kept between passes; longer matches may be missed when streaming
+
+//* =============== LIBMTPARSE: STATUS CODES ===============
+
+/**
+ * @brief Negative results of the libmtparse entry points. Functions that count
+ *        (candidates, records) return the count on success instead of MTP_OK.
+ */
+typedef enum {
+    MTP_OK = 0,
+    MTP_ERROR_ARGUMENT = -1, //* NULL extractor/store or inconsistent options
+    MTP_ERROR_NOMEM = -2,   //* Allocation failed; the extractor is still usable after reset
+    MTP_ERROR_IO = -3      //* Export could not write the whole stream
+} MtpStatus;
+
+/**
+ * @brief Why a regex match did not become a candidate. The values are stable:
+ *        mtproto_parser passes them through its candidate_reject USDT probe.
+ */
+typedef enum {
+    MTP_REJECT_MISSING_GROUP = 1, //* A capture group did not participate
+    MTP_REJECT_FIELD_LENGTH,     //* Server, port or secret outside the accepted lengths
+    MTP_REJECT_INVALID,         //* mtp_validate() failed after normalization
+    MTP_REJECT_DUPLICATE,      //* Already extracted from this document
+    MTP_REJECT_FULL           //* max_candidates already reached (once per pattern, then it stops)
+} MtpRejectReason;
+
+/**
+ * @brief Extraction phases reported through MtpHooks.phase_time.
+ */
+typedef enum {
+    MTP_PHASE_NORMALIZE, //* mtp_normalize_fields() on one match
+    MTP_PHASE_VALIDATE  //* mtp_validate() + hashing + the document dedup check
+} MtpPhase;
+
+//* =============== LIBMTPARSE: CANDIDATES ===============
+
+/**
+ * @brief Borrowed byte range. Not NUL-terminated unless stated otherwise.
+ */
+typedef struct {
+    const char *data;
+    size_t length;
+} MtpSpan;
+
+/**
+ * @brief One validated, document-unique proxy as delivered to the candidate callback.
+ *        The spans are only valid until the callback returns: they point into the
+ *        caller's buffer when normalization kept the field verbatim (the common case,
+ *        flagged in `borrowed`), otherwise into the extractor's NUL-terminated scratch.
+ *        In streaming mode "the caller's buffer" is the extractor's stream window.
+ */
+typedef struct {
+    MtpSpan server;
+    MtpSpan port;
+    MtpSpan secret;
+    MtpSpan match;          //* Whole regex match, always borrowed
+    uint64_t match_offset; //* Offset of `match` from the start of the document
+    uint64_t hash;        //* mtp_hash() of the normalized fields
+    int pattern_index;   //* Index into the extractor's pattern table
+    int is_ip;          //* Server is a dotted-decimal address rather than a domain
+    unsigned borrowed; //* MTP_BORROWED_* bits
+} MtpCandidate;
+
+#define MTP_BORROWED_SERVER 1u
+#define MTP_BORROWED_PORT 2u
+#define MTP_BORROWED_SECRET 4u
+
+/**
+ * @brief Receives every accepted candidate; return nonzero to stop the current
+ *        document (the remaining patterns and bytes are skipped).
+ */
+typedef int (*MtpCandidateCallback)(void *user, const MtpCandidate *candidate);
+
+/**
+ * @brief Optional instrumentation. Unset members cost one NULL check; phase_time
+ *        additionally enables a clock read around each phase.
+ */
+typedef struct {
+    void (*pattern_begin)(void *user, int pattern_index);
+    void (*pattern_end)(void *user, int pattern_index, int accepted, size_t scanned_bytes);
+    void (*match)(void *user, int pattern_index, uint64_t start, uint64_t end);
+    void (*reject)(void *user, int pattern_index, MtpRejectReason reason, uint64_t match_offset);
+    void (*phase_time)(void *user, MtpPhase phase, uint64_t duration_ns);
+    int (*should_continue)(void *user); //* Polled between matches; return 0 to abandon the document
+} MtpHooks;
+
+/**
+ * @brief Extractor configuration, copied at creation. Zero-initialize and set
+ *        what you need: every zero member selects its default.
+ */
+typedef struct {
+    const char *const *patterns;       //* NULL-terminated PCRE2 table; NULL = mtp_default_patterns
+    MtpCandidateCallback on_candidate;
+    void *user;                      //* Passed to the callback and hooks (mtp_extractor_set_user changes it)
+    MtpHooks hooks;
+    int max_candidates;            //* 0 = MTP_DEFAULT_MAX_CANDIDATES
+    size_t stream_window;         //* 0 = MTP_DEFAULT_STREAM_WINDOW
+    size_t stream_overlap;       //* 0 = MTP_DEFAULT_STREAM_OVERLAP
+} MtpOptions;
+
+//* =============== LIBMTPARSE: STORE ===============
+
+/**
+ * @brief A record of an MtpStore: the candidate's fields copied out of the document.
+ */
+typedef struct {
+    char server[MTP_SERVER_SIZE];
+    char port[MTP_PORT_SIZE];
+    char secret[MTP_SECRET_SIZE];
+    uint64_t hash;
+    int is_ip;
+    unsigned reports; //* How many mtp_store_add() calls carried this proxy
+} MtpProxy;
+
+typedef struct MtpExtractor MtpExtractor;
+typedef struct MtpStore MtpStore;
 
-#endif 
\ No newline at end of file
+#endif
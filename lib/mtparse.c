@@ -0,0 +1,695 @@
+/**
+ * @file mtparse.c
+ * @brief libmtparse implementation: pattern matching, field normalization,
+ *        validation, document dedup, streaming windows and the export store.
+ *        No globals and no locks: every piece of state hangs off an
+ *        MtpExtractor or MtpStore. See headers/mtparse.h for the contract.
+ */
+
+#define _GNU_SOURCE //* memmem
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "../headers/mtparse.h"
+
+#define MTP_STORE_MIN_SLOTS 1024 //** Initial hash index size of an MtpStore (power of two)
+
+/**
+ * @brief Open-addressing set of 64-bit hashes; 0 marks an empty slot, so a zero
+ *        hash is tracked by its own flag.
+ */
+typedef struct {
+    uint64_t *slots;
+    size_t mask;
+    size_t *used;       //* Occupied slot indices, so clearing costs O(entries)
+    size_t used_count;
+    int zero_seen;
+} MtpHashSet;
+
+struct MtpExtractor {
+    MtpOptions options;
+    pcre2_code *codes[MTP_MAX_PATTERNS];
+    pcre2_match_data *match_data[MTP_MAX_PATTERNS];
+    int pattern_total;   //* Table entries, compiled or not
+    int compiled_count;
+    MtpHashSet seen;    //* Hashes accepted in the current document
+    int accepted;      //* Candidates accepted in the current document
+    int stopped;      //* Callback or should_continue ended the document
+    //* Streaming window: stream[0] is document offset stream_base
+    char *stream;
+    size_t stream_length;
+    size_t stream_capacity;
+    uint64_t stream_base;
+    uint64_t next_offset[MTP_MAX_PATTERNS]; //* Where each pattern resumes, as a document offset
+    //* Scratch for fields that normalization changed
+    char server[MTP_SERVER_SIZE];
+    char port[MTP_PORT_SIZE];
+    char secret[MTP_SECRET_SIZE];
+};
+
+struct MtpStore {
+    MtpProxy *records;
+    size_t count;
+    size_t capacity;
+    long *index;      //* Record index + 1 per slot; 0 = empty
+    size_t index_mask;
+};
+
+int mtp_api_version(void) {
+    return MTP_API_VERSION;
+}
+
+static uint64_t mtp_clock_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+//* =============== FIELDS: NORMALIZATION + VALIDATION ===============
+
+void mtp_sanitize(char *text) {
+    if (!text) return;
+
+    char *read_ptr = text;
+    char *write_ptr = text;
+    int space_flag = 0;
+
+    while (*read_ptr) {
+        if ((unsigned char)*read_ptr >= 0x20 && (unsigned char)*read_ptr < 0x7F) {
+            if (*read_ptr == ' ' || *read_ptr == '\t' || *read_ptr == '\n' || *read_ptr == '\r') {
+                if (!space_flag && write_ptr > text) {
+                    *write_ptr++ = ' ';
+                    space_flag = 1;
+                }
+            } else {
+                *write_ptr++ = *read_ptr;
+                space_flag = 0;
+            }
+        }
+        read_ptr++;
+    }
+    *write_ptr = '\0';
+    //* Trim trailing spaces
+    while (write_ptr > text && (*(write_ptr-1) == ' ' || *(write_ptr-1) == '\t')) {
+        *(--write_ptr) = '\0';
+    }
+}
+
+//* Strips each matching label in table order, re-sanitizing after every cut
+static void strip_labels(char *field, const char *const *labels, int label_count) {
+    for (int i = 0; i < label_count; i++) {
+        size_t prefix_len = strlen(labels[i]);
+        if (strncasecmp(field, labels[i], prefix_len) == 0) {
+            memmove(field, field + prefix_len, strlen(field) - prefix_len + 1);
+            mtp_sanitize(field);
+        }
+    }
+}
+
+void mtp_normalize_fields(char *server, char *port, char *secret) {
+    static const char *const server_labels[] = {"Server:", "server:", "SERVER:", "Host:", "host:", "HOST:"};
+    static const char *const port_labels[] = {"Port:", "port:", "PORT:"};
+    static const char *const secret_labels[] = {"Secret:", "secret:", "SECRET:", "Key:", "key:", "KEY:"};
+
+    mtp_sanitize(server);
+    mtp_sanitize(port);
+    mtp_sanitize(secret);
+    //* Remove accidental label prefixes (e.g., "Server: 1.2.3.4" → "1.2.3.4")
+    strip_labels(server, server_labels, 6);
+    strip_labels(port, port_labels, 3);
+    strip_labels(secret, secret_labels, 6);
+}
+
+int mtp_validate(const char *server, const char *port, const char *secret) {
+    if (!server || !port || !secret)
+        return 0;
+
+    size_t server_len = strlen(server);
+    size_t port_len = strlen(port);
+    size_t secret_len = strlen(secret);
+
+    if (server_len < 4 || server_len > 253)
+        return 0;
+
+    if (port_len < 1 || port_len > 15)
+        return 0;
+
+    if (secret_len < 16 || secret_len > 511)
+        return 0;
+    //* Validate port is number and in range
+    char *endptr;
+    long port_value = strtol(port, &endptr, 10);
+    if (endptr == port || *endptr != '\0' || port_value < 1 || port_value > 65535)
+        return 0;
+    //* Validate secret contains only hex chars and optional padding (=)
+    int valid_chars = 0;
+    int hex_chars = 0;
+    for (size_t i = 0; i < secret_len && i < 128; i++) {
+        unsigned char c = secret[i];
+        if ((c >= '0' && c <= '9') ||
+            (c >= 'a' && c <= 'f') ||
+            (c >= 'A' && c <= 'F')) {
+            valid_chars++;
+            hex_chars++;
+        } else if (c == '=') {
+            valid_chars++;
+        } else if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            return 0; //* Invalid character
+        }
+    }
+
+    return (valid_chars >= 16) && (hex_chars >= 8);
+}
+
+uint64_t mtp_hash(const char *server, const char *port, const char *secret) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *p = server; *p; p++)
+        hash = (hash ^ (uint64_t)(*p)) * 1099511628211ULL; //* FNV prime
+
+    hash = (hash ^ (uint64_t)':') * 1099511628211ULL;
+    for (const char *p = port; *p; p++)
+        hash = (hash ^ (uint64_t)(*p)) * 1099511628211ULL;
+
+    hash = (hash ^ (uint64_t)':') * 1099511628211ULL;
+    //* First 64 chars of secret (enough for uniqueness)
+    for (int i = 0; i < 64 && secret[i]; i++)
+        hash = (hash ^ (uint64_t)(secret[i])) * 1099511628211ULL;
+
+    return hash;
+}
+
+int mtp_is_ip(const char *server) {
+    for (const char *s = server; *s; s++) {
+        if ((*s < '0' || *s > '9') && *s != '.')
+            return 0;
+    }
+    return 1;
+}
+
+int mtp_format_url(char *out, size_t size, const char *server, const char *port, const char *secret) {
+    return snprintf(out, size, "tg://proxy?server=%s&port=%s&secret=%s", server, port, secret);
+}
+
+//* =============== EXTRACTOR: DOCUMENT DEDUP SET ===============
+
+static int hash_set_init(MtpHashSet *set, int max_entries) {
+    size_t slots = 16;
+    while (slots < (size_t)max_entries * 2)
+        slots <<= 1;
+    set->slots = calloc(slots, sizeof(uint64_t));
+    set->used = malloc((size_t)max_entries * sizeof(size_t));
+    set->mask = slots - 1;
+    set->used_count = 0;
+    set->zero_seen = 0;
+    return set->slots && set->used;
+}
+
+static void hash_set_clear(MtpHashSet *set) {
+    for (size_t i = 0; i < set->used_count; i++)
+        set->slots[set->used[i]] = 0;
+    set->used_count = 0;
+    set->zero_seen = 0;
+}
+
+//* Returns 1 when `hash` was added, 0 when present. The extractor never inserts
+//* more than max_entries, so the table stays at most half full.
+static int hash_set_insert(MtpHashSet *set, uint64_t hash) {
+    if (hash == 0) {
+        int added = !set->zero_seen;
+        set->zero_seen = 1;
+        return added;
+    }
+    size_t slot = (size_t)(hash ^ (hash >> 29)) & set->mask;
+    while (set->slots[slot] != 0) {
+        if (set->slots[slot] == hash)
+            return 0;
+        slot = (slot + 1) & set->mask;
+    }
+    set->slots[slot] = hash;
+    set->used[set->used_count++] = slot;
+    return 1;
+}
+
+//* =============== EXTRACTOR: LIFECYCLE ===============
+
+MtpExtractor *mtp_extractor_create(const MtpOptions *options) {
+    if (!options || options->max_candidates < 0)
+        return NULL;
+    MtpExtractor *extractor = calloc(1, sizeof(MtpExtractor));
+    if (!extractor)
+        return NULL;
+    extractor->options = *options;
+    MtpOptions *own = &extractor->options;
+    if (!own->patterns)
+        own->patterns = mtp_default_patterns;
+    if (own->max_candidates == 0)
+        own->max_candidates = MTP_DEFAULT_MAX_CANDIDATES;
+    if (own->stream_window == 0)
+        own->stream_window = MTP_DEFAULT_STREAM_WINDOW;
+    if (own->stream_overlap == 0)
+        own->stream_overlap = MTP_DEFAULT_STREAM_OVERLAP;
+    if (own->stream_overlap >= own->stream_window)
+        own->stream_overlap = own->stream_window / 2;
+
+    if (!hash_set_init(&extractor->seen, own->max_candidates)) {
+        mtp_extractor_free(extractor);
+        return NULL;
+    }
+
+    while (extractor->pattern_total < MTP_MAX_PATTERNS && own->patterns[extractor->pattern_total]) {
+        int index = extractor->pattern_total++;
+        int error_code;
+        PCRE2_SIZE error_offset;
+        pcre2_code *code = pcre2_compile((PCRE2_SPTR8)own->patterns[index], PCRE2_ZERO_TERMINATED,
+                                         PCRE2_MULTILINE | PCRE2_DOTALL | PCRE2_CASELESS, //* Flexible matching
+                                         &error_code, &error_offset, NULL);
+        if (!code)
+            continue; //* Keeps its index; mtp_extractor_pattern_count() reports the shortfall
+        pcre2_match_data *match_data = pcre2_match_data_create_from_pattern(code, NULL);
+        if (!match_data) {
+            pcre2_code_free(code);
+            mtp_extractor_free(extractor);
+            return NULL;
+        }
+        extractor->codes[index] = code;
+        extractor->match_data[index] = match_data;
+        extractor->compiled_count++;
+    }
+    return extractor;
+}
+
+void mtp_extractor_free(MtpExtractor *extractor) {
+    if (!extractor)
+        return;
+    for (int i = 0; i < extractor->pattern_total; i++) {
+        pcre2_match_data_free(extractor->match_data[i]);
+        pcre2_code_free(extractor->codes[i]);
+    }
+    free(extractor->seen.slots);
+    free(extractor->seen.used);
+    free(extractor->stream);
+    free(extractor);
+}
+
+int mtp_extractor_pattern_count(const MtpExtractor *extractor) {
+    return extractor ? extractor->compiled_count : 0;
+}
+
+void mtp_extractor_set_user(MtpExtractor *extractor, void *user) {
+    if (extractor)
+        extractor->options.user = user;
+}
+
+void mtp_extractor_reset(MtpExtractor *extractor) {
+    if (!extractor)
+        return;
+    hash_set_clear(&extractor->seen);
+    extractor->accepted = 0;
+    extractor->stopped = 0;
+    extractor->stream_length = 0;
+    extractor->stream_base = 0;
+    memset(extractor->next_offset, 0, sizeof(extractor->next_offset));
+}
+
+//* =============== EXTRACTOR: MATCH → CANDIDATE ===============
+
+//* Copies a capture into `scratch` and normalizes it later; returns the borrowed
+//* span when the normalized text still occurs verbatim inside the capture.
+static MtpSpan field_span(const char *capture, size_t capture_length, const char *normalized, unsigned flag, unsigned *borrowed) {
+    size_t length = strlen(normalized);
+    const char *inside = length ? memmem(capture, capture_length, normalized, length) : NULL;
+    if (inside) {
+        *borrowed |= flag;
+        return (MtpSpan){ inside, length };
+    }
+    return (MtpSpan){ normalized, length };
+}
+
+static int should_continue(const MtpExtractor *extractor) {
+    const MtpOptions *options = &extractor->options;
+    return !options->hooks.should_continue || options->hooks.should_continue(options->user);
+}
+
+//* Turns one successful match into a candidate. Returns 1 when accepted.
+static int process_match(MtpExtractor *extractor, int pattern_index, const char *subject,
+                         uint64_t subject_base, const PCRE2_SIZE *match_vector) {
+    const MtpOptions *options = &extractor->options;
+    const MtpHooks *hooks = &options->hooks;
+    uint64_t match_offset = subject_base + match_vector[0];
+
+    for (int i = 2; i <= 7; i += 2) {
+        if (match_vector[i] == PCRE2_UNSET || match_vector[i+1] == PCRE2_UNSET) {
+            if (hooks->reject)
+                hooks->reject(options->user, pattern_index, MTP_REJECT_MISSING_GROUP, match_offset);
+            return 0;
+        }
+    }
+    size_t server_length = match_vector[3] - match_vector[2];
+    size_t port_length = match_vector[5] - match_vector[4];
+    size_t secret_length = match_vector[7] - match_vector[6];
+    if (!(server_length > 0 && server_length < MTP_SERVER_SIZE &&
+          port_length > 0 && port_length < MTP_PORT_SIZE &&
+          secret_length >= 16 && secret_length < MTP_SECRET_SIZE)) {
+        if (hooks->reject)
+            hooks->reject(options->user, pattern_index, MTP_REJECT_FIELD_LENGTH, match_offset);
+        return 0;
+    }
+
+    uint64_t phase_start = hooks->phase_time ? mtp_clock_ns() : 0;
+    memcpy(extractor->server, subject + match_vector[2], server_length);
+    memcpy(extractor->port, subject + match_vector[4], port_length);
+    memcpy(extractor->secret, subject + match_vector[6], secret_length);
+    extractor->server[server_length] = '\0';
+    extractor->port[port_length] = '\0';
+    extractor->secret[secret_length] = '\0';
+    mtp_normalize_fields(extractor->server, extractor->port, extractor->secret);
+    if (hooks->phase_time) {
+        uint64_t now = mtp_clock_ns();
+        hooks->phase_time(options->user, MTP_PHASE_NORMALIZE, now - phase_start);
+        phase_start = now;
+    }
+
+    if (!mtp_validate(extractor->server, extractor->port, extractor->secret)) {
+        if (hooks->phase_time)
+            hooks->phase_time(options->user, MTP_PHASE_VALIDATE, mtp_clock_ns() - phase_start);
+        if (hooks->reject)
+            hooks->reject(options->user, pattern_index, MTP_REJECT_INVALID, match_offset);
+        return 0;
+    }
+    uint64_t hash = mtp_hash(extractor->server, extractor->port, extractor->secret);
+    int fresh = hash_set_insert(&extractor->seen, hash);
+    if (hooks->phase_time)
+        hooks->phase_time(options->user, MTP_PHASE_VALIDATE, mtp_clock_ns() - phase_start);
+    if (!fresh) {
+        if (hooks->reject)
+            hooks->reject(options->user, pattern_index, MTP_REJECT_DUPLICATE, match_offset);
+        return 0;
+    }
+
+    MtpCandidate candidate = {0};
+    candidate.server = field_span(subject + match_vector[2], server_length, extractor->server, MTP_BORROWED_SERVER, &candidate.borrowed);
+    candidate.port = field_span(subject + match_vector[4], port_length, extractor->port, MTP_BORROWED_PORT, &candidate.borrowed);
+    candidate.secret = field_span(subject + match_vector[6], secret_length, extractor->secret, MTP_BORROWED_SECRET, &candidate.borrowed);
+    candidate.match = (MtpSpan){ subject + match_vector[0], match_vector[1] - match_vector[0] };
+    candidate.match_offset = match_offset;
+    candidate.hash = hash;
+    candidate.pattern_index = pattern_index;
+    candidate.is_ip = mtp_is_ip(extractor->server);
+
+    extractor->accepted++;
+    if (options->on_candidate && options->on_candidate(options->user, &candidate))
+        extractor->stopped = 1;
+    return 1;
+}
+
+//* =============== EXTRACTOR: SCAN PASSES ===============
+
+//* Runs every pattern over subject[0, length), which starts at document offset
+//* `base`. Matches ending beyond `limit` are left for the next pass (the stream
+//* may extend them); a final pass uses limit == length. next_offset[] holds each
+//* pattern's resume point as a document offset. Returns candidates accepted.
+static int scan_pass(MtpExtractor *extractor, const char *subject, size_t length, uint64_t base, size_t limit, uint64_t *next_offset) {
+    const MtpOptions *options = &extractor->options;
+    const MtpHooks *hooks = &options->hooks;
+    int accepted_before = extractor->accepted;
+
+    for (int pattern_index = 0; pattern_index < extractor->pattern_total && !extractor->stopped; pattern_index++) {
+        if (!should_continue(extractor)) {
+            extractor->stopped = 1;
+            break;
+        }
+        pcre2_code *code = extractor->codes[pattern_index];
+        if (!code)
+            continue;
+        pcre2_match_data *match_data = extractor->match_data[pattern_index];
+        if (hooks->pattern_begin)
+            hooks->pattern_begin(options->user, pattern_index);
+
+        int pattern_accepted = 0;
+        int deferred = 0;
+        PCRE2_SIZE current_offset = next_offset[pattern_index] > base ? (PCRE2_SIZE)(next_offset[pattern_index] - base) : 0;
+        //* Find all matches in this window
+        while (current_offset < length && !extractor->stopped) {
+            if (!should_continue(extractor)) {
+                extractor->stopped = 1;
+                break;
+            }
+            int match_result = pcre2_match(code, (PCRE2_SPTR8)subject, length, current_offset, 0, match_data, NULL);
+            if (match_result < 4) //* Need at least 3 capture groups
+                break;
+
+            PCRE2_SIZE *match_vector = pcre2_get_ovector_pointer(match_data);
+            if (match_vector[1] > limit) {
+                deferred = 1; //* Might still grow: retry once more text has arrived
+                break;
+            }
+            if (hooks->match)
+                hooks->match(options->user, pattern_index, base + match_vector[0], base + match_vector[1]);
+            if (extractor->accepted >= options->max_candidates) {
+                //* Reported once per pattern; the rest of the document is not matched
+                if (hooks->reject)
+                    hooks->reject(options->user, pattern_index, MTP_REJECT_FULL, base + match_vector[0]);
+                break;
+            }
+            pattern_accepted += process_match(extractor, pattern_index, subject, base, match_vector);
+
+            current_offset = match_vector[1] + 1;
+        }
+        //* No match left before the limit means none can start there once the stream grows
+        size_t resume = current_offset;
+        if (!deferred && resume < limit)
+            resume = limit;
+        next_offset[pattern_index] = base + resume;
+
+        if (hooks->pattern_end)
+            hooks->pattern_end(options->user, pattern_index, pattern_accepted, length);
+    }
+    return extractor->accepted - accepted_before;
+}
+
+int mtp_extract_buffer(MtpExtractor *extractor, const char *data, size_t length) {
+    if (!extractor || (!data && length > 0))
+        return MTP_ERROR_ARGUMENT;
+    mtp_extractor_reset(extractor);
+    if (length == 0)
+        return 0;
+    uint64_t next_offset[MTP_MAX_PATTERNS] = {0};
+    int accepted = scan_pass(extractor, data, length, 0, length, next_offset);
+    hash_set_clear(&extractor->seen);
+    extractor->accepted = 0;
+    extractor->stopped = 0;
+    return accepted;
+}
+
+//* Scans the stream window and drops the prefix every pattern has moved past
+static int stream_scan(MtpExtractor *extractor, int final_pass) {
+    size_t length = extractor->stream_length;
+    if (length == 0)
+        return 0;
+    size_t limit = final_pass ? length : length - extractor->options.stream_overlap;
+    int accepted = scan_pass(extractor, extractor->stream, length, extractor->stream_base, limit, extractor->next_offset);
+
+    uint64_t keep_from = extractor->stream_base + length;
+    for (int i = 0; i < extractor->pattern_total; i++) {
+        if (extractor->codes[i] && extractor->next_offset[i] < keep_from)
+            keep_from = extractor->next_offset[i];
+    }
+    size_t drop = (size_t)(keep_from - extractor->stream_base);
+    if (drop > 0) {
+        memmove(extractor->stream, extractor->stream + drop, length - drop + 1);
+        extractor->stream_length = length - drop;
+        extractor->stream_base = keep_from;
+    }
+    return accepted;
+}
+
+int mtp_extractor_feed(MtpExtractor *extractor, const char *data, size_t length) {
+    if (!extractor || (!data && length > 0))
+        return MTP_ERROR_ARGUMENT;
+    int accepted = 0;
+    while (length > 0 && !extractor->stopped) {
+        size_t window = extractor->options.stream_window;
+        if (extractor->stream_capacity < window + 1) {
+            char *grown = realloc(extractor->stream, window + 1); //* NUL-terminated like a fetched body
+            if (!grown)
+                return MTP_ERROR_NOMEM;
+            extractor->stream = grown;
+            extractor->stream_capacity = window + 1;
+        }
+        size_t room = window - extractor->stream_length;
+        size_t take = length < room ? length : room;
+        memcpy(extractor->stream + extractor->stream_length, data, take);
+        extractor->stream_length += take;
+        extractor->stream[extractor->stream_length] = '\0';
+        data += take;
+        length -= take;
+        if (extractor->stream_length == window) {
+            accepted += stream_scan(extractor, 0);
+            if (extractor->stream_length > window / 2) {
+                //* A match longer than the overlap is holding the window: settle it as final
+                size_t held = extractor->stream_length;
+                accepted += scan_pass(extractor, extractor->stream, held, extractor->stream_base, held, extractor->next_offset);
+                extractor->stream_base += held;
+                extractor->stream_length = 0;
+            }
+        }
+    }
+    return accepted;
+}
+
+int mtp_extractor_finish(MtpExtractor *extractor) {
+    if (!extractor)
+        return MTP_ERROR_ARGUMENT;
+    int accepted = extractor->stopped ? 0 : stream_scan(extractor, 1);
+    mtp_extractor_reset(extractor);
+    return accepted;
+}
+
+//* =============== STORE: DEDUP + EXPORT ===============
+
+MtpStore *mtp_store_create(size_t expected) {
+    MtpStore *store = calloc(1, sizeof(MtpStore));
+    if (!store)
+        return NULL;
+    size_t slots = MTP_STORE_MIN_SLOTS;
+    while (slots < expected * 2)
+        slots <<= 1;
+    store->index = calloc(slots, sizeof(long));
+    if (!store->index) {
+        free(store);
+        return NULL;
+    }
+    store->index_mask = slots - 1;
+    return store;
+}
+
+void mtp_store_free(MtpStore *store) {
+    if (!store)
+        return;
+    free(store->records);
+    free(store->index);
+    free(store);
+}
+
+static size_t store_slot(const MtpStore *store, uint64_t hash) {
+    size_t slot = (size_t)(hash ^ (hash >> 29)) & store->index_mask;
+    while (store->index[slot] != 0 && store->records[store->index[slot] - 1].hash != hash)
+        slot = (slot + 1) & store->index_mask;
+    return slot;
+}
+
+//* Doubles the index once it is half full and reinserts every record
+static int store_grow_index(MtpStore *store) {
+    size_t slots = (store->index_mask + 1) * 2;
+    long *index = calloc(slots, sizeof(long));
+    if (!index)
+        return MTP_ERROR_NOMEM;
+    free(store->index);
+    store->index = index;
+    store->index_mask = slots - 1;
+    for (size_t i = 0; i < store->count; i++)
+        store->index[store_slot(store, store->records[i].hash)] = (long)i + 1;
+    return MTP_OK;
+}
+
+long mtp_store_find(const MtpStore *store, uint64_t hash) {
+    if (!store)
+        return -1;
+    long entry = store->index[store_slot(store, hash)];
+    return entry - 1;
+}
+
+static void span_copy(char *out, size_t size, MtpSpan span) {
+    size_t length = span.length < size - 1 ? span.length : size - 1;
+    memcpy(out, span.data, length);
+    out[length] = '\0';
+}
+
+int mtp_store_add(MtpStore *store, const MtpCandidate *candidate) {
+    if (!store || !candidate)
+        return MTP_ERROR_ARGUMENT;
+    size_t slot = store_slot(store, candidate->hash);
+    if (store->index[slot] != 0) {
+        store->records[store->index[slot] - 1].reports++;
+        return 0;
+    }
+    if ((store->count + 1) * 2 > store->index_mask + 1) {
+        if (store_grow_index(store) != MTP_OK)
+            return MTP_ERROR_NOMEM;
+        slot = store_slot(store, candidate->hash);
+    }
+    if (store->count == store->capacity) {
+        size_t capacity = store->capacity ? store->capacity * 2 : 256;
+        MtpProxy *records = realloc(store->records, capacity * sizeof(MtpProxy));
+        if (!records)
+            return MTP_ERROR_NOMEM;
+        store->records = records;
+        store->capacity = capacity;
+    }
+    MtpProxy *record = &store->records[store->count];
+    span_copy(record->server, sizeof(record->server), candidate->server);
+    span_copy(record->port, sizeof(record->port), candidate->port);
+    span_copy(record->secret, sizeof(record->secret), candidate->secret);
+    record->hash = candidate->hash;
+    record->is_ip = candidate->is_ip;
+    record->reports = 1;
+    store->index[slot] = (long)++store->count;
+    return 1;
+}
+
+size_t mtp_store_count(const MtpStore *store) {
+    return store ? store->count : 0;
+}
+
+const MtpProxy *mtp_store_get(const MtpStore *store, size_t index) {
+    return store && index < store->count ? &store->records[index] : NULL;
+}
+
+//* Normalized fields are printable ASCII, so only quotes and backslashes need escaping
+static void write_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const char *p = text; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            fputc('\\', out);
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+long mtp_store_write_json(const MtpStore *store, FILE *out) {
+    if (!store || !out)
+        return MTP_ERROR_ARGUMENT;
+    char url[MTP_URL_SIZE];
+    fputs("{\"proxies\":[", out);
+    for (size_t i = 0; i < store->count; i++) {
+        const MtpProxy *record = &store->records[i];
+        mtp_format_url(url, sizeof(url), record->server, record->port, record->secret);
+        fputs(i ? ",\n{\"server\":" : "\n{\"server\":", out);
+        write_json_string(out, record->server);
+        fputs(",\"port\":", out);
+        write_json_string(out, record->port);
+        fputs(",\"secret\":", out);
+        write_json_string(out, record->secret);
+        fputs(",\"url\":", out);
+        write_json_string(out, url);
+        fprintf(out, ",\"type\":\"%s\",\"hash\":\"%016llx\",\"reports\":%u}",
+                record->is_ip ? "IPv4" : "Domain", (unsigned long long)record->hash, record->reports);
+    }
+    fputs("\n]}\n", out);
+    return ferror(out) ? MTP_ERROR_IO : (long)store->count;
+}
+
+long mtp_store_write_text(const MtpStore *store, FILE *out) {
+    if (!store || !out)
+        return MTP_ERROR_ARGUMENT;
+    char url[MTP_URL_SIZE];
+    for (size_t i = 0; i < store->count; i++) {
+        const MtpProxy *record = &store->records[i];
+        mtp_format_url(url, sizeof(url), record->server, record->port, record->secret);
+        fprintf(out, "%s\n", url);
+    }
+    return ferror(out) ? MTP_ERROR_IO : (long)store->count;
+}
@@ -18,7 +18,7 @@
 //** The script autonomously parses multiple added sources and extracts data from them in .json and .txt formats, after which it correctly writes them,
 //** which can help you when creating a script that will take data from a file and make it readable. 
 //** For security, I use User-Agent Rotation, Request Throttling & Random Delays, Connection Hardening, as described in detail in README.md 
-//* Start: "gcc -o mtpro_parser mtproto_parser.c -lcurl -lpcre2-8-ljansson"
+//* Start: "gcc -o mtpro_parser mtproto_parser.c lib/mtparse.c data/data.c -lcurl -lpcre2-8 -ljansson -lz -lm -lpthread"
 
 //* All Includes
 #define PCRE2_CODE_UNIT_WIDTH 8
@@ -26,41 +26,162 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <curl/curl.h>
+#include <zlib.h>
 #include <time.h>
 #include <ctype.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <unistd.h>
 #include <signal.h>
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <errno.h>
 #include <stdatomic.h>
+#include <math.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/types.h>
+#include <poll.h>
+#include <sched.h>
+#include <fcntl.h>
 #include <jansson.h>
+#include "headers/mtparse.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/signalfd.h>
+#endif
+
+//* USDT probes: on whenever systemtap-sdt-dev is installed (build with -DMTP_NO_USDT to omit)
+#if !defined(MTP_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define MTP_HAVE_USDT 1
+#endif
+#endif
 
 #ifndef MIN
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #endif
 
-#define PROXY_CAPACITY 1000000 //** Maximum number of unique proxies to store in memory
+#ifndef PROXY_CAPACITY
+#define PROXY_CAPACITY 1000000 //** Maximum number of unique proxies to store in memory (benches raise it with -D)
+#endif
 #define URL_CAPACITY 800 //** Maximum number of source URLs to parse
 #define BUFFER_CAPACITY (100 * 1024 * 1024) //** Max download buffer size per request(100MB)
+#define BODY_CAPACITY_LIMIT_MB 1024 //** Ceiling for max_body_mb; also bounds the bodies read back from archives
 #define MAX_THREAD_COUNT 50 //** Maximum number of worker threads
 #define CONCURRENT_DOWNLOADS 20 //** Max parallel download per batch
 #define SAVE_INTERVAL 10 //** Auto-save result every N seconds
+#define STATS_INTERVAL 30 //** Console statistics every N seconds
 #define MAX_RETRY_ATTEMPTS 3 //** (Reselved requiest timeout retry logic)
 #define CONNECTION_TIMEOUT 25 //** Total request timeout in seconds
+#define CONNECT_TIMEOUT 10 //** TCP + TLS connect timeout in seconds
 #define USER_AGENT_POOL_SIZE 30 //** Number of User-Agent strings to rotate
 #define MAX_PATTERNS 45 //** Number of regex patterns for proxy extraction
 #define PROXY_BATCH_SIZE 5000 //** Max proxies to hold in temporary batch during parsing 
 #define ROTATION_DELAY_MS 100 //** Max random delay(ms) before each request
+#define PROBE_BUDGET 200 //** Max proxies probed (TCP handshake) per cycle
+#define PROBE_BUDGET_LIMIT 20000 //** Ceiling for probe_budget (--probe-budget, config file)
+#define PROBE_THREADS 16 //** Parallel probe workers per verification pass (<= MAX_THREAD_COUNT)
+#define PROBE_TIMEOUT_MS 3000 //** Connect timeout for a single probe
+#define PROBE_REFRESH_INTERVAL 21600 //** Re-probe a proxy after N seconds (4 probes/day keeps history ~10 bytes/day)
+#define SOURCE_MASK_WORDS 2 //** Bits per proxy remembering which sources reported it (exact up to 128 sources)
+#define REPUTATION_MIN_SAMPLES 10 //** Probed proxies needed before a source can be throttled
+#define REPUTATION_THROTTLE_SCORE 0.25 //** Sources scoring below this are fetched less often
+#define REPUTATION_MAX_SKIP 8 //** Max cycles a poor (or failing) source is skipped
+#define HISTORY_SEGMENT_BYTES 48 //** Encoded payload per history segment (~24 probes)
+#define HISTORY_SEGMENTS 8 //** Ring segments per proxy; the oldest is overwritten when full
+#define HISTORY_TIME_UNIT 300 //** History timestamp resolution in seconds (6h delta fits one varint byte)
+#define HISTORY_RETENTION_DAYS 60 //** Histories of proxies not seen again are dropped after N days
+#define HISTORY_FILE "proxy_history.bin" //** Persistent store for probe histories
+#define METRICS_PORT 9464 //** Prometheus /metrics port (0 disables the endpoint)
+#define METRICS_BIND_ADDRESS "127.0.0.1" //** Use "0.0.0.0" to allow remote scrapes
+#define HISTOGRAM_MAX_BUCKETS 12 //** Finite buckets per histogram (+Inf is implicit)
+#define STATS_FILE "parser_stats.txt" //** Human-readable statistics written on every save
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO //** Messages below this severity are dropped at the call site
+#define LOG_RING_COUNT 96 //** Per-thread log rings (threads beyond this drop messages)
+#define LOG_RING_SLOTS 128 //** Messages buffered per thread before new ones are dropped
+#define LOG_MESSAGE_SIZE 240 //** Max formatted message length (longer ones are truncated)
+#define LOG_FOUND_PROXY_SAMPLE 100 //** Log 1 in N "Found proxy" events (per thread)
+#define TRACE_MAX_EVENTS_PER_THREAD 65536 //** Trace events kept per thread per dump (extra ones are dropped)
+#define TRACE_DEFAULT_FILE "trace.json" //** Chrome trace-event output (override with --trace-file)
+#define STATS_SHARD_COUNT 128 //** Per-thread counter shards (threads beyond this share one overflow shard)
+#define CACHE_LINE_SIZE 64 //** Shards are padded to this so no two threads write the same line
+#define HW_COUNTERS_FILE "hw_counters.json" //** Per-pattern/stage/source hardware counter report (--hw-counters)
+#define MEMORY_BUDGET_MB 0 //** Budget mode: cap on max(accounted memory, RSS); 0 disables (override with --memory-budget)
+#define MEMORY_HIGH_WATER 0.90 //** New transfers and exports wait once usage passes this fraction of the budget
+#define MEMORY_EXPORT_BYTES_PER_PROXY 2048 //** Estimated jansson DOM cost per proxy when reserving for an export
+#define CYCLE_PAUSE_SECONDS 8 //** Pause between cycles (override with --cycle-pause)
+#define CAPTURE_HEADER_BYTES 8192 //** Response headers kept per captured transfer (longer ones are truncated)
+#define SIMULATION_HOURS 24 //** Virtual hours a --simulate run covers (override with --sim-hours)
+#define SIMULATION_MAX_HOURS 87600 //** Longest --sim-hours (ten virtual years; keeps the end time in range)
+#define SIMULATION_EPOCH 1700000000 //** Unix time the virtual clock starts at, fixed so runs are reproducible
+#define SIMULATION_MAX_LISTED 250 //** Proxies a modelled source can list at once (one address octet)
+#define PIPELINE_QUEUE_DEPTH 8 //** Finished items allowed to wait for the next stage; a full queue stalls the stage feeding it
+#define PIPELINE_DECODE_THREADS 1 //** Threads inflating gzip/deflate bodies (override with --decode-threads)
+#define PIPELINE_EXTRACT_THREADS 0 //** Pattern matching threads; 0 = one per online CPU (override with --extract-threads)
+#define PIPELINE_COMMIT_THREADS 1 //** Store commit threads; extra ones mostly queue on storage_mutex (override with --commit-threads)
+#define PIPELINE_MAX_QUEUE_DEPTH 256 //** Ceiling for queue_depth; rings are sized for it so a reload never reallocates them
+#define CONFIG_LINE_SIZE 1024 //** Longest accepted config file line
+#define DAEMON_LOG_FILE "mtproto_parser.log" //** stdout/stderr of --daemon when no log_file is configured
+#define SHARD_MAX_NODES 64 //** Names a shard_nodes list may hold
+#define SHARD_NODE_NAME_SIZE 64 //** Longest node name, NUL included
+#define SHARD_VIRTUAL_NODES 128 //** Ring points per node; more points even out the shares
+#define SYNC_PORT 0 //** Set reconciliation listener for peer instances (0 disables it)
+#define SYNC_BIND_ADDRESS "127.0.0.1" //** Peers connect here; the listener trusts whoever reaches it
+#define SYNC_INTERVAL 60 //** Seconds between reconciliations with the sync_peers
+#define SYNC_MAX_PEERS 16 //** Addresses a sync_peers list may hold
+#define SYNC_ADDRESS_SIZE 128 //** Longest "host:port" peer address, NUL included
+#define SYNC_HASH_COUNT 3 //** Sketch cells each proxy hash is added to (one per sub-table)
+#define SYNC_MIN_CELLS 48 //** First sketch sent to a new peer (16 bytes per cell, peels ~25 differences)
+#define SYNC_MAX_CELLS (SYNC_MIN_CELLS << 12) //** Largest sketch (3 MiB); a bigger difference sends the full hash list
+#define SYNC_MAX_REQUEST_MB 64 //** Largest request body or reply a sync exchange accepts
+#define SYNC_MAX_RECORDS 50000 //** Records per reply or push; a larger difference takes several exchanges
+#define SYNC_IO_TIMEOUT_MS 10000 //** Listener gives up on a peer that stalls this long mid-request
 
 //** =============== DATA STRUCTURES ===============
+/**
+ * @brief Fixed-size chunk of a proxy's probe time series.
+ *        Each sample is a varint delta (in HISTORY_TIME_UNIT) from the previous
+ *        sample followed by one status byte: bit 7 = reachable, bits 0-6 =
+ *        log-quantized connect latency. A typical probe costs 2 bytes.
+ */
+typedef struct {
+    uint32_t base_time;   //* First sample, in HISTORY_TIME_UNIT since the epoch
+    uint32_t last_time;  //* Last sample (delta reference for the next one)
+    uint8_t used;       //* Payload bytes in use
+    uint8_t count;     //* Samples in this segment
+    uint8_t data[HISTORY_SEGMENT_BYTES];
+} HistorySegment;
+
+/**
+ * @brief Ring of history segments, allocated on a proxy's first probe.
+ */
+typedef struct {
+    uint8_t head;      //* Segment currently being appended to
+    uint8_t filled;   //* Segments holding data (<= HISTORY_SEGMENTS)
+    HistorySegment segments[HISTORY_SEGMENTS];
+} ProbeHistory;
+
+/**
+ * @brief Aggregate answer to "how did this proxy do since time X?".
+ */
+typedef struct {
+    int samples;            //* Probes in the window
+    int reachable;         //* ...of which succeeded
+    int avg_latency_ms;   //* Mean decoded latency of successful probes
+    time_t first_sample; //* Oldest probe still retained (0 = none)
+} HistorySummary;
+
 /**
  * @brief Represents a single validated MTProto proxy record.
  *        Includes metadata for tracking, deduplication, and export.
@@ -78,8 +199,12 @@ typedef struct {
     time_t discovery_time; //* Timestamp when proxy was first found
     time_t last_verified; //* Last time proxy was confirmed valid
     atomic_int active;   //* Whether this proxy is currently usable
-    atomic_int verified;//* Reserved for future active probing
-    int speed_score;   //* Proxy perfomance rating (default: 50)
+    atomic_int verified;//* Last probe outcome: 0 = never probed, 1 = reachable, -1 = unreachable
+    int speed_score;   //* Proxy perfomance rating (default: 50, updated from probe latency)
+    int source_index; //* Index in TARGET_URLS of the first source that reported it
+    time_t last_probed; //* Timestamp of the last verification probe (0 = never)
+    uint64_t reporter_mask[SOURCE_MASK_WORDS]; //* Sources that reported this proxy (bit = index % 128)
+    ProbeHistory *history; //* Compressed probe outcomes (NULL until first probe)
 } ProxyRecord;
 
 /**
@@ -97,37 +222,302 @@ typedef struct {
  */
 typedef struct {
     char *url;              //* URL fo fetch (dynamically allocated)
+    int source_index;      //* Index in TARGET_URLS (used for reputation tracking)
     int retry_count;       //* Number of retry attempts (not yes used)
     int priority;         //* Priority level (reselved for future)
     int use_proxy;       //* Whether to route this request through an external proxy (reserved)
+    uint64_t virtual_start_ns; //* Spawn time on the virtual clock (--simulate only)
 } DownloadTask;
 /**
  * @brief Global statistics tracker for monitoring parser performance.
+ *        Monotonic counters live in per-thread shards (see StatCounter).
  */
 typedef struct {
     atomic_uint total_proxies;                  //* Total proxies stored (including duplicates before debup)
-    atomic_uint processed_urls;                //* Successfully fetched URLs
-    atomic_uint completed_cycles;             //*  Full Parsing cycles completed
-    atomic_uint network_errors;              //*  Failed HTTP requests
-    atomic_uint parse_errors;               //* Regex or parsing failures (not currently incremented)
-    atomic_uint unique_proxies;            //* Count of truly unique proxies (after dedup)
-    atomic_int active_workers;            //* Number of currently running worker threads
-    atomic_uint total_requests;          //* Total HTTP requests attempted
-    atomic_uint successful_proxies;     //* Proxies that passed validation
-    atomic_uint total_bytes;           //* Total downloaded data (for bandwidth tracking)
-    time_t initialization_time;       //* Start time of the parser
-    atomic_uint last_cycle_proxies;  //* New proxies found in the most recent cycle
+    atomic_int active_workers;                 //* Sources between scheduling and commit (or drop)
+    time_t initialization_time;               //* Start time of the parser
+    atomic_ullong cycle_start_unique;        //* STAT_UNIQUE_PROXIES when the current cycle began
 } SystemStatistics;
 
+/**
+ * @brief 64-bit monotonic counters, summed over all shards on read.
+ */
+typedef enum {
+    STAT_PROCESSED_URLS,       //* Successfully fetched URLs
+    STAT_COMPLETED_CYCLES,    //* Full parsing cycles started
+    STAT_NETWORK_ERRORS,     //* Failed HTTP requests
+    STAT_PARSE_ERRORS,      //* Fetched bodies that could not be decoded
+    STAT_UNIQUE_PROXIES,   //* Count of truly unique proxies (after dedup)
+    STAT_TOTAL_REQUESTS,  //* Total HTTP requests attempted
+    STAT_SUCCESSFUL_PROXIES, //* Proxies that passed validation
+    STAT_TOTAL_BYTES,       //* Total downloaded data (for bandwidth tracking)
+    STAT_PROBES_ATTEMPTED, //* Verification probes started
+    STAT_PROBES_SUCCEEDED,//* Verification probes that reached the proxy
+    STAT_SKIPPED_FETCHES,//* Source fetches skipped by the reputation scheduler
+    STAT_COUNTER_COUNT
+} StatCounter;
+
+/**
+ * @brief One thread's counters on their own cache line(s). The owning thread is the
+ *        only writer, so updates are plain load/store pairs inside a sequence count
+ *        that lets readers copy the whole shard consistently.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint owner; //* 1 while a live thread holds the shard
+    atomic_uint sequence;                       //* Odd while the owner is mid-update
+    atomic_ullong values[STAT_COUNTER_COUNT];  //* Kept when the owner exits; the next owner continues the sums
+} StatShard;
+
+/**
+ * @brief Point-in-time copy of every counter, for display and rate calculations.
+ */
+typedef struct {
+    uint64_t counters[STAT_COUNTER_COUNT];
+    uint64_t taken_ns; //* monotonic_ns() when the copy was taken
+} StatsSnapshot;
+
+/**
+ * @brief Per-source quality tracking, fed by commits and verification probes.
+ *        Protected by storage_mutex.
+ */
+typedef struct {
+    unsigned int reported;          //* Unique proxies this source reported
+    unsigned int first_reports;    //* ...of which it was the first source to report
+    unsigned int late_reports;    //* ...of which another source reported it earlier
+    double lag_seconds_total;    //* Sum of delays behind the first reporter (late reports only)
+    unsigned int probed;        //* Its proxies with at least one probe outcome
+    unsigned int verified;     //* Its proxies whose last probe succeeded
+    unsigned int fetch_failures; //* Consecutive failed fetches (reset on success)
+    int next_fetch_cycle;       //* Scheduler: first cycle this source is due again
+    double score;              //* 0.0 (useless) .. 1.0 (reliable and early)
+} SourceReputation;
+
+/**
+ * @brief Fixed-bucket histogram updated with relaxed atomics, so any thread can
+ *        observe into it and a scrape can read it without taking a lock.
+ */
+typedef struct {
+    atomic_ullong buckets[HISTOGRAM_MAX_BUCKETS + 1]; //* Non-cumulative; last one is +Inf
+    atomic_ullong count;                              //* Observations
+    atomic_ullong sum;                               //* Sum of raw values (ns or bytes)
+} MetricHistogram;
+
+/**
+ * @brief Bucket layout and exposition details shared by every histogram of one kind.
+ */
+typedef struct {
+    const char *name;           //* Family suffix; exposed as mtproto_source_<name> and mtproto_host_<name>
+    const char *help;          //* HELP text
+    double scale;             //* Divides raw values for exposition (1e9: ns -> seconds)
+    int bound_count;         //* Finite upper bounds in use
+    uint64_t bounds[HISTOGRAM_MAX_BUCKETS]; //* Ascending upper bounds in raw units
+} HistogramSpec;
+
+/**
+ * @brief Per-source counters and histograms exposed on /metrics.
+ *        Per-host series are aggregated from these at scrape time.
+ */
+typedef struct {
+    atomic_ullong requests;         //* Fetch attempts
+    atomic_ullong failures;        //* CURL errors and non-200 responses
+    atomic_ullong bytes;          //* Body bytes of successful fetches
+    atomic_ullong proxies_found; //* Valid candidates extracted (after in-batch dedup)
+    atomic_ullong proxies_added;//* Candidates that were new to the store
+    MetricHistogram fetch_latency;
+    MetricHistogram body_size;
+    MetricHistogram extraction_time;
+    MetricHistogram commit_latency;
+} SourceMetrics;
+
+/**
+ * @brief Set reconciliation traffic for stats and /metrics; relaxed atomics, since the
+ *        listener thread and the main thread both count into it.
+ */
+typedef struct {
+    atomic_ullong exchanges;          //* Reconciliations completed with a peer (this node asking)
+    atomic_ullong failures;          //* ...abandoned on a transport or protocol error
+    atomic_ullong sketches;         //* Sketches and hash lists sent (one per round)
+    atomic_ullong bytes_sent;      //* Request bodies, sketches included
+    atomic_ullong bytes_received; //* Reply bodies
+    atomic_ullong proxies_received; //* Records a peer sent that were new here
+    atomic_ullong proxies_sent;    //* Records pushed to a peer that lacked them
+    atomic_ullong requests_served; //* Requests the listener answered
+} SyncStats;
+
+/**
+ * @brief One PROFILED_LOCK() call site. Each macro expansion owns a static instance,
+ *        so attributing a wait to its site costs no lookup.
+ */
+typedef struct LockSite {
+    const char *function;
+    int line;
+    atomic_int registered;       //* Set once the site is linked into its lock's list
+    atomic_ullong waits;        //* Contended acquisitions from this site
+    atomic_ullong wait_ns;     //* Total time blocked at this site
+    struct LockSite *next;    //* Next site waiting on the same lock
+} LockSite;
+
+/**
+ * @brief pthread mutex that records acquisitions, wait and hold times, and the
+ *        call sites that had to wait. Uncontended locks never read the clock for wait.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    const char *name;                 //* Label in stats and /metrics
+    atomic_ullong acquisitions;
+    atomic_ullong contended;        //* Acquisitions where trylock failed and the caller blocked
+    atomic_ullong max_wait_ns;
+    MetricHistogram wait_time;    //* Contended acquisitions only
+    MetricHistogram hold_time;   //* Every acquisition
+    uint64_t acquired_ns;       //* Written and read by the holder only
+    _Atomic(LockSite *) sites; //* Sites that have waited at least once (push-only list)
+} ProfiledMutex;
+
+#define PROFILED_MUTEX_INITIALIZER(lock_name) { .mutex = PTHREAD_MUTEX_INITIALIZER, .name = (lock_name) }
+
+//* Log severities (LOG_MIN_LEVEL, the log_level setting, LogEntry.level)
+enum {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR
+};
+
+/**
+ * @brief Runtime settings. Defaults reproduce the compile-time tunables; the config file
+ *        (--config) overrides them and command-line flags override both. SIGHUP re-reads
+ *        the file and applies it between cycles (see CONFIG: RUNTIME FILE + RELOAD), so
+ *        worker threads read these without locks. The load benchmark uses the flags to
+ *        drive the parser against local sources.
+ */
+typedef struct {
+    int concurrency;               //* Fetch threads (--concurrency, <= MAX_THREAD_COUNT; --simulate: downloads per batch)
+    int max_cycles;               //* Stop after N cycles; 0 runs until interrupted (--cycles)
+    int cycle_pause;             //* Seconds between cycles (--cycle-pause)
+    int probe_budget;           //* Proxies probed per cycle (--probe-budget, <= PROBE_BUDGET_LIMIT)
+    int throttle;              //* 0 skips the anti-detection delays (--no-throttle)
+    const char *cycle_report; //* Append one JSON line per cycle here (--cycle-report)
+    const char *capture_path; //* Write every transfer to this archive (--capture)
+    const char *replay_path; //* Serve transfers from this archive instead of the network (--replay)
+    int replay_timing;      //* Replay at recorded offsets and durations instead of full speed (--replay-timing)
+    const char *simulate_path; //* Source models for a virtual-clock run without network (--simulate)
+    double simulate_hours;    //* Virtual time a simulation covers (--sim-hours)
+    uint64_t simulate_seed;  //* Seeds every modelled draw (--sim-seed)
+    int decode_threads;     //* Pipeline stage sizes (--decode-threads, --extract-threads, --commit-threads);
+    int extract_threads;   //* fetch uses `concurrency`, export always runs on one thread
+    int commit_threads;
+    int queue_depth;                 //* Items allowed to wait between two stages
+    int save_interval;              //* Seconds between exports
+    int stats_interval;            //* Seconds between console statistics
+    int connection_timeout;       //* Whole-transfer timeout, seconds
+    int connect_timeout;         //* Connect timeout, seconds
+    int max_body_mb;            //* Largest body kept, compressed or decoded
+    int rotation_delay_ms;     //* Random delay before each request is 50 ms + [0, this)
+    int probe_threads;             //* Parallel probe workers (<= MAX_THREAD_COUNT)
+    int probe_timeout_ms;         //* Connect timeout of one probe
+    int probe_refresh_interval;  //* Seconds before a proxy is probed again
+    int reputation_min_samples;       //* Probed proxies before a source's score counts
+    double reputation_throttle_score; //* Sources scoring below this are fetched less often
+    int reputation_max_skip;         //* Most cycles a poor source is skipped
+    int history_retention_days;     //* Histories of proxies not seen again are dropped after this
+    int memory_budget_mb;          //* Mirrored into memory_budget_bytes (--memory-budget)
+    double memory_high_water;     //* Fraction of the budget where reservations start waiting
+    int log_level;               //* Mirrored into log_threshold
+    int log_found_proxy_sample; //* Log 1 in N "Found proxy" events per thread
+    const char *shard_nodes;   //* Comma-separated node names sharing the source list; NULL = no sharding
+    const char *shard_node;   //* This instance's name in shard_nodes (--shard-node)
+    const char *shard_dir;   //* Each export also publishes <shard_node>.json here for mtp_merge
+    const char *sync_peers; //* Comma-separated "host:port" instances to reconcile the store with; NULL = none
+    int sync_interval;     //* Seconds between reconciliations
+    int proxy_capacity;                //* Startup only from here on: store size
+    int metrics_port;                 //* 0 disables /metrics
+    const char *metrics_bind_address;
+    int sync_port;                    //* 0 disables the reconciliation listener
+    const char *sync_bind_address;
+    const char *sources_path;       //* Source list replacing the built-in one (--sources)
+    int daemonize;                 //* Detach from the terminal (--daemon)
+    const char *log_file;         //* stdout/stderr of a daemon (--log-file)
+    const char *pid_file;        //* Written after detaching (--pid-file)
+    const char *config_path;    //* Re-read on SIGHUP (--config)
+} RunOptions;
+
 //* =============== GLOBAL STATE ===============
 
 
 static atomic_int program_active = 1;  //* Flag to control main loop(set to 0 on shutdown)
 static ProxyRecord *proxy_storage = NULL; //* Global array of discovered proxies
-static pthread_mutex_t storage_mutex = PTHREAD_MUTEX_INITIALIZER;   //* Protectors proxy_storage   
-static pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;     //* Protects file I/0
-static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;     //* Ensures clean console logs
+static ProfiledMutex storage_mutex = PROFILED_MUTEX_INITIALIZER("storage"); //* Protectors proxy_storage   
+static ProfiledMutex file_mutex = PROFILED_MUTEX_INITIALIZER("file");      //* Protects file I/0
+static ProfiledMutex log_mutex = PROFILED_MUTEX_INITIALIZER("log");       //* Log ring consumer + console output (never taken by log producers)
+static ProfiledMutex *const PROFILED_MUTEXES[] = { &storage_mutex, &file_mutex, &log_mutex };
 static SystemStatistics stats = {0}; //* Zero-initialized global stats
+static RunOptions run_options = {
+    .concurrency = CONCURRENT_DOWNLOADS, .cycle_pause = CYCLE_PAUSE_SECONDS, .probe_budget = PROBE_BUDGET, .throttle = 1,
+    .simulate_hours = SIMULATION_HOURS, .simulate_seed = 1, .decode_threads = PIPELINE_DECODE_THREADS,
+    .extract_threads = PIPELINE_EXTRACT_THREADS, .commit_threads = PIPELINE_COMMIT_THREADS,
+    .queue_depth = PIPELINE_QUEUE_DEPTH, .save_interval = SAVE_INTERVAL, .stats_interval = STATS_INTERVAL,
+    .connection_timeout = CONNECTION_TIMEOUT, .connect_timeout = CONNECT_TIMEOUT,
+    .max_body_mb = BUFFER_CAPACITY / (1024 * 1024), .rotation_delay_ms = ROTATION_DELAY_MS,
+    .probe_threads = PROBE_THREADS, .probe_timeout_ms = PROBE_TIMEOUT_MS, .probe_refresh_interval = PROBE_REFRESH_INTERVAL,
+    .reputation_min_samples = REPUTATION_MIN_SAMPLES, .reputation_throttle_score = REPUTATION_THROTTLE_SCORE,
+    .reputation_max_skip = REPUTATION_MAX_SKIP, .history_retention_days = HISTORY_RETENTION_DAYS,
+    .memory_budget_mb = MEMORY_BUDGET_MB, .memory_high_water = MEMORY_HIGH_WATER, .log_level = LOG_MIN_LEVEL,
+    .log_found_proxy_sample = LOG_FOUND_PROXY_SAMPLE, .proxy_capacity = PROXY_CAPACITY, .metrics_port = METRICS_PORT,
+    .metrics_bind_address = METRICS_BIND_ADDRESS, .sync_interval = SYNC_INTERVAL, .sync_port = SYNC_PORT,
+    .sync_bind_address = SYNC_BIND_ADDRESS,
+};
+static atomic_int current_cycle = 0;           //* Cycle being fetched (capture/replay key)
+static atomic_ullong current_cycle_start_ns = 0; //* monotonic_ns() when it started
+static SourceReputation source_reputation[URL_CAPACITY] = {0}; //* Indexed like TARGET_URLS
+
+/**
+ * @brief History loaded from disk whose proxy has not been rediscovered yet.
+ */
+typedef struct {
+    uint64_t hash_value;
+    ProbeHistory *history; //* Moved into the ProxyRecord on rediscovery (then NULL)
+} StoredHistory;
+
+static SourceMetrics source_metrics[URL_CAPACITY]; //* Indexed like TARGET_URLS, zero-initialized
+static pthread_t metrics_thread;                   //* Serves /metrics when metrics_port != 0
+static int metrics_thread_started = 0;
+static pthread_t sync_thread;                      //* Answers peers when sync_port != 0
+static int sync_thread_started = 0;
+static SyncStats sync_stats = {0};
+
+static const HistogramSpec FETCH_LATENCY_SPEC = {
+    "fetch_duration_seconds", "Wall time of the HTTP transfer for a source", 1e9, 10,
+    {50000000ULL, 100000000ULL, 250000000ULL, 500000000ULL, 1000000000ULL, 2500000000ULL,
+     5000000000ULL, 10000000000ULL, 25000000000ULL, 60000000000ULL}
+};
+static const HistogramSpec BODY_SIZE_SPEC = {
+    "body_bytes", "Size of successful response bodies", 1.0, 9,
+    {1024ULL, 4096ULL, 16384ULL, 65536ULL, 262144ULL, 1048576ULL, 4194304ULL, 16777216ULL, 67108864ULL}
+};
+static const HistogramSpec EXTRACTION_TIME_SPEC = {
+    "extraction_duration_seconds", "Pattern matching and validation time per body", 1e9, 9,
+    {1000000ULL, 5000000ULL, 10000000ULL, 50000000ULL, 100000000ULL, 500000000ULL,
+     1000000000ULL, 5000000000ULL, 10000000000ULL}
+};
+static const HistogramSpec COMMIT_LATENCY_SPEC = {
+    "commit_duration_seconds", "Store commit time per body, including lock wait", 1e9, 9,
+    {100000ULL, 500000ULL, 1000000ULL, 5000000ULL, 10000000ULL, 50000000ULL,
+     100000000ULL, 500000000ULL, 1000000000ULL}
+};
+
+static const HistogramSpec LOCK_WAIT_SPEC = {
+    "wait_seconds", "Time blocked acquiring the lock (contended acquisitions only)", 1e9, 10,
+    {1000ULL, 10000ULL, 100000ULL, 1000000ULL, 5000000ULL, 10000000ULL, 50000000ULL,
+     100000000ULL, 500000000ULL, 1000000000ULL}
+};
+static const HistogramSpec LOCK_HOLD_SPEC = {
+    "hold_seconds", "Time the lock was held per acquisition", 1e9, 10,
+    {1000ULL, 5000ULL, 10000ULL, 50000ULL, 100000ULL, 500000ULL, 1000000ULL,
+     10000000ULL, 100000000ULL, 1000000000ULL}
+};
+
+static StoredHistory *stored_histories = NULL; //* Sorted by hash_value, protected by storage_mutex
+static int stored_history_count = 0;
 
 
 //* =============== USER-AGENT POOL ===============
@@ -236,685 +626,6211 @@ static const char *TARGET_URLS[URL_CAPACITY] = {
     NULL
 };
 
-//* =============== PARSING PATTERNS ===============
-//* Comprehensive regex patterns to extract proxies from diverse formats:
-//* - JSON, INI, plain text, inline, URL parameters, etc.
+//* Replaces TARGET_URLS with the non-empty, non-# lines of `path` (--sources).
+//* Returns the number of sources loaded, or -1 if the file cannot be read.
+int load_source_list(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return -1;
 
-static const char *PARSE_PATTERNS[MAX_PATTERNS] = {
-    //* Standard labeld format: "Server: ... Port: ... Secret: ..."
-    "Server:[\\s\\r\\n]*([^\\r\\n]+?)[\\s\\r\\n]*Port:[\\s\\r\\n]*([0-9]{1,5})[\\s\\r\\n]*Secret:[\\s\\r\\n]*([0-9a-fA-F=]{16,512})",
-    "server[\\s]*:[\\s]*([^\\r\\n]+?)[\\s]*port[\\s]*:[\\s]*([0-9]{1,5})[\\s]*secret[\\s]*:[\\s]*([0-9a-fA-F=]{16,512})",
-    "Host:[\\s]*([^\\r\\n]+?)[\\s]*Port:[\\s]*([0-9]{1,5})[\\s]*Key:[\\s]*([0-9a-fA-F=]{16,512})",
-    
-    "\"server\"[\\s]*:[\\s]*\"([^\"]+?)\"[\\s]*,[\\s]*\"port\"[\\s]*:[\\s]*([0-9]+)[\\s]*,[\\s]*\"secret\"[\\s]*:[\\s]*\"([^\"]+?)\"",
-    "\"host\"[\\s]*:[\\s]*\"([^\"]+?)\"[\\s]*,[\\s]*\"port\"[\\s]*:[\\s]*([0-9]+)[\\s]*,[\\s]*\"secret\"[\\s]*:[\\s]*\"([^\"]+?)\"",
-    
-    "tg://proxy\\?server=([^&]+?)&port=([0-9]+?)&secret=([^&\\s]+?)",
-    "tg://socks\\?server=([^&]+?)&port=([0-9]+?)&secret=([^&\\s]+?)",
-    
-    "server=([^&\\s]+?)&port=([0-9]+?)&secret=([^&\\s]+?)",
-    "host=([^&\\s]+?)&port=([0-9]+?)&key=([^&\\s]+?)",
-    
-    "([0-9a-zA-Z.-]+)[\\s\\-:]+([0-9]{1,5})[\\s\\-:]+([0-9a-fA-F\\s\\-=]{16,512})",
-    "([0-9a-zA-Z._-]+):([0-9]{1,5}):([0-9a-fA-F=]{16,512})",
-    
-    "([0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3})[^0-9]*([0-9]{1,5})[^0-9a-fA-F]*([0-9a-fA-F\\s\\-=]{16,512})",
-    "([0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}):([0-9]{1,5}):([0-9a-fA-F=]{16,512})",
-    
-    "([0-9a-fA-F]{32,512})[\\s@]+([^:\\s]+):([0-9]{1,5})",
-    "([0-9a-fA-F=]+)[\\s@]+([^:\\s]+):([0-9]{1,5})",
-    
-    "address[\\s]*=[\\s]*([^\\r\\n]+?)[\\s]*port[\\s]*=[\\s]*([0-9]+)[\\s]*secret[\\s]*=[\\s]*([0-9a-fA-F=]+)",
-    "Server[\\s]*=[\\s]*([^\\r\\n]+?)[\\s]*Port[\\s]*=[\\s]*([0-9]+)[\\s]*Secret[\\s]*=[\\s]*([0-9a-fA-F=]+)",
-    
-    "proxy[\\s]*:[\\s]*([^:]+):([0-9]+)[\\s]*key[\\s]*:[\\s]*([0-9a-fA-F]+)",
-    "mtproto[\\s]*:[\\s]*([^:]+):([0-9]+)[\\s]*secret[\\s]*:[\\s]*([0-9a-fA-F]+)",
-    
-    "\"endpoint\"[\\s]*:[\\s]*\"([^:]+):([0-9]+)\"[\\s]*,[\\s]*\"secret\"[\\s]*:[\\s]*\"([^\"]+)\"",
-    "([0-9]+\\.[0-9]+\\.[0-9]+\\.[0-9]+)[\\s|\\-]+([0-9]+)[\\s|\\-]+([0-9a-fA-F]+)",
-    "([a-zA-Z0-9.-]+\\.[a-zA-Z]{2,}):([0-9]+):([0-9a-fA-F]{32,})",
-    "([0-9a-fA-F]{32,})@([0-9a-zA-Z.-]+):([0-9]{1,5})",
-    
-    "([A-Za-z0-9+/=]{20,})[\\s@]+([^:\\s]+):([0-9]{1,5})",
-    "([A-Za-z0-9_-]{20,})[\\s@]+([^:\\s]+):([0-9]{1,5})",
-    
-    "mtproxy://([^:]+):([0-9]+)\\?secret=([0-9a-fA-F]+)",
-    "socks5://([^:]+):([0-9]+)\\?secret=([0-9a-fA-F]+)",
-    "\\{\\s*\"s\"\\s*:\\s*\"([^\"]+)\"\\s*,\\s*\"p\"\\s*:\\s*([0-9]+)\\s*,\\s*\"k\"\\s*:\\s*\"([^\"]+)\"\\s*\\}",
-    "\\[\\s*\"([^\"]+)\"\\s*,\\s*([0-9]+)\\s*,\\s*\"([^\"]+)\"\\s*\\]",
-    
-    "proxy_server[:=]\\s*([^\\s,]+)\\s*proxy_port[:=]\\s*([0-9]+)\\s*proxy_secret[:=]\\s*([^\\s,]+)",
-    "\\|\\s*([^|]+)\\s*\\|\\s*([0-9]+)\\s*\\|\\s*([^|]+)\\s*\\|",
-    "\\b([0-9a-fA-F]{64})\\b[^0-9a-fA-F]*([0-9a-zA-Z.-]+):([0-9]+)",
-    
-    "Server\\s*[=:]\\s*([^\\r\\n]+)[\\r\\n]+Port\\s*[=:]\\s*([0-9]+)[\\r\\n]+Secret\\s*[=:]\\s*([0-9a-fA-F=]+)",
-    "Host\\s*[=:]\\s*([^\\r\\n]+)[\\r\\n]+Port\\s*[=:]\\s*([0-9]+)[\\r\\n]+Key\\s*[=:]\\s*([0-9a-fA-F=]+)",
-    
-    NULL //* Sentinel
-};
+    char line[2048];
+    int count = 0;
+    while (count < URL_CAPACITY - 1 && fgets(line, sizeof(line), file)) {
+        char *start = line;
+        while (*start == ' ' || *start == '\t')
+            start++;
+        size_t length = strcspn(start, "\r\n");
+        while (length > 0 && (start[length - 1] == ' ' || start[length - 1] == '\t'))
+            length--;
+        if (length == 0 || start[0] == '#')
+            continue;
+        char *url = strndup(start, length);
+        if (!url)
+            break;
+        TARGET_URLS[count++] = url; //* Lives for the whole run
+    }
+    TARGET_URLS[count] = NULL;
+    fclose(file);
+    return count;
+}
 
-//* =============== SIGNAL HANDLER ===============
-//* Gracefully shuts down on Ctrl+C or kill signal
+//* =============== PARSING PATTERNS ===============
+//* The regex table lives with libmtparse in data/data.c; MAX_PATTERNS bounds the
+//* per-pattern counters and spans kept here.
 
-void handle_interrupt(int signal) {
-    printf("\n[SYSTEM] Received signal %d. Performing graceful shutdown...\n", signal);
-    atomic_store(&program_active, 0); //* Signal all thread to stop
-}
+#define PARSE_PATTERNS mtp_default_patterns
 
-//* =============== THREAD-SAFE LOGGING ===============
-//* Prints timestamped messages without interleaving in multi-threaded context
+//* =============== TIMING: MONOTONIC CLOCK ===============
+//* Wall-clock durations immune to system time changes
 
-void log_message(const char* format, ...) {
-    pthread_mutex_lock(&log_mutex);
-    
-    time_t now = time(NULL);
-    struct tm *timeinfo = localtime(&now);
-    char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", timeinfo);
-    
-    printf("[%s] ", timestamp);
-    
-    va_list args;
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
-    
-    printf("\n");
-    pthread_mutex_unlock(&log_mutex);
+uint64_t monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
 }
 
-//* =============== SECURITY: USER-AGENT ROTATION ===============
-//* Returns a random User-Agent from the pool to mimic real users
+//* =============== TIMING: VIRTUAL CLOCK ===============
+//* Scheduling time (cycle timing, save/stats intervals, probe ages, discovery stamps,
+//* sleeps) goes through mtp_time(), mtp_monotonic_ns() and mtp_sleep_ns(). Live runs use
+//* the real clocks. --simulate switches to a virtual clock that only moves when code
+//* sleeps or a modelled transfer or probe takes time.
+//* Simulated workers run one at a time, each on its own thread clock that starts at its
+//* spawn time. The shared clock then jumps to the slowest worker's finish, just as the
+//* join barrier would wait for it.
+//* Host-cost timers (stage spans, lock profiling, extraction and commit histograms) stay
+//* on monotonic_ns(), because they measure this machine, not the schedule.
 
-const char* get_random_user_agent() {
-    return USER_AGENTS[rand() % USER_AGENT_POOL_SIZE];
+static int virtual_clock_enabled = 0;
+static atomic_ullong virtual_now_ns = 0;
+static __thread int virtual_thread_clock_active = 0;
+static __thread uint64_t virtual_thread_clock_ns = 0;
+
+uint64_t mtp_monotonic_ns() {
+    if (!virtual_clock_enabled)
+        return monotonic_ns();
+    return virtual_thread_clock_active ? virtual_thread_clock_ns : atomic_load(&virtual_now_ns);
 }
 
-//* =============== SECURITY: REQUEST THROTTLING ===============
-//* Adds random micro-delays to avoid burst traffic patterns
-void random_delay() {
-    usleep((rand() % ROTATION_DELAY_MS + 50) * 1000);
+time_t mtp_time() {
+    if (!virtual_clock_enabled)
+        return time(NULL);
+    return (time_t)(SIMULATION_EPOCH + mtp_monotonic_ns() / 1000000000ULL);
 }
 
-//* =============== DEDUPLICATION: FAST HASHING ===============
-//* Computes a 64-bit FNV-1a hash from server:port:secret for O(1) duplicate checks
+void mtp_sleep_ns(uint64_t duration_ns) {
+    if (!virtual_clock_enabled) {
+        struct timespec delay = { (time_t)(duration_ns / 1000000000ULL), (long)(duration_ns % 1000000000ULL) };
+        nanosleep(&delay, NULL); //* Like sleep()/usleep(), a signal cuts it short
+    } else if (virtual_thread_clock_active) {
+        virtual_thread_clock_ns += duration_ns;
+    } else {
+        atomic_fetch_add(&virtual_now_ns, duration_ns);
+    }
+}
 
-uint64_t compute_hash(const char* server, const char* port, const char* secret) {
-    uint64_t hash = 14695981039346656037ULL;
-    //* Hash server
-    for (const char* p = server; *p; p++) 
-        hash = (hash ^ (uint64_t)(*p)) * 1099511628211ULL; //* FNV prime
-    
-    hash = (hash ^ (uint64_t)':') * 1099511628211ULL;
-    //* Hash port
-    for (const char* p = port; *p; p++) 
-        hash = (hash ^ (uint64_t)(*p)) * 1099511628211ULL;
-    
-    hash = (hash ^ (uint64_t)':') * 1099511628211ULL;
-    //* Hash first 64 chars of secret (enough for uniqueness)
-    for (int i = 0; i < 64 && secret[i]; i++) 
-        hash = (hash ^ (uint64_t)(secret[i])) * 1099511628211ULL;
-    
-    return hash;
+//* Starts this thread's own clock at `start_ns` (a simulated worker's spawn time)
+void virtual_clock_enter(uint64_t start_ns) {
+    virtual_thread_clock_ns = start_ns;
+    virtual_thread_clock_active = 1;
 }
 
-//* =============== VALIDATION: PROXY SANITY CHECK ===============
-//* Ensures server, port, and secret meet MTProto requirements
+//* Stops this thread's clock and returns where it ended
+uint64_t virtual_clock_leave() {
+    virtual_thread_clock_active = 0;
+    return virtual_thread_clock_ns;
+}
 
-int validate_proxy(const char* server, const char* port, const char* secret) {
-    if (!server || !port || !secret) 
-        return 0;
-    
-    size_t server_len = strlen(server);
-    size_t port_len = strlen(port);
-    size_t secret_len = strlen(secret);
-    
-    if (server_len < 4 || server_len > 253) 
-        return 0;
-    
-    if (port_len < 1 || port_len > 15)
-        return 0;
-    
-    if (secret_len < 16 || secret_len > 511)
-        return 0;
-    //* Validate port is number and in range
-    char* endptr;
-    long port_value = strtol(port, &endptr, 10);
-    if (endptr == port || *endptr != '\0' || port_value < 1 || port_value > 65535) 
-        return 0;
-    //* Validate secret contains only hex chars and optional padding (=)
-    int valid_chars = 0;
-    int hex_chars = 0;
-    for (size_t i = 0; i < secret_len && i < 128; i++) {
-        unsigned char c = secret[i];
-        if ((c >= '0' && c <= '9') || 
-            (c >= 'a' && c <= 'f') || 
-            (c >= 'A' && c <= 'F')) {
-            valid_chars++;
-            hex_chars++;
-        } else if (c == '=') {
-            valid_chars++;
-        } else if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
-            return 0; //* Ivanlud character
-        }
+//* Moves the shared clock forward to `when_ns` (never backwards)
+void virtual_clock_advance_to(uint64_t when_ns) {
+    unsigned long long now = atomic_load(&virtual_now_ns);
+    while (now < when_ns && !atomic_compare_exchange_weak(&virtual_now_ns, &now, when_ns)) {
     }
-    
-    return (valid_chars >= 16) && (hex_chars >= 8);
 }
 
+//* =============== PROBES: USDT STATIC TRACEPOINTS ===============
+//* Provider "mtproto". An unattached probe is a single nop in the instruction stream;
+//* arguments are plain values already in registers, so nothing is computed for them.
+//* See tools/bpftrace/ for scripts and README.md for the probe list.
 
-//* =============== SANITIZATION: CLEAN EXTRACTED STRINGS ===============
-//*          Removes control chars, normalizes whitespace, trims ends
+#ifdef MTP_HAVE_USDT
+#define USDT_PROBE1(name, a) DTRACE_PROBE1(mtproto, name, a)
+#define USDT_PROBE2(name, a, b) DTRACE_PROBE2(mtproto, name, a, b)
+#define USDT_PROBE4(name, a, b, c, d) DTRACE_PROBE4(mtproto, name, a, b, c, d)
+#define USDT_PROBE6(name, a, b, c, d, e, f) DTRACE_PROBE6(mtproto, name, a, b, c, d, e, f)
+#else
+#define USDT_PROBE1(name, a) ((void)0)
+#define USDT_PROBE2(name, a, b) ((void)0)
+#define USDT_PROBE4(name, a, b, c, d) ((void)0)
+#define USDT_PROBE6(name, a, b, c, d, e, f) ((void)0)
+#endif
 
-void sanitize_string(char *str) {
-    if (!str) return;
-    
-    char *read_ptr = str;
-    char *write_ptr = str;
-    int space_flag = 0;
-    
-    while (*read_ptr) {
-        if ((unsigned char)*read_ptr >= 0x20 && (unsigned char)*read_ptr < 0x7F) {
-            if (*read_ptr == ' ' || *read_ptr == '\t' || *read_ptr == '\n' || *read_ptr == '\r') {
-                if (!space_flag && write_ptr > str) {
-                    *write_ptr++ = ' ';
-                    space_flag = 1;
-                }
-            } else {
-                *write_ptr++ = *read_ptr;
-                space_flag = 0;
-            }
-        }
-        read_ptr++;
-    }
-    *write_ptr = '\0';
-    //* Trim trainig spaces
-    while (write_ptr > str && (*(write_ptr-1) == ' ' || *(write_ptr-1) == '\t')) {
-        *(--write_ptr) = '\0';
-    }
+//* candidate_reject reason codes (stable: scripts decode them)
+//* (libmtparse's MtpRejectReason values, passed through unchanged)
+enum {
+    REJECT_MISSING_GROUP = MTP_REJECT_MISSING_GROUP, //* A capture group did not participate
+    REJECT_FIELD_LENGTH = MTP_REJECT_FIELD_LENGTH,  //* Server, port or secret outside the accepted lengths
+    REJECT_INVALID = MTP_REJECT_INVALID,           //* validate_proxy() failed after normalization
+    REJECT_BATCH_DUPLICATE = MTP_REJECT_DUPLICATE,//* Already extracted from this body
+    REJECT_BATCH_FULL = MTP_REJECT_FULL          //* PROXY_BATCH_SIZE reached
+};
+
+//* =============== STATS: SHARDED COUNTERS ===============
+//* Each thread claims a padded shard on first use (like the log rings) and releases
+//* it on exit. Increments never leave the thread's own cache line and need no locked
+//* instruction; readers sum all shards, retrying a shard caught mid-update.
+
+static StatShard stat_shards[STATS_SHARD_COUNT];
+static atomic_ullong stat_overflow[STAT_COUNTER_COUNT]; //* Shared fallback when every shard is taken
+static __thread StatShard *thread_stat_shard = NULL;
+static __thread int thread_stat_overflow = 0;          //* No shard was free for this thread
+static pthread_key_t stat_shard_key;
+static pthread_once_t stat_shard_once = PTHREAD_ONCE_INIT;
+
+static void stat_shard_release(void *shard_data) {
+    atomic_store_explicit(&((StatShard *)shard_data)->owner, 0, memory_order_release);
 }
 
-//* =============== HTTP: CURL WRITE CALLBACK ===============
-//*          Appends downloaded data to a dynamic buffer
-size_t write_callback(void *content, size_t element_size, size_t element_count, void *user_buffer) {
-    size_t total_size = element_size * element_count;
-    DynamicBuffer *buffer = (DynamicBuffer *)user_buffer;
+static void stat_shard_init_once(void) {
+    pthread_key_create(&stat_shard_key, stat_shard_release);
+}
 
-    if (!buffer || !atomic_load(&program_active)) 
-        return 0;
-    //* Grow buffer is needed (capped at BUFFER_CAPACIRY)
-    if (buffer->size + total_size + 1 > buffer->capacity) {
-        size_t new_capacity = buffer->capacity * 2;
-        if (new_capacity < buffer->size + total_size + 1) {
-            new_capacity = buffer->size + total_size + 1;
-        }
-        if (new_capacity > BUFFER_CAPACITY) {
-            new_capacity = BUFFER_CAPACITY;
+static StatShard* stat_acquire_shard() {
+    pthread_once(&stat_shard_once, stat_shard_init_once);
+    for (int s = 0; s < STATS_SHARD_COUNT; s++) {
+        unsigned int expected = 0;
+        if (atomic_compare_exchange_strong_explicit(&stat_shards[s].owner, &expected, 1,
+                                                    memory_order_acquire, memory_order_relaxed)) {
+            pthread_setspecific(stat_shard_key, &stat_shards[s]);
+            return &stat_shards[s];
         }
-        
-        char *new_data = realloc(buffer->data, new_capacity);
-        if (!new_data) {
-            return 0;
-        }
-        
-        buffer->data = new_data;
-        buffer->capacity = new_capacity;
     }
+    return NULL;
+}
 
-    if (buffer->data) {
-        memcpy(buffer->data + buffer->size, content, total_size);
-        buffer->size += total_size;
-        buffer->data[buffer->size] = '\0';
+void stats_add(StatCounter counter, uint64_t amount) {
+    StatShard *shard = thread_stat_shard;
+    if (!shard && !thread_stat_overflow) {
+        shard = thread_stat_shard = stat_acquire_shard();
+        thread_stat_overflow = (shard == NULL);
+    }
+    if (!shard) {
+        atomic_fetch_add_explicit(&stat_overflow[counter], amount, memory_order_relaxed);
+        return;
     }
+    unsigned int sequence = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+    atomic_store_explicit(&shard->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    uint64_t value = atomic_load_explicit(&shard->values[counter], memory_order_relaxed);
+    atomic_store_explicit(&shard->values[counter], value + amount, memory_order_relaxed);
+    atomic_store_explicit(&shard->sequence, sequence + 2, memory_order_release);
+}
 
-    return total_size;
+//* Sums every shard. Each thread's counters are copied as of one instant, so related
+//* counters bumped by the same thread (e.g. probes attempted/succeeded) stay coherent.
+void stats_snapshot(StatsSnapshot *snapshot) {
+    uint64_t shard_values[STAT_COUNTER_COUNT];
+    memset(snapshot, 0, sizeof(*snapshot));
+    for (int s = 0; s < STATS_SHARD_COUNT; s++) {
+        const StatShard *shard = &stat_shards[s];
+        unsigned int before, after;
+        do {
+            before = atomic_load_explicit(&shard->sequence, memory_order_acquire);
+            for (int c = 0; c < STAT_COUNTER_COUNT; c++)
+                shard_values[c] = atomic_load_explicit(&shard->values[c], memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            after = atomic_load_explicit(&shard->sequence, memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        for (int c = 0; c < STAT_COUNTER_COUNT; c++)
+            snapshot->counters[c] += shard_values[c];
+    }
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++)
+        snapshot->counters[c] += atomic_load_explicit(&stat_overflow[c], memory_order_relaxed);
+    snapshot->taken_ns = monotonic_ns();
 }
 
-//* =============== HTTP: CURL HANDLE SETUP ===============
-//* Configures libcurl with security and stealth options
+uint64_t stats_total(StatCounter counter) {
+    StatsSnapshot snapshot;
+    stats_snapshot(&snapshot);
+    return snapshot.counters[counter];
+}
 
-CURL* setup_curl_handle() {
-    CURL *curl = curl_easy_init();
-    if (!curl) return NULL;
-    
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, get_random_user_agent());
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, CONNECTION_TIMEOUT);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);         //* Follow redirects
-    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);            
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);       //* Disable cert verification (common )
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);    //* Fast connect timeout
-    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1024L);//* About slow transefts
-    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 15L);
-    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "gzip, deflate"); //* Save bandwith
-    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);              //* Maintan connection
-    
-    return curl;
+//* =============== METRICS: LOCK-FREE HISTOGRAMS ===============
+//* Relaxed atomic adds only; readers may see a count one observation ahead of a bucket
+
+void histogram_observe(MetricHistogram *histogram, const HistogramSpec *spec, uint64_t value) {
+    int bucket = 0;
+    while (bucket < spec->bound_count && value > spec->bounds[bucket])
+        bucket++;
+    atomic_fetch_add_explicit(&histogram->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum, value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
 }
 
-//* =============== CORE: PROXY EXTRACTION ENGINE ===============
-//* Applies all regex patterns to content and validates discovered proxies
+//* Per-source helpers ignore out-of-range indexes (e.g. ad-hoc extraction calls)
+static SourceMetrics* metrics_for_source(int source_index) {
+    return (source_index >= 0 && source_index < URL_CAPACITY) ? &source_metrics[source_index] : NULL;
+}
 
-void extract_proxies_from_content(const char *content, size_t content_length, const char* source) {
-    if (!content || content_length == 0 || !atomic_load(&program_active)) 
-        return;
+//* =============== PROFILING: LOCK CONTENTION ===============
+//* Always on: the uncontended path is a trylock plus two clock reads for hold time.
+//* Blocked acquisitions additionally time the wait and charge it to the call site.
 
-    log_message("Parsing content from %s (%zu bytes)", source, content_length);
-    //* Allocate temporary batch storage   
-    ProxyRecord *discovered_proxies = malloc(PROXY_BATCH_SIZE * sizeof(ProxyRecord));
-    if (!discovered_proxies) {
-        log_message("Memory allocation failed for proxy batch");
-        return;
-    }
-    
-    int discovery_count = 0;
-    int total_discovered = 0;
-    //* Try every regex pattern
-    for (int pattern_index = 0; PARSE_PATTERNS[pattern_index] != NULL && atomic_load(&program_active); pattern_index++) {
-        const char *pattern = PARSE_PATTERNS[pattern_index];
-        pcre2_code *compiled_pattern = NULL;
-        pcre2_match_data *match_data = NULL;
-        
-        compiled_pattern = pcre2_compile(
-            (PCRE2_SPTR8)pattern,
-            PCRE2_ZERO_TERMINATED,
-            PCRE2_MULTILINE | PCRE2_DOTALL | PCRE2_CASELESS, // * Flexiblae matching
-            NULL, NULL, NULL
-        );
-        
-        if (!compiled_pattern) {
-            continue;
-        }
+#define PROFILED_LOCK(lock) do { \
+    static LockSite lock_site_ = { .function = __func__, .line = __LINE__ }; \
+    profiled_mutex_lock((lock), &lock_site_); \
+} while (0)
+#define PROFILED_UNLOCK(lock) profiled_mutex_unlock(lock)
 
-        match_data = pcre2_match_data_create_from_pattern(compiled_pattern, NULL);
-        if (!match_data) {
-            pcre2_code_free(compiled_pattern);
-            continue;
-        }
+//* Links a site into the lock's list the first time it waits (each site names one lock)
+static void lock_site_register(ProfiledMutex *lock, LockSite *site) {
+    if (atomic_exchange_explicit(&site->registered, 1, memory_order_relaxed))
+        return;
+    LockSite *head = atomic_load_explicit(&lock->sites, memory_order_relaxed);
+    do {
+        site->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&lock->sites, &head, site,
+                                                    memory_order_release, memory_order_relaxed));
+}
 
-        PCRE2_SIZE current_offset = 0;
-        int pattern_matches = 0;
-        //* Find all matches in content
-        while (current_offset < content_length && discovery_count < PROXY_BATCH_SIZE && atomic_load(&program_active)) {
-            int match_result = pcre2_match(
-                compiled_pattern, 
-                (PCRE2_SPTR8)content, 
-                content_length, 
-                current_offset, 0, 
-                match_data, NULL
-            );
-            
-            if (match_result < 4) break; //* Need at least 3 capture groups
+void profiled_mutex_lock(ProfiledMutex *lock, LockSite *site) {
+    if (pthread_mutex_trylock(&lock->mutex) == 0) {
+        lock->acquired_ns = monotonic_ns();
+    } else {
+        uint64_t wait_start = monotonic_ns();
+        pthread_mutex_lock(&lock->mutex);
+        lock->acquired_ns = monotonic_ns();
+        uint64_t waited = lock->acquired_ns - wait_start;
 
-            PCRE2_SIZE *match_vector = pcre2_get_ovector_pointer(match_data);
-            
-            int valid_match = 1;
-            for (int i = 2; i <= 7; i += 2) {
-                if (match_vector[i] == PCRE2_UNSET || match_vector[i+1] == PCRE2_UNSET) {
-                    valid_match = 0;
-                    break;
-                }
-            }
-            //* Extract matchet substrings
-            if (valid_match) {
-                size_t server_length = match_vector[3] - match_vector[2];
-                size_t port_length = match_vector[5] - match_vector[4];
-                size_t secret_length = match_vector[7] - match_vector[6];
-                
-                if (server_length > 0 && server_length < 256 && 
-                    port_length > 0 && port_length < 16 && 
-                    secret_length >= 16 && secret_length < 512) {
-                    
-                    ProxyRecord new_proxy = {0};
-                    
-                    strncpy(new_proxy.server, content + match_vector[2], server_length);
-                    strncpy(new_proxy.port, content + match_vector[4], port_length);
-                    strncpy(new_proxy.secret, content + match_vector[6], secret_length);
-                    
-                    new_proxy.server[server_length] = '\0';
-                    new_proxy.port[port_length] = '\0';
-                    new_proxy.secret[secret_length] = '\0';
-                    //* Clean extracted fields
-                    sanitize_string(new_proxy.server);
-                    sanitize_string(new_proxy.port);
-                    sanitize_string(new_proxy.secret);
-                  //* Remove accidental label prefixes (e.g., "Server: 1.2.3.4" → "1.2.3.4")                  
-                    const char* field_prefixes[] = {"Server:", "server:", "SERVER:", "Host:", "host:", "HOST:"};
-                    for (int i = 0; i < 6; i++) {
-                        size_t prefix_len = strlen(field_prefixes[i]);
-                        if (strncasecmp(new_proxy.server, field_prefixes[i], prefix_len) == 0) {
-                            memmove(new_proxy.server, new_proxy.server + prefix_len, strlen(new_proxy.server) - prefix_len + 1);
-                            sanitize_string(new_proxy.server);
-                        }
-                    }
-                    //* Similar cleanup for port and secret...                 
-                    const char* port_prefixes[] = {"Port:", "port:", "PORT:"};
-                    for (int i = 0; i < 3; i++) {
-                        size_t prefix_len = strlen(port_prefixes[i]);
-                        if (strncasecmp(new_proxy.port, port_prefixes[i], prefix_len) == 0) {
-                            memmove(new_proxy.port, new_proxy.port + prefix_len, strlen(new_proxy.port) - prefix_len + 1);
-                            sanitize_string(new_proxy.port);
-                        }
-                    }
-                    
-                    const char* secret_prefixes[] = {"Secret:", "secret:", "SECRET:", "Key:", "key:", "KEY:"};
-                    for (int i = 0; i < 6; i++) {
-                        size_t prefix_len = strlen(secret_prefixes[i]);
-                        if (strncasecmp(new_proxy.secret, secret_prefixes[i], prefix_len) == 0) {
-                            memmove(new_proxy.secret, new_proxy.secret + prefix_len, strlen(new_proxy.secret) - prefix_len + 1);
-                            sanitize_string(new_proxy.secret);
-                        }
-                    }
-                    //* Validate and finalize proxy
-                    if (validate_proxy(new_proxy.server, new_proxy.port, new_proxy.secret)) {
-                        new_proxy.hash_value = compute_hash(new_proxy.server, new_proxy.port, new_proxy.secret);
-                        new_proxy.discovery_time = time(NULL);
-                        new_proxy.last_verified = time(NULL);
-                        new_proxy.active = 1;
-                        new_proxy.verified = 0;
-                        new_proxy.speed_score = 50;
-                        strncpy(new_proxy.source, source, sizeof(new_proxy.source) - 1);
-                        //* Classify as IP or Domain
-                        int is_ip = 1;
-                        for (const char *s = new_proxy.server; *s; s++) {
-                            if ((*s < '0' || *s > '9') && *s != '.') {
-                                is_ip = 0;
-                                break;
-                            }
-                        }
-                        strcpy(new_proxy.type, is_ip ? "IPv4" : "Domain");
-                        strcpy(new_proxy.country, "UN");
-                        //* Build Telegram-ready URL
-                        snprintf(new_proxy.connection_url, sizeof(new_proxy.connection_url),
-                                "tg://proxy?server=%s&port=%s&secret=%s",
-                                new_proxy.server, new_proxy.port, new_proxy.secret);
-                        
-                        int duplicate_found = 0;
-                        for (int i = 0; i < discovery_count; i++) {
-                            if (discovered_proxies[i].hash_value == new_proxy.hash_value) {
-                                duplicate_found = 1;
-                                break;
-                            }
-                        }
-                        
-                        if (!duplicate_found) {
-                            if (discovery_count < PROXY_BATCH_SIZE) {
-                                discovered_proxies[discovery_count++] = new_proxy;
-                                pattern_matches++;
-                                total_discovered++;
-                                
-                                log_message("Found proxy: %s:%s (secret: %.32s...) from pattern %d", 
-                                           new_proxy.server, new_proxy.port, new_proxy.secret, pattern_index);
-                            }
-                        }
-                    }
-                }
-            }
-            
-            current_offset = match_vector[1] + 1;
-            if (current_offset >= content_length) 
-                break;
-        }
-        
-        pcre2_match_data_free(match_data);
-        pcre2_code_free(compiled_pattern);
-        
-        if (pattern_matches > 0) {
-            log_message("Pattern %d: Found %d proxies", pattern_index, pattern_matches);
-        }
-    }
-    
-    if (discovery_count > 0) {
-        pthread_mutex_lock(&storage_mutex);
-        
-        int current_total = atomic_load(&stats.total_proxies);
-        int added_count = 0;
-        
-        for (int i = 0; i < discovery_count && current_total < PROXY_CAPACITY; i++) {
-            int duplicate_found = 0;
-            for (int j = 0; j < current_total; j++) {
-                if (proxy_storage[j].hash_value == discovered_proxies[i].hash_value) {
-                    duplicate_found = 1;
-                    break;
-                }
-            }
-            
-            if (!duplicate_found) {
-                proxy_storage[current_total++] = discovered_proxies[i];
-                added_count++;
-                atomic_fetch_add(&stats.unique_proxies, 1);
-                atomic_fetch_add(&stats.successful_proxies, 1);
-            }
-        }
-        
-        atomic_store(&stats.total_proxies, current_total);
-        atomic_fetch_add(&stats.last_cycle_proxies, added_count);
-        pthread_mutex_unlock(&storage_mutex);
-        
-        log_message("Added %d new proxies | Total: %d", added_count, current_total);
-    }
-    
-    free(discovered_proxies);
-    
-    if (total_discovered > 0) {
-        log_message("Total proxies discovered from %s: %d", source, total_discovered);
+        atomic_fetch_add_explicit(&lock->contended, 1, memory_order_relaxed);
+        histogram_observe(&lock->wait_time, &LOCK_WAIT_SPEC, waited);
+        uint64_t max_wait = atomic_load_explicit(&lock->max_wait_ns, memory_order_relaxed);
+        while (waited > max_wait &&
+               !atomic_compare_exchange_weak_explicit(&lock->max_wait_ns, &max_wait, waited,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            ;
+        lock_site_register(lock, site);
+        atomic_fetch_add_explicit(&site->waits, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&site->wait_ns, waited, memory_order_relaxed);
     }
+    atomic_fetch_add_explicit(&lock->acquisitions, 1, memory_order_relaxed);
 }
 
-//* =============== HTTP: FETCH SINGLE URL ===============
-//* Downloads content from a URL and triggers parsing
+void profiled_mutex_unlock(ProfiledMutex *lock) {
+    histogram_observe(&lock->hold_time, &LOCK_HOLD_SPEC, monotonic_ns() - lock->acquired_ns);
+    pthread_mutex_unlock(&lock->mutex);
+}
 
-int fetch_url_content(const char *url) {
-    if (!atomic_load(&program_active)) 
+/**
+ * @brief Snapshot of one waiting call site, for sorting in reports.
+ */
+typedef struct {
+    const char *function;
+    int line;
+    uint64_t waits;
+    uint64_t wait_ns;
+} LockSiteSnapshot;
+
+static int compare_lock_site_wait(const void *a, const void *b) {
+    const LockSiteSnapshot *site_a = a, *site_b = b;
+    return (site_b->wait_ns > site_a->wait_ns) - (site_b->wait_ns < site_a->wait_ns);
+}
+
+#define LOCK_MAX_SITES 64 //** Waiting call sites collected per lock for reports
+
+//* Copies up to `capacity` waiting sites of a lock, most total wait first; returns the count
+int lock_top_sites(ProfiledMutex *lock, LockSiteSnapshot *sites, int capacity) {
+    int count = 0;
+    for (LockSite *site = atomic_load_explicit(&lock->sites, memory_order_acquire);
+         site != NULL && count < capacity; site = site->next) {
+        sites[count].function = site->function;
+        sites[count].line = site->line;
+        sites[count].waits = atomic_load_explicit(&site->waits, memory_order_relaxed);
+        sites[count].wait_ns = atomic_load_explicit(&site->wait_ns, memory_order_relaxed);
+        count++;
+    }
+    qsort(sites, count, sizeof(LockSiteSnapshot), compare_lock_site_wait);
+    return count;
+}
+
+//* Upper bound of the bucket holding the given percentile (UINT64_MAX when it is the +Inf bucket)
+uint64_t histogram_percentile_bound(const MetricHistogram *histogram, const HistogramSpec *spec, double percentile) {
+    uint64_t total = 0, counts[HISTOGRAM_MAX_BUCKETS + 1];
+    for (int b = 0; b <= spec->bound_count; b++)
+        total += counts[b] = atomic_load_explicit(&histogram->buckets[b], memory_order_relaxed);
+    if (total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(total * percentile / 100.0 + 0.5), seen = 0;
+    for (int b = 0; b < spec->bound_count; b++) {
+        seen += counts[b];
+        if (seen >= rank)
+            return spec->bounds[b];
+    }
+    return UINT64_MAX;
+}
+
+//* =============== MEMORY: SUBSYSTEM ACCOUNTING + BUDGET ===============
+//* Large allocations are charged to a subsystem so stats can say where memory went.
+//* With a budget set, new transfers and exports wait (holding nothing) while usage
+//* is above the high-water mark and some in-flight work can still release memory;
+//* a transfer that would grow past the full budget is aborted instead of growing.
+
+enum {
+    MEMORY_STORE,       //* Touched proxy records and probe histories
+    MEMORY_TRANSFER,   //* HTTP body buffers
+    MEMORY_EXTRACTION,//* Per-body candidate batch arrays
+    MEMORY_EXPORT,   //* Estimated jansson DOM while saving
+    MEMORY_LOGGING, //* Log rings and trace buffers
+    MEMORY_SUBSYSTEM_COUNT
+};
+
+static const char *MEMORY_SUBSYSTEM_NAMES[MEMORY_SUBSYSTEM_COUNT] = {
+    "store", "transfer", "extraction", "export", "logging"
+};
+
+static atomic_llong memory_used[MEMORY_SUBSYSTEM_COUNT];
+static atomic_llong memory_peak[MEMORY_SUBSYSTEM_COUNT];
+static atomic_ullong memory_budget_bytes = (unsigned long long)MEMORY_BUDGET_MB * 1024 * 1024;
+static atomic_ullong memory_budget_waits = 0;   //* Reservations that had to wait
+static atomic_ullong memory_budget_aborts = 0; //* Transfers aborted for exceeding the budget
+static atomic_int memory_waiters = 0;
+static pthread_mutex_t memory_budget_mutex = PTHREAD_MUTEX_INITIALIZER; //* Waiters only
+static pthread_cond_t memory_budget_released = PTHREAD_COND_INITIALIZER;
+
+//* Adds (or with a negative delta, releases) bytes charged to a subsystem
+void memory_charge(int subsystem, long long delta) {
+    long long used = atomic_fetch_add_explicit(&memory_used[subsystem], delta, memory_order_relaxed) + delta;
+    long long peak = atomic_load_explicit(&memory_peak[subsystem], memory_order_relaxed);
+    while (used > peak &&
+           !atomic_compare_exchange_weak_explicit(&memory_peak[subsystem], &peak, used,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
+    if (delta < 0 && atomic_load_explicit(&memory_waiters, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&memory_budget_mutex);
+        pthread_cond_broadcast(&memory_budget_released);
+        pthread_mutex_unlock(&memory_budget_mutex);
+    }
+}
+
+uint64_t memory_accounted_total() {
+    long long total = 0;
+    for (int s = 0; s < MEMORY_SUBSYSTEM_COUNT; s++)
+        total += atomic_load_explicit(&memory_used[s], memory_order_relaxed);
+    return total > 0 ? (uint64_t)total : 0;
+}
+
+//* Resident set size from /proc/self/statm (0 where unavailable)
+uint64_t memory_resident_bytes() {
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    unsigned long long pages_total = 0, pages_resident = 0;
+    int parsed = fscanf(statm, "%llu %llu", &pages_total, &pages_resident);
+    fclose(statm);
+    return parsed == 2 ? pages_resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+//* What the budget is compared against: RSS also covers allocations we do not account (curl, PCRE2)
+static uint64_t memory_pressure() {
+    uint64_t accounted = memory_accounted_total();
+    uint64_t resident = memory_resident_bytes();
+    return accounted > resident ? accounted : resident;
+}
+
+//* Memory held by work that will finish and free it (store and logging never shrink)
+static long long memory_reclaimable() {
+    return atomic_load_explicit(&memory_used[MEMORY_TRANSFER], memory_order_relaxed) +
+           atomic_load_explicit(&memory_used[MEMORY_EXTRACTION], memory_order_relaxed) +
+           atomic_load_explicit(&memory_used[MEMORY_EXPORT], memory_order_relaxed);
+}
+
+//* Charges `bytes`, first waiting for headroom when budget mode is on. Call only while
+//* holding no other accounted memory, so waiters cannot block each other.
+void memory_reserve(int subsystem, size_t bytes) {
+    uint64_t budget = atomic_load_explicit(&memory_budget_bytes, memory_order_relaxed);
+    if (budget > 0) {
+        uint64_t high_water = (uint64_t)(budget * run_options.memory_high_water);
+        int waited = 0;
+        while (atomic_load(&program_active) && memory_pressure() + bytes > high_water && memory_reclaimable() > 0) {
+            if (!waited++)
+                atomic_fetch_add_explicit(&memory_budget_waits, 1, memory_order_relaxed);
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 200000000L; //* Re-check RSS even if nothing signals
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            atomic_fetch_add(&memory_waiters, 1);
+            pthread_mutex_lock(&memory_budget_mutex);
+            pthread_cond_timedwait(&memory_budget_released, &memory_budget_mutex, &deadline);
+            pthread_mutex_unlock(&memory_budget_mutex);
+            atomic_fetch_sub(&memory_waiters, 1);
+        }
+    }
+    memory_charge(subsystem, (long long)bytes);
+}
+
+//* Budget check for growing an existing allocation; never waits (the caller holds memory)
+int memory_growth_allowed(size_t extra_bytes) {
+    uint64_t budget = atomic_load_explicit(&memory_budget_bytes, memory_order_relaxed);
+    return budget == 0 || memory_accounted_total() + extra_bytes <= budget;
+}
+
+//* =============== PROFILING: PER-STAGE SPANS (BUILD-TIME) ===============
+//* Compile with -DMTP_STAGE_SPANS to time fetch, decode, every pattern loop,
+//* normalization, validation, commit and export. Each thread records into its
+//* own log-linear (HDR-style) histograms; readers merge all threads on demand.
+//* Without the flag the span macros expand to nothing.
+
+enum {
+    STAGE_FETCH,           //* curl_easy_perform()
+    STAGE_DECODE,         //* write callback: curl-decoded body chunks appended to the buffer
+    STAGE_NORMALIZE,     //* sanitize_string() + label prefix stripping per candidate
+    STAGE_VALIDATE,     //* validate_proxy() + hashing and record finalization
+    STAGE_COMMIT,      //* storage_mutex wait + store dedup/insert per body
+    STAGE_EXPORT,     //* save_proxies_to_json()
+    STAGE_PATTERN_BASE, //* STAGE_PATTERN_BASE + i: match loop of PARSE_PATTERNS[i]
+    STAGE_COUNT = STAGE_PATTERN_BASE + MAX_PATTERNS
+};
+
+#ifdef MTP_STAGE_SPANS
+
+#define HDR_SUB_BUCKET_BITS 4 //** 16 linear sub-buckets per power of two (~6% relative error)
+#define HDR_MAX_EXPONENT 40 //** Largest tracked value ~2^41 ns (~36 minutes)
+#define HDR_BUCKET_COUNT ((HDR_MAX_EXPONENT - HDR_SUB_BUCKET_BITS + 2) << HDR_SUB_BUCKET_BITS)
+
+#define STAGE_SPAN_BEGIN(var) uint64_t var = monotonic_ns()
+#define STAGE_SPAN_END(var, stage) stage_span_record((stage), monotonic_ns() - (var))
+
+/**
+ * @brief One thread's histogram for one stage. Only the owning thread writes;
+ *        relaxed atomics let readers merge it without stopping the writer.
+ */
+typedef struct {
+    atomic_uint counts[HDR_BUCKET_COUNT];
+    atomic_ullong sum_ns;
+    atomic_ullong max_ns;
+} StageHistogram;
+
+/**
+ * @brief All stage histograms of one thread, linked into a global registry.
+ */
+typedef struct StageSpanBlock {
+    StageHistogram *histograms[STAGE_COUNT]; //* Allocated on the stage's first span
+    struct StageSpanBlock *next;
+} StageSpanBlock;
+
+/**
+ * @brief Merged view of one stage across live and exited threads.
+ */
+typedef struct {
+    uint64_t counts[HDR_BUCKET_COUNT];
+    uint64_t total;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} StageSpanTotals;
+
+static __thread StageSpanBlock *stage_span_block = NULL; //* This thread's block
+static StageSpanBlock *stage_span_blocks = NULL;         //* Registry of live threads' blocks
+static StageSpanTotals *stage_span_retired = NULL;       //* Merged histograms of exited threads
+static pthread_mutex_t stage_span_mutex = PTHREAD_MUTEX_INITIALIZER; //* Registry only, never on the hot path
+static pthread_key_t stage_span_key;
+static pthread_once_t stage_span_once = PTHREAD_ONCE_INIT;
+
+static int hdr_bucket_index(uint64_t value) {
+    if (value < (1u << HDR_SUB_BUCKET_BITS))
+        return (int)value;
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > HDR_MAX_EXPONENT)
+        return HDR_BUCKET_COUNT - 1;
+    int shift = exponent - HDR_SUB_BUCKET_BITS;
+    int sub_bucket = (int)((value >> shift) & ((1u << HDR_SUB_BUCKET_BITS) - 1));
+    return ((shift + 1) << HDR_SUB_BUCKET_BITS) + sub_bucket;
+}
+
+//* Representative (midpoint) value of a bucket
+static uint64_t hdr_bucket_value(int index) {
+    if (index < (1 << HDR_SUB_BUCKET_BITS))
+        return (uint64_t)index;
+    int shift = (index >> HDR_SUB_BUCKET_BITS) - 1;
+    uint64_t base = ((uint64_t)(1u << HDR_SUB_BUCKET_BITS) + (index & ((1u << HDR_SUB_BUCKET_BITS) - 1))) << shift;
+    return base + (((uint64_t)1 << shift) >> 1);
+}
+
+static void stage_span_merge(StageSpanTotals *into, int stage, const StageHistogram *histogram) {
+    for (int b = 0; b < HDR_BUCKET_COUNT; b++) {
+        uint64_t count = atomic_load_explicit(&histogram->counts[b], memory_order_relaxed);
+        into[stage].counts[b] += count;
+        into[stage].total += count;
+    }
+    into[stage].sum_ns += atomic_load_explicit(&histogram->sum_ns, memory_order_relaxed);
+    uint64_t max_ns = atomic_load_explicit(&histogram->max_ns, memory_order_relaxed);
+    if (max_ns > into[stage].max_ns)
+        into[stage].max_ns = max_ns;
+}
+
+//* Thread exit: fold the block into the retired totals and unlink it
+static void stage_span_thread_exit(void *block_data) {
+    StageSpanBlock *block = (StageSpanBlock *)block_data;
+    pthread_mutex_lock(&stage_span_mutex);
+    for (StageSpanBlock **link = &stage_span_blocks; *link; link = &(*link)->next) {
+        if (*link == block) {
+            *link = block->next;
+            break;
+        }
+    }
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        if (block->histograms[stage]) {
+            if (stage_span_retired)
+                stage_span_merge(stage_span_retired, stage, block->histograms[stage]);
+            free(block->histograms[stage]);
+        }
+    }
+    pthread_mutex_unlock(&stage_span_mutex);
+    free(block);
+}
+
+static void stage_span_init_once(void) {
+    pthread_key_create(&stage_span_key, stage_span_thread_exit);
+    stage_span_retired = calloc(STAGE_COUNT, sizeof(StageSpanTotals));
+}
+
+static StageHistogram* stage_span_histogram(int stage) {
+    if (!stage_span_block) {
+        pthread_once(&stage_span_once, stage_span_init_once);
+        StageSpanBlock *block = calloc(1, sizeof(StageSpanBlock));
+        if (!block)
+            return NULL;
+        pthread_mutex_lock(&stage_span_mutex);
+        block->next = stage_span_blocks;
+        stage_span_blocks = block;
+        pthread_mutex_unlock(&stage_span_mutex);
+        pthread_setspecific(stage_span_key, block);
+        stage_span_block = block;
+    }
+    if (!stage_span_block->histograms[stage]) {
+        StageHistogram *histogram = calloc(1, sizeof(StageHistogram));
+        if (!histogram)
+            return NULL;
+        //* Publish under the registry lock so a concurrent merge sees a complete histogram
+        pthread_mutex_lock(&stage_span_mutex);
+        stage_span_block->histograms[stage] = histogram;
+        pthread_mutex_unlock(&stage_span_mutex);
+    }
+    return stage_span_block->histograms[stage];
+}
+
+void stage_span_record(int stage, uint64_t duration_ns) {
+    if (stage < 0 || stage >= STAGE_COUNT)
+        return;
+    StageHistogram *histogram = stage_span_histogram(stage);
+    if (!histogram)
+        return;
+    //* Single writer: plain load + store, no locked read-modify-write
+    atomic_uint *count = &histogram->counts[hdr_bucket_index(duration_ns)];
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&histogram->sum_ns,
+                          atomic_load_explicit(&histogram->sum_ns, memory_order_relaxed) + duration_ns,
+                          memory_order_relaxed);
+    if (duration_ns > atomic_load_explicit(&histogram->max_ns, memory_order_relaxed))
+        atomic_store_explicit(&histogram->max_ns, duration_ns, memory_order_relaxed);
+}
+
+//* Merges every thread's histograms into `totals` (STAGE_COUNT entries)
+void stage_span_collect(StageSpanTotals *totals) {
+    memset(totals, 0, sizeof(StageSpanTotals) * STAGE_COUNT);
+    pthread_once(&stage_span_once, stage_span_init_once);
+    pthread_mutex_lock(&stage_span_mutex);
+    if (stage_span_retired)
+        memcpy(totals, stage_span_retired, sizeof(StageSpanTotals) * STAGE_COUNT);
+    for (StageSpanBlock *block = stage_span_blocks; block; block = block->next) {
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            if (block->histograms[stage])
+                stage_span_merge(totals, stage, block->histograms[stage]);
+        }
+    }
+    pthread_mutex_unlock(&stage_span_mutex);
+}
+
+uint64_t stage_span_percentile(const StageSpanTotals *totals, double percentile) {
+    if (totals->total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * totals->total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < HDR_BUCKET_COUNT; b++) {
+        seen += totals->counts[b];
+        if (seen >= rank)
+            return MIN(hdr_bucket_value(b), totals->max_ns);
+    }
+    return totals->max_ns;
+}
+
+void stage_span_name(int stage, char *name, size_t name_size) {
+    static const char *STAGE_NAMES[STAGE_PATTERN_BASE] = {
+        "fetch", "decode", "normalize", "validate", "commit", "export"
+    };
+    if (stage < STAGE_PATTERN_BASE)
+        snprintf(name, name_size, "%s", STAGE_NAMES[stage]);
+    else
+        snprintf(name, name_size, "pattern_%d", stage - STAGE_PATTERN_BASE);
+}
+
+#else
+
+#define STAGE_SPAN_BEGIN(var) ((void)0)
+#define STAGE_SPAN_END(var, stage) ((void)0)
+
+#endif //* MTP_STAGE_SPANS
+
+//* =============== PROFILING: HARDWARE COUNTERS (OPT-IN) ===============
+//* --hw-counters opens a perf_event group per thread (instructions, cycles, cache
+//* misses, branch misses; user space only) and reads it around every pattern pass,
+//* the extraction and commit stages. Where perf events are unavailable (no PMU,
+//* perf_event_paranoid, non-Linux) the same passes are recorded with timing only.
+
+enum {
+    HW_INSTRUCTIONS,
+    HW_CYCLES,
+    HW_CACHE_MISSES,
+    HW_BRANCH_MISSES,
+    HW_EVENT_COUNT
+};
+
+enum {
+    HW_STAGE_EXTRACTION, //* All pattern passes over one body
+    HW_STAGE_COMMIT,    //* Store dedup/insert for one body
+    HW_STAGE_COUNT
+};
+
+static const char *HW_EVENT_NAMES[HW_EVENT_COUNT] = {"instructions", "cycles", "cache_misses", "branch_misses"};
+static const char *HW_STAGE_NAMES[HW_STAGE_COUNT] = {"extraction", "commit"};
+
+/**
+ * @brief Aggregated measurements for one pattern, stage or source.
+ */
+typedef struct {
+    atomic_ullong passes;                      //* Measured executions
+    atomic_ullong counted_passes;             //* ...of which had hardware counters
+    atomic_ullong bytes;                     //* Input bytes scanned
+    atomic_ullong ns;                       //* Wall time
+    atomic_ullong events[HW_EVENT_COUNT];  //* Summed over counted passes only
+} HwCounterTotals;
+
+/**
+ * @brief Counter readings at the start of a measured region.
+ */
+typedef struct {
+    uint64_t ns;
+    int counted;                       //* 0: this thread has no counters (timing only)
+    uint64_t enabled_ns;              //* perf time_enabled / time_running, for multiplex scaling
+    uint64_t running_ns;
+    uint64_t events[HW_EVENT_COUNT];
+} HwSample;
+
+/**
+ * @brief One thread's perf_event group (leader is fds[0]).
+ */
+typedef struct {
+    int fds[HW_EVENT_COUNT];
+} HwThreadCounters;
+
+static atomic_int hw_counters_enabled = 0;      //* Set by --hw-counters before any worker starts
+static atomic_int hw_threads_counted = 0;      //* Threads that opened a counter group
+static atomic_int hw_threads_timing_only = 0; //* Threads that fell back to timing
+static HwCounterTotals hw_pattern_totals[MAX_PATTERNS];
+static HwCounterTotals hw_stage_totals[HW_STAGE_COUNT];
+static HwCounterTotals hw_source_totals[URL_CAPACITY];
+static __thread HwThreadCounters *thread_hw_counters = NULL;
+static __thread int thread_hw_state = 0; //* 0 unopened, 1 counting, -1 timing only
+static pthread_key_t hw_counters_key;
+static pthread_once_t hw_counters_once = PTHREAD_ONCE_INIT;
+
+#define HW_COUNTERS_ON() __builtin_expect(atomic_load_explicit(&hw_counters_enabled, memory_order_relaxed), 0)
+
+static void hw_counters_close(HwThreadCounters *counters) {
+    for (int e = HW_EVENT_COUNT - 1; e >= 0; e--)
+        if (counters->fds[e] >= 0)
+            close(counters->fds[e]);
+    free(counters);
+}
+
+static void hw_counters_thread_exit(void *counters_data) {
+    hw_counters_close((HwThreadCounters *)counters_data);
+}
+
+static void hw_counters_init_once(void) {
+    pthread_key_create(&hw_counters_key, hw_counters_thread_exit);
+}
+
+//* Opens this thread's counter group; on any failure the thread records timing only
+static int hw_counters_open_thread() {
+#ifdef __linux__
+    static const uint64_t configs[HW_EVENT_COUNT] = {
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    HwThreadCounters *counters = malloc(sizeof(HwThreadCounters));
+    if (!counters)
+        return -1;
+    for (int e = 0; e < HW_EVENT_COUNT; e++)
+        counters->fds[e] = -1;
+
+    for (int e = 0; e < HW_EVENT_COUNT; e++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[e];
+        attr.disabled = (e == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        counters->fds[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, e == 0 ? -1 : counters->fds[0], 0);
+        if (counters->fds[e] < 0) {
+            hw_counters_close(counters);
+            return -1;
+        }
+    }
+    ioctl(counters->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    pthread_once(&hw_counters_once, hw_counters_init_once);
+    pthread_setspecific(hw_counters_key, counters);
+    thread_hw_counters = counters;
+    return 1;
+#else
+    return -1;
+#endif
+}
+
+void hw_sample_begin(HwSample *sample) {
+    if (thread_hw_state == 0) {
+        thread_hw_state = hw_counters_open_thread();
+        atomic_fetch_add(thread_hw_state > 0 ? &hw_threads_counted : &hw_threads_timing_only, 1);
+    }
+    sample->counted = 0;
+    if (thread_hw_state > 0) {
+        uint64_t values[3 + HW_EVENT_COUNT]; //* nr, time_enabled, time_running, value...
+        if (read(thread_hw_counters->fds[0], values, sizeof(values)) == (ssize_t)sizeof(values)) {
+            sample->enabled_ns = values[1];
+            sample->running_ns = values[2];
+            memcpy(sample->events, &values[3], sizeof(sample->events));
+            sample->counted = 1;
+        }
+    }
+    sample->ns = monotonic_ns();
+}
+
+//* Adds the region since `start` to each non-NULL totals entry
+void hw_sample_end(const HwSample *start, size_t bytes, HwCounterTotals *first, HwCounterTotals *second) {
+    uint64_t elapsed_ns = monotonic_ns() - start->ns;
+    uint64_t deltas[HW_EVENT_COUNT] = {0};
+    int counted = 0;
+    if (start->counted) {
+        uint64_t values[3 + HW_EVENT_COUNT];
+        if (read(thread_hw_counters->fds[0], values, sizeof(values)) == (ssize_t)sizeof(values)) {
+            uint64_t enabled = values[1] - start->enabled_ns;
+            uint64_t running = values[2] - start->running_ns;
+            for (int e = 0; e < HW_EVENT_COUNT; e++) {
+                deltas[e] = values[3 + e] - start->events[e];
+                if (running > 0 && running < enabled) //* Group was multiplexed: extrapolate
+                    deltas[e] = (uint64_t)((double)deltas[e] * enabled / running);
+            }
+            counted = 1;
+        }
+    }
+    HwCounterTotals *targets[2] = {first, second};
+    for (int t = 0; t < 2; t++) {
+        HwCounterTotals *totals = targets[t];
+        if (!totals)
+            continue;
+        atomic_fetch_add_explicit(&totals->passes, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&totals->bytes, bytes, memory_order_relaxed);
+        atomic_fetch_add_explicit(&totals->ns, elapsed_ns, memory_order_relaxed);
+        if (counted) {
+            atomic_fetch_add_explicit(&totals->counted_passes, 1, memory_order_relaxed);
+            for (int e = 0; e < HW_EVENT_COUNT; e++)
+                atomic_fetch_add_explicit(&totals->events[e], deltas[e], memory_order_relaxed);
+        }
+    }
+}
+
+//* =============== SIGNAL HANDLER ===============
+//* Gracefully shuts down on Ctrl+C or kill signal
+
+void handle_interrupt(int signal) {
+    printf("\n[SYSTEM] Received signal %d. Performing graceful shutdown...\n", signal);
+    atomic_store(&program_active, 0); //* Signal all thread to stop
+}
+
+//* SIGHUP asks for a config reload. On Linux it stays blocked in every thread (the mask is
+//* set before the first thread starts and inherited) and is read from a signalfd at cycle
+//* boundaries; elsewhere a handler sets a flag that is polled at the same points.
+static int reload_signal_fd = -1;
+static volatile sig_atomic_t reload_signal_flag = 0;
+
+static void handle_reload_signal(int signal) {
+    (void)signal;
+    reload_signal_flag = 1;
+}
+
+//* Call before any thread is created
+void reload_signal_init() {
+#ifdef __linux__
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGHUP);
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) == 0) {
+        reload_signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (reload_signal_fd >= 0)
+            return;
+        pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+    }
+#endif
+    signal(SIGHUP, handle_reload_signal);
+}
+
+//* Consumes pending SIGHUPs without blocking; returns 1 if there was at least one
+int reload_signal_pending() {
+    int pending = 0;
+#ifdef __linux__
+    struct signalfd_siginfo info;
+    while (reload_signal_fd >= 0 && read(reload_signal_fd, &info, sizeof(info)) == (ssize_t)sizeof(info))
+        pending = 1;
+#endif
+    if (reload_signal_flag) {
+        reload_signal_flag = 0;
+        pending = 1;
+    }
+    return pending;
+}
+
+//* =============== ASYNC LOGGING ===============
+//* Each thread formats into its own single-producer ring; a background writer
+//* drains all rings with a cached timestamp. Producers never lock or block:
+//* when a ring is full (or no ring is free) the message is dropped and counted.
+
+/**
+ * @brief One buffered log line (formatted by the producer, stamped with its second).
+ */
+typedef struct {
+    time_t timestamp;              //* CLOCK_REALTIME_COARSE seconds
+    int level;                    //* LOG_LEVEL_*
+    char text[LOG_MESSAGE_SIZE]; //* NUL-terminated message
+} LogEntry;
+
+/**
+ * @brief Single-producer/single-consumer ring owned by one thread at a time.
+ */
+typedef struct {
+    atomic_int owner;          //* 1 while a thread holds the ring (released on thread exit)
+    atomic_uint head;         //* Next entry the writer reads (consumer-owned)
+    atomic_uint tail;        //* Next entry the producer writes (producer-owned)
+    LogEntry entries[LOG_RING_SLOTS];
+} LogRing;
+
+static LogRing *log_rings = NULL;                  //* LOG_RING_COUNT rings, allocated by start_log_writer()
+static __thread LogRing *thread_log_ring = NULL;  //* This thread's ring
+static atomic_int log_threshold = LOG_MIN_LEVEL;
+static atomic_ullong log_dropped = 0;             //* Messages lost to full rings or ring exhaustion
+static atomic_int log_writer_running = 0;
+static pthread_t log_writer_thread;
+static pthread_key_t log_ring_key;
+static pthread_once_t log_ring_once = PTHREAD_ONCE_INIT;
+
+static const char *LOG_LEVEL_NAMES[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+static void log_ring_release(void *ring_data) {
+    atomic_store_explicit(&((LogRing *)ring_data)->owner, 0, memory_order_release);
+}
+
+static void log_ring_init_once(void) {
+    pthread_key_create(&log_ring_key, log_ring_release);
+}
+
+static LogRing* log_acquire_ring() {
+    if (!log_rings)
+        return NULL;
+    pthread_once(&log_ring_once, log_ring_init_once);
+    for (int r = 0; r < LOG_RING_COUNT; r++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong_explicit(&log_rings[r].owner, &expected, 1,
+                                                    memory_order_acquire, memory_order_relaxed)) {
+            pthread_setspecific(log_ring_key, &log_rings[r]);
+            return &log_rings[r];
+        }
+    }
+    return NULL;
+}
+
+//* Hot path: a level check, then a vsnprintf into the thread's own ring
+void log_message(int level, const char* format, ...) {
+    if (level < atomic_load_explicit(&log_threshold, memory_order_relaxed))
+        return;
+
+    LogRing *ring = thread_log_ring;
+    if (!ring) {
+        ring = thread_log_ring = log_acquire_ring();
+        if (!ring) {
+            atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= LOG_RING_SLOTS) {
+        atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    LogEntry *entry = &ring->entries[tail % LOG_RING_SLOTS];
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    entry->timestamp = now.tv_sec;
+    entry->level = level;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(entry->text, sizeof(entry->text), format, args);
+    va_end(args);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+//* Emits roughly 1 in `every` calls per thread; use for per-item hot-path events
+#define LOG_SAMPLED(every, level, ...) do { \
+        static __thread unsigned int log_sample_counter; \
+        if (log_sample_counter++ % (every) == 0) \
+            log_message((level), __VA_ARGS__); \
+    } while (0)
+
+//* Consumer side: writes every buffered entry. Caller holds log_mutex.
+static int log_drain_locked() {
+    static time_t cached_second = 0;
+    static char cached_timestamp[32] = "";
+    int written = 0;
+
+    for (int r = 0; log_rings && r < LOG_RING_COUNT; r++) {
+        LogRing *ring = &log_rings[r];
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        for (; head != tail; head++) {
+            const LogEntry *entry = &ring->entries[head % LOG_RING_SLOTS];
+            if (entry->timestamp != cached_second) {
+                struct tm timeinfo;
+                localtime_r(&entry->timestamp, &timeinfo);
+                strftime(cached_timestamp, sizeof(cached_timestamp), "%Y-%m-%d %H:%M:%S", &timeinfo);
+                cached_second = entry->timestamp;
+            }
+            int level = entry->level >= LOG_LEVEL_DEBUG && entry->level <= LOG_LEVEL_ERROR ? entry->level : LOG_LEVEL_INFO;
+            fprintf(stdout, "[%s] [%s] %s\n", cached_timestamp, LOG_LEVEL_NAMES[level], entry->text);
+            written++;
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+
+    static unsigned long long reported_dropped = 0;
+    unsigned long long dropped = atomic_load_explicit(&log_dropped, memory_order_relaxed);
+    if (dropped != reported_dropped) {
+        fprintf(stdout, "[%s] [WARN] Logging dropped %llu messages (rings full)\n",
+                cached_timestamp, dropped - reported_dropped);
+        reported_dropped = dropped;
+    }
+
+    if (written > 0)
+        fflush(stdout);
+    return written;
+}
+
+//* Writes everything buffered so far (used before direct console output)
+void log_flush() {
+    PROFILED_LOCK(&log_mutex);
+    log_drain_locked();
+    PROFILED_UNLOCK(&log_mutex);
+}
+
+void* log_writer(void *unused) {
+    (void)unused;
+    while (atomic_load(&log_writer_running)) {
+        PROFILED_LOCK(&log_mutex);
+        int written = log_drain_locked();
+        PROFILED_UNLOCK(&log_mutex);
+        if (written == 0)
+            usleep(5000); //* Idle: producers never signal, the writer polls
+    }
+    log_flush();
+    return NULL;
+}
+
+//* Allocates the rings and starts the writer; until then messages are dropped
+int start_log_writer() {
+    log_rings = calloc(LOG_RING_COUNT, sizeof(LogRing));
+    if (!log_rings)
+        return 0;
+    memory_charge(MEMORY_LOGGING, (long long)(LOG_RING_COUNT * sizeof(LogRing)));
+    atomic_store(&log_writer_running, 1);
+    if (pthread_create(&log_writer_thread, NULL, log_writer, NULL) != 0) {
+        atomic_store(&log_writer_running, 0);
+        return 1; //* Rings still work; log_flush() drains them synchronously
+    }
+    return 1;
+}
+
+//* Drains remaining messages and stops the writer (call after the last log line)
+void stop_log_writer() {
+    if (atomic_exchange(&log_writer_running, 0))
+        pthread_join(log_writer_thread, NULL);
+    else
+        log_flush();
+}
+
+//* =============== TRACING: CHROME TRACE-EVENT TIMELINE ===============
+//* Opt-in (--trace-cycles / --trace-window). Threads append begin/end events to
+//* their own buffers; the main loop dumps them as Chrome trace-event JSON
+//* (chrome://tracing, Perfetto) at a cycle boundary, when no worker is running.
+//* While tracing is off every trace point costs one predictable branch.
+
+enum {
+    TRACE_ARG_NONE,
+    TRACE_ARG_SOURCE,     //* arg = TARGET_URLS index
+    TRACE_ARG_PATTERN,   //* arg = PARSE_PATTERNS index
+    TRACE_ARG_COUNT,    //* arg = item count
+    TRACE_ARG_CYCLE    //* arg = cycle number
+};
+
+/**
+ * @brief One timeline event; names are string literals, never copied.
+ */
+typedef struct {
+    const char *name;
+    uint64_t timestamp_ns;   //* monotonic_ns() at begin (or at start for 'X')
+    uint64_t duration_ns;   //* Complete ('X') events only
+    int32_t arg;
+    char phase;           //* 'B', 'E' or 'X'
+    uint8_t arg_kind;    //* TRACE_ARG_*
+} TraceEvent;
+
+/**
+ * @brief Events of one thread. Kept after the thread exits until the next dump.
+ */
+typedef struct TraceBuffer {
+    int tid;                //* Small sequential id shown as the timeline row
+    const char *label;     //* Thread role shown as the row name
+    TraceEvent *events;
+    int count;
+    int capacity;
+    int dropped;
+    struct TraceBuffer *next;
+} TraceBuffer;
+
+/**
+ * @brief Which part of the run to trace, from the command line.
+ */
+typedef struct {
+    int first_cycle;          //* Cycle range (0 = unused)
+    int last_cycle;
+    long window_start;       //* Seconds since start (-1 = unused)
+    long window_end;
+    const char *output_path;
+} TraceOptions;
+
+static atomic_int trace_active = 0;                 //* The single branch every trace point checks
+static atomic_uint trace_generation = 1;          //* Bumped by each dump to invalidate thread buffers
+static atomic_int trace_writers = 0;             //* Threads touching their buffer; a dump frees only at 0
+static TraceBuffer *trace_buffers = NULL;        //* All buffers since the last dump
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER; //* Buffer registration and dumps only
+static atomic_int trace_next_tid = 1;
+static uint64_t trace_origin_ns = 0;          //* Timeline zero (first activation)
+static TraceOptions trace_options = { 0, 0, -1, -1, TRACE_DEFAULT_FILE };
+static __thread TraceBuffer *thread_trace_buffer = NULL;
+static __thread unsigned int thread_trace_generation = 0; //* Checked instead of the buffer, which a dump frees
+static __thread const char *thread_trace_label = "thread";
+
+#define TRACE_ENABLED() __builtin_expect(atomic_load_explicit(&trace_active, memory_order_relaxed), 0)
+#define TRACE_BEGIN(name, kind, arg) do { if (TRACE_ENABLED()) trace_emit('B', (name), (kind), (arg), 0, 0); } while (0)
+#define TRACE_END(name, kind, arg) do { if (TRACE_ENABLED()) trace_emit('E', (name), (kind), (arg), 0, 0); } while (0)
+#define TRACE_COMPLETE(name, kind, arg, start_ns, duration_ns) \
+    do { if (TRACE_ENABLED()) trace_emit('X', (name), (kind), (arg), (start_ns), (duration_ns)); } while (0)
+
+//* Names the calling thread's timeline row ("worker", "prober", ...)
+void trace_set_thread_label(const char *label) {
+    thread_trace_label = label;
+    atomic_fetch_add(&trace_writers, 1);
+    if (thread_trace_buffer && thread_trace_generation == atomic_load(&trace_generation))
+        thread_trace_buffer->label = label;
+    atomic_fetch_sub(&trace_writers, 1);
+}
+
+//* Call with trace_writers raised. Both sides use seq_cst: a thread that raised it after a
+//* dump's bump sees the new generation, and one that raised it before is waited for.
+static TraceBuffer* trace_thread_buffer() {
+    unsigned int generation = atomic_load(&trace_generation);
+    if (thread_trace_buffer && thread_trace_generation == generation)
+        return thread_trace_buffer;
+
+    TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+    if (!buffer)
+        return NULL;
+    memory_charge(MEMORY_LOGGING, sizeof(TraceBuffer));
+    buffer->tid = atomic_fetch_add(&trace_next_tid, 1);
+    buffer->label = thread_trace_label;
+
+    pthread_mutex_lock(&trace_mutex);
+    buffer->next = trace_buffers;
+    trace_buffers = buffer;
+    pthread_mutex_unlock(&trace_mutex);
+
+    thread_trace_buffer = buffer;
+    thread_trace_generation = generation;
+    return buffer;
+}
+
+static void trace_append(TraceBuffer *buffer, char phase, const char *name, int arg_kind, int arg, uint64_t start_ns,
+                         uint64_t duration_ns) {
+    if (buffer->count == buffer->capacity) {
+        int new_capacity = buffer->capacity ? buffer->capacity * 2 : 1024;
+        TraceEvent *events = NULL;
+        if (new_capacity <= TRACE_MAX_EVENTS_PER_THREAD)
+            events = realloc(buffer->events, sizeof(TraceEvent) * new_capacity);
+        if (!events) {
+            buffer->dropped++;
+            return;
+        }
+        memory_charge(MEMORY_LOGGING, (long long)sizeof(TraceEvent) * (new_capacity - buffer->capacity));
+        buffer->events = events;
+        buffer->capacity = new_capacity;
+    }
+    TraceEvent *event = &buffer->events[buffer->count++];
+    event->name = name;
+    event->phase = phase;
+    event->arg_kind = (uint8_t)arg_kind;
+    event->arg = arg;
+    event->timestamp_ns = phase == 'X' ? start_ns : monotonic_ns();
+    event->duration_ns = duration_ns;
+}
+
+void trace_emit(char phase, const char *name, int arg_kind, int arg, uint64_t start_ns, uint64_t duration_ns) {
+    atomic_fetch_add(&trace_writers, 1);
+    TraceBuffer *buffer = trace_thread_buffer();
+    if (buffer)
+        trace_append(buffer, phase, name, arg_kind, arg, start_ns, duration_ns);
+    atomic_fetch_sub(&trace_writers, 1);
+}
+
+static void trace_write_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const char *p = text; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            fprintf(out, "\\%c", *p);
+        else if ((unsigned char)*p < 0x20)
+            fprintf(out, "\\u%04x", (unsigned char)*p);
+        else
+            fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void trace_write_args(FILE *out, const TraceEvent *event) {
+    switch (event->arg_kind) {
+    case TRACE_ARG_SOURCE:
+        fprintf(out, ",\"args\":{\"source\":");
+        trace_write_json_string(out, event->arg >= 0 && event->arg < URL_CAPACITY && TARGET_URLS[event->arg]
+                                     ? TARGET_URLS[event->arg] : "unknown");
+        fputc('}', out);
+        break;
+    case TRACE_ARG_PATTERN:
+        fprintf(out, ",\"args\":{\"pattern\":%d}", event->arg);
+        break;
+    case TRACE_ARG_COUNT:
+        fprintf(out, ",\"args\":{\"count\":%d}", event->arg);
+        break;
+    case TRACE_ARG_CYCLE:
+        fprintf(out, ",\"args\":{\"cycle\":%d}", event->arg);
+        break;
+    default:
+        break;
+    }
+}
+
+//* Writes and discards every buffered event. Safe while traced threads run (stage threads,
+//* the sync listener): events recorded after the bump go to fresh buffers, and the old ones
+//* are read and freed only once no thread is still inside trace_emit().
+void trace_dump(const char *reason) {
+    pthread_mutex_lock(&trace_mutex);
+    TraceBuffer *buffers = trace_buffers;
+    trace_buffers = NULL;
+    atomic_fetch_add(&trace_generation, 1);
+    pthread_mutex_unlock(&trace_mutex);
+    while (atomic_load(&trace_writers) > 0)
+        sched_yield();
+    if (!buffers)
+        return;
+
+    FILE *out = fopen(trace_options.output_path, "w");
+    if (!out) {
+        log_message(LOG_LEVEL_WARN, "Cannot write trace %s: %s", trace_options.output_path, strerror(errno));
+    }
+
+    long total_events = 0, total_dropped = 0;
+    int first = 1;
+    if (out)
+        fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (TraceBuffer *buffer = buffers; buffer; ) {
+        if (out) {
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s-%d\"}}",
+                    first ? "" : ",\n", buffer->tid, buffer->label, buffer->tid);
+            first = 0;
+            for (int e = 0; e < buffer->count; e++) {
+                const TraceEvent *event = &buffer->events[e];
+                double timestamp_us = event->timestamp_ns >= trace_origin_ns
+                                      ? (event->timestamp_ns - trace_origin_ns) / 1000.0 : 0.0;
+                fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"mtproto\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                        event->name, event->phase, timestamp_us, buffer->tid);
+                if (event->phase == 'X')
+                    fprintf(out, ",\"dur\":%.3f", event->duration_ns / 1000.0);
+                trace_write_args(out, event);
+                fputc('}', out);
+            }
+        }
+        total_events += buffer->count;
+        total_dropped += buffer->dropped;
+        TraceBuffer *next = buffer->next;
+        memory_charge(MEMORY_LOGGING, -(long long)(sizeof(TraceBuffer) + sizeof(TraceEvent) * buffer->capacity));
+        free(buffer->events);
+        free(buffer);
+        buffer = next;
+    }
+    if (out) {
+        fprintf(out, "\n],\"otherData\":{\"reason\":\"%s\",\"events\":%ld,\"dropped\":%ld}}\n",
+                reason, total_events, total_dropped);
+        fclose(out);
+        log_message(LOG_LEVEL_INFO, "Trace written to %s (%ld events, %ld dropped, %s)",
+                    trace_options.output_path, total_events, total_dropped, reason);
+    }
+}
+
+//* Called by the main loop at points where no worker is running: before a
+//* cycle, after it, and during the pause. Starts, stops and dumps the trace.
+void trace_checkpoint(int cycle_number, int cycle_starting) {
+    int wanted = 0;
+    if (trace_options.first_cycle > 0) {
+        wanted = cycle_starting && cycle_number >= trace_options.first_cycle &&
+                 cycle_number <= trace_options.last_cycle;
+        if (!cycle_starting && cycle_number >= trace_options.first_cycle && cycle_number < trace_options.last_cycle)
+            wanted = 1; //* Between cycles inside the range: keep the pause on the timeline
+    } else if (trace_options.window_start >= 0) {
+        double uptime = difftime(mtp_time(), stats.initialization_time);
+        wanted = uptime >= trace_options.window_start && uptime < trace_options.window_end;
+    } else {
+        return;
+    }
+
+    int active = atomic_load(&trace_active);
+    if (wanted && !active) {
+        if (trace_origin_ns == 0)
+            trace_origin_ns = monotonic_ns();
+        atomic_store(&trace_active, 1);
+        log_message(LOG_LEVEL_INFO, "Tracing enabled (cycle #%d)", cycle_number);
+    } else if (!wanted && active) {
+        atomic_store(&trace_active, 0);
+        char reason[64];
+        snprintf(reason, sizeof(reason), "stopped after cycle %d", cycle_number);
+        trace_dump(reason);
+    }
+}
+
+//* Flushes a trace cut short by shutdown
+void trace_shutdown() {
+    if (atomic_exchange(&trace_active, 0))
+        trace_dump("shutdown");
+}
+
+//* =============== SECURITY: USER-AGENT ROTATION ===============
+//* Returns a random User-Agent from the pool to mimic real users
+
+const char* get_random_user_agent() {
+    return USER_AGENTS[rand() % USER_AGENT_POOL_SIZE];
+}
+
+//* =============== SECURITY: REQUEST THROTTLING ===============
+//* Adds random micro-delays to avoid burst traffic patterns
+void random_delay() {
+    mtp_sleep_ns((rand() % run_options.rotation_delay_ms + 50) * 1000000ULL);
+}
+
+//* =============== DEDUPLICATION: FAST HASHING ===============
+//* 64-bit FNV-1a of server:port:secret. libmtparse owns the field code so stored
+//* hashes and the extractor's per-body dedup always agree.
+
+uint64_t compute_hash(const char* server, const char* port, const char* secret) {
+    return mtp_hash(server, port, secret);
+}
+
+//* =============== VALIDATION: PROXY SANITY CHECK ===============
+//* Ensures server, port, and secret meet MTProto requirements
+
+int validate_proxy(const char* server, const char* port, const char* secret) {
+    return mtp_validate(server, port, secret);
+}
+
+//* =============== SANITIZATION: CLEAN EXTRACTED STRINGS ===============
+//*          Removes control chars, normalizes whitespace, trims ends
+
+void sanitize_string(char *str) {
+    mtp_sanitize(str);
+}
+
+//* =============== HISTORY: COMPRESSED PROBE TIME SERIES ===============
+//* Bit-packed per-proxy probe outcomes kept in fixed-size ring segments
+
+//* Latency is stored as a 3-bit-mantissa logarithm: ~10% precision up to 127 codes
+uint8_t quantize_latency(int latency_ms) {
+    unsigned int value = (unsigned int)(latency_ms < 0 ? 0 : latency_ms) + 1;
+    int exponent = 31 - __builtin_clz(value);
+    if (exponent < 3)
+        return (uint8_t)value;
+    unsigned int code = (unsigned int)exponent * 8 + ((value >> (exponent - 3)) & 7);
+    return (uint8_t)MIN(code, 127u);
+}
+
+int dequantize_latency(uint8_t code) {
+    if (code < 8)
+        return code > 0 ? code - 1 : 0;
+    int exponent = code / 8;
+    unsigned int value = (8u + (code & 7)) << (exponent - 3);
+    return (int)(value + ((1u << (exponent - 3)) >> 1)) - 1; //* Midpoint of the bucket
+}
+
+static int encode_varint(uint32_t value, uint8_t *out) {
+    int length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static int decode_varint(const uint8_t *in, int available, uint32_t *value) {
+    uint32_t result = 0;
+    for (int i = 0; i < available && i < 5; i++) {
+        result |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0; //* Truncated
+}
+
+//* Appends one probe outcome, opening a new segment (and recycling the oldest) when full
+int history_append(ProbeHistory *history, time_t when, int reachable, int latency_ms) {
+    uint32_t unit_time = (uint32_t)(when / HISTORY_TIME_UNIT);
+    uint8_t status = reachable ? (uint8_t)(0x80 | quantize_latency(latency_ms)) : 0;
+    HistorySegment *segment = &history->segments[history->head];
+
+    if (history->filled == 0) {
+        history->filled = 1;
+        memset(segment, 0, sizeof(*segment));
+        segment->base_time = segment->last_time = unit_time;
+    }
+
+    uint8_t encoded[6];
+    uint32_t delta = unit_time > segment->last_time ? unit_time - segment->last_time : 0;
+    int length = encode_varint(delta, encoded);
+    encoded[length++] = status;
+
+    if (segment->used + length > HISTORY_SEGMENT_BYTES || segment->count == UINT8_MAX) {
+        history->head = (history->head + 1) % HISTORY_SEGMENTS;
+        if (history->filled < HISTORY_SEGMENTS)
+            history->filled++;
+        segment = &history->segments[history->head];
+        memset(segment, 0, sizeof(*segment));
+        segment->base_time = segment->last_time = unit_time;
+        length = encode_varint(0, encoded);
+        encoded[length++] = status;
+    }
+
+    memcpy(segment->data + segment->used, encoded, length);
+    segment->used += length;
+    segment->count++;
+    segment->last_time = unit_time;
+    return length;
+}
+
+//* Decodes every retained sample at or after `since` into a summary
+HistorySummary history_summarize(const ProbeHistory *history, time_t since) {
+    HistorySummary summary = {0};
+    if (!history || history->filled == 0)
+        return summary;
+
+    uint32_t since_unit = since > 0 ? (uint32_t)(since / HISTORY_TIME_UNIT) : 0;
+    long latency_total = 0;
+    int oldest = (history->head + HISTORY_SEGMENTS - history->filled + 1) % HISTORY_SEGMENTS;
+
+    for (int k = 0; k < history->filled; k++) {
+        const HistorySegment *segment = &history->segments[(oldest + k) % HISTORY_SEGMENTS];
+        uint32_t sample_time = segment->base_time;
+        int offset = 0;
+        for (int n = 0; n < segment->count && offset < segment->used; n++) {
+            uint32_t delta = 0;
+            int length = decode_varint(segment->data + offset, segment->used - offset, &delta);
+            if (length == 0 || offset + length >= segment->used)
+                break;
+            offset += length;
+            uint8_t status = segment->data[offset++];
+            sample_time += delta;
+
+            if (summary.first_sample == 0)
+                summary.first_sample = (time_t)sample_time * HISTORY_TIME_UNIT;
+            if (sample_time < since_unit)
+                continue;
+            summary.samples++;
+            if (status & 0x80) {
+                summary.reachable++;
+                latency_total += dequantize_latency(status & 0x7F);
+            }
+        }
+    }
+
+    if (summary.reachable > 0)
+        summary.avg_latency_ms = (int)(latency_total / summary.reachable);
+    return summary;
+}
+
+//* Records a probe outcome on a proxy, allocating its history on first use. Caller holds storage_mutex.
+void history_record_probe(ProxyRecord *record, time_t when, int reachable, int latency_ms) {
+    if (!record->history) {
+        record->history = calloc(1, sizeof(ProbeHistory));
+        if (!record->history)
+            return;
+        memory_charge(MEMORY_STORE, sizeof(ProbeHistory));
+    }
+    history_append(record->history, when, reachable, latency_ms);
+}
+
+static int compare_stored_history(const void *a, const void *b) {
+    uint64_t hash_a = ((const StoredHistory *)a)->hash_value;
+    uint64_t hash_b = ((const StoredHistory *)b)->hash_value;
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+//* Hands a persisted history to a rediscovered proxy. Caller holds storage_mutex.
+void history_claim_stored(ProxyRecord *record) {
+    if (stored_history_count == 0 || record->history)
+        return;
+    StoredHistory key = { .hash_value = record->hash_value };
+    StoredHistory *found = bsearch(&key, stored_histories, stored_history_count,
+                                   sizeof(StoredHistory), compare_stored_history);
+    if (found && found->history) {
+        record->history = found->history;
+        found->history = NULL;
+    }
+}
+
+static void write_u32(FILE *file, uint32_t value) {
+    uint8_t bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+static int read_u32(FILE *file, uint32_t *value) {
+    uint8_t bytes[4];
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes))
+        return 0;
+    *value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return 1;
+}
+
+static void write_history(FILE *file, uint64_t hash_value, const ProbeHistory *history) {
+    write_u32(file, (uint32_t)hash_value);
+    write_u32(file, (uint32_t)(hash_value >> 32));
+    fputc(history->head, file);
+    fputc(history->filled, file);
+    int oldest = (history->head + HISTORY_SEGMENTS - history->filled + 1) % HISTORY_SEGMENTS;
+    for (int k = 0; k < history->filled; k++) {
+        const HistorySegment *segment = &history->segments[(oldest + k) % HISTORY_SEGMENTS];
+        write_u32(file, segment->base_time);
+        write_u32(file, segment->last_time);
+        fputc(segment->used, file);
+        fputc(segment->count, file);
+        fwrite(segment->data, 1, segment->used, file);
+    }
+}
+
+//* Loads one history as written by write_history(); segments come back oldest-first
+static int read_history(FILE *file, uint64_t *hash_value, ProbeHistory *history) {
+    uint32_t low, high;
+    if (!read_u32(file, &low) || !read_u32(file, &high))
+        return 0;
+    *hash_value = ((uint64_t)high << 32) | low;
+    int head = fgetc(file), filled = fgetc(file);
+    if (head == EOF || filled == EOF || filled > HISTORY_SEGMENTS)
+        return 0;
+    memset(history, 0, sizeof(*history));
+    history->filled = (uint8_t)filled;
+    history->head = (uint8_t)(filled > 0 ? filled - 1 : 0);
+    for (int k = 0; k < filled; k++) {
+        HistorySegment *segment = &history->segments[k];
+        int used, count;
+        if (!read_u32(file, &segment->base_time) || !read_u32(file, &segment->last_time))
+            return 0;
+        used = fgetc(file);
+        count = fgetc(file);
+        if (used == EOF || count == EOF || used > HISTORY_SEGMENT_BYTES)
+            return 0;
+        segment->used = (uint8_t)used;
+        segment->count = (uint8_t)count;
+        if (fread(segment->data, 1, used, file) != (size_t)used)
+            return 0;
+    }
+    return 1;
+}
+
+//* Writes live and not-yet-claimed histories to HISTORY_FILE (tmp file + rename)
+void save_probe_histories() {
+    char tmp_path[64];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", HISTORY_FILE);
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        log_message(LOG_LEVEL_WARN, "Cannot write %s: %s", tmp_path, strerror(errno));
+        return;
+    }
+
+    uint32_t retention_cutoff = (uint32_t)((mtp_time() - run_options.history_retention_days * 86400L) / HISTORY_TIME_UNIT);
+    uint32_t written = 0;
+    fwrite("MTPH", 1, 4, file);
+    write_u32(file, 1); //* Format version
+    long count_offset = ftell(file);
+    write_u32(file, 0); //* Record count, patched below
+
+    PROFILED_LOCK(&storage_mutex);
+    int current_total = atomic_load(&stats.total_proxies);
+    for (int i = 0; i < current_total; i++) {
+        if (proxy_storage[i].history) {
+            write_history(file, proxy_storage[i].hash_value, proxy_storage[i].history);
+            written++;
+        }
+    }
+    for (int i = 0; i < stored_history_count; i++) {
+        const ProbeHistory *history = stored_histories[i].history;
+        if (history && history->filled > 0 &&
+            history->segments[history->head].last_time >= retention_cutoff) {
+            write_history(file, stored_histories[i].hash_value, history);
+            written++;
+        }
+    }
+    PROFILED_UNLOCK(&storage_mutex);
+
+    fseek(file, count_offset, SEEK_SET);
+    write_u32(file, written);
+    if (fclose(file) == 0 && rename(tmp_path, HISTORY_FILE) == 0) {
+        log_message(LOG_LEVEL_INFO, "Saved %u probe histories to %s", written, HISTORY_FILE);
+    } else {
+        log_message(LOG_LEVEL_WARN, "Failed to save %s", HISTORY_FILE);
+        unlink(tmp_path);
+    }
+}
+
+//* Loads HISTORY_FILE at startup; histories attach to proxies as they are rediscovered
+void load_probe_histories() {
+    FILE *file = fopen(HISTORY_FILE, "rb");
+    if (!file)
+        return;
+
+    char magic[4];
+    uint32_t version = 0, count = 0;
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, "MTPH", 4) != 0 ||
+        !read_u32(file, &version) || version != 1 || !read_u32(file, &count)) {
+        log_message(LOG_LEVEL_WARN, "Ignoring %s: unknown format", HISTORY_FILE);
+        fclose(file);
+        return;
+    }
+
+    stored_histories = calloc(count > 0 ? count : 1, sizeof(StoredHistory));
+    if (!stored_histories) {
+        fclose(file);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        ProbeHistory *history = malloc(sizeof(ProbeHistory));
+        if (!history || !read_history(file, &stored_histories[stored_history_count].hash_value, history)) {
+            free(history);
+            break;
+        }
+        stored_histories[stored_history_count++].history = history;
+    }
+    fclose(file);
+    memory_charge(MEMORY_STORE, (long long)(count * sizeof(StoredHistory) + stored_history_count * sizeof(ProbeHistory)));
+
+    qsort(stored_histories, stored_history_count, sizeof(StoredHistory), compare_stored_history);
+    log_message(LOG_LEVEL_INFO, "Loaded %d probe histories from %s", stored_history_count, HISTORY_FILE);
+}
+
+void free_probe_histories() {
+    int current_total = atomic_load(&stats.total_proxies);
+    for (int i = 0; proxy_storage && i < current_total; i++) {
+        if (proxy_storage[i].history)
+            memory_charge(MEMORY_STORE, -(long long)sizeof(ProbeHistory));
+        free(proxy_storage[i].history);
+        proxy_storage[i].history = NULL;
+    }
+    for (int i = 0; i < stored_history_count; i++) {
+        if (stored_histories[i].history)
+            memory_charge(MEMORY_STORE, -(long long)sizeof(ProbeHistory));
+        free(stored_histories[i].history);
+    }
+    free(stored_histories);
+    stored_histories = NULL;
+    stored_history_count = 0;
+}
+
+//* =============== REPUTATION: SOURCE QUALITY TRACKING ===============
+//* Remembers which sources report which proxies, and how early. Caller holds storage_mutex.
+
+void note_source_report(ProxyRecord *record, int source_index, int is_new, time_t now) {
+    if (source_index < 0 || source_index >= URL_CAPACITY)
+        return;
+
+    int bit = source_index % (SOURCE_MASK_WORDS * 64);
+    uint64_t flag = 1ULL << (bit % 64);
+    if (record->reporter_mask[bit / 64] & flag)
+        return; //* Already counted for this source
+
+    record->reporter_mask[bit / 64] |= flag;
+    SourceReputation *rep = &source_reputation[source_index];
+    rep->reported++;
+    if (is_new) {
+        rep->first_reports++;
+    } else {
+        rep->late_reports++;
+        rep->lag_seconds_total += difftime(now, record->discovery_time);
+    }
+}
+
+//* Recomputes every source score from probe outcomes. Caller holds storage_mutex.
+//* score = 0.75 * verify ratio + 0.25 * first-report ratio, both smoothed towards 0.5
+//* so a source with few samples is neither rewarded nor punished.
+
+void update_source_scores(int url_count) {
+    for (int s = 0; s < url_count; s++) {
+        source_reputation[s].probed = 0;
+        source_reputation[s].verified = 0;
+    }
+
+    int current_total = atomic_load(&stats.total_proxies);
+    int mask_bits = SOURCE_MASK_WORDS * 64;
+    for (int i = 0; i < current_total; i++) {
+        int outcome = atomic_load(&proxy_storage[i].verified);
+        if (outcome == 0)
+            continue;
+        for (int w = 0; w < SOURCE_MASK_WORDS; w++) {
+            uint64_t mask = proxy_storage[i].reporter_mask[w];
+            while (mask) {
+                int bit = w * 64 + __builtin_ctzll(mask);
+                mask &= mask - 1;
+                //* Credit every source sharing this bit (exact while url_count <= mask_bits)
+                for (int s = bit; s < url_count; s += mask_bits) {
+                    source_reputation[s].probed++;
+                    if (outcome > 0)
+                        source_reputation[s].verified++;
+                }
+            }
+        }
+    }
+
+    for (int s = 0; s < url_count; s++) {
+        SourceReputation *rep = &source_reputation[s];
+        double verify_ratio = (rep->verified + 2.0) / (rep->probed + 4.0);
+        double first_ratio = (rep->first_reports + 2.0) / (rep->reported + 4.0);
+        rep->score = 0.75 * verify_ratio + 0.25 * first_ratio;
+    }
+}
+
+//* True once a source has enough probed proxies for its score to be trusted
+int source_score_trusted(const SourceReputation *rep) {
+    return rep->probed >= (unsigned int)run_options.reputation_min_samples;
+}
+
+//* Cycles to wait before fetching a source again, from score and failure streak
+int source_fetch_interval(const SourceReputation *rep) {
+    int interval = 1;
+    double throttle_score = run_options.reputation_throttle_score;
+    if (source_score_trusted(rep) && rep->score < throttle_score) {
+        double deficit = (throttle_score - rep->score) / throttle_score;
+        interval = 2 + (int)(deficit * (run_options.reputation_max_skip - 2));
+    }
+    if (rep->fetch_failures > 0) {
+        int backoff = 1 << MIN(rep->fetch_failures, 3u);
+        if (backoff > interval)
+            interval = backoff;
+    }
+    return MIN(interval, run_options.reputation_max_skip);
+}
+
+//* Score of the source that first reported a proxy (0.5 when unknown)
+double proxy_source_score(const ProxyRecord *record) {
+    if (record->source_index < 0 || record->source_index >= URL_CAPACITY)
+        return 0.5;
+    const SourceReputation *rep = &source_reputation[record->source_index];
+    return source_score_trusted(rep) ? rep->score : 0.5;
+}
+
+//* =============== HTTP: CURL WRITE CALLBACK ===============
+//*          Appends downloaded data to a dynamic buffer
+
+//* Largest body a transfer or decode may hold (max_body_mb)
+size_t body_capacity() {
+    return (size_t)run_options.max_body_mb * 1024 * 1024;
+}
+
+size_t write_callback(void *content, size_t element_size, size_t element_count, void *user_buffer) {
+    size_t total_size = element_size * element_count;
+    DynamicBuffer *buffer = (DynamicBuffer *)user_buffer;
+
+    if (!buffer || !atomic_load(&program_active)) 
+        return 0;
+    STAGE_SPAN_BEGIN(decode_span);
+    //* Grow buffer is needed (capped at body_capacity())
+    if (buffer->size + total_size + 1 > buffer->capacity) {
+        size_t limit = body_capacity();
+        if (buffer->size + total_size + 1 > limit)
+            return 0; //* Body too large: abort the transfer
+        size_t new_capacity = buffer->capacity * 2;
+        if (new_capacity < buffer->size + total_size + 1) {
+            new_capacity = buffer->size + total_size + 1;
+        }
+        if (new_capacity > limit) {
+            new_capacity = limit;
+        }
+        if (!memory_growth_allowed(new_capacity - buffer->capacity)) {
+            atomic_fetch_add_explicit(&memory_budget_aborts, 1, memory_order_relaxed);
+            return 0; //* Budget mode: fail this transfer rather than the process
+        }
+        
+        char *new_data = realloc(buffer->data, new_capacity);
+        if (!new_data) {
+            return 0;
+        }
+        
+        memory_charge(MEMORY_TRANSFER, (long long)(new_capacity - buffer->capacity));
+        buffer->data = new_data;
+        buffer->capacity = new_capacity;
+    }
+
+    if (buffer->data) {
+        memcpy(buffer->data + buffer->size, content, total_size);
+        buffer->size += total_size;
+        buffer->data[buffer->size] = '\0';
+    }
+
+    STAGE_SPAN_END(decode_span, STAGE_DECODE);
+    return total_size;
+}
+
+//* =============== HTTP: CURL HANDLE SETUP ===============
+//* Configures libcurl with security and stealth options
+
+CURL* setup_curl_handle() {
+    CURL *curl = curl_easy_init();
+    if (!curl) return NULL;
+    
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, get_random_user_agent());
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)run_options.connection_timeout);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);         //* Follow redirects
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);            
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);       //* Disable cert verification (common )
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)run_options.connect_timeout); //* Fast connect timeout
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1024L);//* About slow transefts
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 15L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "gzip, deflate"); //* Save bandwith
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);              //* Maintan connection
+    
+    return curl;
+}
+
+//* =============== STORAGE: LOOKUP + COMMIT ===============
+//* The dedup store is a flat array scanned linearly; bench/bench_store.c measures
+//* both functions directly, so a replacement index only has to keep their contracts.
+
+//* Returns the index of the record with `hash_value`, or -1. Caller holds storage_mutex.
+int store_lookup(uint64_t hash_value) {
+    int current_total = atomic_load(&stats.total_proxies);
+    for (int j = 0; j < current_total; j++) {
+        if (proxy_storage[j].hash_value == hash_value)
+            return j;
+    }
+    return -1;
+}
+
+//* Merges a batch of validated, batch-unique proxies into the store under storage_mutex.
+//* Known proxies only record the reporting source. Returns the number of new records.
+int commit_discovered_proxies(const ProxyRecord *batch, int count, int source_index) {
+    SourceMetrics *metrics = metrics_for_source(source_index);
+    uint64_t commit_start = monotonic_ns();
+    int hw_counting = HW_COUNTERS_ON();
+    HwSample commit_sample;
+    TRACE_BEGIN("commit", TRACE_ARG_COUNT, count);
+    if (hw_counting)
+        hw_sample_begin(&commit_sample);
+    PROFILED_LOCK(&storage_mutex);
+    
+    int current_total = atomic_load(&stats.total_proxies);
+    int added_count = 0;
+    time_t commit_time = mtp_time();
+    
+    for (int i = 0; i < count && current_total < run_options.proxy_capacity; i++) {
+        int existing = store_lookup(batch[i].hash_value);
+        if (existing >= 0) {
+            note_source_report(&proxy_storage[existing], source_index, 0, commit_time);
+        } else {
+            proxy_storage[current_total] = batch[i];
+            note_source_report(&proxy_storage[current_total], source_index, 1, commit_time);
+            history_claim_stored(&proxy_storage[current_total]);
+            current_total++;
+            added_count++;
+            atomic_store(&stats.total_proxies, current_total); //* Visible to store_lookup for the rest of the batch
+        }
+    }
+    
+    stats_add(STAT_UNIQUE_PROXIES, added_count);
+    stats_add(STAT_SUCCESSFUL_PROXIES, added_count);
+    PROFILED_UNLOCK(&storage_mutex);
+    if (hw_counting)
+        hw_sample_end(&commit_sample, count * sizeof(ProxyRecord), &hw_stage_totals[HW_STAGE_COMMIT], NULL);
+    memory_charge(MEMORY_STORE, (long long)added_count * sizeof(ProxyRecord)); //* Store pages touched so far
+    
+    STAGE_SPAN_END(commit_start, STAGE_COMMIT);
+    TRACE_END("commit", TRACE_ARG_COUNT, count);
+    USDT_PROBE4(commit, source_index, count, added_count, current_total);
+    if (metrics) {
+        histogram_observe(&metrics->commit_latency, &COMMIT_LATENCY_SPEC, monotonic_ns() - commit_start);
+        atomic_fetch_add_explicit(&metrics->proxies_added, added_count, memory_order_relaxed);
+    }
+    
+    log_message(LOG_LEVEL_INFO, "Added %d new proxies | Total: %d", added_count, current_total);
+    return added_count;
+}
+
+//* =============== CORE: PROXY EXTRACTION ENGINE ===============
+//* Every thread drives its own libmtparse extractor (patterns compiled once per
+//* thread) and turns its candidates into a batch for commit_discovered_proxies().
+//* The hooks keep the per-pattern traces, hardware counters, spans and probes.
+
+/**
+ * @brief Per-body state shared with the extractor callback and hooks.
+ */
+typedef struct {
+    ProxyRecord *batch;
+    int count;
+    const char *source;
+    int source_index;
+    int hw_counting;
+    HwSample pattern_sample;
+    uint64_t pattern_start; //* Stage span start of the running pattern
+} ExtractionContext;
+
+static __thread MtpExtractor *thread_extractor = NULL;
+static pthread_key_t extractor_key;
+static pthread_once_t extractor_once = PTHREAD_ONCE_INIT;
+
+static void extractor_thread_exit(void *extractor) {
+    mtp_extractor_free((MtpExtractor *)extractor);
+}
+
+static void extractor_init_once(void) {
+    pthread_key_create(&extractor_key, extractor_thread_exit);
+}
+
+//* Frees the calling thread's extractor now; the main thread never runs the key destructor
+void release_thread_extractor() {
+    if (!thread_extractor)
+        return;
+    pthread_setspecific(extractor_key, NULL);
+    mtp_extractor_free(thread_extractor);
+    thread_extractor = NULL;
+}
+
+static void extraction_pattern_begin(void *user, int pattern_index) {
+    ExtractionContext *context = (ExtractionContext *)user;
+#ifdef MTP_STAGE_SPANS
+    context->pattern_start = monotonic_ns();
+#endif
+    TRACE_BEGIN("pattern", TRACE_ARG_PATTERN, pattern_index);
+    if (context->hw_counting)
+        hw_sample_begin(&context->pattern_sample);
+}
+
+static void extraction_pattern_end(void *user, int pattern_index, int accepted, size_t scanned_bytes) {
+    ExtractionContext *context = (ExtractionContext *)user;
+    STAGE_SPAN_END(context->pattern_start, STAGE_PATTERN_BASE + pattern_index);
+    TRACE_END("pattern", TRACE_ARG_PATTERN, pattern_index);
+    if (context->hw_counting)
+        hw_sample_end(&context->pattern_sample, scanned_bytes, &hw_pattern_totals[pattern_index], NULL);
+    if (accepted > 0)
+        log_message(LOG_LEVEL_INFO, "Pattern %d: Found %d proxies", pattern_index, accepted);
+}
+
+#ifdef MTP_HAVE_USDT
+static void extraction_match(void *user, int pattern_index, uint64_t start, uint64_t end) {
+    ExtractionContext *context = (ExtractionContext *)user;
+    USDT_PROBE4(pattern_match, pattern_index, context->source_index, start, end);
+}
+
+static void extraction_reject(void *user, int pattern_index, MtpRejectReason reason, uint64_t match_offset) {
+    ExtractionContext *context = (ExtractionContext *)user;
+    USDT_PROBE4(candidate_reject, pattern_index, context->source_index, reason, match_offset);
+}
+#endif
+
+#ifdef MTP_STAGE_SPANS
+static void extraction_phase_time(void *user, MtpPhase phase, uint64_t duration_ns) {
+    (void)user;
+    stage_span_record(phase == MTP_PHASE_NORMALIZE ? STAGE_NORMALIZE : STAGE_VALIDATE, duration_ns);
+}
+#endif
+
+static int extraction_should_continue(void *user) {
+    (void)user;
+    return atomic_load(&program_active);
+}
+
+//* Copies a candidate span into a fixed record field (the extractor bounds the lengths)
+static void copy_span(char *field, size_t field_size, MtpSpan span) {
+    size_t length = MIN(span.length, field_size - 1);
+    memcpy(field, span.data, length);
+    field[length] = '\0';
+}
+
+//* Finalizes one validated, body-unique candidate into the batch
+static int extraction_candidate(void *user, const MtpCandidate *candidate) {
+    ExtractionContext *context = (ExtractionContext *)user;
+    ProxyRecord *new_proxy = &context->batch[context->count++];
+    memset(new_proxy, 0, sizeof(ProxyRecord));
+    copy_span(new_proxy->server, sizeof(new_proxy->server), candidate->server);
+    copy_span(new_proxy->port, sizeof(new_proxy->port), candidate->port);
+    copy_span(new_proxy->secret, sizeof(new_proxy->secret), candidate->secret);
+    new_proxy->hash_value = candidate->hash;
+    new_proxy->discovery_time = mtp_time();
+    new_proxy->last_verified = mtp_time();
+    new_proxy->active = 1;
+    new_proxy->verified = 0;
+    new_proxy->speed_score = 50;
+    new_proxy->source_index = context->source_index;
+    strncpy(new_proxy->source, context->source, sizeof(new_proxy->source) - 1);
+    strcpy(new_proxy->type, candidate->is_ip ? "IPv4" : "Domain");
+    strcpy(new_proxy->country, "UN");
+    //* Build Telegram-ready URL
+    mtp_format_url(new_proxy->connection_url, sizeof(new_proxy->connection_url),
+                   new_proxy->server, new_proxy->port, new_proxy->secret);
+
+    //* Per-proxy event: sampled; the per-pattern count is the aggregate
+    LOG_SAMPLED(run_options.log_found_proxy_sample, LOG_LEVEL_DEBUG,
+                "Found proxy: %s:%s (secret: %.32s...) from pattern %d",
+                new_proxy->server, new_proxy->port, new_proxy->secret, candidate->pattern_index);
+    return 0;
+}
+
+//* Returns this thread's extractor, compiling the pattern table on first use
+static MtpExtractor* extractor_for_thread() {
+    if (thread_extractor)
+        return thread_extractor;
+    pthread_once(&extractor_once, extractor_init_once);
+    MtpOptions options = {0};
+    options.patterns = PARSE_PATTERNS;
+    options.on_candidate = extraction_candidate;
+    options.max_candidates = PROXY_BATCH_SIZE;
+    options.hooks.pattern_begin = extraction_pattern_begin;
+    options.hooks.pattern_end = extraction_pattern_end;
+#ifdef MTP_HAVE_USDT
+    options.hooks.match = extraction_match;
+    options.hooks.reject = extraction_reject;
+#endif
+#ifdef MTP_STAGE_SPANS
+    options.hooks.phase_time = extraction_phase_time;
+#endif
+    options.hooks.should_continue = extraction_should_continue;
+    thread_extractor = mtp_extractor_create(&options);
+    if (thread_extractor)
+        pthread_setspecific(extractor_key, thread_extractor);
+    return thread_extractor;
+}
+
+//* Runs every pattern over one body. Returns the number of validated, body-unique proxies
+//* and stores them in *batch_out: a malloc'd array sized to fit, charged to
+//* MEMORY_EXTRACTION until release_proxy_batch() (NULL when nothing was found).
+int extract_proxy_batch(const char *content, size_t content_length, const char* source, int source_index,
+                        ProxyRecord **batch_out) {
+    *batch_out = NULL;
+    if (!content || content_length == 0 || !atomic_load(&program_active)) 
+        return 0;
+
+    MtpExtractor *extractor = extractor_for_thread();
+    if (!extractor) {
+        log_message(LOG_LEVEL_ERROR, "Memory allocation failed for extractor");
+        return 0;
+    }
+    log_message(LOG_LEVEL_DEBUG, "Parsing content from %s (%zu bytes)", source, content_length);
+    SourceMetrics *metrics = metrics_for_source(source_index);
+    uint64_t extraction_start = monotonic_ns();
+    TRACE_BEGIN("extract", TRACE_ARG_SOURCE, source_index);
+    ExtractionContext context = {0};
+    context.source = source;
+    context.source_index = source_index;
+    context.hw_counting = HW_COUNTERS_ON();
+    HwSample extraction_sample;
+    if (context.hw_counting)
+        hw_sample_begin(&extraction_sample);
+    //* Allocate temporary batch storage   
+    context.batch = malloc(PROXY_BATCH_SIZE * sizeof(ProxyRecord));
+    if (!context.batch) {
+        log_message(LOG_LEVEL_ERROR, "Memory allocation failed for proxy batch");
+        TRACE_END("extract", TRACE_ARG_SOURCE, source_index);
+        return 0;
+    }
+    memory_charge(MEMORY_EXTRACTION, (long long)(PROXY_BATCH_SIZE * sizeof(ProxyRecord)));
+    
+    //* Try every regex pattern
+    mtp_extractor_set_user(extractor, &context);
+    mtp_extract_buffer(extractor, content, content_length);
+    mtp_extractor_set_user(extractor, NULL);
+    int discovery_count = context.count;
+    
+    uint64_t extraction_end = monotonic_ns();
+    if (metrics) {
+        histogram_observe(&metrics->extraction_time, &EXTRACTION_TIME_SPEC, extraction_end - extraction_start);
+        atomic_fetch_add_explicit(&metrics->proxies_found, discovery_count, memory_order_relaxed);
+    }
+    
+    TRACE_END("extract", TRACE_ARG_SOURCE, source_index);
+    if (context.hw_counting)
+        hw_sample_end(&extraction_sample, content_length, &hw_stage_totals[HW_STAGE_EXTRACTION],
+                      (source_index >= 0 && source_index < URL_CAPACITY) ? &hw_source_totals[source_index] : NULL);
+    
+    //* Shrink to fit: a batch may wait in the commit queue, and most bodies yield a handful
+    if (discovery_count == 0) {
+        free(context.batch);
+        context.batch = NULL;
+    } else {
+        ProxyRecord *fitted = realloc(context.batch, discovery_count * sizeof(ProxyRecord));
+        if (fitted)
+            context.batch = fitted;
+    }
+    memory_charge(MEMORY_EXTRACTION, -(long long)((PROXY_BATCH_SIZE - discovery_count) * sizeof(ProxyRecord)));
+    
+    if (discovery_count > 0) {
+        log_message(LOG_LEVEL_INFO, "Total proxies discovered from %s: %d", source, discovery_count);
+    }
+    *batch_out = context.batch;
+    return discovery_count;
+}
+
+//* Frees a batch returned by extract_proxy_batch()
+void release_proxy_batch(ProxyRecord *batch, int count) {
+    if (!batch)
+        return;
+    free(batch);
+    memory_charge(MEMORY_EXTRACTION, -(long long)(count * sizeof(ProxyRecord)));
+}
+
+//* Extracts and commits one body on the calling thread
+void extract_proxies_from_content(const char *content, size_t content_length, const char* source, int source_index) {
+    ProxyRecord *batch = NULL;
+    int discovery_count = extract_proxy_batch(content, content_length, source, source_index, &batch);
+    if (discovery_count > 0)
+        commit_discovered_proxies(batch, discovery_count, source_index);
+    release_proxy_batch(batch, discovery_count);
+}
+
+//* =============== TRACING: TRANSFER PHASES ===============
+//* Turns libcurl's cumulative timers into dns/connect/tls/wait/body slices
+
+void trace_transfer_phases(CURL *curl_handle, int source_index, uint64_t start_ns) {
+    static const struct { const char *name; CURLINFO info; } PHASES[] = {
+        {"dns", CURLINFO_NAMELOOKUP_TIME_T},
+        {"connect", CURLINFO_CONNECT_TIME_T},
+        {"tls", CURLINFO_APPCONNECT_TIME_T},
+        {"wait", CURLINFO_STARTTRANSFER_TIME_T},
+        {"body", CURLINFO_TOTAL_TIME_T},
+    };
+    curl_off_t previous_us = 0;
+    for (size_t p = 0; p < sizeof(PHASES) / sizeof(PHASES[0]); p++) {
+        curl_off_t mark_us = 0;
+        if (curl_easy_getinfo(curl_handle, PHASES[p].info, &mark_us) != CURLE_OK || mark_us <= previous_us)
+            continue; //* Phase skipped (e.g. no TLS, reused connection)
+        trace_emit('X', PHASES[p].name, TRACE_ARG_SOURCE, source_index,
+                   start_ns + (uint64_t)previous_us * 1000, (uint64_t)(mark_us - previous_us) * 1000);
+        previous_us = mark_us;
+    }
+}
+
+//* =============== REPLAY: CAPTURE ARCHIVE ===============
+//* --capture appends every transfer (URL, status, CURL code, headers, timing, decoded
+//* body) to a gzip stream; --replay loads it and fetch_transfer() takes the bodies
+//* from memory instead of libcurl, so the rest of the pipeline runs unchanged.
+//* Format: "MTPA", u32 version, then records until EOF (little-endian):
+//*   u32 cycle, u32 source, u32 http status, u32 CURL code, u64 offset ns, u64 duration ns,
+//*   u32 + URL, u32 + headers, u32 + body
+
+/**
+ * @brief One captured transfer.
+ */
+typedef struct {
+    uint32_t cycle;           //* Cycle it was fetched in (1-based)
+    int source_index;        //* Index into TARGET_URLS (remapped to the archive's URL list on replay)
+    long http_status;
+    int curl_result;
+    uint64_t offset_ns;    //* Transfer start relative to the cycle start
+    uint64_t duration_ns;
+    char *url;
+    char *headers;       //* Raw header block(s), NUL-terminated
+    char *body;         //* Decoded body as the write callback received it
+    uint32_t body_size;
+} ArchiveRecord;
+
+/**
+ * @brief Response headers collected while capturing.
+ */
+typedef struct {
+    char data[CAPTURE_HEADER_BYTES];
+    size_t size;
+} HeaderBuffer;
+
+static gzFile capture_file = NULL;
+static pthread_mutex_t capture_mutex = PTHREAD_MUTEX_INITIALIZER; //* Serializes record writes
+static ArchiveRecord *replay_records = NULL; //* Sorted by (source_index, cycle)
+static int replay_record_count = 0;
+
+static void archive_write_u32(gzFile file, uint32_t value) {
+    uint8_t bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    gzwrite(file, bytes, sizeof(bytes));
+}
+
+static void archive_write_u64(gzFile file, uint64_t value) {
+    archive_write_u32(file, (uint32_t)value);
+    archive_write_u32(file, (uint32_t)(value >> 32));
+}
+
+static void archive_write_blob(gzFile file, const void *data, uint32_t size) {
+    archive_write_u32(file, size);
+    if (size > 0)
+        gzwrite(file, data, size);
+}
+
+static int archive_read_u32(gzFile file, uint32_t *value) {
+    uint8_t bytes[4];
+    if (gzread(file, bytes, sizeof(bytes)) != (int)sizeof(bytes))
+        return 0;
+    *value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return 1;
+}
+
+static int archive_read_u64(gzFile file, uint64_t *value) {
+    uint32_t low, high;
+    if (!archive_read_u32(file, &low) || !archive_read_u32(file, &high))
+        return 0;
+    *value = low | ((uint64_t)high << 32);
+    return 1;
+}
+
+//* Reads a length-prefixed blob into a NUL-terminated heap string
+static char *archive_read_blob(gzFile file, uint32_t *size) {
+    if (!archive_read_u32(file, size) || *size > (uint32_t)BODY_CAPACITY_LIMIT_MB * 1024 * 1024)
+        return NULL;
+    char *data = malloc(*size + 1);
+    if (!data)
+        return NULL;
+    if (*size > 0 && gzread(file, data, *size) != (int)*size) {
+        free(data);
+        return NULL;
+    }
+    data[*size] = '\0';
+    return data;
+}
+
+int capture_open(const char *path) {
+    capture_file = gzopen(path, "wb6");
+    if (!capture_file)
+        return 0;
+    gzwrite(capture_file, "MTPA", 4);
+    archive_write_u32(capture_file, 1);
+    return 1;
+}
+
+void capture_close() {
+    pthread_mutex_lock(&capture_mutex);
+    if (capture_file) {
+        gzclose(capture_file);
+        capture_file = NULL;
+    }
+    pthread_mutex_unlock(&capture_mutex);
+}
+
+size_t capture_header_callback(char *data, size_t element_size, size_t element_count, void *user_buffer) {
+    size_t total_size = element_size * element_count;
+    HeaderBuffer *headers = (HeaderBuffer *)user_buffer;
+    size_t room = sizeof(headers->data) - 1 - headers->size;
+    size_t kept = total_size < room ? total_size : room;
+    memcpy(headers->data + headers->size, data, kept);
+    headers->size += kept;
+    headers->data[headers->size] = '\0';
+    return total_size;
+}
+
+void capture_record(const char *url, int source_index, long http_status, int curl_result, uint64_t start_ns,
+                    uint64_t duration_ns, const HeaderBuffer *headers, const DynamicBuffer *body) {
+    uint64_t cycle_start = atomic_load(&current_cycle_start_ns);
+    pthread_mutex_lock(&capture_mutex);
+    if (capture_file) {
+        archive_write_u32(capture_file, (uint32_t)atomic_load(&current_cycle));
+        archive_write_u32(capture_file, (uint32_t)source_index);
+        archive_write_u32(capture_file, (uint32_t)http_status);
+        archive_write_u32(capture_file, (uint32_t)curl_result);
+        archive_write_u64(capture_file, start_ns > cycle_start ? start_ns - cycle_start : 0);
+        archive_write_u64(capture_file, duration_ns);
+        archive_write_blob(capture_file, url, (uint32_t)strlen(url));
+        archive_write_blob(capture_file, headers->data, (uint32_t)headers->size);
+        archive_write_blob(capture_file, body->data, body->data ? (uint32_t)body->size : 0);
+    }
+    pthread_mutex_unlock(&capture_mutex);
+}
+
+static int compare_archive_records(const void *a, const void *b) {
+    const ArchiveRecord *x = a, *y = b;
+    if (x->source_index != y->source_index)
+        return x->source_index < y->source_index ? -1 : 1;
+    return (x->cycle > y->cycle) - (x->cycle < y->cycle);
+}
+
+//* Loads the archive, replaces TARGET_URLS with its URLs (first-seen order) and returns
+//* the number of cycles it covers, or -1 if it cannot be read.
+int replay_load(const char *path) {
+    gzFile file = gzopen(path, "rb");
+    if (!file)
+        return -1;
+    char magic[4];
+    uint32_t version = 0;
+    if (gzread(file, magic, 4) != 4 || memcmp(magic, "MTPA", 4) != 0 || !archive_read_u32(file, &version) || version != 1) {
+        gzclose(file);
+        return -1;
+    }
+
+    int capacity = 256, url_count = 0;
+    uint32_t max_cycle = 0;
+    long long loaded_bytes = 0;
+    replay_records = malloc(sizeof(ArchiveRecord) * capacity);
+    while (replay_records) {
+        ArchiveRecord record = {0};
+        uint32_t source, status, result, url_size, header_size;
+        if (!archive_read_u32(file, &record.cycle))
+            break; //* Clean end of archive
+        if (!archive_read_u32(file, &source) || !archive_read_u32(file, &status) || !archive_read_u32(file, &result) ||
+            !archive_read_u64(file, &record.offset_ns) || !archive_read_u64(file, &record.duration_ns) ||
+            !(record.url = archive_read_blob(file, &url_size)) ||
+            !(record.headers = archive_read_blob(file, &header_size)) ||
+            !(record.body = archive_read_blob(file, &record.body_size))) {
+            fprintf(stderr, "Replay archive %s is truncated after %d records\n", path, replay_record_count);
+            free(record.url);
+            free(record.headers);
+            break;
+        }
+        record.http_status = (long)(int32_t)status;
+        record.curl_result = (int)result;
+
+        record.source_index = -1;
+        for (int u = 0; u < url_count; u++) {
+            if (strcmp(TARGET_URLS[u], record.url) == 0) {
+                record.source_index = u;
+                break;
+            }
+        }
+        if (record.source_index < 0 && url_count < URL_CAPACITY - 1) {
+            TARGET_URLS[url_count] = strdup(record.url); //* Lives for the whole run
+            record.source_index = url_count++;
+        }
+        if (record.source_index < 0 || !TARGET_URLS[record.source_index]) {
+            free(record.url);
+            free(record.headers);
+            free(record.body);
+            continue;
+        }
+
+        if (replay_record_count == capacity) {
+            ArchiveRecord *grown = realloc(replay_records, sizeof(ArchiveRecord) * capacity * 2);
+            if (!grown)
+                break;
+            replay_records = grown;
+            capacity *= 2;
+        }
+        loaded_bytes += record.body_size + header_size + url_size;
+        if (record.cycle > max_cycle)
+            max_cycle = record.cycle;
+        replay_records[replay_record_count++] = record;
+    }
+    gzclose(file);
+    TARGET_URLS[url_count] = NULL;
+    if (!replay_records || replay_record_count == 0)
+        return -1;
+
+    qsort(replay_records, replay_record_count, sizeof(ArchiveRecord), compare_archive_records);
+    memory_charge(MEMORY_TRANSFER, loaded_bytes + (long long)(capacity * sizeof(ArchiveRecord)));
+    printf("Replay: %d transfers from %d sources over %u cycles (%.1f MB)\n",
+           replay_record_count, url_count, max_cycle, loaded_bytes / 1048576.0);
+    return (int)max_cycle;
+}
+
+//* Stands in for curl_easy_perform(): feeds the recorded body through write_callback
+CURLcode replay_transfer(int source_index, DynamicBuffer *buffer, long *http_status) {
+    ArchiveRecord key = { .source_index = source_index, .cycle = (uint32_t)atomic_load(&current_cycle) };
+    const ArchiveRecord *record = bsearch(&key, replay_records, replay_record_count, sizeof(ArchiveRecord),
+                                          compare_archive_records);
+    if (!record) {
+        log_message(LOG_LEVEL_WARN, "Replay: source %d has no transfer in cycle %u", source_index, key.cycle);
+        return CURLE_COULDNT_CONNECT;
+    }
+
+    if (run_options.replay_timing) {
+        uint64_t due = atomic_load(&current_cycle_start_ns) + record->offset_ns;
+        uint64_t now = mtp_monotonic_ns();
+        if (due > now)
+            mtp_sleep_ns(due - now);
+        mtp_sleep_ns(record->duration_ns);
+    }
+
+    *http_status = record->http_status;
+    if (record->body_size > 0 && write_callback(record->body, 1, record->body_size, buffer) != record->body_size)
+        return CURLE_WRITE_ERROR;
+    return (CURLcode)record->curl_result;
+}
+
+void free_replay_records() {
+    for (int i = 0; i < replay_record_count; i++) {
+        free(replay_records[i].url);
+        free(replay_records[i].headers);
+        free(replay_records[i].body);
+    }
+    free(replay_records);
+    replay_records = NULL;
+    replay_record_count = 0;
+}
+
+//* =============== SIMULATION: SOURCE MODELS ===============
+//* --simulate MODEL swaps the network for one model per source, read from a text file.
+//* Each line describes one source as key=value pairs; '#' starts a comment:
+//*   url=sim://slow-mirror latency=900 jitter=0.6 fail=0.05 error=0.01 size=40
+//*   churn=0.5 alive=0.7 ttl=12 mirror=2 lag=1800
+//* Every draw (latency, failure, proxy liveness) hashes the seed with the source and the
+//* virtual time, and every list is a pure function of virtual time. Two policies run
+//* against the same model and seed therefore see the same world, however often they fetch.
+
+/**
+ * @brief Behaviour of one modelled source (keys of the --simulate file in brackets).
+ */
+typedef struct {
+    double latency_ms;  //* Median transfer time [latency]
+    double jitter;     //* Log-normal sigma of the transfer time [jitter]
+    double fail_rate; //* Share of fetches that cannot connect [fail]
+    double error_rate; //* Share of fetches answered with HTTP 503 [error]
+    int list_size;    //* Proxies listed at any moment, <= SIMULATION_MAX_LISTED [size]
+    double churn;    //* Replacements per listed entry per hour; 0 = static list [churn]
+    double alive;   //* Share of this source's proxies that accept connections [alive]
+    double ttl_hours; //* Hours a proxy stays reachable after it is first listed; 0 = forever [ttl]
+    int mirror;      //* Republish this source's list instead of an own one; -1 = own [mirror]
+    double lag_seconds; //* ...this many seconds late [lag]
+} SimulatedSource;
+
+static SimulatedSource *simulated_sources = NULL;
+static int simulated_source_count = 0;
+static uint64_t simulation_end_ns = 0;
+
+//* splitmix64 finalizer over the seed and up to four draw coordinates
+static uint64_t simulation_hash(uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    uint64_t x = run_options.simulate_seed;
+    uint64_t parts[4] = { a, b, c, d };
+    for (int i = 0; i < 4; i++) {
+        x += parts[i] + 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+    }
+    return x;
+}
+
+static double simulation_unit(uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    return (simulation_hash(a, b, c, d) >> 11) * 0x1.0p-53;
+}
+
+//* Reads the model file and makes its sources the fetch list. Returns the source count, or -1.
+int simulation_load(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return -1;
+    simulated_sources = calloc(URL_CAPACITY, sizeof(SimulatedSource));
+    if (!simulated_sources) {
+        fclose(file);
+        return -1;
+    }
+
+    char line[2048];
+    int count = 0;
+    while (count < URL_CAPACITY - 1 && fgets(line, sizeof(line), file)) {
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        SimulatedSource model = { .latency_ms = 400, .jitter = 0.5, .fail_rate = 0.02, .error_rate = 0.01,
+                                  .list_size = 30, .churn = 0.5, .alive = 0.6, .mirror = -1 };
+        char url[1024] = "";
+        int fields = 0;
+        for (char *token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+            char *equals = strchr(token, '=');
+            if (!equals) {
+                fprintf(stderr, "%s: ignoring '%s' (expected key=value)\n", path, token);
+                continue;
+            }
+            *equals = '\0';
+            const char *key = token, *value = equals + 1;
+            fields++;
+            if (strcmp(key, "url") == 0)
+                snprintf(url, sizeof(url), "%s", value);
+            else if (strcmp(key, "latency") == 0)
+                model.latency_ms = atof(value);
+            else if (strcmp(key, "jitter") == 0)
+                model.jitter = atof(value);
+            else if (strcmp(key, "fail") == 0)
+                model.fail_rate = atof(value);
+            else if (strcmp(key, "error") == 0)
+                model.error_rate = atof(value);
+            else if (strcmp(key, "size") == 0)
+                model.list_size = atoi(value);
+            else if (strcmp(key, "churn") == 0)
+                model.churn = atof(value);
+            else if (strcmp(key, "alive") == 0)
+                model.alive = atof(value);
+            else if (strcmp(key, "ttl") == 0)
+                model.ttl_hours = atof(value);
+            else if (strcmp(key, "mirror") == 0)
+                model.mirror = atoi(value);
+            else if (strcmp(key, "lag") == 0)
+                model.lag_seconds = atof(value);
+            else
+                fprintf(stderr, "%s: unknown model key '%s'\n", path, key);
+        }
+        if (fields == 0)
+            continue;
+        if (model.list_size < 0 || model.list_size > SIMULATION_MAX_LISTED)
+            model.list_size = model.list_size < 0 ? 0 : SIMULATION_MAX_LISTED;
+        if (!url[0])
+            snprintf(url, sizeof(url), "sim://source-%d", count);
+        char *copy = strdup(url);
+        if (!copy)
+            break;
+        simulated_sources[count] = model;
+        TARGET_URLS[count++] = copy; //* Lives for the whole run
+    }
+    fclose(file);
+    TARGET_URLS[count] = NULL;
+    for (int s = 0; s < count; s++) {
+        if (simulated_sources[s].mirror >= count || simulated_sources[s].mirror == s)
+            simulated_sources[s].mirror = -1;
+    }
+    if (count == 0) {
+        free(simulated_sources);
+        simulated_sources = NULL;
+        return -1;
+    }
+
+    simulated_source_count = count;
+    simulation_end_ns = (uint64_t)(run_options.simulate_hours * 3600.0 * 1e9);
+    virtual_clock_enabled = 1;
+    printf("Simulation: %d modelled sources, %.1f virtual hours, seed %llu\n", count, run_options.simulate_hours,
+           (unsigned long long)run_options.simulate_seed);
+    return count;
+}
+
+//* Follows mirror links (at most a few hops) to the source whose list is published, and
+//* the virtual second that list is taken at
+static int simulation_origin(int source_index, double *when) {
+    for (int hops = 0; hops < 4 && simulated_sources[source_index].mirror >= 0; hops++) {
+        *when -= simulated_sources[source_index].lag_seconds;
+        source_index = simulated_sources[source_index].mirror;
+    }
+    if (*when < 0)
+        *when = 0;
+    return source_index;
+}
+
+//* Lifetime and phase of one list slot; a slot's entry changes every `period` seconds
+static void simulation_slot(int origin, int slot, double *period, double *phase) {
+    const SimulatedSource *model = &simulated_sources[origin];
+    *period = model->churn > 0 ? 3600.0 / model->churn * (0.5 + simulation_unit(1, origin, slot, 0)) : 0;
+    *phase = *period * simulation_unit(2, origin, slot, 0);
+}
+
+//* Proxy in `slot` of `origin` at virtual second `when`. The endpoint encodes its origin,
+//* slot and generation (10.<origin>.<slot>, port 1024 + generation), so simulation_probe()
+//* can recover them.
+static void simulation_listed_proxy(int origin, int slot, double when, char *line, size_t line_size) {
+    double period, phase;
+    simulation_slot(origin, slot, &period, &phase);
+    uint32_t generation = period > 0 ? (uint32_t)((when + phase) / period) % 64000 : 0;
+    uint64_t secret_high = simulation_hash(3, origin, slot, generation);
+    uint64_t secret_low = simulation_hash(4, origin, slot, generation);
+    snprintf(line, line_size, "10.%d.%d.%d:%u:%016llx%016llx\n", origin >> 8, origin & 255, slot, 1024 + generation,
+             (unsigned long long)secret_high, (unsigned long long)secret_low);
+}
+
+//* Modelled transfer time and outcome for a fetch of `source_index` starting at `start_ns`
+static uint64_t simulation_transfer_plan(int source_index, uint64_t start_ns, int *outcome) {
+    const SimulatedSource *model = &simulated_sources[source_index];
+    double u1 = simulation_unit(5, source_index, start_ns, 0);
+    double u2 = simulation_unit(6, source_index, start_ns, 0);
+    double normal = sqrt(-2.0 * log(u1 > 0 ? u1 : 1e-12)) * cos(2.0 * M_PI * u2);
+    double milliseconds = model->latency_ms * exp(model->jitter * normal);
+    if (milliseconds > run_options.connection_timeout * 1000.0)
+        milliseconds = run_options.connection_timeout * 1000.0;
+    if (outcome) {
+        double draw = simulation_unit(7, source_index, start_ns, 0);
+        *outcome = draw < model->fail_rate ? 2 : draw < model->fail_rate + model->error_rate ? 1 : 0;
+    }
+    return (uint64_t)(milliseconds * 1e6);
+}
+
+//* When a fetch starting at `start_ns` completes; orders simulated workers within a batch
+uint64_t simulation_transfer_finish(int source_index, uint64_t start_ns) {
+    return start_ns + simulation_transfer_plan(source_index, start_ns, NULL);
+}
+
+//* Stands in for curl_easy_perform(): takes the modelled time on the caller's clock, then
+//* feeds the source's current list through write_callback
+CURLcode simulation_transfer(int source_index, DynamicBuffer *buffer, long *http_status) {
+    if (source_index < 0 || source_index >= simulated_source_count)
+        return CURLE_COULDNT_CONNECT;
+    uint64_t start_ns = mtp_monotonic_ns();
+    int outcome = 0;
+    mtp_sleep_ns(simulation_transfer_plan(source_index, start_ns, &outcome));
+    if (outcome == 2)
+        return CURLE_COULDNT_CONNECT;
+    *http_status = outcome == 1 ? 503 : 200;
+    if (outcome == 1)
+        return write_callback("Service Unavailable\n", 1, 20, buffer) == 20 ? CURLE_OK : CURLE_WRITE_ERROR;
+
+    double when = start_ns / 1e9;
+    int origin = simulation_origin(source_index, &when);
+    char line[128];
+    for (int slot = 0; slot < simulated_sources[origin].list_size; slot++) {
+        simulation_listed_proxy(origin, slot, when, line, sizeof(line));
+        size_t length = strlen(line);
+        if (write_callback(line, 1, length, buffer) != length)
+            return CURLE_WRITE_ERROR;
+    }
+    return CURLE_OK;
+}
+
+//* Stands in for probe_proxy(): a modelled endpoint is reachable if its origin's alive share
+//* says so and it is younger than the origin's ttl. Takes no time itself (see
+//* run_verification_pass()).
+int simulation_probe(const char *server, const char *port, int timeout_ms, int *latency_ms) {
+    int high, low, slot;
+    char tail;
+    unsigned generation = (unsigned)atoi(port) - 1024;
+    *latency_ms = timeout_ms;
+    if (sscanf(server, "10.%d.%d.%d%c", &high, &low, &slot, &tail) != 3 || generation >= 64000)
+        return 0;
+    int origin = high * 256 + low;
+    if (origin < 0 || origin >= simulated_source_count || slot < 0 || slot >= SIMULATION_MAX_LISTED)
+        return 0;
+
+    const SimulatedSource *model = &simulated_sources[origin];
+    double period, phase;
+    simulation_slot(origin, slot, &period, &phase);
+    double born = period > 0 ? generation * period - phase : 0;
+    double age = mtp_monotonic_ns() / 1e9 - born;
+    if (simulation_unit(8, origin, slot, generation) >= model->alive ||
+        (model->ttl_hours > 0 && age > model->ttl_hours * 3600.0))
+        return 0;
+    *latency_ms = 40 + (int)(400 * simulation_unit(9, origin, slot, generation));
+    return 1;
+}
+
+//* =============== HTTP: FETCH SINGLE URL ===============
+//* Downloads content from a URL. The pipeline fetches bodies still compressed and leaves
+//* inflating to its decode stage; the inline path (--simulate) lets libcurl decode.
+
+/**
+ * @brief Content-Encoding a fetched body still carries.
+ */
+typedef enum {
+    BODY_IDENTITY,
+    BODY_GZIP,
+    BODY_DEFLATE,     //* zlib-wrapped per the RFC; raw deflate is accepted too
+    BODY_UNSUPPORTED //* Anything else: the body is dropped as undecodable
+} BodyEncoding;
+
+//* Tracks the Content-Encoding of the final response (each redirect starts a new header block)
+size_t encoding_header_callback(char *data, size_t element_size, size_t element_count, void *user_encoding) {
+    size_t total_size = element_size * element_count;
+    BodyEncoding *encoding = (BodyEncoding *)user_encoding;
+    static const char field[] = "content-encoding:";
+    if (total_size >= 5 && strncmp(data, "HTTP/", 5) == 0) {
+        *encoding = BODY_IDENTITY;
+    } else if (total_size > sizeof(field) - 1 && strncasecmp(data, field, sizeof(field) - 1) == 0) {
+        const char *value = data + sizeof(field) - 1, *end = data + total_size;
+        while (value < end && (*value == ' ' || *value == '\t'))
+            value++;
+        size_t length = 0;
+        while (value + length < end && !isspace((unsigned char)value[length]) && value[length] != ',')
+            length++;
+        if ((length == 4 && strncasecmp(value, "gzip", 4) == 0) || (length == 6 && strncasecmp(value, "x-gzip", 6) == 0))
+            *encoding = BODY_GZIP;
+        else if (length == 7 && strncasecmp(value, "deflate", 7) == 0)
+            *encoding = BODY_DEFLATE;
+        else if (!(length == 8 && strncasecmp(value, "identity", 8) == 0))
+            *encoding = BODY_UNSUPPORTED;
+    }
+    return total_size;
+}
+
+//* Frees a transfer or decode buffer and its MEMORY_TRANSFER charge
+void release_body(DynamicBuffer *body) {
+    if (body->data) {
+        free(body->data);
+        memory_charge(MEMORY_TRANSFER, -(long long)body->capacity);
+    }
+    body->data = NULL;
+    body->size = body->capacity = 0;
+}
+
+//* Performs one transfer into `body` (allocated here). With `keep_encoding` libcurl does not
+//* decode the body and *encoding reports what it carries; capture archives always store
+//* decoded bodies, so capturing turns it off. Returns 1 for a 200 response with a body;
+//* otherwise the failure is logged and counted, and `body` is already released.
+int fetch_transfer(const char *url, int source_index, int keep_encoding, DynamicBuffer *body, BodyEncoding *encoding) {
+    *encoding = BODY_IDENTITY;
+    memset(body, 0, sizeof(DynamicBuffer));
+    if (!atomic_load(&program_active)) 
+        return 0;
+    
+    int replaying = replay_record_count > 0;
+    int simulating = simulated_source_count > 0;
+    CURL *curl_handle = replaying || simulating ? NULL : setup_curl_handle();
+    if (!replaying && !simulating && !curl_handle) {
+        stats_add(STAT_NETWORK_ERRORS, 1);
+        return 0;
+    }
+    
+    body->capacity = 1 * 1024 * 1024; //* 1MB initial
+    memory_reserve(MEMORY_TRANSFER, body->capacity); //* May wait in budget mode
+    body->data = malloc(body->capacity);
+    if (!body->data) {
+        memory_charge(MEMORY_TRANSFER, -(long long)body->capacity);
+        body->capacity = 0;
+        if (curl_handle)
+            curl_easy_cleanup(curl_handle);
+        return 0;
+    }
+    body->data[0] = '\0';
+    
+    HeaderBuffer *capture_headers = NULL;
+    if (curl_handle) {
+        curl_easy_setopt(curl_handle, CURLOPT_URL, url);
+        curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_callback);
+        curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, body);
+        if (capture_file && (capture_headers = calloc(1, sizeof(HeaderBuffer)))) {
+            curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, capture_header_callback);
+            curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, capture_headers);
+        } else if (keep_encoding && !capture_file) {
+            curl_easy_setopt(curl_handle, CURLOPT_HTTP_CONTENT_DECODING, 0L); //* Still advertises gzip, deflate
+            curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, encoding_header_callback);
+            curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, encoding);
+        }
+    }
+    
+    stats_add(STAT_TOTAL_REQUESTS, 1);
+    log_message(LOG_LEVEL_DEBUG, "Fetching: %s", url);
+    
+    SourceMetrics *metrics = metrics_for_source(source_index);
+    if (metrics)
+        atomic_fetch_add_explicit(&metrics->requests, 1, memory_order_relaxed);
+    
+    STAGE_SPAN_BEGIN(fetch_span);
+    uint64_t start_time = mtp_monotonic_ns();
+    TRACE_BEGIN("fetch", TRACE_ARG_SOURCE, source_index);
+    USDT_PROBE2(transfer_start, source_index, url);
+    long http_status = 0;
+    CURLcode result = simulating ? simulation_transfer(source_index, body, &http_status)
+                    : replaying ? replay_transfer(source_index, body, &http_status)
+                                : curl_easy_perform(curl_handle);
+    uint64_t end_time = mtp_monotonic_ns();
+    STAGE_SPAN_END(fetch_span, STAGE_FETCH);
+    if (curl_handle && result == CURLE_OK)
+        curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &http_status);
+    if (capture_headers) {
+        capture_record(url, source_index, http_status, (int)result, start_time, end_time - start_time,
+                       capture_headers, body);
+        free(capture_headers);
+    }
+    if (TRACE_ENABLED() && curl_handle)
+        trace_transfer_phases(curl_handle, source_index, start_time);
+    TRACE_END("fetch", TRACE_ARG_SOURCE, source_index);
+    if (metrics)
+        histogram_observe(&metrics->fetch_latency, &FETCH_LATENCY_SPEC, end_time - start_time);
+    
+    int success = 0;
+    
+    if (result == CURLE_OK && body->size > 0) {
+        if (http_status == 200) {
+            success = 1;
+            stats_add(STAT_PROCESSED_URLS, 1);
+            log_message(LOG_LEVEL_INFO, "Success: %s (%zu bytes, %.2f seconds)", url, body->size, (end_time - start_time) / 1e9);
+        } else {
+            log_message(LOG_LEVEL_WARN, "HTTP %ld: %s", http_status, url);
+            stats_add(STAT_NETWORK_ERRORS, 1);
+        }
+    } else {
+        log_message(LOG_LEVEL_WARN, "CURL error %d: %s", result, url);
+        stats_add(STAT_NETWORK_ERRORS, 1);
+    }
+    
+    if (metrics && !success)
+        atomic_fetch_add_explicit(&metrics->failures, 1, memory_order_relaxed);
+    USDT_PROBE6(transfer_end, source_index, url, body->size, http_status, (int)result, end_time - start_time);
+    
+    if (!success)
+        release_body(body);
+    
+    if (curl_handle)
+        curl_easy_cleanup(curl_handle);
+    
+    if (source_index >= 0 && source_index < URL_CAPACITY) {
+        PROFILED_LOCK(&storage_mutex);
+        if (success)
+            source_reputation[source_index].fetch_failures = 0;
+        else
+            source_reputation[source_index].fetch_failures++;
+        PROFILED_UNLOCK(&storage_mutex);
+    }
+    
+    return success;
+}
+
+//* Inflates `body` in place (into a new buffer). Returns 1 with an identity body, or 0 when
+//* the encoding is unsupported, the stream is corrupt or truncated, or the decoded body would
+//* pass body_capacity() or the memory budget; `body` is released in that case.
+int decode_body(DynamicBuffer *body, BodyEncoding encoding, int source_index) {
+    if (encoding == BODY_IDENTITY)
+        return 1;
+    STAGE_SPAN_BEGIN(decode_span);
+    TRACE_BEGIN("decode", TRACE_ARG_SOURCE, source_index);
+    DynamicBuffer decoded = {0};
+    //* gzip may arrive zlib-wrapped and "deflate" raw; one retry covers what libcurl accepts
+    int window_bits = encoding == BODY_GZIP ? 15 + 32 : 15;
+    int status = encoding == BODY_UNSUPPORTED ? Z_DATA_ERROR : Z_OK;
+    for (int attempt = 0; attempt < 2 && status == Z_OK; attempt++) {
+        z_stream stream = {0};
+        if (inflateInit2(&stream, window_bits) != Z_OK) {
+            status = Z_MEM_ERROR;
+            break;
+        }
+        stream.next_in = (Bytef *)body->data;
+        stream.avail_in = (uInt)body->size;
+        decoded.size = 0;
+        size_t limit = body_capacity();
+        while (status == Z_OK) {
+            if (decoded.size + 1 >= decoded.capacity) {
+                size_t new_capacity = decoded.capacity ? decoded.capacity * 2 : MIN(body->size * 4 + 4096, limit);
+                if (new_capacity > limit)
+                    new_capacity = limit;
+                if (new_capacity <= decoded.size + 1) {
+                    status = Z_MEM_ERROR; //* Would pass body_capacity()
+                    break;
+                }
+                if (!memory_growth_allowed(new_capacity - decoded.capacity)) {
+                    atomic_fetch_add_explicit(&memory_budget_aborts, 1, memory_order_relaxed);
+                    status = Z_MEM_ERROR;
+                    break;
+                }
+                char *new_data = realloc(decoded.data, new_capacity);
+                if (!new_data) {
+                    status = Z_MEM_ERROR;
+                    break;
+                }
+                memory_charge(MEMORY_TRANSFER, (long long)(new_capacity - decoded.capacity));
+                decoded.data = new_data;
+                decoded.capacity = new_capacity;
+            }
+            stream.next_out = (Bytef *)decoded.data + decoded.size;
+            stream.avail_out = (uInt)(decoded.capacity - decoded.size - 1);
+            status = inflate(&stream, Z_NO_FLUSH);
+            decoded.size = decoded.capacity - 1 - stream.avail_out;
+            if (status == Z_OK && stream.avail_in == 0 && stream.avail_out > 0)
+                status = Z_BUF_ERROR; //* Input ended before the stream did
+        }
+        int raw_retry = status == Z_DATA_ERROR && encoding == BODY_DEFLATE && window_bits > 0 && stream.total_out == 0;
+        inflateEnd(&stream);
+        if (raw_retry) {
+            window_bits = -15;
+            status = Z_OK;
+        }
+    }
+    
+    int decoded_ok = status == Z_STREAM_END;
+    if (decoded_ok) {
+        decoded.data[decoded.size] = '\0';
+        log_message(LOG_LEVEL_DEBUG, "Decoded %zu -> %zu bytes (source %d)", body->size, decoded.size, source_index);
+        release_body(body);
+        *body = decoded;
+    } else {
+        log_message(LOG_LEVEL_WARN, "Cannot decode %s body from source %d (zlib status %d)",
+                    encoding == BODY_UNSUPPORTED ? "unsupported" : encoding == BODY_GZIP ? "gzip" : "deflate",
+                    source_index, status);
+        stats_add(STAT_PARSE_ERRORS, 1);
+        release_body(&decoded);
+        release_body(body);
+    }
+    TRACE_END("decode", TRACE_ARG_SOURCE, source_index);
+    STAGE_SPAN_END(decode_span, STAGE_DECODE);
+    return decoded_ok;
+}
+
+//* Bandwidth and size accounting for a decoded body about to be extracted
+void note_decoded_body(const DynamicBuffer *body, int source_index) {
+    SourceMetrics *metrics = metrics_for_source(source_index);
+    stats_add(STAT_TOTAL_BYTES, body->size);
+    if (metrics) {
+        atomic_fetch_add_explicit(&metrics->bytes, body->size, memory_order_relaxed);
+        histogram_observe(&metrics->body_size, &BODY_SIZE_SPEC, body->size);
+    }
+}
+
+//* Fetches, extracts and commits one URL on the calling thread
+int fetch_url_content(const char *url, int source_index) {
+    DynamicBuffer content_buffer;
+    BodyEncoding encoding;
+    if (!fetch_transfer(url, source_index, 0, &content_buffer, &encoding))
+        return 0;
+    note_decoded_body(&content_buffer, source_index);
+    extract_proxies_from_content(content_buffer.data, content_buffer.size, url, source_index);
+    release_body(&content_buffer);
+    return 1;
+}
+//* =============== THREAD WORKER ===============
+//* Runs one download task start to finish on the calling thread (--simulate; the live
+//* run goes through the pipeline stages below)
+void* url_worker(void *task_data) {
+    DownloadTask *task = (DownloadTask *)task_data;
+    
+    trace_set_thread_label("worker");
+    if (atomic_load(&program_active) && task && task->url) {
+        if (run_options.throttle) {
+            TRACE_BEGIN("throttle_delay", TRACE_ARG_NONE, 0);
+            random_delay();
+            TRACE_END("throttle_delay", TRACE_ARG_NONE, 0);
+        }
+        fetch_url_content(task->url, task->source_index);
+    }
+    //* clean up dynamically allocated task
+    if (task) {
+        if (task->url) free(task->url);
+        free(task);
+    }
+    
+    atomic_fetch_sub(&stats.active_workers, 1);
+    return NULL;
+}
+
+/**
+ * @brief A simulated worker waiting to run, keyed by its modelled finish time.
+ */
+typedef struct {
+    uint64_t finish_ns;
+    DownloadTask *task;
+} SimulatedWorker;
+
+static int compare_simulated_workers(const void *a, const void *b) {
+    const SimulatedWorker *x = a, *y = b;
+    if (x->finish_ns != y->finish_ns)
+        return (x->finish_ns > y->finish_ns) - (x->finish_ns < y->finish_ns);
+    return x->task->source_index - y->task->source_index;
+}
+
+//* --simulate: runs a batch's workers inline on the calling thread, in order of modelled
+//* finish time, so reports commit in the order the transfers would have completed. Each
+//* worker runs on its own clock from its spawn time. Like the join barrier, the batch ends
+//* when its slowest worker does.
+void run_simulated_batch(DownloadTask **tasks, int count) {
+    SimulatedWorker *workers = malloc(sizeof(SimulatedWorker) * (count > 0 ? count : 1));
+    if (!workers) {
+        for (int i = 0; i < count; i++)
+            url_worker(tasks[i]);
+        return;
+    }
+    for (int i = 0; i < count; i++)
+        workers[i] = (SimulatedWorker){ simulation_transfer_finish(tasks[i]->source_index, tasks[i]->virtual_start_ns),
+                                        tasks[i] };
+    qsort(workers, count, sizeof(SimulatedWorker), compare_simulated_workers);
+
+    uint64_t batch_end = mtp_monotonic_ns();
+    for (int i = 0; i < count; i++) {
+        virtual_clock_enter(workers[i].task->virtual_start_ns);
+        url_worker(workers[i].task); //* Frees the task
+        uint64_t worker_end = virtual_clock_leave();
+        if (worker_end > batch_end)
+            batch_end = worker_end;
+    }
+    virtual_clock_advance_to(batch_end);
+    trace_set_thread_label("main"); //* url_worker() relabelled this thread
+    free(workers);
+}
+
+//* Allocates the task for one scheduled source (NULL on allocation failure)
+DownloadTask* new_download_task(int source_index) {
+    DownloadTask *task = malloc(sizeof(DownloadTask));
+    if (!task)
+        return NULL;
+    task->source_index = source_index;
+    task->url = strdup(TARGET_URLS[source_index]);
+    if (!task->url) {
+        free(task);
+        return NULL;
+    }
+    task->retry_count = 0;
+    task->priority = 1;
+    task->use_proxy = 0;
+    task->virtual_start_ns = 0;
+    return task;
+}
+
+//* --simulate: one cycle's fetches in batches of `concurrency`, each batch ending with its
+//* slowest worker (the pipeline has no virtual-clock model, so simulations keep batches)
+void run_simulated_cycle(const int *schedule, int scheduled_count) {
+    DownloadTask *simulated_tasks[MAX_THREAD_COUNT];
+    int current_url_index = 0;
+    
+    while (current_url_index < scheduled_count && atomic_load(&program_active)) {
+        int batch_size = MIN(run_options.concurrency, scheduled_count - current_url_index);
+        int workers_launched = 0;
+        TRACE_BEGIN("spawn_batch", TRACE_ARG_COUNT, batch_size);
+        for (int i = 0; i < batch_size; i++, current_url_index++) {
+            DownloadTask *task = new_download_task(schedule[current_url_index]);
+            if (!task)
+                continue;
+            atomic_fetch_add(&stats.active_workers, 1);
+            task->virtual_start_ns = mtp_monotonic_ns();
+            simulated_tasks[workers_launched++] = task;
+        }
+        TRACE_END("spawn_batch", TRACE_ARG_COUNT, batch_size);
+        
+        TRACE_BEGIN("join_barrier", TRACE_ARG_COUNT, workers_launched);
+        run_simulated_batch(simulated_tasks, workers_launched);
+        TRACE_END("join_barrier", TRACE_ARG_COUNT, workers_launched);
+    }
+}
+
+//* =============== PIPELINE: BOUNDED QUEUES ===============
+//* fetch -> decode -> extract -> commit run as separate thread pools joined by fixed-size
+//* MPMC rings (per-cell sequence numbers, so push and pop never take a lock). Two
+//* semaphores count free and filled cells and only ever put threads to sleep. A thread
+//* reserves its output cell before it starts the work that fills it, so a stage that
+//* falls behind fills its input queue and stalls the stage feeding it, back to the fetch
+//* threads, which then stop starting transfers instead of piling up bodies. Rings are
+//* allocated for the largest configurable bound; a reload only moves the semaphore count.
+
+/**
+ * @brief One ring cell; `sequence` tells producers and consumers whose turn it is.
+ */
+typedef struct {
+    atomic_size_t sequence;
+    void *value;
+} PipelineCell;
+
+/**
+ * @brief Bounded multi-producer multi-consumer queue of pointers (NULL is the stop pill).
+ */
+typedef struct {
+    PipelineCell *cells;
+    size_t mask;                 //* Ring size - 1; the ring is rounded up to a power of two
+    atomic_int bound;           //* Items reserved or queued at once (what free_cells counts down from)
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_position;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_position;
+    sem_t free_cells;         //* Taken by pipeline_queue_reserve(), returned by pop or cancel
+    sem_t filled_cells;
+    atomic_int depth;               //* Items waiting for a consumer
+    atomic_int peak_depth;
+    atomic_ullong full_waits;     //* Reservations that found every cell taken and blocked
+    atomic_ullong blocked_ns;    //* Time producers spent blocked in them
+} PipelineQueue;
+
+/**
+ * @brief Pipeline stages; each consumes pipeline_queues[stage].
+ */
+typedef enum {
+    PIPELINE_FETCH,
+    PIPELINE_DECODE,
+    PIPELINE_EXTRACT,
+    PIPELINE_COMMIT,
+    PIPELINE_EXPORT, //* Off the per-source path: consumes save requests
+    PIPELINE_STAGE_COUNT
+} PipelineStageId;
+
+static const char *const PIPELINE_STAGE_NAMES[PIPELINE_STAGE_COUNT] = { "fetch", "decode", "extract", "commit", "export" };
+
+/**
+ * @brief One source on its way through the stages. Whichever stage finishes or drops it
+ *        calls pipeline_item_done().
+ */
+typedef struct {
+    DownloadTask *task;
+    DynamicBuffer body;      //* fetch -> decode -> extract
+    BodyEncoding encoding;  //* What `body` still carries after the transfer
+    ProxyRecord *batch;    //* extract -> commit
+    int batch_count;
+} PipelineItem;
+
+/**
+ * @brief A thread pool draining one queue. `process` returns 1 to forward the item
+ *        into the next stage's queue (a cell was reserved for it), 0 when it is done with it.
+ */
+typedef struct {
+    int (*process)(void *value);
+    PipelineQueue *output;       //* NULL for commit and export
+    atomic_int threads;         //* Threads running; changed only by pipeline_resize_stage()
+    pthread_t workers[MAX_THREAD_COUNT];
+    int running[MAX_THREAD_COUNT];  //* Slot holds a thread that has not been joined (main thread only)
+    int exited[MAX_THREAD_COUNT];  //* Slots whose thread took a stop pill (pipeline_idle_mutex)
+    int exited_count;
+    atomic_int busy;           //* Threads processing an item right now
+    atomic_ullong items;
+    atomic_ullong busy_ns;   //* Processing time; waits for input or an output cell excluded
+    atomic_ullong thread_ns;     //* Thread time available before the last resize (utilization denominator)
+    atomic_ullong resized_ns;   //* monotonic_ns() of the last resize
+} PipelineStage;
+
+static PipelineQueue pipeline_queues[PIPELINE_STAGE_COUNT];
+static PipelineStage pipeline_stages[PIPELINE_STAGE_COUNT];
+static int pipeline_started = 0;       //* Set by pipeline_start(), cleared by pipeline_stop() (main thread only)
+static uint64_t pipeline_start_ns = 0;
+static atomic_int pipeline_outstanding = 0;    //* Submitted items not yet done
+static atomic_int pipeline_export_pending = 0; //* Save requests queued or running
+static pthread_mutex_t pipeline_idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pipeline_idle_cond = PTHREAD_COND_INITIALIZER;
+static int pipeline_export_request; //* Its address is the export queue's (non-NULL) item
+
+//* Allocates a ring holding `capacity` items and admits `bound` of them
+static int pipeline_queue_init(PipelineQueue *queue, int capacity, int bound) {
+    size_t ring_size = 1;
+    while (ring_size < (size_t)capacity)
+        ring_size <<= 1;
+    memset(queue, 0, sizeof(PipelineQueue));
+    queue->cells = calloc(ring_size, sizeof(PipelineCell));
+    if (!queue->cells)
+        return 0;
+    for (size_t i = 0; i < ring_size; i++)
+        atomic_init(&queue->cells[i].sequence, i);
+    queue->mask = ring_size - 1;
+    atomic_init(&queue->bound, bound);
+    sem_init(&queue->free_cells, 0, (unsigned)bound);
+    sem_init(&queue->filled_cells, 0, 0);
+    return 1;
+}
+
+static void pipeline_queue_destroy(PipelineQueue *queue) {
+    if (!queue->cells)
+        return;
+    sem_destroy(&queue->free_cells);
+    sem_destroy(&queue->filled_cells);
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+static void semaphore_wait(sem_t *semaphore) {
+    while (sem_wait(semaphore) != 0 && errno == EINTR)
+        ;
+}
+
+//* Changes how many items the queue admits (at most its ring size). Only called with the
+//* queue empty and no cell reserved, so lowering it never waits.
+void pipeline_queue_set_bound(PipelineQueue *queue, int bound) {
+    if (bound > (int)queue->mask + 1)
+        bound = (int)queue->mask + 1;
+    for (int current = atomic_load(&queue->bound); current < bound; current++)
+        sem_post(&queue->free_cells);
+    for (int current = atomic_load(&queue->bound); current > bound; current--)
+        semaphore_wait(&queue->free_cells);
+    atomic_store(&queue->bound, bound);
+}
+
+//* Blocks until a cell is free and claims it for a later pipeline_queue_push()
+void pipeline_queue_reserve(PipelineQueue *queue) {
+    if (sem_trywait(&queue->free_cells) == 0)
+        return;
+    uint64_t wait_start = monotonic_ns();
+    TRACE_BEGIN("backpressure", TRACE_ARG_NONE, 0);
+    semaphore_wait(&queue->free_cells);
+    TRACE_END("backpressure", TRACE_ARG_NONE, 0);
+    atomic_fetch_add_explicit(&queue->full_waits, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&queue->blocked_ns, monotonic_ns() - wait_start, memory_order_relaxed);
+}
+
+//* Claims a cell only if one is free right now; returns 0 otherwise
+int pipeline_queue_try_reserve(PipelineQueue *queue) {
+    return sem_trywait(&queue->free_cells) == 0;
+}
+
+//* Gives back a reservation that will not be used
+void pipeline_queue_cancel(PipelineQueue *queue) {
+    sem_post(&queue->free_cells);
+}
+
+//* Publishes `value` into a reserved cell; never blocks
+void pipeline_queue_push(PipelineQueue *queue, void *value) {
+    size_t position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+    PipelineCell *cell;
+    for (;;) {
+        cell = &queue->cells[position & queue->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        if (sequence == position) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else {
+            position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+        }
+    }
+    cell->value = value;
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+    int depth = atomic_fetch_add_explicit(&queue->depth, 1, memory_order_relaxed) + 1;
+    int peak = atomic_load_explicit(&queue->peak_depth, memory_order_relaxed);
+    while (depth > peak && !atomic_compare_exchange_weak_explicit(&queue->peak_depth, &peak, depth,
+                                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
+    sem_post(&queue->filled_cells);
+}
+
+//* Blocks until an item is available and removes it (its cell becomes reservable again)
+void* pipeline_queue_pop(PipelineQueue *queue) {
+    semaphore_wait(&queue->filled_cells);
+    size_t position = atomic_load_explicit(&queue->dequeue_position, memory_order_relaxed);
+    PipelineCell *cell;
+    for (;;) {
+        cell = &queue->cells[position & queue->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        if (sequence == position + 1) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else {
+            //* The producer that claimed this cell has not published it yet
+            position = atomic_load_explicit(&queue->dequeue_position, memory_order_relaxed);
+        }
+    }
+    void *value = cell->value;
+    atomic_store_explicit(&cell->sequence, position + queue->mask + 1, memory_order_release);
+    atomic_fetch_sub_explicit(&queue->depth, 1, memory_order_relaxed);
+    sem_post(&queue->free_cells);
+    return value;
+}
+
+//* =============== VERIFICATION: TCP PROBING ===============
+//* Checks that a proxy accepts TCP connections; latency feeds speed_score
+
+int probe_proxy(const char *server, const char *port, int timeout_ms, int *latency_ms) {
+    struct addrinfo hints = {0};
+    struct addrinfo *resolved = NULL;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(server, port, &hints, &resolved) != 0 || !resolved)
+        return 0;
+
+    int reachable = 0;
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    int fd = socket(resolved->ai_family, resolved->ai_socktype, resolved->ai_protocol);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int rc = connect(fd, resolved->ai_addr, resolved->ai_addrlen);
+        if (rc == 0) {
+            reachable = 1;
+        } else if (errno == EINPROGRESS) {
+            struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+            if (poll(&pfd, 1, timeout_ms) == 1) {
+                int so_error = 0;
+                socklen_t len = sizeof(so_error);
+                if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len) == 0 && so_error == 0)
+                    reachable = 1;
+            }
+        }
+        close(fd);
+    }
+    freeaddrinfo(resolved);
+
+    gettimeofday(&end, NULL);
+    if (latency_ms)
+        *latency_ms = (int)((end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000);
+    return reachable;
+}
+
+/**
+ * @brief One probe job: a snapshot of the proxy endpoint plus its result.
+ */
+typedef struct {
+    int storage_index;      //* Slot in proxy_storage
+    char server[256];      //* Copied so probes run without storage_mutex
+    char port[16];
+    int completed;       //* Set once the probe ran (shutdown can cut a pass short)
+    int reachable;      //* Probe outcome
+    int latency_ms;    //* Connect time
+} ProbeJob;
+
+typedef struct {
+    ProbeJob *jobs;
+    int job_count;
+    atomic_int next_job;
+} ProbeQueue;
+
+static double *probe_sort_scores = NULL; //* Only valid during select_probe_candidates()
+
+static int compare_probe_priority(const void *a, const void *b) {
+    double score_a = probe_sort_scores[*(const int *)a];
+    double score_b = probe_sort_scores[*(const int *)b];
+    return (score_a < score_b) - (score_a > score_b); //* Highest score first
+}
+
+void* probe_worker(void *queue_data) {
+    ProbeQueue *queue = (ProbeQueue *)queue_data;
+    int job_index;
+    trace_set_thread_label("prober");
+    while (atomic_load(&program_active) &&
+           (job_index = atomic_fetch_add(&queue->next_job, 1)) < queue->job_count) {
+        ProbeJob *job = &queue->jobs[job_index];
+        stats_add(STAT_PROBES_ATTEMPTED, 1);
+        TRACE_BEGIN("probe", TRACE_ARG_NONE, 0);
+        job->reachable = virtual_clock_enabled ? simulation_probe(job->server, job->port, run_options.probe_timeout_ms, &job->latency_ms)
+                                               : probe_proxy(job->server, job->port, run_options.probe_timeout_ms, &job->latency_ms);
+        TRACE_END("probe", TRACE_ARG_NONE, 0);
+        job->completed = 1;
+        if (job->reachable)
+            stats_add(STAT_PROBES_SUCCEEDED, 1);
+    }
+    return NULL;
+}
+
+//* Picks up to probe_budget proxies that were never probed or are stale,
+//* preferring those first reported by high-reputation sources.
+//* Caller holds storage_mutex. Returns the number of jobs filled.
+
+int select_probe_candidates(ProbeJob *jobs, time_t now) {
+    int current_total = atomic_load(&stats.total_proxies);
+    int *due = malloc(sizeof(int) * (current_total > 0 ? current_total : 1));
+    double *scores = malloc(sizeof(double) * (current_total > 0 ? current_total : 1));
+    if (!due || !scores) {
+        free(due);
+        free(scores);
+        return 0;
+    }
+
+    int due_count = 0;
+    for (int i = 0; i < current_total; i++) {
+        ProxyRecord *record = &proxy_storage[i];
+        if (record->last_probed == 0 || difftime(now, record->last_probed) >= run_options.probe_refresh_interval) {
+            scores[i] = proxy_source_score(record) + (record->last_probed == 0 ? 1.0 : 0.0);
+            due[due_count++] = i;
+        }
+    }
+
+    probe_sort_scores = scores;
+    qsort(due, due_count, sizeof(int), compare_probe_priority);
+    probe_sort_scores = NULL;
+
+    int job_count = MIN(due_count, run_options.probe_budget);
+    for (int j = 0; j < job_count; j++) {
+        ProxyRecord *record = &proxy_storage[due[j]];
+        memset(&jobs[j], 0, sizeof(ProbeJob));
+        jobs[j].storage_index = due[j];
+        snprintf(jobs[j].server, sizeof(jobs[j].server), "%s", record->server);
+        snprintf(jobs[j].port, sizeof(jobs[j].port), "%s", record->port);
+    }
+
+    free(due);
+    free(scores);
+    return job_count;
+}
+
+//* --simulate: time a pass would take when probe_threads probers take jobs in order, each
+//* probe lasting its connect time (the timeout when unreachable)
+static uint64_t simulated_probe_pass_ns(const ProbeJob *jobs, int job_count) {
+    uint64_t lanes[MAX_THREAD_COUNT] = {0};
+    uint64_t longest = 0;
+    for (int j = 0; j < job_count; j++) {
+        int lane = 0;
+        for (int l = 1; l < run_options.probe_threads; l++)
+            if (lanes[l] < lanes[lane])
+                lane = l;
+        lanes[lane] += (uint64_t)jobs[j].latency_ms * 1000000ULL;
+        if (lanes[lane] > longest)
+            longest = lanes[lane];
+    }
+    return longest;
+}
+
+//* Probes a budgeted set of proxies, records outcomes and refreshes source scores
+
+void run_verification_pass(int url_count) {
+    ProbeJob *jobs = calloc(run_options.probe_budget > 0 ? run_options.probe_budget : 1, sizeof(ProbeJob));
+    if (!jobs) {
+        log_message(LOG_LEVEL_ERROR, "Memory allocation failed for probe jobs");
+        return;
+    }
+
+    PROFILED_LOCK(&storage_mutex);
+    int job_count = select_probe_candidates(jobs, mtp_time());
+    PROFILED_UNLOCK(&storage_mutex);
+
+    if (job_count > 0 && virtual_clock_enabled) {
+        ProbeQueue queue = { .jobs = jobs, .job_count = job_count };
+        atomic_init(&queue.next_job, 0);
+        probe_worker(&queue); //* Modelled probes are instant and deterministic in list order
+        mtp_sleep_ns(simulated_probe_pass_ns(jobs, job_count));
+    } else if (job_count > 0) {
+        ProbeQueue queue = { .jobs = jobs, .job_count = job_count };
+        atomic_init(&queue.next_job, 0);
+
+        pthread_t probers[MAX_THREAD_COUNT];
+        int probers_launched = 0;
+        for (int i = 0; i < run_options.probe_threads && i < job_count; i++) {
+            if (pthread_create(&probers[probers_launched], NULL, probe_worker, &queue) == 0)
+                probers_launched++;
+        }
+        if (probers_launched == 0)
+            probe_worker(&queue); //* Fall back to probing inline
+        for (int i = 0; i < probers_launched; i++)
+            pthread_join(probers[i], NULL);
+    }
+
+    int reachable_count = 0;
+    int probed_count = 0;
+    time_t now = mtp_time();
+
+    PROFILED_LOCK(&storage_mutex);
+    for (int j = 0; j < job_count; j++) {
+        ProxyRecord *record = &proxy_storage[jobs[j].storage_index];
+        if (!jobs[j].completed)
+            continue;
+        probed_count++;
+        record->last_probed = now;
+        history_record_probe(record, now, jobs[j].reachable, jobs[j].latency_ms);
+        if (jobs[j].reachable) {
+            atomic_store(&record->verified, 1);
+            record->last_verified = now;
+            record->speed_score = 100 - MIN(jobs[j].latency_ms / 30, 99);
+            reachable_count++;
+        } else {
+            atomic_store(&record->verified, -1);
+        }
+    }
+    update_source_scores(url_count);
+    PROFILED_UNLOCK(&storage_mutex);
+
+    if (probed_count > 0)
+        log_message(LOG_LEVEL_INFO, "Verification: %d/%d probed proxies reachable", reachable_count, probed_count);
+    free(jobs);
+}
+
+//* =============== SHARDING: CONSISTENT-HASH SOURCE OWNERSHIP ===============
+//* Several instances split one source list: every node named in shard_nodes places
+//* SHARD_VIRTUAL_NODES points on a 64-bit ring, and a source belongs to the node owning
+//* the first point at or after the hash of its URL. Each node computes the same ring
+//* from the same list, so they agree without talking to each other, and adding or
+//* removing a node only moves the sources that land on its points. The ring is rebuilt
+//* at startup and after a reload (with no export running); in between the main thread
+//* and the export thread only read it.
+
+/**
+ * @brief One ring point: `node` owns the arc that ends here.
+ */
+typedef struct {
+    uint64_t point;
+    int node;
+} ShardPoint;
+
+static char shard_names[SHARD_MAX_NODES][SHARD_NODE_NAME_SIZE];
+static int shard_node_count = 0;
+static int shard_self = -1;                       //* Index of shard_node in shard_names; -1 = not sharded
+static ShardPoint shard_ring[SHARD_MAX_NODES * SHARD_VIRTUAL_NODES];
+static signed char source_shard[URL_CAPACITY];  //* Owning node per source, valid while shard_self >= 0
+static int shard_built = 0;                   //* shard_ring and source_shard reflect the settings below
+static char shard_built_nodes[SHARD_MAX_NODES * SHARD_NODE_NAME_SIZE];
+static char shard_built_self[SHARD_NODE_NAME_SIZE];
+
+//* FNV-1a finished with a 64-bit mixer: node names like "node1".."node9" differ in one
+//* byte, and raw FNV would cluster their points
+static uint64_t shard_hash(const char *text, uint64_t salt) {
+    uint64_t hash = 14695981039346656037ULL ^ salt;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    return hash ^ (hash >> 33);
+}
+
+//* Splits a shard_nodes value into names. Returns the count, or -1 with `problem` set.
+static int shard_parse_nodes(const char *list, char names[][SHARD_NODE_NAME_SIZE], const char **problem) {
+    int count = 0;
+    const char *cursor = list;
+    while (*cursor) {
+        size_t length = strcspn(cursor, ",");
+        const char *name = cursor;
+        cursor += length + (cursor[length] == ',');
+        while (length > 0 && isspace((unsigned char)*name))
+            name++, length--;
+        while (length > 0 && isspace((unsigned char)name[length - 1]))
+            length--;
+        if (length == 0)
+            continue;
+        if (length >= SHARD_NODE_NAME_SIZE) {
+            *problem = "node name too long";
+            return -1;
+        }
+        for (size_t i = 0; i < length; i++) {
+            if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '_' && name[i] != '.') {
+                *problem = "node names may only use letters, digits, '-', '_' and '.'";
+                return -1;
+            }
+        }
+        if (count == SHARD_MAX_NODES) {
+            *problem = "too many nodes";
+            return -1;
+        }
+        memcpy(names[count], name, length);
+        names[count][length] = '\0';
+        for (int i = 0; i < count; i++) {
+            if (strcmp(names[i], names[count]) == 0) {
+                *problem = "node listed twice";
+                return -1;
+            }
+        }
+        count++;
+    }
+    if (count == 0) {
+        *problem = "no node names";
+        return -1;
+    }
+    return count;
+}
+
+//* Cross-key check of the shard settings. Returns NULL, or why they cannot be used.
+const char* shard_validate(const RunOptions *options) {
+    static char names[SHARD_MAX_NODES][SHARD_NODE_NAME_SIZE]; //* Main thread only
+    if (!options->shard_nodes)
+        return NULL; //* A lone shard_node is fine: sharding is simply off
+    const char *problem = NULL;
+    int count = shard_parse_nodes(options->shard_nodes, names, &problem);
+    if (count < 0)
+        return problem;
+    if (!options->shard_node)
+        return "shard_nodes is set but this node has no shard_node (--shard-node)";
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], options->shard_node) == 0)
+            return NULL;
+    }
+    return "shard_node is not listed in shard_nodes";
+}
+
+static int compare_shard_points(const void *a, const void *b) {
+    const ShardPoint *point_a = a, *point_b = b;
+    if (point_a->point != point_b->point)
+        return point_a->point < point_b->point ? -1 : 1;
+    return point_a->node - point_b->node;
+}
+
+//* Owner of a source URL on the current ring (binary search for the first point >= its hash)
+static int shard_owner(const char *url) {
+    uint64_t hash = shard_hash(url, 0);
+    int ring_size = shard_node_count * SHARD_VIRTUAL_NODES;
+    int low = 0, high = ring_size;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (shard_ring[middle].point < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return shard_ring[low == ring_size ? 0 : low].node;
+}
+
+//* Rebuilds the ring and every source's owner from run_options (validated already)
+static void shard_build(int url_count) {
+    shard_self = -1;
+    shard_node_count = 0;
+    shard_built = 1;
+    snprintf(shard_built_nodes, sizeof(shard_built_nodes), "%s", run_options.shard_nodes ? run_options.shard_nodes : "");
+    snprintf(shard_built_self, sizeof(shard_built_self), "%s", run_options.shard_node ? run_options.shard_node : "");
+    const char *problem = NULL;
+    if (!run_options.shard_nodes)
+        return;
+    int count = shard_parse_nodes(run_options.shard_nodes, shard_names, &problem);
+    if (count <= 0)
+        return;
+    shard_node_count = count;
+    for (int n = 0; n < count; n++) {
+        uint64_t base = shard_hash(shard_names[n], 0);
+        for (int v = 0; v < SHARD_VIRTUAL_NODES; v++) {
+            shard_ring[n * SHARD_VIRTUAL_NODES + v].point = shard_hash(shard_names[n], base + (uint64_t)v);
+            shard_ring[n * SHARD_VIRTUAL_NODES + v].node = n;
+        }
+        if (run_options.shard_node && strcmp(shard_names[n], run_options.shard_node) == 0)
+            shard_self = n;
+    }
+    qsort(shard_ring, (size_t)count * SHARD_VIRTUAL_NODES, sizeof(ShardPoint), compare_shard_points);
+    for (int s = 0; s < url_count; s++)
+        source_shard[s] = (signed char)shard_owner(TARGET_URLS[s]);
+}
+
+int shard_owns(int source_index) {
+    return shard_self < 0 || source_shard[source_index] == shard_self;
+}
+
+//* Sources this node fetches: all of them unless sharded
+int shard_owned_count(int url_count) {
+    int owned = 0;
+    for (int s = 0; s < url_count; s++)
+        owned += shard_owns(s);
+    return owned;
+}
+
+//* Startup and post-reload hook: rebuilds the ring when the membership or this node's
+//* name changed and logs how many sources moved in and out
+void shard_update() {
+    int url_count = 0;
+    while (url_count < URL_CAPACITY && TARGET_URLS[url_count] != NULL)
+        url_count++;
+    if (shard_built && strcmp(shard_built_nodes, run_options.shard_nodes ? run_options.shard_nodes : "") == 0 &&
+        strcmp(shard_built_self, run_options.shard_node ? run_options.shard_node : "") == 0)
+        return;
+    static unsigned char owned_before[URL_CAPACITY];
+    int was_built = shard_built;
+    for (int s = 0; s < url_count; s++)
+        owned_before[s] = (unsigned char)shard_owns(s);
+    shard_build(url_count);
+    if (shard_self < 0) {
+        if (was_built)
+            log_message(LOG_LEVEL_INFO, "Shard: sharding off, fetching all %d sources", url_count);
+        return;
+    }
+    int owned = 0, moved_in = 0, moved_out = 0;
+    for (int s = 0; s < url_count; s++) {
+        int mine = shard_owns(s);
+        owned += mine;
+        moved_in += mine && !owned_before[s];
+        moved_out += !mine && owned_before[s];
+    }
+    log_message(LOG_LEVEL_INFO, "Shard: node %s owns %d/%d sources (%d nodes)", run_options.shard_node, owned, url_count,
+                shard_node_count);
+    if (was_built)
+        log_message(LOG_LEVEL_INFO, "Shard: membership changed, %d sources moved in, %d moved out", moved_in, moved_out);
+}
+
+//* --shard-plan: one "node<TAB>url" line per source, for checking a membership change offline
+void shard_print_plan(FILE *out, int url_count) {
+    for (int s = 0; s < url_count; s++)
+        fprintf(out, "%s\t%s\n", shard_names[source_shard[s]], TARGET_URLS[s]);
+}
+
+//* =============== SCHEDULER: REPUTATION-AWARE FETCH ORDER ===============
+//* Picks the sources due this cycle, best-scoring first; poor or failing
+//* sources are pushed out by source_fetch_interval() cycles, and sources another
+//* shard node owns are left out.
+
+static const SourceReputation *schedule_sort_reputation = NULL; //* Only valid during build_fetch_schedule()
+
+static int compare_schedule_priority(const void *a, const void *b) {
+    const SourceReputation *rep_a = &schedule_sort_reputation[*(const int *)a];
+    const SourceReputation *rep_b = &schedule_sort_reputation[*(const int *)b];
+    double score_a = source_score_trusted(rep_a) ? rep_a->score : 0.5;
+    double score_b = source_score_trusted(rep_b) ? rep_b->score : 0.5;
+    if (score_a != score_b)
+        return (score_a < score_b) - (score_a > score_b);
+    return *(const int *)a - *(const int *)b; //* Keep list order among equals
+}
+
+int build_fetch_schedule(int cycle_number, int url_count, int *schedule) {
+    int scheduled = 0;
+
+    PROFILED_LOCK(&storage_mutex);
+    for (int s = 0; s < url_count; s++) {
+        SourceReputation *rep = &source_reputation[s];
+        if (!shard_owns(s))
+            continue; //* Another node's source
+        if (rep->next_fetch_cycle > cycle_number) {
+            stats_add(STAT_SKIPPED_FETCHES, 1);
+            continue;
+        }
+        rep->next_fetch_cycle = cycle_number + source_fetch_interval(rep);
+        schedule[scheduled++] = s;
+    }
+    schedule_sort_reputation = source_reputation;
+    qsort(schedule, scheduled, sizeof(int), compare_schedule_priority);
+    schedule_sort_reputation = NULL;
+    PROFILED_UNLOCK(&storage_mutex);
+
+    return scheduled;
+}
+
+//* =============== CONSOLE: REAL-TIME STATS ===============
+//* Lock table: contention rate, wait/hold summary and the sites that waited longest
+void write_lock_statistics(FILE *out) {
+    fprintf(out, "Locks          acquired  contended  wait avg  wait max  hold p99 (ms)\n");
+    for (size_t l = 0; l < sizeof(PROFILED_MUTEXES) / sizeof(PROFILED_MUTEXES[0]); l++) {
+        ProfiledMutex *lock = PROFILED_MUTEXES[l];
+        uint64_t acquisitions = atomic_load_explicit(&lock->acquisitions, memory_order_relaxed);
+        uint64_t contended = atomic_load_explicit(&lock->contended, memory_order_relaxed);
+        uint64_t wait_total = atomic_load_explicit(&lock->wait_time.sum, memory_order_relaxed);
+        uint64_t hold_p99 = histogram_percentile_bound(&lock->hold_time, &LOCK_HOLD_SPEC, 99);
+        char hold_text[16];
+        if (acquisitions == 0)
+            snprintf(hold_text, sizeof(hold_text), "-");
+        else if (hold_p99 == UINT64_MAX)
+            snprintf(hold_text, sizeof(hold_text), ">%.0f", LOCK_HOLD_SPEC.bounds[LOCK_HOLD_SPEC.bound_count - 1] / 1e6);
+        else
+            snprintf(hold_text, sizeof(hold_text), "<=%.3f", hold_p99 / 1e6);
+        fprintf(out, "  %-10s %12llu %9.2f%% %9.3f %9.3f %10s\n", lock->name, (unsigned long long)acquisitions,
+                acquisitions ? 100.0 * contended / acquisitions : 0.0,
+                contended ? wait_total / 1e6 / contended : 0.0,
+                atomic_load_explicit(&lock->max_wait_ns, memory_order_relaxed) / 1e6, hold_text);
+
+        LockSiteSnapshot sites[LOCK_MAX_SITES];
+        int site_count = lock_top_sites(lock, sites, LOCK_MAX_SITES);
+        for (int s = 0; s < site_count && s < 3; s++)
+            fprintf(out, "      waited at %s:%d  %llu times, %.3f ms total\n", sites[s].function, sites[s].line,
+                    (unsigned long long)sites[s].waits, sites[s].wait_ns / 1e6);
+    }
+}
+
+//* Memory table: accounted bytes per subsystem against RSS and the budget
+void write_memory_statistics(FILE *out) {
+    uint64_t budget = atomic_load_explicit(&memory_budget_bytes, memory_order_relaxed);
+    fprintf(out, "Memory: %.1f MB accounted, %.1f MB resident", memory_accounted_total() / 1048576.0,
+            memory_resident_bytes() / 1048576.0);
+    if (budget > 0)
+        fprintf(out, ", budget %.0f MB (%llu waits, %llu aborted transfers)", budget / 1048576.0,
+                (unsigned long long)atomic_load(&memory_budget_waits), (unsigned long long)atomic_load(&memory_budget_aborts));
+    fprintf(out, "\n");
+    for (int s = 0; s < MEMORY_SUBSYSTEM_COUNT; s++)
+        fprintf(out, "  %-10s %9.1f MB (peak %.1f MB)\n", MEMORY_SUBSYSTEM_NAMES[s],
+                atomic_load(&memory_used[s]) / 1048576.0, atomic_load(&memory_peak[s]) / 1048576.0);
+}
+
+//* Pipeline table: per stage threads, utilization, input queue fill and time stalled on the next queue
+void write_pipeline_statistics(FILE *out) {
+    if (pipeline_start_ns == 0)
+        return;
+    uint64_t now = monotonic_ns();
+    fprintf(out, "Pipeline     threads    util     queue   peak  full waits  stalled (s)       items\n");
+    for (int s = 0; s < PIPELINE_STAGE_COUNT; s++) {
+        const PipelineStage *stage = &pipeline_stages[s];
+        const PipelineQueue *queue = &pipeline_queues[s];
+        int threads = atomic_load(&stage->threads);
+        uint64_t busy_ns = atomic_load_explicit(&stage->busy_ns, memory_order_relaxed);
+        uint64_t stalled_ns = stage->output ? atomic_load_explicit(&stage->output->blocked_ns, memory_order_relaxed) : 0;
+        //* Thread time summed over resizes, so a reload does not skew utilization
+        double thread_ns = (double)atomic_load(&stage->thread_ns) + (double)threads * (now - atomic_load(&stage->resized_ns));
+        char queue_text[24];
+        snprintf(queue_text, sizeof(queue_text), "%d/%d", atomic_load_explicit(&queue->depth, memory_order_relaxed),
+                 atomic_load(&queue->bound));
+        fprintf(out, "  %-10s %7d %6.1f%% %9s %6d %11llu %12.3f %11llu\n", PIPELINE_STAGE_NAMES[s], threads,
+                thread_ns > 0 ? 100.0 * busy_ns / thread_ns : 0.0, queue_text,
+                atomic_load_explicit(&queue->peak_depth, memory_order_relaxed),
+                (unsigned long long)atomic_load_explicit(&queue->full_waits, memory_order_relaxed), stalled_ns / 1e9,
+                (unsigned long long)atomic_load_explicit(&stage->items, memory_order_relaxed));
+    }
+}
+
+//* Writes current performance metrics to a console or file stream
+void write_statistics(FILE *out) {
+    time_t uptime = mtp_time() - stats.initialization_time;
+    int hours = uptime / 3600;
+    int minutes = (uptime % 3600) / 60;
+    int seconds = uptime % 60;
+    
+    StatsSnapshot snapshot;
+    stats_snapshot(&snapshot);
+    const uint64_t *counters = snapshot.counters;
+    double mb_processed = counters[STAT_TOTAL_BYTES] / (1024.0 * 1024.0);
+    
+    fprintf(out, "\n=== SYSTEM STATISTICS ===\n");
+    fprintf(out, "Uptime: %02d:%02d:%02d\n", hours, minutes, seconds);
+    fprintf(out, "Total proxies: %u\n", atomic_load(&stats.total_proxies));
+    fprintf(out, "Unique proxies: %llu\n", (unsigned long long)counters[STAT_UNIQUE_PROXIES]);
+    fprintf(out, "Successful proxies: %llu\n", (unsigned long long)counters[STAT_SUCCESSFUL_PROXIES]);
+    fprintf(out, "URLs processed: %llu/%llu\n", (unsigned long long)counters[STAT_PROCESSED_URLS],
+            (unsigned long long)counters[STAT_TOTAL_REQUESTS]);
+    fprintf(out, "Data processed: %.2f MB\n", mb_processed);
+    fprintf(out, "Completed cycles: %llu\n", (unsigned long long)counters[STAT_COMPLETED_CYCLES]);
+    fprintf(out, "Network errors: %llu\n", (unsigned long long)counters[STAT_NETWORK_ERRORS]);
+    fprintf(out, "Active workers: %d\n", atomic_load(&stats.active_workers));
+    fprintf(out, "Last cycle: +%llu proxies\n",
+            (unsigned long long)(counters[STAT_UNIQUE_PROXIES] - atomic_load(&stats.cycle_start_unique)));
+    fprintf(out, "Probes: %llu/%llu reachable\n", (unsigned long long)counters[STAT_PROBES_SUCCEEDED],
+            (unsigned long long)counters[STAT_PROBES_ATTEMPTED]);
+    fprintf(out, "Skipped fetches (reputation): %llu\n", (unsigned long long)counters[STAT_SKIPPED_FETCHES]);
+    if (run_options.sync_port || run_options.sync_peers)
+        fprintf(out, "Sync: %llu exchanges (%llu failed), %llu proxies in, %llu out, %.1f KB sent, %.1f KB received\n",
+                (unsigned long long)atomic_load(&sync_stats.exchanges), (unsigned long long)atomic_load(&sync_stats.failures),
+                (unsigned long long)atomic_load(&sync_stats.proxies_received),
+                (unsigned long long)atomic_load(&sync_stats.proxies_sent), atomic_load(&sync_stats.bytes_sent) / 1024.0,
+                atomic_load(&sync_stats.bytes_received) / 1024.0);
+    
+    //* Rates over the interval since the previous report (console or stats file, whichever came last)
+    static StatsSnapshot previous_report = {{0}, 0};
+    static pthread_mutex_t previous_report_mutex = PTHREAD_MUTEX_INITIALIZER; //* The export thread writes reports too
+    pthread_mutex_lock(&previous_report_mutex);
+    if (previous_report.taken_ns > 0 && snapshot.taken_ns > previous_report.taken_ns) {
+        double interval = (snapshot.taken_ns - previous_report.taken_ns) / 1e9;
+        const uint64_t *before = previous_report.counters;
+        fprintf(out, "Rates (last %.0fs): %.1f req/s, %.2f MB/s, %.1f new proxies/s, %.1f errors/s\n", interval,
+                (counters[STAT_TOTAL_REQUESTS] - before[STAT_TOTAL_REQUESTS]) / interval,
+                (counters[STAT_TOTAL_BYTES] - before[STAT_TOTAL_BYTES]) / 1048576.0 / interval,
+                (counters[STAT_UNIQUE_PROXIES] - before[STAT_UNIQUE_PROXIES]) / interval,
+                (counters[STAT_NETWORK_ERRORS] - before[STAT_NETWORK_ERRORS]) / interval);
+    }
+    previous_report = snapshot;
+    pthread_mutex_unlock(&previous_report_mutex);
+    
+    PROFILED_LOCK(&storage_mutex);
+    int throttled = 0;
+    for (int s = 0; s < URL_CAPACITY && TARGET_URLS[s] != NULL; s++) {
+        const SourceReputation *rep = &source_reputation[s];
+        if (source_fetch_interval(rep) > 1) {
+            if (throttled++ < 5)
+                fprintf(out, "  throttled: %.2f score, every %d cycles  %s\n",
+                       rep->score, source_fetch_interval(rep), TARGET_URLS[s]);
+        }
+    }
+    PROFILED_UNLOCK(&storage_mutex);
+    fprintf(out, "Throttled sources: %d (details in sources.json)\n", throttled);
+    write_memory_statistics(out);
+    write_pipeline_statistics(out);
+    write_lock_statistics(out);
+#ifdef MTP_STAGE_SPANS
+    StageSpanTotals *span_totals = malloc(sizeof(StageSpanTotals) * STAGE_COUNT);
+    if (span_totals) {
+        stage_span_collect(span_totals);
+        fprintf(out, "Stage latency (ms)      count      p50      p90      p99    p99.9      max\n");
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            const StageSpanTotals *totals = &span_totals[stage];
+            if (totals->total == 0)
+                continue;
+            char name[32];
+            stage_span_name(stage, name, sizeof(name));
+            fprintf(out, "  %-16s %10llu %8.3f %8.3f %8.3f %8.3f %8.3f\n", name, (unsigned long long)totals->total,
+                    stage_span_percentile(totals, 50) / 1e6, stage_span_percentile(totals, 90) / 1e6,
+                    stage_span_percentile(totals, 99) / 1e6, stage_span_percentile(totals, 99.9) / 1e6,
+                    totals->max_ns / 1e6);
+        }
+        free(span_totals);
+    }
+#endif
+    fprintf(out, "=========================\n\n");
+}
+
+//* Prints current performance metrics
+void display_statistics() {
+    PROFILED_LOCK(&log_mutex); //* Keep the report contiguous with the async log stream
+    log_drain_locked();
+    write_statistics(stdout);
+    fflush(stdout);
+    PROFILED_UNLOCK(&log_mutex);
+}
+
+//* Writes the same report to STATS_FILE (caller holds file_mutex)
+void save_statistics_file() {
+    FILE *stats_file = fopen(STATS_FILE, "w");
+    if (!stats_file)
+        return;
+    write_statistics(stats_file);
+    fclose(stats_file);
+}
+
+//* =============== OUTPUT: SOURCE REPUTATION ===============
+//* Writes per-source quality scores to sources.json (caller holds file_mutex)
+void save_source_reputation() {
+    json_t *root = json_object();
+    json_t *sources_array = json_array();
+    if (!root || !sources_array) {
+        json_decref(root);
+        json_decref(sources_array);
+        return;
+    }
+
+    PROFILED_LOCK(&storage_mutex);
+    for (int s = 0; s < URL_CAPACITY && TARGET_URLS[s] != NULL; s++) {
+        const SourceReputation *rep = &source_reputation[s];
+        json_t *source_obj = json_object();
+        json_object_set_new(source_obj, "url", json_string(TARGET_URLS[s]));
+        json_object_set_new(source_obj, "score", json_real(rep->score));
+        json_object_set_new(source_obj, "trusted", json_boolean(source_score_trusted(rep)));
+        json_object_set_new(source_obj, "reported", json_integer(rep->reported));
+        json_object_set_new(source_obj, "first_reports", json_integer(rep->first_reports));
+        json_object_set_new(source_obj, "avg_lag_seconds",
+                            json_real(rep->late_reports ? rep->lag_seconds_total / rep->late_reports : 0.0));
+        json_object_set_new(source_obj, "probed", json_integer(rep->probed));
+        json_object_set_new(source_obj, "verified", json_integer(rep->verified));
+        json_object_set_new(source_obj, "fetch_failures", json_integer(rep->fetch_failures));
+        json_object_set_new(source_obj, "fetch_interval_cycles", json_integer(source_fetch_interval(rep)));
+        if (shard_self >= 0)
+            json_object_set_new(source_obj, "owned", json_boolean(shard_owns(s)));
+        json_array_append_new(sources_array, source_obj);
+    }
+    PROFILED_UNLOCK(&storage_mutex);
+
+    json_object_set_new(root, "sources", sources_array);
+    if (json_dump_file(root, "sources.json", JSON_INDENT(2) | JSON_PRESERVE_ORDER) == 0)
+        log_message(LOG_LEVEL_DEBUG, "Saved source reputation to sources.json");
+    json_decref(root);
+}
+
+//* =============== OUTPUT: HARDWARE COUNTER REPORT ===============
+//* Writes HW_COUNTERS_FILE when --hw-counters is on (caller holds file_mutex)
+
+static json_t* hw_totals_json(const HwCounterTotals *totals) {
+    uint64_t passes = atomic_load_explicit(&totals->passes, memory_order_relaxed);
+    uint64_t counted = atomic_load_explicit(&totals->counted_passes, memory_order_relaxed);
+    uint64_t bytes = atomic_load_explicit(&totals->bytes, memory_order_relaxed);
+    uint64_t ns = atomic_load_explicit(&totals->ns, memory_order_relaxed);
+    json_t *entry = json_object();
+    json_object_set_new(entry, "passes", json_integer(passes));
+    json_object_set_new(entry, "bytes", json_integer(bytes));
+    json_object_set_new(entry, "ns", json_integer(ns));
+    json_object_set_new(entry, "ns_per_byte", json_real(bytes ? (double)ns / bytes : 0.0));
+    json_object_set_new(entry, "mb_per_s", json_real(ns ? bytes / 1048576.0 / (ns / 1e9) : 0.0));
+    json_object_set_new(entry, "counted_passes", json_integer(counted));
+    if (counted > 0) {
+        uint64_t events[HW_EVENT_COUNT];
+        for (int e = 0; e < HW_EVENT_COUNT; e++) {
+            events[e] = atomic_load_explicit(&totals->events[e], memory_order_relaxed);
+            json_object_set_new(entry, HW_EVENT_NAMES[e], json_integer(events[e]));
+        }
+        //* Per-byte ratios use the bytes of counted passes only (approximated pro rata)
+        double counted_bytes = passes ? (double)bytes * counted / passes : 0.0;
+        json_object_set_new(entry, "ipc", json_real(events[HW_CYCLES] ? (double)events[HW_INSTRUCTIONS] / events[HW_CYCLES] : 0.0));
+        json_object_set_new(entry, "instructions_per_byte", json_real(counted_bytes > 0 ? events[HW_INSTRUCTIONS] / counted_bytes : 0.0));
+        json_object_set_new(entry, "cache_misses_per_kb", json_real(counted_bytes > 0 ? events[HW_CACHE_MISSES] * 1024.0 / counted_bytes : 0.0));
+        json_object_set_new(entry, "branch_misses_per_kb", json_real(counted_bytes > 0 ? events[HW_BRANCH_MISSES] * 1024.0 / counted_bytes : 0.0));
+    }
+    return entry;
+}
+
+void save_hw_counter_report() {
+    if (!atomic_load(&hw_counters_enabled))
+        return;
+    json_t *root = json_object();
+    json_t *patterns = json_array();
+    json_t *stages = json_object();
+    json_t *sources = json_array();
+    if (!root || !patterns || !stages || !sources) {
+        json_decref(root);
+        json_decref(patterns);
+        json_decref(stages);
+        json_decref(sources);
+        return;
+    }
+
+    int counted_threads = atomic_load(&hw_threads_counted);
+    json_object_set_new(root, "mode", json_string(counted_threads > 0 ? "hardware" : "timing"));
+    json_object_set_new(root, "threads_counted", json_integer(counted_threads));
+    json_object_set_new(root, "threads_timing_only", json_integer(atomic_load(&hw_threads_timing_only)));
+
+    for (int p = 0; p < MAX_PATTERNS && PARSE_PATTERNS[p] != NULL; p++) {
+        if (atomic_load_explicit(&hw_pattern_totals[p].passes, memory_order_relaxed) == 0)
+            continue;
+        json_t *entry = hw_totals_json(&hw_pattern_totals[p]);
+        json_object_set_new(entry, "pattern", json_integer(p));
+        json_array_append_new(patterns, entry);
+    }
+    for (int stage = 0; stage < HW_STAGE_COUNT; stage++)
+        json_object_set_new(stages, HW_STAGE_NAMES[stage], hw_totals_json(&hw_stage_totals[stage]));
+    for (int s = 0; s < URL_CAPACITY && TARGET_URLS[s] != NULL; s++) {
+        if (atomic_load_explicit(&hw_source_totals[s].passes, memory_order_relaxed) == 0)
+            continue;
+        json_t *entry = hw_totals_json(&hw_source_totals[s]);
+        json_object_set_new(entry, "url", json_string(TARGET_URLS[s]));
+        json_array_append_new(sources, entry);
+    }
+
+    json_object_set_new(root, "stages", stages);
+    json_object_set_new(root, "patterns", patterns);
+    json_object_set_new(root, "sources", sources);
+    if (json_dump_file(root, HW_COUNTERS_FILE, JSON_INDENT(2) | JSON_PRESERVE_ORDER) == 0)
+        log_message(LOG_LEVEL_DEBUG, "Saved hardware counter report to %s", HW_COUNTERS_FILE);
+    json_decref(root);
+}
+
+//* =============== OUTPUT: CYCLE REPORT ===============
+//* One JSON object per line per cycle (--cycle-report); read by bench/bench_load.c
+
+void write_cycle_report(int cycle_number, int scheduled_count, uint64_t duration_ns,
+                        const StatsSnapshot *before, const StatsSnapshot *after, int saved) {
+    if (!run_options.cycle_report)
+        return;
+    FILE *out = fopen(run_options.cycle_report, "a");
+    if (!out) {
+        log_message(LOG_LEVEL_WARN, "Cannot append cycle report %s: %s", run_options.cycle_report, strerror(errno));
+        return;
+    }
+    fprintf(out, "{\"cycle\":%d,\"duration_ns\":%llu,\"sources\":%d,\"concurrency\":%d,"
+                 "\"fetched\":%llu,\"errors\":%llu,\"bytes\":%llu,\"new_proxies\":%llu,"
+                 "\"store_total\":%u,\"saved\":%d,\"rss_bytes\":%llu}\n",
+            cycle_number, (unsigned long long)duration_ns, scheduled_count, run_options.concurrency,
+            (unsigned long long)(after->counters[STAT_PROCESSED_URLS] - before->counters[STAT_PROCESSED_URLS]),
+            (unsigned long long)(after->counters[STAT_NETWORK_ERRORS] - before->counters[STAT_NETWORK_ERRORS]),
+            (unsigned long long)(after->counters[STAT_TOTAL_BYTES] - before->counters[STAT_TOTAL_BYTES]),
+            (unsigned long long)(after->counters[STAT_UNIQUE_PROXIES] - before->counters[STAT_UNIQUE_PROXIES]),
+            atomic_load(&stats.total_proxies), saved, (unsigned long long)memory_resident_bytes());
+    fclose(out);
+}
+
+//* =============== OUTPUT: SHARD PUBLISH ===============
+//* A sharded node's proxies.json carries a "shard" object naming the node, the
+//* membership it saw and the sources it owned; with shard_dir set the same document is
+//* also published as <shard_dir>/<node>.json for mtp_merge (caller holds file_mutex)
+
+json_t* shard_json(time_t now) {
+    json_t *shard = json_object();
+    json_t *nodes = json_array();
+    json_t *owned = json_array();
+    int url_count = 0;
+    for (int n = 0; n < shard_node_count; n++)
+        json_array_append_new(nodes, json_string(shard_names[n]));
+    while (url_count < URL_CAPACITY && TARGET_URLS[url_count] != NULL) {
+        if (shard_owns(url_count))
+            json_array_append_new(owned, json_string(TARGET_URLS[url_count]));
+        url_count++;
+    }
+    json_object_set_new(shard, "node", json_string(shard_names[shard_self]));
+    json_object_set_new(shard, "nodes", nodes);
+    json_object_set_new(shard, "sources", json_integer(url_count));
+    json_object_set_new(shard, "owned_sources", json_integer((json_int_t)json_array_size(owned)));
+    json_object_set_new(shard, "published", json_integer((json_int_t)now));
+    json_object_set_new(shard, "owned", owned);
+    return shard;
+}
+
+//* Written to a temporary name and renamed, so the merger never reads half a file
+void shard_publish(json_t *root) {
+    char path[PATH_MAX], tmp_path[PATH_MAX + 8];
+    snprintf(path, sizeof(path), "%s/%s.json", run_options.shard_dir, shard_names[shard_self]);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    if (json_dump_file(root, tmp_path, JSON_COMPACT | JSON_PRESERVE_ORDER) == 0 && rename(tmp_path, path) == 0) {
+        log_message(LOG_LEVEL_DEBUG, "Published shard store to %s", path);
+    } else {
+        log_message(LOG_LEVEL_WARN, "Cannot publish shard store to %s", path);
+        unlink(tmp_path);
+    }
+}
+
+//* =============== OUTPUT: SAVE TO JSON + TXT ===============
+//* Exports all proxies in structured JSON and simple text formats
+void save_proxies_to_json() {
+    STAGE_SPAN_BEGIN(export_span);
+    TRACE_BEGIN("export", TRACE_ARG_NONE, 0);
+    size_t export_reservation = (size_t)atomic_load(&stats.total_proxies) * MEMORY_EXPORT_BYTES_PER_PROXY;
+    memory_reserve(MEMORY_EXPORT, export_reservation); //* Large exports wait for transfers in budget mode
+    PROFILED_LOCK(&file_mutex);
+    USDT_PROBE1(export_start, atomic_load(&stats.total_proxies));
+    
+    time_t current_time = mtp_time();
+    struct tm *time_info = localtime(&current_time);
+    char time_string[64];
+    strftime(time_string, sizeof(time_string), "%Y-%m-%d %H:%M:%S", time_info);
+    
+    int current_total = atomic_load(&stats.total_proxies);
+    //* Buld json root object
+    json_t *root = json_object();
+    if (!root) {
+        PROFILED_UNLOCK(&file_mutex);
+        memory_charge(MEMORY_EXPORT, -(long long)export_reservation);
+        TRACE_END("export", TRACE_ARG_NONE, 0);
+        return;
+    }
+    
+    json_object_set_new(root, "version", json_string("2.0"));
+    json_object_set_new(root, "updated", json_string(time_string));
+    json_object_set_new(root, "total_proxies", json_integer(current_total));
+    StatsSnapshot snapshot;
+    stats_snapshot(&snapshot);
+    json_object_set_new(root, "unique_proxies", json_integer(snapshot.counters[STAT_UNIQUE_PROXIES]));
+    json_object_set_new(root, "sources_processed", json_integer(snapshot.counters[STAT_PROCESSED_URLS]));
+    
+    json_t *proxies_array = json_array();
+    int saved_count = 0;
+    
+    for (int i = 0; i < current_total; i++) {
+        if (proxy_storage[i].active) {
+            json_t *proxy_obj = json_object();
+            json_object_set_new(proxy_obj, "server", json_string(proxy_storage[i].server));
+            json_object_set_new(proxy_obj, "port", json_string(proxy_storage[i].port));
+            json_object_set_new(proxy_obj, "secret", json_string(proxy_storage[i].secret));
+            json_object_set_new(proxy_obj, "url", json_string(proxy_storage[i].connection_url));
+            json_object_set_new(proxy_obj, "source", json_string(proxy_storage[i].source));
+            json_object_set_new(proxy_obj, "type", json_string(proxy_storage[i].type));
+            json_object_set_new(proxy_obj, "country", json_string(proxy_storage[i].country));
+            json_object_set_new(proxy_obj, "speed_score", json_integer(proxy_storage[i].speed_score));
+            
+            char discovered_str[64];
+            strftime(discovered_str, sizeof(discovered_str), "%Y-%m-%d %H:%M:%S", localtime(&proxy_storage[i].discovery_time));
+            json_object_set_new(proxy_obj, "discovered", json_string(discovered_str));
+            
+            char verified_str[64];
+            strftime(verified_str, sizeof(verified_str), "%Y-%m-%d %H:%M:%S", localtime(&proxy_storage[i].last_verified));
+            json_object_set_new(proxy_obj, "last_verified", json_string(verified_str));
+            
+            char hash_str[17];
+            snprintf(hash_str, sizeof(hash_str), "%016llx", proxy_storage[i].hash_value);
+            json_object_set_new(proxy_obj, "hash", json_string(hash_str));
+            
+            if (proxy_storage[i].history) {
+                //* Uptime windows decoded from the compressed probe history
+                static const struct { const char *name; long seconds; } windows[] = {
+                    {"24h", 86400L}, {"7d", 7 * 86400L}, {"30d", 30 * 86400L}
+                };
+                json_t *uptime_obj = json_object();
+                for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+                    HistorySummary summary = history_summarize(proxy_storage[i].history, current_time - windows[w].seconds);
+                    json_t *window_obj = json_object();
+                    json_object_set_new(window_obj, "probes", json_integer(summary.samples));
+                    json_object_set_new(window_obj, "reachable", json_integer(summary.reachable));
+                    json_object_set_new(window_obj, "uptime", summary.samples > 0 ?
+                                        json_real((double)summary.reachable / summary.samples) : json_null());
+                    json_object_set_new(window_obj, "avg_latency_ms", json_integer(summary.avg_latency_ms));
+                    json_object_set_new(uptime_obj, windows[w].name, window_obj);
+                }
+                json_object_set_new(proxy_obj, "uptime", uptime_obj);
+            }
+            
+            json_array_append_new(proxies_array, proxy_obj);
+            saved_count++;
+        }
+    }
+    
+    json_object_set_new(root, "proxies", proxies_array);
+    if (shard_self >= 0)
+        json_object_set_new(root, "shard", shard_json(current_time));
+    //* Write JSON file
+    FILE *json_file = fopen("proxies.json", "w");
+    if (json_file) {
+        json_dumpf(root, json_file, JSON_INDENT(2) | JSON_PRESERVE_ORDER);
+        fclose(json_file);
+        log_message(LOG_LEVEL_INFO, "Saved %d proxies to proxies.json", saved_count);
+    }
+    if (shard_self >= 0 && run_options.shard_dir)
+        shard_publish(root);
+    
+    json_decref(root);
+    memory_charge(MEMORY_EXPORT, -(long long)export_reservation);
+    //* Write simple text file (tg:// URLs only)
+    FILE *simple_file = fopen("proxies.txt", "w");
+    if (simple_file) {
+        fprintf(simple_file, "# MTPROTO PROXY LIST\n");
+        fprintf(simple_file, "# Updated: %s\n", time_string);
+        fprintf(simple_file, "# Total proxies: %d\n", current_total);
+        fprintf(simple_file, "# Sources: %llu URLs processed\n", (unsigned long long)snapshot.counters[STAT_PROCESSED_URLS]);
+        fprintf(simple_file, "# Unique proxies: %llu\n\n", (unsigned long long)snapshot.counters[STAT_UNIQUE_PROXIES]);
+        
+        int txt_saved = 0;
+        for (int i = 0; i < current_total; i++) {
+            if (proxy_storage[i].active) {
+                fprintf(simple_file, "%s\n", proxy_storage[i].connection_url);
+                txt_saved++;
+            }
+        }
+        fclose(simple_file);
+        log_message(LOG_LEVEL_INFO, "Saved %d proxies to proxies.txt", txt_saved);
+    }
+    
+    save_source_reputation();
+    save_probe_histories();
+    save_statistics_file();
+    save_hw_counter_report();
+    
+    USDT_PROBE1(export_end, saved_count);
+    PROFILED_UNLOCK(&file_mutex);
+    STAGE_SPAN_END(export_span, STAGE_EXPORT);
+    TRACE_END("export", TRACE_ARG_NONE, 0);
+}
+//* =============== METRICS: PROMETHEUS ENDPOINT ===============
+//* Serves GET /metrics from relaxed-atomic snapshots; scrapes never take a parser lock
+
+/**
+ * @brief Plain copy of a MetricHistogram taken at scrape time.
+ */
+typedef struct {
+    uint64_t buckets[HISTOGRAM_MAX_BUCKETS + 1];
+    uint64_t count;
+    uint64_t sum;
+} HistogramSnapshot;
+
+/**
+ * @brief Plain copy of SourceMetrics; also used to aggregate per-host series.
+ */
+typedef struct {
+    char label[256];          //* Source URL or host name
+    uint64_t requests;
+    uint64_t failures;
+    uint64_t bytes;
+    uint64_t proxies_found;
+    uint64_t proxies_added;
+    HistogramSnapshot histograms[4]; //* fetch latency, body size, extraction, commit
+} SourceMetricsSnapshot;
+
+static const HistogramSpec *SOURCE_HISTOGRAM_SPECS[4] = {
+    &FETCH_LATENCY_SPEC, &BODY_SIZE_SPEC, &EXTRACTION_TIME_SPEC, &COMMIT_LATENCY_SPEC
+};
+
+static void snapshot_histogram(const MetricHistogram *histogram, HistogramSnapshot *snapshot) {
+    for (int b = 0; b <= HISTOGRAM_MAX_BUCKETS; b++)
+        snapshot->buckets[b] = atomic_load_explicit(&histogram->buckets[b], memory_order_relaxed);
+    snapshot->sum = atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+    snapshot->count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+}
+
+static void snapshot_source_metrics(int source_index, SourceMetricsSnapshot *snapshot) {
+    const SourceMetrics *metrics = &source_metrics[source_index];
+    snapshot->requests = atomic_load_explicit(&metrics->requests, memory_order_relaxed);
+    snapshot->failures = atomic_load_explicit(&metrics->failures, memory_order_relaxed);
+    snapshot->bytes = atomic_load_explicit(&metrics->bytes, memory_order_relaxed);
+    snapshot->proxies_found = atomic_load_explicit(&metrics->proxies_found, memory_order_relaxed);
+    snapshot->proxies_added = atomic_load_explicit(&metrics->proxies_added, memory_order_relaxed);
+    snapshot_histogram(&metrics->fetch_latency, &snapshot->histograms[0]);
+    snapshot_histogram(&metrics->body_size, &snapshot->histograms[1]);
+    snapshot_histogram(&metrics->extraction_time, &snapshot->histograms[2]);
+    snapshot_histogram(&metrics->commit_latency, &snapshot->histograms[3]);
+}
+
+static void merge_source_snapshot(SourceMetricsSnapshot *into, const SourceMetricsSnapshot *from) {
+    into->requests += from->requests;
+    into->failures += from->failures;
+    into->bytes += from->bytes;
+    into->proxies_found += from->proxies_found;
+    into->proxies_added += from->proxies_added;
+    for (int h = 0; h < 4; h++) {
+        for (int b = 0; b <= HISTOGRAM_MAX_BUCKETS; b++)
+            into->histograms[h].buckets[b] += from->histograms[h].buckets[b];
+        into->histograms[h].count += from->histograms[h].count;
+        into->histograms[h].sum += from->histograms[h].sum;
+    }
+}
+
+//* Copies the host part of a URL ("https://host:port/path" -> "host")
+void url_host(const char *url, char *host, size_t host_size) {
+    const char *start = strstr(url, "://");
+    start = start ? start + 3 : url;
+    size_t length = strcspn(start, ":/?#");
+    if (length >= host_size)
+        length = host_size - 1;
+    memcpy(host, start, length);
+    host[length] = '\0';
+}
+
+//* printf-style append to a growable buffer (no BUFFER_CAPACITY cap: output is small)
+void buffer_printf(DynamicBuffer *buffer, const char *format, ...) {
+    va_list args;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t available = buffer->capacity - buffer->size;
+        va_start(args, format);
+        int needed = vsnprintf(buffer->data + buffer->size, available, format, args);
+        va_end(args);
+        if (needed < 0)
+            return;
+        if ((size_t)needed < available) {
+            buffer->size += needed;
+            return;
+        }
+        size_t new_capacity = buffer->capacity * 2 + needed + 1;
+        char *new_data = realloc(buffer->data, new_capacity);
+        if (!new_data)
+            return;
+        buffer->data = new_data;
+        buffer->capacity = new_capacity;
+    }
+}
+
+//* Writes a label value with Prometheus escaping (backslash, quote, newline)
+static void buffer_label_value(DynamicBuffer *buffer, const char *value) {
+    for (const char *p = value; *p; p++) {
+        if (*p == '\\' || *p == '"')
+            buffer_printf(buffer, "\\%c", *p);
+        else if (*p == '\n')
+            buffer_printf(buffer, "\\n");
+        else
+            buffer_printf(buffer, "%c", *p);
+    }
+}
+
+static void render_metric(DynamicBuffer *out, const char *name, const char *type, const char *help, double value) {
+    buffer_printf(out, "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n", name, help, name, type, name, value);
+}
+
+static void render_labeled_counters(DynamicBuffer *out, const char *scope, const SourceMetricsSnapshot *rows, int row_count) {
+    static const struct { const char *name; const char *help; size_t offset; } counters[] = {
+        {"requests_total", "Fetch attempts", offsetof(SourceMetricsSnapshot, requests)},
+        {"failures_total", "Failed fetches (transport errors and non-200 responses)", offsetof(SourceMetricsSnapshot, failures)},
+        {"bytes_total", "Body bytes of successful fetches", offsetof(SourceMetricsSnapshot, bytes)},
+        {"proxies_found_total", "Valid proxies extracted", offsetof(SourceMetricsSnapshot, proxies_found)},
+        {"proxies_added_total", "Extracted proxies that were new to the store", offsetof(SourceMetricsSnapshot, proxies_added)},
+    };
+    for (size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); c++) {
+        buffer_printf(out, "# HELP mtproto_%s_%s %s\n# TYPE mtproto_%s_%s counter\n",
+                      scope, counters[c].name, counters[c].help, scope, counters[c].name);
+        for (int r = 0; r < row_count; r++) {
+            uint64_t value = *(const uint64_t *)((const char *)&rows[r] + counters[c].offset);
+            buffer_printf(out, "mtproto_%s_%s{%s=\"", scope, counters[c].name, scope);
+            buffer_label_value(out, rows[r].label);
+            buffer_printf(out, "\"} %llu\n", (unsigned long long)value);
+        }
+    }
+}
+
+//* Writes the _bucket/_sum/_count series of one labeled histogram (family is mtproto_<scope>_<spec name>)
+static void render_histogram_series(DynamicBuffer *out, const char *scope, const char *label,
+                                    const HistogramSpec *spec, const HistogramSnapshot *snapshot) {
+    uint64_t cumulative = 0;
+    for (int b = 0; b <= spec->bound_count; b++) {
+        cumulative += snapshot->buckets[b];
+        buffer_printf(out, "mtproto_%s_%s_bucket{%s=\"", scope, spec->name, scope);
+        buffer_label_value(out, label);
+        if (b < spec->bound_count)
+            buffer_printf(out, "\",le=\"%g\"} %llu\n", spec->bounds[b] / spec->scale, (unsigned long long)cumulative);
+        else
+            buffer_printf(out, "\",le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+    }
+    buffer_printf(out, "mtproto_%s_%s_sum{%s=\"", scope, spec->name, scope);
+    buffer_label_value(out, label);
+    buffer_printf(out, "\"} %.17g\n", snapshot->sum / spec->scale);
+    buffer_printf(out, "mtproto_%s_%s_count{%s=\"", scope, spec->name, scope);
+    buffer_label_value(out, label);
+    buffer_printf(out, "\"} %llu\n", (unsigned long long)snapshot->count);
+}
+
+static void render_labeled_histograms(DynamicBuffer *out, const char *scope, const SourceMetricsSnapshot *rows, int row_count) {
+    for (int h = 0; h < 4; h++) {
+        const HistogramSpec *spec = SOURCE_HISTOGRAM_SPECS[h];
+        buffer_printf(out, "# HELP mtproto_%s_%s %s\n# TYPE mtproto_%s_%s histogram\n",
+                      scope, spec->name, spec->help, scope, spec->name);
+        for (int r = 0; r < row_count; r++)
+            render_histogram_series(out, scope, rows[r].label, spec, &rows[r].histograms[h]);
+    }
+}
+
+static void render_memory_metrics(DynamicBuffer *out) {
+    static const struct { const char *name; const char *help; atomic_llong *values; } gauges[] = {
+        {"memory_bytes", "Accounted memory by subsystem", memory_used},
+        {"memory_peak_bytes", "Highest accounted memory by subsystem", memory_peak},
+    };
+    for (size_t g = 0; g < sizeof(gauges) / sizeof(gauges[0]); g++) {
+        buffer_printf(out, "# HELP mtproto_%s %s\n# TYPE mtproto_%s gauge\n", gauges[g].name, gauges[g].help, gauges[g].name);
+        for (int s = 0; s < MEMORY_SUBSYSTEM_COUNT; s++)
+            buffer_printf(out, "mtproto_%s{subsystem=\"%s\"} %lld\n", gauges[g].name, MEMORY_SUBSYSTEM_NAMES[s],
+                          (long long)atomic_load_explicit(&gauges[g].values[s], memory_order_relaxed));
+    }
+    render_metric(out, "mtproto_resident_memory_bytes", "gauge", "Resident set size", memory_resident_bytes());
+    render_metric(out, "mtproto_memory_budget_bytes", "gauge", "Budget mode limit (0 = disabled)",
+                  atomic_load(&memory_budget_bytes));
+    render_metric(out, "mtproto_memory_budget_waits_total", "counter", "Transfers and exports that waited for memory headroom",
+                  atomic_load(&memory_budget_waits));
+    render_metric(out, "mtproto_memory_budget_aborts_total", "counter", "Transfers aborted because growing them would exceed the budget",
+                  atomic_load(&memory_budget_aborts));
+}
+
+//* Per-stage threads, busy and stall time, and the fill of each stage's input queue
+static void render_pipeline_metrics(DynamicBuffer *out) {
+    if (pipeline_start_ns == 0)
+        return;
+    static const struct { const char *name; const char *type; const char *help; } series[] = {
+        {"stage_threads", "gauge", "Threads running the stage"},
+        {"stage_busy_seconds_total", "counter", "Time spent processing items (divide its rate by stage_threads for utilization)"},
+        {"stage_stalled_seconds_total", "counter", "Time the stage waited for room in the next stage's queue"},
+        {"stage_items_total", "counter", "Items the stage has processed"},
+        {"queue_depth", "gauge", "Items waiting in the stage's input queue"},
+        {"queue_capacity", "gauge", "Items the input queue holds, counting cells reserved by producers"},
+        {"queue_peak_depth", "gauge", "Highest input queue depth seen"},
+        {"queue_full_waits_total", "counter", "Times a producer found the input queue full and blocked"},
+    };
+    for (size_t m = 0; m < sizeof(series) / sizeof(series[0]); m++) {
+        buffer_printf(out, "# HELP mtproto_pipeline_%s %s\n# TYPE mtproto_pipeline_%s %s\n",
+                      series[m].name, series[m].help, series[m].name, series[m].type);
+        for (int s = 0; s < PIPELINE_STAGE_COUNT; s++) {
+            const PipelineStage *stage = &pipeline_stages[s];
+            const PipelineQueue *queue = &pipeline_queues[s];
+            double values[] = {
+                atomic_load(&stage->threads),
+                atomic_load_explicit(&stage->busy_ns, memory_order_relaxed) / 1e9,
+                stage->output ? atomic_load_explicit(&stage->output->blocked_ns, memory_order_relaxed) / 1e9 : 0.0,
+                (double)atomic_load_explicit(&stage->items, memory_order_relaxed),
+                atomic_load_explicit(&queue->depth, memory_order_relaxed),
+                atomic_load(&queue->bound),
+                atomic_load_explicit(&queue->peak_depth, memory_order_relaxed),
+                (double)atomic_load_explicit(&queue->full_waits, memory_order_relaxed),
+            };
+            buffer_printf(out, "mtproto_pipeline_%s{stage=\"%s\"} %.9g\n", series[m].name, PIPELINE_STAGE_NAMES[s], values[m]);
+        }
+    }
+}
+
+//* Per-lock counters, wait/hold histograms and per-site wait totals
+static void render_lock_metrics(DynamicBuffer *out) {
+    size_t lock_count = sizeof(PROFILED_MUTEXES) / sizeof(PROFILED_MUTEXES[0]);
+    static const struct { const char *name; const char *help; size_t offset; } counters[] = {
+        {"acquisitions_total", "Lock acquisitions", offsetof(ProfiledMutex, acquisitions)},
+        {"contended_total", "Acquisitions that blocked because the lock was held", offsetof(ProfiledMutex, contended)},
+    };
+    for (size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); c++) {
+        buffer_printf(out, "# HELP mtproto_lock_%s %s\n# TYPE mtproto_lock_%s counter\n",
+                      counters[c].name, counters[c].help, counters[c].name);
+        for (size_t l = 0; l < lock_count; l++) {
+            const atomic_ullong *value = (const atomic_ullong *)((const char *)PROFILED_MUTEXES[l] + counters[c].offset);
+            buffer_printf(out, "mtproto_lock_%s{lock=\"%s\"} %llu\n", counters[c].name, PROFILED_MUTEXES[l]->name,
+                          (unsigned long long)atomic_load_explicit(value, memory_order_relaxed));
+        }
+    }
+
+    static const HistogramSpec *const lock_specs[2] = { &LOCK_WAIT_SPEC, &LOCK_HOLD_SPEC };
+    for (int h = 0; h < 2; h++) {
+        buffer_printf(out, "# HELP mtproto_lock_%s %s\n# TYPE mtproto_lock_%s histogram\n",
+                      lock_specs[h]->name, lock_specs[h]->help, lock_specs[h]->name);
+        for (size_t l = 0; l < lock_count; l++) {
+            HistogramSnapshot snapshot;
+            snapshot_histogram(h == 0 ? &PROFILED_MUTEXES[l]->wait_time : &PROFILED_MUTEXES[l]->hold_time, &snapshot);
+            render_histogram_series(out, "lock", PROFILED_MUTEXES[l]->name, lock_specs[h], &snapshot);
+        }
+    }
+
+    buffer_printf(out, "# HELP mtproto_lock_site_wait_seconds_total Time blocked on a lock, by call site\n"
+                       "# TYPE mtproto_lock_site_wait_seconds_total counter\n");
+    for (size_t l = 0; l < lock_count; l++) {
+        LockSiteSnapshot sites[LOCK_MAX_SITES];
+        int site_count = lock_top_sites(PROFILED_MUTEXES[l], sites, LOCK_MAX_SITES);
+        for (int s = 0; s < site_count; s++)
+            buffer_printf(out, "mtproto_lock_site_wait_seconds_total{lock=\"%s\",site=\"%s:%d\"} %.9f\n",
+                          PROFILED_MUTEXES[l]->name, sites[s].function, sites[s].line, sites[s].wait_ns / 1e9);
+    }
+}
+
+//* Renders the full exposition text into `out`
+void render_metrics(DynamicBuffer *out) {
+    StatsSnapshot snapshot;
+    stats_snapshot(&snapshot);
+    const uint64_t *counters = snapshot.counters;
+    render_metric(out, "mtproto_uptime_seconds", "gauge", "Seconds since the parser started",
+                  difftime(mtp_time(), stats.initialization_time));
+    render_metric(out, "mtproto_stored_proxies", "gauge", "Proxies currently held in the store",
+                  atomic_load(&stats.total_proxies));
+    render_metric(out, "mtproto_unique_proxies_total", "counter", "Unique proxies added to the store",
+                  counters[STAT_UNIQUE_PROXIES]);
+    render_metric(out, "mtproto_successful_proxies_total", "counter", "Proxies that passed validation and were stored",
+                  counters[STAT_SUCCESSFUL_PROXIES]);
+    render_metric(out, "mtproto_processed_urls_total", "counter", "Sources fetched successfully",
+                  counters[STAT_PROCESSED_URLS]);
+    render_metric(out, "mtproto_requests_total", "counter", "HTTP requests attempted",
+                  counters[STAT_TOTAL_REQUESTS]);
+    render_metric(out, "mtproto_network_errors_total", "counter", "Failed HTTP requests",
+                  counters[STAT_NETWORK_ERRORS]);
+    render_metric(out, "mtproto_parse_errors_total", "counter", "Regex or parsing failures",
+                  counters[STAT_PARSE_ERRORS]);
+    render_metric(out, "mtproto_downloaded_bytes_total", "counter", "Body bytes downloaded",
+                  counters[STAT_TOTAL_BYTES]);
+    render_metric(out, "mtproto_completed_cycles_total", "counter", "Parsing cycles started",
+                  counters[STAT_COMPLETED_CYCLES]);
+    render_metric(out, "mtproto_active_workers", "gauge", "Sources being fetched, decoded, extracted or committed",
+                  atomic_load(&stats.active_workers));
+    render_metric(out, "mtproto_last_cycle_new_proxies", "gauge", "New proxies found in the current cycle",
+                  counters[STAT_UNIQUE_PROXIES] - atomic_load(&stats.cycle_start_unique));
+    render_metric(out, "mtproto_probes_attempted_total", "counter", "Verification probes started",
+                  counters[STAT_PROBES_ATTEMPTED]);
+    render_metric(out, "mtproto_probes_succeeded_total", "counter", "Verification probes that reached the proxy",
+                  counters[STAT_PROBES_SUCCEEDED]);
+    render_metric(out, "mtproto_skipped_fetches_total", "counter", "Source fetches skipped by the reputation scheduler",
+                  counters[STAT_SKIPPED_FETCHES]);
+
+    render_metric(out, "mtproto_sync_exchanges_total", "counter", "Set reconciliations completed with a peer",
+                  atomic_load(&sync_stats.exchanges));
+    render_metric(out, "mtproto_sync_failures_total", "counter", "Set reconciliations abandoned on an error",
+                  atomic_load(&sync_stats.failures));
+    render_metric(out, "mtproto_sync_sketches_total", "counter", "Sketches and hash lists sent to peers",
+                  atomic_load(&sync_stats.sketches));
+    render_metric(out, "mtproto_sync_sent_bytes_total", "counter", "Request bytes sent to peers",
+                  atomic_load(&sync_stats.bytes_sent));
+    render_metric(out, "mtproto_sync_received_bytes_total", "counter", "Reply bytes received from peers",
+                  atomic_load(&sync_stats.bytes_received));
+    render_metric(out, "mtproto_sync_received_proxies_total", "counter", "Proxies received from peers that were new here",
+                  atomic_load(&sync_stats.proxies_received));
+    render_metric(out, "mtproto_sync_sent_proxies_total", "counter", "Proxies pushed to peers that lacked them",
+                  atomic_load(&sync_stats.proxies_sent));
+    render_metric(out, "mtproto_sync_requests_served_total", "counter", "Peer requests answered by the sync listener",
+                  atomic_load(&sync_stats.requests_served));
+
+    render_memory_metrics(out);
+    render_pipeline_metrics(out);
+    render_lock_metrics(out);
+
+#ifdef MTP_STAGE_SPANS
+    StageSpanTotals *span_totals = malloc(sizeof(StageSpanTotals) * STAGE_COUNT);
+    if (span_totals) {
+        static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+        stage_span_collect(span_totals);
+        buffer_printf(out, "# HELP mtproto_stage_duration_seconds Per-stage span latency (merged thread-local HDR histograms)\n"
+                           "# TYPE mtproto_stage_duration_seconds summary\n");
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            const StageSpanTotals *totals = &span_totals[stage];
+            if (totals->total == 0)
+                continue;
+            char name[32];
+            stage_span_name(stage, name, sizeof(name));
+            for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+                buffer_printf(out, "mtproto_stage_duration_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n",
+                              name, quantiles[q], stage_span_percentile(totals, quantiles[q] * 100) / 1e9);
+            buffer_printf(out, "mtproto_stage_duration_seconds_sum{stage=\"%s\"} %.9f\n", name, totals->sum_ns / 1e9);
+            buffer_printf(out, "mtproto_stage_duration_seconds_count{stage=\"%s\"} %llu\n", name, (unsigned long long)totals->total);
+        }
+        free(span_totals);
+    }
+#endif
+
+    int url_count = 0;
+    while (url_count < URL_CAPACITY && TARGET_URLS[url_count] != NULL)
+        url_count++;
+
+    SourceMetricsSnapshot *sources = calloc(url_count > 0 ? url_count : 1, sizeof(SourceMetricsSnapshot));
+    SourceMetricsSnapshot *hosts = calloc(url_count > 0 ? url_count : 1, sizeof(SourceMetricsSnapshot));
+    if (!sources || !hosts) {
+        free(sources);
+        free(hosts);
+        return;
+    }
+
+    int host_count = 0;
+    for (int s = 0; s < url_count; s++) {
+        snapshot_source_metrics(s, &sources[s]);
+        strncpy(sources[s].label, TARGET_URLS[s], sizeof(sources[s].label) - 1);
+
+        char host[256];
+        url_host(TARGET_URLS[s], host, sizeof(host));
+        int h = 0;
+        while (h < host_count && strcmp(hosts[h].label, host) != 0)
+            h++;
+        if (h == host_count)
+            strcpy(hosts[host_count++].label, host);
+        merge_source_snapshot(&hosts[h], &sources[s]);
+    }
+
+    render_labeled_counters(out, "source", sources, url_count);
+    render_labeled_histograms(out, "source", sources, url_count);
+    render_labeled_counters(out, "host", hosts, host_count);
+    render_labeled_histograms(out, "host", hosts, host_count);
+
+    free(sources);
+    free(hosts);
+}
+
+static void send_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return;
+        data += sent;
+        length -= sent;
+    }
+}
+
+static void serve_metrics_request(int client_fd) {
+    char request[2048];
+    size_t received = 0;
+    struct pollfd pfd = { .fd = client_fd, .events = POLLIN };
+    while (received < sizeof(request) - 1 && poll(&pfd, 1, 2000) == 1) {
+        ssize_t n = recv(client_fd, request + received, sizeof(request) - 1 - received, 0);
+        if (n <= 0)
+            break;
+        received += n;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n"))
+            break;
+    }
+    request[received] = '\0';
+
+    if (strncmp(request, "GET /metrics ", 13) != 0 && strncmp(request, "GET /metrics?", 13) != 0) {
+        static const char not_found[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_all(client_fd, not_found, sizeof(not_found) - 1);
+        return;
+    }
+
+    DynamicBuffer body = {0};
+    body.capacity = 64 * 1024;
+    body.data = malloc(body.capacity);
+    if (!body.data)
+        return;
+    body.data[0] = '\0';
+    render_metrics(&body);
+
+    char header[256];
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                 "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size);
+    send_all(client_fd, header, header_length);
+    send_all(client_fd, body.data, body.size);
+    free(body.data);
+}
+
+void* metrics_server(void *listen_data) {
+    int listen_fd = (int)(intptr_t)listen_data;
+    while (atomic_load(&program_active)) {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 1000) != 1)
+            continue;
+        int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0)
+            continue;
+        serve_metrics_request(client_fd);
+        close(client_fd);
+    }
+    close(listen_fd);
+    return NULL;
+}
+
+//* Listening IPv4 socket for an embedded endpoint, or -1 after logging why `label` is disabled
+int open_listener(const char *label, const char *bind_address, int port) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        return -1;
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, bind_address, &address.sin_addr) != 1) {
+        log_message(LOG_LEVEL_WARN, "%s disabled: %s is not an IPv4 address", label, bind_address);
+        close(listen_fd);
+        return -1;
+    }
+
+    if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listen_fd, 16) != 0) {
+        log_message(LOG_LEVEL_WARN, "%s disabled: cannot listen on %s:%d (%s)", label, bind_address, port, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+    return listen_fd;
+}
+
+void start_metrics_server() {
+    int port = run_options.metrics_port;
+    const char *bind_address = run_options.metrics_bind_address;
+    if (port == 0)
+        return;
+
+    int listen_fd = open_listener("Metrics endpoint", bind_address, port);
+    if (listen_fd < 0)
+        return;
+
+    if (pthread_create(&metrics_thread, NULL, metrics_server, (void *)(intptr_t)listen_fd) == 0) {
+        metrics_thread_started = 1;
+        log_message(LOG_LEVEL_INFO, "Metrics endpoint: http://%s:%d/metrics", bind_address, port);
+    } else {
+        close(listen_fd);
+    }
+}
+
+void stop_metrics_server() {
+    if (metrics_thread_started) {
+        pthread_join(metrics_thread, NULL);
+        metrics_thread_started = 0;
+    }
+}
+
+//* =============== SYNC: SET RECONCILIATION BETWEEN INSTANCES ===============
+//* Redundant instances converge on one store without shipping it whole. The asking node
+//* sends an invertible Bloom lookup table of its proxy hashes: SYNC_HASH_COUNT sub-tables
+//* of cells, each holding a count, the XOR of its hashes and the XOR of a check value per
+//* hash. The listener removes its own hashes from the table and peels cells left holding
+//* exactly one hash, which recovers both halves of the difference when the table was big
+//* enough. A table that does not peel is resent twice as large, so the bytes spent follow
+//* the difference, not the store; once a table would be no smaller than the asker's plain
+//* hash list (or past SYNC_MAX_CELLS), the list goes instead.
+//* The listener replies with the records the asker lacks and the hashes it lacks itself,
+//* and the asker pushes those. The main thread asks its sync_peers between cycles; the
+//* listener answers one request at a time on its own thread. Both only read hash_value
+//* (fixed once a record is published) to build tables, and copy records out under
+//* storage_mutex, since probes rewrite last_verified and speed_score.
+//* Format (sketch fields little-endian, everything else text):
+//*   POST /sync/diff  "MTPS", u8 version, u8 kind ('I' table, 'L' hash list), u16 0, u32 entries,
+//*                    then 16-byte cells (i32 count, u32 check, u64 hash XOR) or u64 hashes
+//*                 -> "MTPS 1 ok <records> <hashes>\n", record lines, 16-hex-digit hash lines
+//*                    or "MTPS 1 undecodable\n" when the table was too small
+//*   POST /sync/push  "MTPS 1 push <records>\n", record lines -> "MTPS 1 added <new>\n"
+//*   record line      server, port, secret, source, discovered, last verified, speed score (tab-separated)
+
+#define SYNC_VERSION 1 //** Bumped on any change to the formats above
+#define SYNC_HEADER_BYTES 12 //** Magic, version, kind, reserved, entry count
+#define SYNC_CELL_BYTES 16 //** Wire size of one table cell
+
+/**
+ * @brief One table cell. Once the other side is subtracted, a cell with a count of +1 or
+ *        -1 whose check matches its hash XOR holds a single hash of the difference.
+ */
+typedef struct {
+    int32_t count;
+    uint32_t check;
+    uint64_t hash_sum;
+} SyncCell;
+
+/**
+ * @brief A sync_peers entry and the table size its next exchange opens with.
+ */
+typedef struct {
+    char address[SYNC_ADDRESS_SIZE]; //* "host:port"
+    int cells;                      //* Sized for twice the last difference seen with this peer
+} SyncPeer;
+
+/**
+ * @brief Bytes one exchange moved, for its log line.
+ */
+typedef struct {
+    size_t sent;
+    size_t received;
+} SyncTraffic;
+
+static SyncPeer sync_peer_list[SYNC_MAX_PEERS]; //* Main thread only
+static int sync_peer_count = 0;
+static int sync_built = 0;                      //* sync_peer_list reflects sync_built_peers
+static char sync_built_peers[SYNC_MAX_PEERS * SYNC_ADDRESS_SIZE];
+static time_t sync_last_exchange = 0;
+
+//* SplitMix64 finalizer: proxy hashes are FNV-1a, whose low bits are too regular to index by
+static uint64_t sync_mix(uint64_t hash, uint64_t seed) {
+    uint64_t x = hash + seed * 0x9e3779b97f4a7c15ULL;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static int sync_cell_index(uint64_t hash, int table, int cell_count) {
+    int part = cell_count / SYNC_HASH_COUNT;
+    return table * part + (int)(sync_mix(hash, (uint64_t)table + 1) % (uint64_t)part);
+}
+
+//* Adds (delta 1) or removes (delta -1) one hash, in one cell of every sub-table
+static void sync_table_toggle(SyncCell *cells, int cell_count, uint64_t hash, int delta) {
+    uint32_t check = (uint32_t)sync_mix(hash, 0);
+    for (int t = 0; t < SYNC_HASH_COUNT; t++) {
+        SyncCell *cell = &cells[sync_cell_index(hash, t, cell_count)];
+        cell->count += delta;
+        cell->check ^= check;
+        cell->hash_sum ^= hash;
+    }
+}
+
+//* Adds every stored hash with `delta`; no lock, records below total_proxies are complete
+static void sync_table_add_store(SyncCell *cells, int cell_count, int delta) {
+    int current_total = atomic_load(&stats.total_proxies);
+    for (int i = 0; i < current_total; i++)
+        sync_table_toggle(cells, cell_count, proxy_storage[i].hash_value, delta);
+}
+
+static int sync_cell_pure(const SyncCell *cell) {
+    return (cell->count == 1 || cell->count == -1) && cell->check == (uint32_t)sync_mix(cell->hash_sum, 0);
+}
+
+//* Peels a subtracted table (asker minus listener) into the hashes only the asker has
+//* (`theirs`) and only the listener has (`ours`); each array holds cell_count hashes.
+//* Returns 1 when the table emptied, 0 when it was too small for the difference.
+static int sync_table_peel(SyncCell *cells, int cell_count, uint64_t *theirs, int *their_count,
+                           uint64_t *ours, int *our_count) {
+    //* Every peeled hash queues at most SYNC_HASH_COUNT cells, and at most cell_count peel
+    int *pending = malloc(sizeof(int) * (size_t)cell_count * (SYNC_HASH_COUNT + 1));
+    if (!pending)
+        return 0;
+    int depth = 0, found = 0;
+    *their_count = 0;
+    *our_count = 0;
+    for (int c = 0; c < cell_count; c++) {
+        if (sync_cell_pure(&cells[c]))
+            pending[depth++] = c;
+    }
+    while (depth > 0 && found < cell_count) {
+        SyncCell *cell = &cells[pending[--depth]];
+        if (!sync_cell_pure(cell))
+            continue; //* Emptied by an earlier peel
+        uint64_t hash = cell->hash_sum;
+        int side = cell->count;
+        if (side > 0)
+            theirs[(*their_count)++] = hash;
+        else
+            ours[(*our_count)++] = hash;
+        found++;
+        sync_table_toggle(cells, cell_count, hash, -side);
+        for (int t = 0; t < SYNC_HASH_COUNT; t++) {
+            int index = sync_cell_index(hash, t, cell_count);
+            if (sync_cell_pure(&cells[index]))
+                pending[depth++] = index;
+        }
+    }
+    free(pending);
+    for (int c = 0; c < cell_count; c++) {
+        if (cells[c].count != 0 || cells[c].check != 0 || cells[c].hash_sum != 0)
+            return 0;
+    }
+    return 1;
+}
+
+static int compare_sync_hashes(const void *a, const void *b) {
+    uint64_t hash_a = *(const uint64_t *)a, hash_b = *(const uint64_t *)b;
+    return hash_a < hash_b ? -1 : hash_a > hash_b;
+}
+
+//* True when a text body starts "MTPS <SYNC_VERSION> <word>"
+static int sync_text_is(const char *text, const char *word) {
+    char found[16];
+    int version = 0;
+    return sscanf(text, "MTPS %d %15s", &version, found) == 2 && version == SYNC_VERSION && strcmp(found, word) == 0;
+}
+
+static void sync_put_u32(uint8_t *out, uint32_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
+}
+
+static void sync_put_u64(uint8_t *out, uint64_t value) {
+    sync_put_u32(out, (uint32_t)value);
+    sync_put_u32(out + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t sync_get_u32(const uint8_t *in) {
+    return in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+static uint64_t sync_get_u64(const uint8_t *in) {
+    return sync_get_u32(in) | (uint64_t)sync_get_u32(in + 4) << 32;
+}
+
+//* /sync/diff body: a table of the store with `cell_count` cells, or the hash list when
+//* cell_count is 0. Returns NULL when out of memory.
+static uint8_t* sync_encode_diff(int cell_count, size_t *length) {
+    int current_total = atomic_load(&stats.total_proxies);
+    int entries = cell_count > 0 ? cell_count : current_total;
+    *length = SYNC_HEADER_BYTES + (size_t)entries * (cell_count > 0 ? SYNC_CELL_BYTES : sizeof(uint64_t));
+    uint8_t *body = malloc(*length);
+    if (!body)
+        return NULL;
+    memcpy(body, "MTPS", 4);
+    body[4] = SYNC_VERSION;
+    body[5] = cell_count > 0 ? 'I' : 'L';
+    body[6] = body[7] = 0;
+    sync_put_u32(body + 8, (uint32_t)entries);
+    uint8_t *out = body + SYNC_HEADER_BYTES;
+    if (cell_count <= 0) {
+        for (int i = 0; i < current_total; i++, out += sizeof(uint64_t))
+            sync_put_u64(out, proxy_storage[i].hash_value);
+        return body;
+    }
+    SyncCell *cells = calloc(cell_count, sizeof(SyncCell));
+    if (!cells) {
+        free(body);
+        return NULL;
+    }
+    sync_table_add_store(cells, cell_count, 1);
+    for (int c = 0; c < cell_count; c++, out += SYNC_CELL_BYTES) {
+        sync_put_u32(out, (uint32_t)cells[c].count);
+        sync_put_u32(out + 4, cells[c].check);
+        sync_put_u64(out + 8, cells[c].hash_sum);
+    }
+    free(cells);
+    return body;
+}
+
+//* Appends a record line for each stored proxy whose hash is in sorted `hashes`, up to
+//* `limit`. Returns how many were written; a field holding a tab or newline is skipped.
+static int sync_append_records(DynamicBuffer *out, const uint64_t *hashes, int hash_count, int limit) {
+    int written = 0;
+    if (hash_count == 0)
+        return 0;
+    PROFILED_LOCK(&storage_mutex);
+    int current_total = atomic_load(&stats.total_proxies);
+    for (int i = 0; i < current_total && written < limit; i++) {
+        const ProxyRecord *record = &proxy_storage[i];
+        if (!bsearch(&record->hash_value, hashes, hash_count, sizeof(uint64_t), compare_sync_hashes))
+            continue;
+        if (strpbrk(record->server, "\t\n") || strpbrk(record->secret, "\t\n") || strpbrk(record->source, "\t\n"))
+            continue;
+        buffer_printf(out, "%s\t%s\t%s\t%s\t%lld\t%lld\t%d\n", record->server, record->port, record->secret,
+                      record->source, (long long)record->discovery_time, (long long)record->last_verified,
+                      record->speed_score);
+        written++;
+    }
+    PROFILED_UNLOCK(&storage_mutex);
+    return written;
+}
+
+//* Fills `record` from one record line (split in place). Returns 0 unless it holds a valid proxy.
+static int sync_parse_record(char *line, ProxyRecord *record) {
+    char *fields[7];
+    int field_count = 0;
+    char *cursor = line;
+    while (cursor && field_count < 7) {
+        fields[field_count++] = cursor;
+        cursor = strchr(cursor, '\t');
+        if (cursor)
+            *cursor++ = '\0';
+    }
+    if (field_count != 7 || cursor)
+        return 0;
+    if (strlen(fields[0]) >= sizeof(record->server) || strlen(fields[1]) >= sizeof(record->port) ||
+        strlen(fields[2]) >= sizeof(record->secret) || strlen(fields[3]) >= sizeof(record->source) ||
+        !validate_proxy(fields[0], fields[1], fields[2]))
+        return 0;
+
+    memset(record, 0, sizeof(ProxyRecord));
+    strcpy(record->server, fields[0]);
+    strcpy(record->port, fields[1]);
+    strcpy(record->secret, fields[2]);
+    strcpy(record->source, fields[3]);
+    record->hash_value = compute_hash(record->server, record->port, record->secret);
+    record->discovery_time = (time_t)strtoll(fields[4], NULL, 10);
+    record->last_verified = (time_t)strtoll(fields[5], NULL, 10);
+    int score = atoi(fields[6]);
+    record->speed_score = score < 0 ? 0 : score > 100 ? 100 : score;
+    record->active = 1;
+    record->source_index = -1; //* Not reported by any of this node's sources
+    strcpy(record->type, mtp_is_ip(record->server) ? "IPv4" : "Domain");
+    strcpy(record->country, "UN");
+    mtp_format_url(record->connection_url, sizeof(record->connection_url), record->server, record->port,
+                   record->secret);
+    return 1;
+}
+
+//* Commits the next `count` record lines of `*text` and moves it past them.
+//* Returns how many were new here, or -1 when the lines run out early.
+static int sync_commit_records(char **text, int count) {
+    int batch_size = count < 1 ? 1 : MIN(count, PROXY_BATCH_SIZE);
+    ProxyRecord *batch = malloc(sizeof(ProxyRecord) * batch_size);
+    if (!batch)
+        return -1;
+    int filled = 0, added = 0, read = 0;
+    char *cursor = *text;
+    while (read < count) {
+        char *end = strchr(cursor, '\n');
+        if (!end)
+            break;
+        *end = '\0';
+        if (sync_parse_record(cursor, &batch[filled]))
+            filled++;
+        cursor = end + 1;
+        read++;
+        if (filled == batch_size || (read == count && filled > 0)) {
+            added += commit_discovered_proxies(batch, filled, -1);
+            filled = 0;
+        }
+    }
+    free(batch);
+    *text = cursor;
+    return read == count ? added : -1;
+}
+
+//* ---- Listener ----
+
+//* Reads one request: the head into `head` (NUL-terminated), the body into a heap buffer
+//* with a NUL after it. Returns 0, or the HTTP status to refuse the request with.
+static int sync_read_request(int client_fd, char *head, size_t head_size, char **body, size_t *body_length) {
+    char buffer[4096];
+    size_t received = 0, head_length = 0;
+    struct pollfd pfd = { .fd = client_fd, .events = POLLIN };
+    *body = NULL;
+    while (!head_length) {
+        if (received == sizeof(buffer) || poll(&pfd, 1, SYNC_IO_TIMEOUT_MS) != 1)
+            return 400;
+        ssize_t n = recv(client_fd, buffer + received, sizeof(buffer) - received, 0);
+        if (n <= 0)
+            return 400;
+        received += n;
+        for (size_t i = 3; i < received && !head_length; i++) {
+            if (memcmp(buffer + i - 3, "\r\n\r\n", 4) == 0)
+                head_length = i + 1;
+        }
+    }
+    if (head_length >= head_size)
+        return 400;
+    memcpy(head, buffer, head_length);
+    head[head_length] = '\0';
+
+    long long content_length = 0;
+    int expect_continue = 0;
+    for (char *line = strstr(head, "\r\n"); line && line[2] != '\r'; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0)
+            content_length = strtoll(line + 17, NULL, 10);
+        else if (strncasecmp(line + 2, "Expect: 100-continue", 20) == 0)
+            expect_continue = 1;
+    }
+    if (content_length < 0 || content_length > (long long)SYNC_MAX_REQUEST_MB * 1024 * 1024)
+        return 413;
+    *body_length = (size_t)content_length;
+    *body = malloc(*body_length + 1);
+    if (!*body)
+        return 413;
+    size_t filled = MIN(received - head_length, *body_length);
+    memcpy(*body, buffer + head_length, filled);
+    if (expect_continue && filled < *body_length) {
+        static const char proceed[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        send_all(client_fd, proceed, sizeof(proceed) - 1);
+    }
+    while (filled < *body_length) {
+        if (poll(&pfd, 1, SYNC_IO_TIMEOUT_MS) != 1)
+            return 400;
+        ssize_t n = recv(client_fd, *body + filled, *body_length - filled, 0);
+        if (n <= 0)
+            return 400;
+        filled += n;
+    }
+    (*body)[*body_length] = '\0';
+    return 0;
+}
+
+static void sync_reply(int client_fd, int status, const char *body, size_t length) {
+    const char *reason = status == 200 ? "OK" : status == 404 ? "Not Found" :
+                         status == 413 ? "Payload Too Large" : status == 503 ? "Service Unavailable" : "Bad Request";
+    char header[160];
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n"
+                                 "Connection: close\r\n\r\n", status, reason, length);
+    send_all(client_fd, header, header_length);
+    send_all(client_fd, body, length);
+}
+
+//* /sync/diff: works out both halves of the difference and replies with our records the
+//* asker lacks (up to SYNC_MAX_RECORDS) and the hashes we lack
+static void sync_serve_diff(int client_fd, const uint8_t *body, size_t length) {
+    if (length < SYNC_HEADER_BYTES || memcmp(body, "MTPS", 4) != 0 || body[4] != SYNC_VERSION ||
+        (body[5] != 'I' && body[5] != 'L')) {
+        sync_reply(client_fd, 400, "", 0);
+        return;
+    }
+    int is_table = body[5] == 'I';
+    uint32_t entries = sync_get_u32(body + 8);
+    size_t entry_bytes = is_table ? SYNC_CELL_BYTES : sizeof(uint64_t);
+    if ((is_table && (entries < SYNC_HASH_COUNT || entries > SYNC_MAX_CELLS || entries % SYNC_HASH_COUNT != 0)) ||
+        length != SYNC_HEADER_BYTES + (size_t)entries * entry_bytes) {
+        sync_reply(client_fd, 400, "", 0);
+        return;
+    }
+    const uint8_t *in = body + SYNC_HEADER_BYTES;
+    int current_total = atomic_load(&stats.total_proxies);
+    int their_count = 0, our_count = 0, decoded = 1;
+    uint64_t *theirs = malloc(sizeof(uint64_t) * (entries + 1));
+    uint64_t *ours = malloc(sizeof(uint64_t) * ((is_table ? entries : (uint32_t)current_total) + 1));
+    SyncCell *cells = is_table ? malloc(sizeof(SyncCell) * entries) : NULL;
+    uint64_t *stored = is_table ? NULL : malloc(sizeof(uint64_t) * (current_total + 1));
+    if (!theirs || !ours || (is_table ? !cells : !stored)) {
+        sync_reply(client_fd, 503, "", 0);
+        free(theirs);
+        free(ours);
+        free(cells);
+        free(stored);
+        return;
+    }
+
+    if (is_table) {
+        for (uint32_t c = 0; c < entries; c++, in += SYNC_CELL_BYTES) {
+            cells[c].count = (int32_t)sync_get_u32(in);
+            cells[c].check = sync_get_u32(in + 4);
+            cells[c].hash_sum = sync_get_u64(in + 8);
+        }
+        sync_table_add_store(cells, (int)entries, -1);
+        decoded = sync_table_peel(cells, (int)entries, theirs, &their_count, ours, &our_count);
+    } else {
+        //* The full list: both sides sorted, then one merge walk
+        for (uint32_t h = 0; h < entries; h++, in += sizeof(uint64_t))
+            theirs[h] = sync_get_u64(in);
+        for (int i = 0; i < current_total; i++)
+            stored[i] = proxy_storage[i].hash_value;
+        qsort(theirs, entries, sizeof(uint64_t), compare_sync_hashes);
+        qsort(stored, current_total, sizeof(uint64_t), compare_sync_hashes);
+        uint32_t t = 0;
+        int s = 0;
+        while (t < entries || s < current_total) {
+            if (s == current_total || (t < entries && theirs[t] < stored[s])) {
+                theirs[their_count++] = theirs[t++]; //* Compacts in place: their_count <= t
+            } else if (t == entries || stored[s] < theirs[t]) {
+                ours[our_count++] = stored[s++];
+            } else {
+                t++;
+                s++;
+            }
+        }
+    }
+
+    DynamicBuffer reply = {0};
+    if (!decoded) {
+        buffer_printf(&reply, "MTPS %d undecodable\n", SYNC_VERSION);
+    } else {
+        DynamicBuffer records = {0};
+        qsort(ours, our_count, sizeof(uint64_t), compare_sync_hashes);
+        int record_count = sync_append_records(&records, ours, our_count, SYNC_MAX_RECORDS);
+        buffer_printf(&reply, "MTPS %d ok %d %d\n", SYNC_VERSION, record_count, their_count);
+        if (records.size > 0)
+            buffer_printf(&reply, "%.*s", (int)records.size, records.data);
+        for (int h = 0; h < their_count; h++)
+            buffer_printf(&reply, "%016llx\n", (unsigned long long)theirs[h]);
+        free(records.data);
+    }
+    sync_reply(client_fd, 200, reply.data, reply.size);
+    free(reply.data);
+    free(theirs);
+    free(ours);
+    free(cells);
+    free(stored);
+}
+
+//* /sync/push: records the asker found we lack
+static void sync_serve_push(int client_fd, char *body) {
+    int count = 0, consumed = 0;
+    if (!sync_text_is(body, "push") || sscanf(body, "MTPS %*d push %d%n", &count, &consumed) != 1 ||
+        body[consumed] != '\n' || count < 0 || count > SYNC_MAX_RECORDS) {
+        sync_reply(client_fd, 400, "", 0);
+        return;
+    }
+    char *records = body + consumed + 1;
+    int added = sync_commit_records(&records, count);
+    if (added < 0) {
+        sync_reply(client_fd, 400, "", 0);
+        return;
+    }
+    char reply[64];
+    int length = snprintf(reply, sizeof(reply), "MTPS %d added %d\n", SYNC_VERSION, added);
+    sync_reply(client_fd, 200, reply, length);
+}
+
+static void serve_sync_request(int client_fd) {
+    char head[2048];
+    char *body = NULL;
+    size_t body_length = 0;
+    int refused = sync_read_request(client_fd, head, sizeof(head), &body, &body_length);
+    if (refused) {
+        sync_reply(client_fd, refused, "", 0);
+    } else if (strncmp(head, "POST /sync/diff ", 16) == 0) {
+        sync_serve_diff(client_fd, (const uint8_t *)body, body_length);
+    } else if (strncmp(head, "POST /sync/push ", 16) == 0) {
+        sync_serve_push(client_fd, body);
+    } else {
+        sync_reply(client_fd, 404, "", 0);
+    }
+    atomic_fetch_add_explicit(&sync_stats.requests_served, 1, memory_order_relaxed);
+    free(body);
+}
+
+void* sync_server(void *listen_data) {
+    int listen_fd = (int)(intptr_t)listen_data;
+    trace_set_thread_label("sync");
+    while (atomic_load(&program_active)) {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 1000) != 1)
+            continue;
+        int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0)
+            continue;
+        serve_sync_request(client_fd);
+        close(client_fd);
+    }
+    close(listen_fd);
+    return NULL;
+}
+
+void start_sync_server() {
+    if (run_options.sync_port == 0 || virtual_clock_enabled)
+        return;
+    int listen_fd = open_listener("Sync endpoint", run_options.sync_bind_address, run_options.sync_port);
+    if (listen_fd < 0)
+        return;
+    if (pthread_create(&sync_thread, NULL, sync_server, (void *)(intptr_t)listen_fd) == 0) {
+        sync_thread_started = 1;
+        log_message(LOG_LEVEL_INFO, "Sync endpoint: %s:%d", run_options.sync_bind_address, run_options.sync_port);
+    } else {
+        close(listen_fd);
+    }
+}
+
+void stop_sync_server() {
+    if (sync_thread_started) {
+        pthread_join(sync_thread, NULL);
+        sync_thread_started = 0;
+    }
+}
+
+//* ---- Asking peers ----
+
+//* Splits a sync_peers value into "host:port" addresses. Returns the count, or -1 with `problem` set.
+static int sync_parse_peers(const char *list, SyncPeer *peers, const char **problem) {
+    int count = 0;
+    const char *cursor = list;
+    while (*cursor) {
+        size_t length = strcspn(cursor, ",");
+        const char *address = cursor;
+        cursor += length + (cursor[length] == ',');
+        while (length > 0 && isspace((unsigned char)*address))
+            address++, length--;
+        while (length > 0 && isspace((unsigned char)address[length - 1]))
+            length--;
+        if (length == 0)
+            continue;
+        if (length >= SYNC_ADDRESS_SIZE) {
+            *problem = "peer address too long";
+            return -1;
+        }
+        const char *colon = memchr(address, ':', length);
+        size_t host_length = colon ? (size_t)(colon - address) : 0;
+        long port = 0;
+        for (size_t i = host_length + 1; colon && i < length && port <= 65535; i++)
+            port = isdigit((unsigned char)address[i]) ? port * 10 + (address[i] - '0') : 65536;
+        if (host_length == 0 || port < 1 || port > 65535) {
+            *problem = "peers must be written host:port";
+            return -1;
+        }
+        for (size_t i = 0; i < host_length; i++) {
+            if (!isalnum((unsigned char)address[i]) && address[i] != '-' && address[i] != '.') {
+                *problem = "peer host names may only use letters, digits, '-' and '.'";
+                return -1;
+            }
+        }
+        if (count == SYNC_MAX_PEERS) {
+            *problem = "too many sync peers";
+            return -1;
+        }
+        memcpy(peers[count].address, address, length);
+        peers[count].address[length] = '\0';
+        peers[count].cells = SYNC_MIN_CELLS;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(peers[i].address, peers[count].address) == 0) {
+                *problem = "peer listed twice";
+                return -1;
+            }
+        }
+        count++;
+    }
+    return count;
+}
+
+//* Checks sync_peers. Returns NULL, or why it cannot be used.
+const char* sync_validate(const RunOptions *options) {
+    static SyncPeer peers[SYNC_MAX_PEERS]; //* Main thread only
+    const char *problem = NULL;
+    if (options->sync_peers && sync_parse_peers(options->sync_peers, peers, &problem) < 0)
+        return problem;
+    return NULL;
+}
+
+//* Startup and post-reload hook: re-reads sync_peers when it changed; peers that stay
+//* listed keep their table size
+void sync_update() {
+    const char *list = run_options.sync_peers ? run_options.sync_peers : "";
+    if (sync_built && strcmp(sync_built_peers, list) == 0)
+        return;
+    sync_built = 1;
+    snprintf(sync_built_peers, sizeof(sync_built_peers), "%s", list);
+    if (virtual_clock_enabled) {
+        if (*list)
+            log_message(LOG_LEVEL_WARN, "Sync: sync_peers ignored under --simulate (virtual clock)");
+        sync_peer_count = 0;
+        return;
+    }
+    SyncPeer peers[SYNC_MAX_PEERS];
+    const char *problem = NULL;
+    int count = sync_parse_peers(list, peers, &problem);
+    if (count < 0)
+        count = 0; //* Validated already
+    for (int p = 0; p < count; p++) {
+        for (int old = 0; old < sync_peer_count; old++) {
+            if (strcmp(sync_peer_list[old].address, peers[p].address) == 0)
+                peers[p].cells = sync_peer_list[old].cells;
+        }
+    }
+    memcpy(sync_peer_list, peers, sizeof(SyncPeer) * count);
+    sync_peer_count = count;
+    if (count > 0)
+        log_message(LOG_LEVEL_INFO, "Sync: reconciling with %d peer%s every %d seconds", count, count == 1 ? "" : "s",
+                    run_options.sync_interval);
+}
+
+static size_t sync_write_callback(void *content, size_t element_size, size_t element_count, void *user_buffer) {
+    size_t total_size = element_size * element_count;
+    DynamicBuffer *buffer = (DynamicBuffer *)user_buffer;
+    if (buffer->size + total_size + 1 > (size_t)SYNC_MAX_REQUEST_MB * 1024 * 1024)
+        return 0;
+    if (buffer->size + total_size + 1 > buffer->capacity) {
+        size_t new_capacity = (buffer->size + total_size + 1) * 2;
+        char *new_data = realloc(buffer->data, new_capacity);
+        if (!new_data)
+            return 0;
+        buffer->data = new_data;
+        buffer->capacity = new_capacity;
+    }
+    memcpy(buffer->data + buffer->size, content, total_size);
+    buffer->size += total_size;
+    buffer->data[buffer->size] = '\0';
+    return total_size;
+}
+
+//* POSTs `body` to a peer. Returns 1 with the NUL-terminated reply in `reply` on HTTP 200.
+static int sync_post(const SyncPeer *peer, const char *path, const void *body, size_t length,
+                     DynamicBuffer *reply, SyncTraffic *traffic) {
+    CURL *curl = curl_easy_init();
+    if (!curl)
+        return 0;
+    char url[SYNC_ADDRESS_SIZE + 32];
+    snprintf(url, sizeof(url), "http://%s%s", peer->address, path);
+    struct curl_slist *headers = curl_slist_append(NULL, "Content-Type: application/octet-stream");
+    headers = curl_slist_append(headers, "Expect:"); //* Send the body without waiting for 100 Continue
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)length);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)run_options.connection_timeout);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)run_options.connect_timeout);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, sync_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, reply);
+    reply->size = 0;
+    CURLcode result = curl_easy_perform(curl);
+    long http_status = 0;
+    if (result == CURLE_OK)
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_status);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    traffic->sent += length;
+    traffic->received += reply->size;
+    atomic_fetch_add_explicit(&sync_stats.bytes_sent, length, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sync_stats.bytes_received, reply->size, memory_order_relaxed);
+    if (result != CURLE_OK) {
+        log_message(LOG_LEVEL_WARN, "Sync: %s%s: %s", peer->address, path, curl_easy_strerror(result));
+        return 0;
+    }
+    if (http_status != 200 || !reply->data) {
+        log_message(LOG_LEVEL_WARN, "Sync: %s%s: HTTP %ld", peer->address, path, http_status);
+        return 0;
+    }
+    return 1;
+}
+
+//* One reconciliation with `peer`: the table doubles until the difference peels (or until
+//* the plain hash list is smaller), then each side gets the records it lacks. Returns 1 on
+//* success.
+static int sync_exchange(SyncPeer *peer) {
+    uint64_t start_ns = monotonic_ns();
+    SyncTraffic traffic = {0, 0};
+    DynamicBuffer reply = {0};
+    int cells = peer->cells, rounds = 0, agreed = 0;
+    while (atomic_load(&program_active)) {
+        //* A table no smaller than our own hash list buys nothing: send the list instead
+        size_t length = 0;
+        int send_list = cells > SYNC_MAX_CELLS ||
+                        (size_t)cells * SYNC_CELL_BYTES >= (size_t)atomic_load(&stats.total_proxies) * sizeof(uint64_t);
+        uint8_t *request = sync_encode_diff(send_list ? 0 : cells, &length);
+        if (!request)
+            break;
+        rounds++;
+        atomic_fetch_add_explicit(&sync_stats.sketches, 1, memory_order_relaxed);
+        int posted = sync_post(peer, "/sync/diff", request, length, &reply, &traffic);
+        free(request);
+        if (!posted)
+            break;
+        if (sync_text_is(reply.data, "undecodable") && !send_list) {
+            cells *= 2;
+            continue;
+        }
+        agreed = 1;
+        break;
+    }
+
+    int record_count = 0, hash_count = 0, consumed = 0, received = -1, pushed = 0;
+    if (agreed && (!sync_text_is(reply.data, "ok") ||
+                   sscanf(reply.data, "MTPS %*d ok %d %d%n", &record_count, &hash_count, &consumed) != 2 ||
+                   reply.data[consumed] != '\n' || record_count < 0 || hash_count < 0)) {
+        log_message(LOG_LEVEL_WARN, "Sync: %s: unexpected reply", peer->address);
+        agreed = 0;
+    }
+    if (agreed) {
+        char *cursor = reply.data + consumed + 1;
+        received = sync_commit_records(&cursor, record_count);
+        uint64_t *wanted = malloc(sizeof(uint64_t) * (hash_count + 1));
+        int wanted_count = 0;
+        while (received >= 0 && wanted && wanted_count < hash_count) {
+            char *end = NULL;
+            wanted[wanted_count] = strtoull(cursor, &end, 16);
+            if (end == cursor || *end != '\n')
+                break;
+            wanted_count++;
+            cursor = end + 1;
+        }
+        if (received < 0 || !wanted || wanted_count < hash_count) {
+            log_message(LOG_LEVEL_WARN, "Sync: %s: truncated reply", peer->address);
+            agreed = 0;
+        } else if (wanted_count > 0) {
+            DynamicBuffer records = {0};
+            qsort(wanted, wanted_count, sizeof(uint64_t), compare_sync_hashes);
+            int record_lines = sync_append_records(&records, wanted, wanted_count, SYNC_MAX_RECORDS);
+            DynamicBuffer push = {0};
+            buffer_printf(&push, "MTPS %d push %d\n", SYNC_VERSION, record_lines);
+            if (records.size > 0)
+                buffer_printf(&push, "%.*s", (int)records.size, records.data);
+            free(records.data);
+            if (!sync_post(peer, "/sync/push", push.data, push.size, &reply, &traffic) ||
+                !sync_text_is(reply.data, "added") || sscanf(reply.data, "MTPS %*d added %d", &pushed) != 1) {
+                agreed = 0;
+            }
+            free(push.data);
+        }
+        free(wanted);
+        //* Size the next table for twice this difference, so it usually peels first time
+        int difference = record_count + hash_count;
+        peer->cells = SYNC_MIN_CELLS;
+        while (peer->cells < 2 * difference && peer->cells < SYNC_MAX_CELLS)
+            peer->cells *= 2;
+    }
+    free(reply.data);
+
+    if (!agreed) {
+        atomic_fetch_add_explicit(&sync_stats.failures, 1, memory_order_relaxed);
+        return 0;
+    }
+    atomic_fetch_add_explicit(&sync_stats.exchanges, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sync_stats.proxies_received, received, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sync_stats.proxies_sent, pushed, memory_order_relaxed);
+    log_message(LOG_LEVEL_INFO, "Sync: %s: %d round%s, %zu bytes sent, %zu received; %d new here, %d new there (%.0f ms)",
+                peer->address, rounds, rounds == 1 ? "" : "s", traffic.sent, traffic.received, received, pushed,
+                (monotonic_ns() - start_ns) / 1e6);
+    return 1;
+}
+
+//* Main loop hook: reconciles with every peer once sync_interval has passed
+void sync_poll() {
+    if (sync_peer_count == 0 || difftime(mtp_time(), sync_last_exchange) < run_options.sync_interval)
+        return;
+    TRACE_BEGIN("sync", TRACE_ARG_NONE, 0);
+    for (int p = 0; p < sync_peer_count && atomic_load(&program_active); p++)
+        sync_exchange(&sync_peer_list[p]);
+    TRACE_END("sync", TRACE_ARG_NONE, 0);
+    sync_last_exchange = mtp_time();
+}
+
+//* =============== PIPELINE: STAGES ===============
+//* Each stage's threads pop from its queue, reserve a cell in the next stage's queue, then
+//* process. In-flight bodies are bounded by the fetch threads plus queue_depth per queue;
+//* export runs beside the per-source path so a save overlaps the next cycle. Stage sizes
+//* and queue bounds change only while the pipeline is drained (start, reload, stop).
+
+//* Marks an item finished (committed, failed or dropped) and frees what it still holds
+static void pipeline_item_done(PipelineItem *item) {
+    release_body(&item->body);
+    release_proxy_batch(item->batch, item->batch_count);
+    free(item->task->url);
+    free(item->task);
+    free(item);
+    atomic_fetch_sub(&stats.active_workers, 1);
+    if (atomic_fetch_sub(&pipeline_outstanding, 1) == 1) {
+        pthread_mutex_lock(&pipeline_idle_mutex);
+        pthread_cond_broadcast(&pipeline_idle_cond);
+        pthread_mutex_unlock(&pipeline_idle_mutex);
+    }
+}
+
+static int pipeline_fetch_item(void *value) {
+    PipelineItem *item = (PipelineItem *)value;
+    if (atomic_load(&program_active) && run_options.throttle) {
+        TRACE_BEGIN("throttle_delay", TRACE_ARG_NONE, 0);
+        random_delay();
+        TRACE_END("throttle_delay", TRACE_ARG_NONE, 0);
+    }
+    if (!fetch_transfer(item->task->url, item->task->source_index, 1, &item->body, &item->encoding)) {
+        pipeline_item_done(item);
+        return 0;
+    }
+    return 1;
+}
+
+static int pipeline_decode_item(void *value) {
+    PipelineItem *item = (PipelineItem *)value;
+    if (!atomic_load(&program_active) || !decode_body(&item->body, item->encoding, item->task->source_index)) {
+        pipeline_item_done(item);
+        return 0;
+    }
+    note_decoded_body(&item->body, item->task->source_index);
+    return 1;
+}
+
+static int pipeline_extract_item(void *value) {
+    PipelineItem *item = (PipelineItem *)value;
+    item->batch_count = extract_proxy_batch(item->body.data, item->body.size, item->task->url,
+                                            item->task->source_index, &item->batch);
+    release_body(&item->body); //* Only the batch travels on
+    if (item->batch_count == 0) {
+        pipeline_item_done(item);
         return 0;
+    }
+    return 1;
+}
+
+static int pipeline_commit_item(void *value) {
+    PipelineItem *item = (PipelineItem *)value;
+    commit_discovered_proxies(item->batch, item->batch_count, item->task->source_index);
+    pipeline_item_done(item);
+    return 0;
+}
+
+static int pipeline_export(void *value) {
+    (void)value;
+    save_proxies_to_json();
+    pthread_mutex_lock(&pipeline_idle_mutex);
+    atomic_fetch_sub(&pipeline_export_pending, 1);
+    pthread_cond_broadcast(&pipeline_idle_cond);
+    pthread_mutex_unlock(&pipeline_idle_mutex);
+    return 0;
+}
+
+//* Worker argument: stage * MAX_THREAD_COUNT + slot
+static void* pipeline_stage_worker(void *worker_data) {
+    int stage_id = (int)(intptr_t)worker_data / MAX_THREAD_COUNT;
+    int slot = (int)(intptr_t)worker_data % MAX_THREAD_COUNT;
+    PipelineStage *stage = &pipeline_stages[stage_id];
+    trace_set_thread_label(PIPELINE_STAGE_NAMES[stage_id]);
+    
+    void *value;
+    while ((value = pipeline_queue_pop(&pipeline_queues[stage_id])) != NULL) {
+        if (stage->output)
+            pipeline_queue_reserve(stage->output); //* Backpressure: wait here, before taking on more work
+        atomic_fetch_add_explicit(&stage->busy, 1, memory_order_relaxed);
+        uint64_t start = monotonic_ns();
+        int forward = stage->process(value); //* `value` may be freed unless forwarded
+        atomic_fetch_add_explicit(&stage->busy_ns, monotonic_ns() - start, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stage->items, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&stage->busy, 1, memory_order_relaxed);
+        if (stage->output) {
+            if (forward)
+                pipeline_queue_push(stage->output, value);
+            else
+                pipeline_queue_cancel(stage->output);
+        }
+    }
+    //* Stop pill: tell pipeline_resize_stage() which slot to join
+    pthread_mutex_lock(&pipeline_idle_mutex);
+    stage->exited[stage->exited_count++] = slot;
+    pthread_cond_broadcast(&pipeline_idle_cond);
+    pthread_mutex_unlock(&pipeline_idle_mutex);
+    return NULL;
+}
+
+//* Grows or shrinks stage `s` to `count` threads. Shrinking queues one stop pill per extra
+//* thread behind whatever the stage still has to do and joins the threads that take them.
+//* Returns the number of threads running afterwards.
+static int pipeline_resize_stage(int s, int count) {
+    PipelineStage *stage = &pipeline_stages[s];
+    int current = atomic_load(&stage->threads);
+    uint64_t now = monotonic_ns();
+    atomic_fetch_add(&stage->thread_ns, (uint64_t)current * (now - atomic_load(&stage->resized_ns)));
+    atomic_store(&stage->resized_ns, now);
+    
+    for (int t = 0; t < MAX_THREAD_COUNT && current < count; t++) {
+        if (stage->running[t])
+            continue;
+        if (pthread_create(&stage->workers[t], NULL, pipeline_stage_worker,
+                           (void *)(intptr_t)(s * MAX_THREAD_COUNT + t)) != 0) {
+            log_message(LOG_LEVEL_ERROR, "Cannot start %s thread %d of %d", PIPELINE_STAGE_NAMES[s], current + 1, count);
+            break;
+        }
+        stage->running[t] = 1;
+        atomic_store(&stage->threads, ++current);
+    }
+    
+    if (current > count) {
+        int stopping = current - count;
+        for (int i = 0; i < stopping; i++) {
+            pipeline_queue_reserve(&pipeline_queues[s]);
+            pipeline_queue_push(&pipeline_queues[s], NULL);
+        }
+        int exited[MAX_THREAD_COUNT];
+        pthread_mutex_lock(&pipeline_idle_mutex);
+        while (stage->exited_count < stopping)
+            pthread_cond_wait(&pipeline_idle_cond, &pipeline_idle_mutex);
+        memcpy(exited, stage->exited, sizeof(int) * stopping);
+        stage->exited_count = 0;
+        pthread_mutex_unlock(&pipeline_idle_mutex);
+        for (int i = 0; i < stopping; i++) {
+            pthread_join(stage->workers[exited[i]], NULL);
+            stage->running[exited[i]] = 0;
+        }
+        current = count;
+        atomic_store(&stage->threads, current);
+    }
+    return current;
+}
+
+//* Sizes every stage and queue from run_options. Called with the pipeline drained (no item
+//* between stages, no output cell reserved). Returns 0 when a stage ended up without threads.
+int pipeline_configure() {
+    int extract_threads = run_options.extract_threads;
+    if (extract_threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        extract_threads = online < 1 ? 1 : online > MAX_THREAD_COUNT ? MAX_THREAD_COUNT : (int)online;
+    }
+    const int threads[PIPELINE_STAGE_COUNT] = { run_options.concurrency, run_options.decode_threads, extract_threads,
+                                                run_options.commit_threads, 1 };
+    //* A producer holds its output cell while working, so each queue also covers its producers
+    for (int s = PIPELINE_DECODE; s <= PIPELINE_COMMIT; s++)
+        pipeline_queue_set_bound(&pipeline_queues[s], threads[s - 1] + run_options.queue_depth);
+    
+    int complete = 1;
+    for (int s = 0; s < PIPELINE_STAGE_COUNT; s++) {
+        if (pipeline_resize_stage(s, threads[s]) == 0)
+            complete = 0;
+    }
+    log_message(LOG_LEVEL_INFO, "Pipeline: %d fetch, %d decode, %d extract, %d commit threads, queue depth %d",
+                atomic_load(&pipeline_stages[PIPELINE_FETCH].threads), atomic_load(&pipeline_stages[PIPELINE_DECODE].threads),
+                atomic_load(&pipeline_stages[PIPELINE_EXTRACT].threads), atomic_load(&pipeline_stages[PIPELINE_COMMIT].threads),
+                run_options.queue_depth);
+    return complete;
+}
+
+//* Stops every stage in pipeline order (so each drains what the previous one forwarded)
+//* and frees the rings. Counters stay readable for the final report.
+void pipeline_stop() {
+    if (!pipeline_started)
+        return;
+    for (int s = 0; s < PIPELINE_STAGE_COUNT; s++)
+        pipeline_resize_stage(s, 0);
+    for (int s = 0; s < PIPELINE_STAGE_COUNT; s++)
+        pipeline_queue_destroy(&pipeline_queues[s]);
+    pipeline_started = 0;
+}
+
+//* Creates the queues and starts every stage. Returns 0, with whatever had started
+//* stopped again, when a queue or thread cannot be created.
+int pipeline_start() {
+    static int (*const processors[PIPELINE_STAGE_COUNT])(void *) = {
+        pipeline_fetch_item, pipeline_decode_item, pipeline_extract_item, pipeline_commit_item, pipeline_export
+    };
+    //* Stage queues get their bounds from pipeline_configure(); the export queue holds one
+    //* save waiting at most, later requests coalesce into it
+    const int capacities[PIPELINE_STAGE_COUNT] = { URL_CAPACITY, MAX_THREAD_COUNT + PIPELINE_MAX_QUEUE_DEPTH,
+                                                   MAX_THREAD_COUNT + PIPELINE_MAX_QUEUE_DEPTH,
+                                                   MAX_THREAD_COUNT + PIPELINE_MAX_QUEUE_DEPTH, 1 };
+    const int bounds[PIPELINE_STAGE_COUNT] = { URL_CAPACITY, 1, 1, 1, 1 };
     
-    CURL *curl_handle = setup_curl_handle();
-    if (!curl_handle) {
-        atomic_fetch_add(&stats.network_errors, 1);
+    for (int s = 0; s < PIPELINE_STAGE_COUNT; s++) {
+        if (!pipeline_queue_init(&pipeline_queues[s], capacities[s], bounds[s])) {
+            log_message(LOG_LEVEL_ERROR, "Memory allocation failed for the %s queue", PIPELINE_STAGE_NAMES[s]);
+            for (int q = 0; q < s; q++)
+                pipeline_queue_destroy(&pipeline_queues[q]);
+            return 0;
+        }
+    }
+    pipeline_started = 1;
+    pipeline_start_ns = monotonic_ns();
+    for (int s = 0; s < PIPELINE_STAGE_COUNT; s++) {
+        PipelineStage *stage = &pipeline_stages[s];
+        stage->process = processors[s];
+        stage->output = s < PIPELINE_COMMIT ? &pipeline_queues[s + 1] : NULL;
+        atomic_store(&stage->resized_ns, pipeline_start_ns);
+    }
+    if (!pipeline_configure()) {
+        pipeline_stop();
+        return 0;
+    }
+    return 1;
+}
+
+//* Hands one scheduled source to the fetch stage
+void pipeline_submit(DownloadTask *task) {
+    PipelineItem *item = calloc(1, sizeof(PipelineItem));
+    if (!item) {
+        free(task->url);
+        free(task);
+        return;
+    }
+    item->task = task;
+    atomic_fetch_add(&stats.active_workers, 1);
+    atomic_fetch_add(&pipeline_outstanding, 1);
+    pipeline_queue_reserve(&pipeline_queues[PIPELINE_FETCH]);
+    pipeline_queue_push(&pipeline_queues[PIPELINE_FETCH], item);
+}
+
+//* Blocks until every submitted source has been committed or dropped
+void pipeline_wait_drained() {
+    pthread_mutex_lock(&pipeline_idle_mutex);
+    while (atomic_load(&pipeline_outstanding) > 0)
+        pthread_cond_wait(&pipeline_idle_cond, &pipeline_idle_mutex);
+    pthread_mutex_unlock(&pipeline_idle_mutex);
+}
+
+//* Queues a save for the export thread. Returns 0 when one is already waiting to start,
+//* which will see the same store anyway.
+int pipeline_request_export() {
+    if (!pipeline_queue_try_reserve(&pipeline_queues[PIPELINE_EXPORT]))
         return 0;
+    atomic_fetch_add(&pipeline_export_pending, 1);
+    pipeline_queue_push(&pipeline_queues[PIPELINE_EXPORT], &pipeline_export_request);
+    return 1;
+}
+
+//* Blocks until no save is queued or running (verification and trace dumps need the export idle)
+void pipeline_wait_export() {
+    pthread_mutex_lock(&pipeline_idle_mutex);
+    while (atomic_load(&pipeline_export_pending) > 0)
+        pthread_cond_wait(&pipeline_idle_cond, &pipeline_idle_mutex);
+    pthread_mutex_unlock(&pipeline_idle_mutex);
+}
+
+//* Feeds one cycle's schedule to the fetch stage and waits for the cycle to drain
+void pipeline_run_cycle(const int *schedule, int scheduled_count) {
+    TRACE_BEGIN("submit", TRACE_ARG_COUNT, scheduled_count);
+    for (int i = 0; i < scheduled_count && atomic_load(&program_active); i++) {
+        DownloadTask *task = new_download_task(schedule[i]);
+        if (task)
+            pipeline_submit(task);
+        if (run_options.throttle)
+            mtp_sleep_ns((10000 + rand() % 15000) * 1000ULL); //* Spread transfer starts
     }
+    TRACE_END("submit", TRACE_ARG_COUNT, scheduled_count);
     
-    DynamicBuffer content_buffer = {0};
-    content_buffer.capacity = 1 * 1024 * 1024; //* 1MB initial
-    content_buffer.data = malloc(content_buffer.capacity);
-    if (!content_buffer.data) {
-        curl_easy_cleanup(curl_handle);
+    TRACE_BEGIN("drain", TRACE_ARG_COUNT, scheduled_count);
+    pipeline_wait_drained();
+    TRACE_END("drain", TRACE_ARG_COUNT, scheduled_count);
+}
+
+//* =============== DAEMON: DETACH + LOG FILE ===============
+//* --daemon detaches before any thread starts: stdin reads /dev/null and stdout/stderr
+//* (console statistics and the log writer) append to log_file. A SIGHUP reopens the
+//* file, so logrotate can move it away.
+
+static const char *daemon_log_path = NULL; //* Set once detached
+
+//* Points stdout and stderr at `path`, appending. Returns 0 when it cannot be opened.
+static int daemon_redirect_output(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return 0;
+    fflush(stdout);
+    fflush(stderr);
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    return 1;
+}
+
+//* Forks into the background and writes pid_file. Returns 0, still attached, when the log
+//* file cannot be opened or the fork fails.
+int daemonize_process() {
+    const char *log_path = run_options.log_file ? run_options.log_file : DAEMON_LOG_FILE;
+    int log_check = open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_check < 0) {
+        fprintf(stderr, "Cannot open log file %s: %s\n", log_path, strerror(errno));
+        return 0;
+    }
+    close(log_check);
+    fflush(stdout);
+    //* Keep the working directory: every output file is relative to it
+    if (daemon(1, 0) != 0) {
+        fprintf(stderr, "Cannot detach: %s\n", strerror(errno));
         return 0;
     }
-    content_buffer.data[0] = '\0';
+    daemon_redirect_output(log_path);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    daemon_log_path = log_path;
     
-    curl_easy_setopt(curl_handle, CURLOPT_URL, url);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &content_buffer);
-    
-    atomic_fetch_add(&stats.total_requests, 1);
-    log_message("Fetching: %s", url);
-    
-    double start_time = (double)clock() / CLOCKS_PER_SEC;
-    CURLcode result = curl_easy_perform(curl_handle);
-    double end_time = (double)clock() / CLOCKS_PER_SEC;
-    
-    int success = 0;
-    
-    if (result == CURLE_OK && content_buffer.size > 0) {
-        long http_status = 0;
-        curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &http_status);
-        
-        if (http_status == 200) {
-            atomic_fetch_add(&stats.total_bytes, content_buffer.size);
-            extract_proxies_from_content(content_buffer.data, content_buffer.size, url);
-            success = 1;
-            atomic_fetch_add(&stats.processed_urls, 1);
-            log_message("Success: %s (%zu bytes, %.2f seconds)", url, content_buffer.size, end_time - start_time);
+    if (run_options.pid_file) {
+        FILE *pid_file = fopen(run_options.pid_file, "w");
+        if (pid_file) {
+            fprintf(pid_file, "%ld\n", (long)getpid());
+            fclose(pid_file);
         } else {
-            log_message("HTTP %ld: %s", http_status, url);
-            atomic_fetch_add(&stats.network_errors, 1);
+            fprintf(stderr, "Cannot write pid file %s: %s\n", run_options.pid_file, strerror(errno));
         }
-    } else {
-        log_message("CURL error %d: %s", result, url);
-        atomic_fetch_add(&stats.network_errors, 1);
     }
-    
-    if (content_buffer.data) 
-        free(content_buffer.data);
-    
-    curl_easy_cleanup(curl_handle);
-    
-    return success;
+    return 1;
 }
-//* =============== THREAD WORKER ===============
-//* Entry point for each download thread
-void* url_worker(void *task_data) {
-    DownloadTask *task = (DownloadTask *)task_data;
-    
-    if (atomic_load(&program_active) && task && task->url) {
-        random_delay();
-        fetch_url_content(task->url);
+
+//* SIGHUP: reopens the log file in case it was rotated
+void daemon_reopen_log() {
+    if (!daemon_log_path)
+        return;
+    PROFILED_LOCK(&log_mutex);
+    log_drain_locked();
+    int reopened = daemon_redirect_output(daemon_log_path);
+    PROFILED_UNLOCK(&log_mutex);
+    if (!reopened)
+        log_message(LOG_LEVEL_WARN, "Cannot reopen log file %s: %s", daemon_log_path, strerror(errno));
+}
+
+void daemon_cleanup() {
+    if (daemon_log_path && run_options.pid_file)
+        unlink(run_options.pid_file);
+}
+
+//* =============== CONFIG: RUNTIME FILE + RELOAD ===============
+//* --config FILE sets any RunOptions field with "key = value" lines ('#' starts a comment,
+//* values may be double-quoted). The whole file is validated before anything is applied:
+//* at startup a bad line exits, on SIGHUP it leaves the running settings alone. A reload
+//* is applied at the next cycle boundary (or within a second during the pause) with the
+//* pipeline drained and no export running, which is why workers can read run_options
+//* without locks. Keys removed from the file keep their current value, and a setting
+//* given as a command-line flag keeps the flag's value across reloads.
+
+typedef enum {
+    CONFIG_INT,
+    CONFIG_DOUBLE,
+    CONFIG_BOOL,
+    CONFIG_STRING,
+    CONFIG_LOG_LEVEL
+} ConfigType;
+
+/**
+ * @brief One config file key: the RunOptions field it sets and the values it accepts.
+ */
+typedef struct {
+    const char *key;
+    ConfigType type;
+    size_t offset;      //* Into RunOptions
+    double min, max;   //* Inclusive range of CONFIG_INT and CONFIG_DOUBLE values
+    int reloadable;   //* 0: read at startup only; a changed value on SIGHUP is reported and ignored
+} ConfigKey;
+
+#define CONFIG_FIELD(name) offsetof(RunOptions, name)
+
+static const ConfigKey CONFIG_KEYS[] = {
+    {"concurrency", CONFIG_INT, CONFIG_FIELD(concurrency), 1, MAX_THREAD_COUNT, 1},
+    {"decode_threads", CONFIG_INT, CONFIG_FIELD(decode_threads), 1, MAX_THREAD_COUNT, 1},
+    {"extract_threads", CONFIG_INT, CONFIG_FIELD(extract_threads), 0, MAX_THREAD_COUNT, 1},
+    {"commit_threads", CONFIG_INT, CONFIG_FIELD(commit_threads), 1, MAX_THREAD_COUNT, 1},
+    {"queue_depth", CONFIG_INT, CONFIG_FIELD(queue_depth), 1, PIPELINE_MAX_QUEUE_DEPTH, 1},
+    {"cycles", CONFIG_INT, CONFIG_FIELD(max_cycles), 0, INT_MAX, 1},
+    {"cycle_pause", CONFIG_INT, CONFIG_FIELD(cycle_pause), 0, 86400, 1},
+    {"save_interval", CONFIG_INT, CONFIG_FIELD(save_interval), 1, 86400, 1},
+    {"stats_interval", CONFIG_INT, CONFIG_FIELD(stats_interval), 1, 86400, 1},
+    {"throttle", CONFIG_BOOL, CONFIG_FIELD(throttle), 0, 1, 1},
+    {"rotation_delay_ms", CONFIG_INT, CONFIG_FIELD(rotation_delay_ms), 1, 60000, 1},
+    {"connection_timeout", CONFIG_INT, CONFIG_FIELD(connection_timeout), 1, 3600, 1},
+    {"connect_timeout", CONFIG_INT, CONFIG_FIELD(connect_timeout), 1, 600, 1},
+    {"max_body_mb", CONFIG_INT, CONFIG_FIELD(max_body_mb), 1, BODY_CAPACITY_LIMIT_MB, 1},
+    {"probe_budget", CONFIG_INT, CONFIG_FIELD(probe_budget), 0, PROBE_BUDGET_LIMIT, 1},
+    {"probe_threads", CONFIG_INT, CONFIG_FIELD(probe_threads), 1, MAX_THREAD_COUNT, 1},
+    {"probe_timeout_ms", CONFIG_INT, CONFIG_FIELD(probe_timeout_ms), 100, 60000, 1},
+    {"probe_refresh_interval", CONFIG_INT, CONFIG_FIELD(probe_refresh_interval), 60, 30 * 86400, 1},
+    {"reputation_min_samples", CONFIG_INT, CONFIG_FIELD(reputation_min_samples), 1, 1000000, 1},
+    {"reputation_throttle_score", CONFIG_DOUBLE, CONFIG_FIELD(reputation_throttle_score), 0.01, 1.0, 1},
+    {"reputation_max_skip", CONFIG_INT, CONFIG_FIELD(reputation_max_skip), 2, 1000, 1},
+    {"history_retention_days", CONFIG_INT, CONFIG_FIELD(history_retention_days), 1, 3650, 1},
+    {"memory_budget_mb", CONFIG_INT, CONFIG_FIELD(memory_budget_mb), 0, 1 << 20, 1},
+    {"memory_high_water", CONFIG_DOUBLE, CONFIG_FIELD(memory_high_water), 0.05, 1.0, 1},
+    {"log_level", CONFIG_LOG_LEVEL, CONFIG_FIELD(log_level), 0, 0, 1},
+    {"log_found_proxy_sample", CONFIG_INT, CONFIG_FIELD(log_found_proxy_sample), 1, 1000000, 1},
+    {"cycle_report", CONFIG_STRING, CONFIG_FIELD(cycle_report), 0, 0, 1},
+    {"shard_nodes", CONFIG_STRING, CONFIG_FIELD(shard_nodes), 0, 0, 1},
+    {"shard_node", CONFIG_STRING, CONFIG_FIELD(shard_node), 0, 0, 1},
+    {"shard_dir", CONFIG_STRING, CONFIG_FIELD(shard_dir), 0, 0, 1},
+    {"sync_peers", CONFIG_STRING, CONFIG_FIELD(sync_peers), 0, 0, 1},
+    {"sync_interval", CONFIG_INT, CONFIG_FIELD(sync_interval), 1, 86400, 1},
+    {"proxy_capacity", CONFIG_INT, CONFIG_FIELD(proxy_capacity), 1, 100000000, 0},
+    {"metrics_port", CONFIG_INT, CONFIG_FIELD(metrics_port), 0, 65535, 0},
+    {"metrics_bind_address", CONFIG_STRING, CONFIG_FIELD(metrics_bind_address), 0, 0, 0},
+    {"sync_port", CONFIG_INT, CONFIG_FIELD(sync_port), 0, 65535, 0},
+    {"sync_bind_address", CONFIG_STRING, CONFIG_FIELD(sync_bind_address), 0, 0, 0},
+    {"sources", CONFIG_STRING, CONFIG_FIELD(sources_path), 0, 0, 0},
+    {"daemon", CONFIG_BOOL, CONFIG_FIELD(daemonize), 0, 1, 0},
+    {"log_file", CONFIG_STRING, CONFIG_FIELD(log_file), 0, 0, 0},
+    {"pid_file", CONFIG_STRING, CONFIG_FIELD(pid_file), 0, 0, 0},
+};
+
+#define CONFIG_KEY_COUNT ((int)(sizeof(CONFIG_KEYS) / sizeof(CONFIG_KEYS[0])))
+
+static char *config_strings[CONFIG_KEY_COUNT]; //* Copies the config file supplied that run_options still points at
+static unsigned char config_flag_set[CONFIG_KEY_COUNT]; //* Set by a command-line flag, which outranks the file
+static int replay_cycles_loaded = 0;           //* Cycles in the --replay archive
+
+//* Settings that --simulate and --replay pin whatever the flags or the config file say
+void pin_run_mode(RunOptions *options) {
+    if (options->simulate_path) {
+        //* Request throttling is stealth, not scheduling; its delays would only add rand() noise
+        options->throttle = 0;
+    } else if (options->replay_path) {
+        //* Offline: no probes, no throttling, and stop when the archive runs out
+        if (options->max_cycles == 0 || options->max_cycles > replay_cycles_loaded)
+            options->max_cycles = replay_cycles_loaded;
+        options->probe_budget = 0;
+        options->throttle = 0;
+        if (!options->replay_timing)
+            options->cycle_pause = 0;
     }
-    //* clean up dynamically allocated task
-    if (task) {
-        if (task->url) free(task->url);
-        free(task);
+}
+
+//* Pushes settings that live outside run_options (atomics other threads poll) to their homes
+void config_apply_live() {
+    atomic_store(&log_threshold, run_options.log_level);
+    atomic_store(&memory_budget_bytes, (unsigned long long)run_options.memory_budget_mb * 1024 * 1024);
+    pthread_mutex_lock(&memory_budget_mutex);
+    pthread_cond_broadcast(&memory_budget_released); //* A raised budget may admit a waiter now
+    pthread_mutex_unlock(&memory_budget_mutex);
+}
+
+//* Records that a flag set `key`, so reloads leave it alone
+void config_mark_flag(const char *key) {
+    for (int k = 0; k < CONFIG_KEY_COUNT; k++) {
+        if (strcmp(CONFIG_KEYS[k].key, key) == 0)
+            config_flag_set[k] = 1;
     }
-    
-    atomic_fetch_sub(&stats.active_workers, 1);
-    return NULL;
 }
-//* =============== OUTPUT: SAVE TO JSON + TXT ===============
-//* Exports all proxies in structured JSON and simple text formats
-void save_proxies_to_json() {
-    pthread_mutex_lock(&file_mutex);
-    
-    time_t current_time = time(NULL);
-    struct tm *time_info = localtime(&current_time);
-    char time_string[64];
-    strftime(time_string, sizeof(time_string), "%Y-%m-%d %H:%M:%S", time_info);
-    
-    int current_total = atomic_load(&stats.total_proxies);
-    //* Buld json root object
-    json_t *root = json_object();
-    if (!root) {
-        pthread_mutex_unlock(&file_mutex);
-        return;
+
+static int config_flag_set_for(const char *key) {
+    for (int k = 0; k < CONFIG_KEY_COUNT; k++) {
+        if (strcmp(CONFIG_KEYS[k].key, key) == 0)
+            return config_flag_set[k];
     }
-    
-    json_object_set_new(root, "version", json_string("2.0"));
-    json_object_set_new(root, "updated", json_string(time_string));
-    json_object_set_new(root, "total_proxies", json_integer(current_total));
-    json_object_set_new(root, "unique_proxies", json_integer(atomic_load(&stats.unique_proxies)));
-    json_object_set_new(root, "sources_processed", json_integer(atomic_load(&stats.processed_urls)));
-    
-    json_t *proxies_array = json_array();
-    int saved_count = 0;
-    
-    for (int i = 0; i < current_total; i++) {
-        if (proxy_storage[i].active) {
-            json_t *proxy_obj = json_object();
-            json_object_set_new(proxy_obj, "server", json_string(proxy_storage[i].server));
-            json_object_set_new(proxy_obj, "port", json_string(proxy_storage[i].port));
-            json_object_set_new(proxy_obj, "secret", json_string(proxy_storage[i].secret));
-            json_object_set_new(proxy_obj, "url", json_string(proxy_storage[i].connection_url));
-            json_object_set_new(proxy_obj, "source", json_string(proxy_storage[i].source));
-            json_object_set_new(proxy_obj, "type", json_string(proxy_storage[i].type));
-            json_object_set_new(proxy_obj, "country", json_string(proxy_storage[i].country));
-            json_object_set_new(proxy_obj, "speed_score", json_integer(proxy_storage[i].speed_score));
-            
-            char discovered_str[64];
-            strftime(discovered_str, sizeof(discovered_str), "%Y-%m-%d %H:%M:%S", localtime(&proxy_storage[i].discovery_time));
-            json_object_set_new(proxy_obj, "discovered", json_string(discovered_str));
-            
-            char verified_str[64];
-            strftime(verified_str, sizeof(verified_str), "%Y-%m-%d %H:%M:%S", localtime(&proxy_storage[i].last_verified));
-            json_object_set_new(proxy_obj, "last_verified", json_string(verified_str));
-            
-            char hash_str[17];
-            snprintf(hash_str, sizeof(hash_str), "%016llx", proxy_storage[i].hash_value);
-            json_object_set_new(proxy_obj, "hash", json_string(hash_str));
-            
-            json_array_append_new(proxies_array, proxy_obj);
-            saved_count++;
+    return 0;
+}
+
+static void config_report(int startup, const char *format, ...) {
+    char message[LOG_MESSAGE_SIZE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    if (startup)
+        fprintf(stderr, "%s\n", message);
+    else
+        log_message(LOG_LEVEL_WARN, "%s", message);
+}
+
+static char* config_trim(char *text) {
+    while (*text == ' ' || *text == '\t')
+        text++;
+    size_t length = strcspn(text, "\r\n");
+    while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t'))
+        length--;
+    text[length] = '\0';
+    return text;
+}
+
+//* Stores `text` into `key`'s field of `options`. Returns NULL, or why the value is refused.
+static const char* config_parse_value(const ConfigKey *key, const char *text, RunOptions *options) {
+    void *field = (char *)options + key->offset;
+    char *end = NULL;
+    switch (key->type) {
+    case CONFIG_INT: {
+        errno = 0;
+        long long number = strtoll(text, &end, 10);
+        if (end == text || *end != '\0' || errno != 0)
+            return "not an integer";
+        if (number < key->min || number > key->max)
+            return "out of range";
+        *(int *)field = (int)number;
+        return NULL;
+    }
+    case CONFIG_DOUBLE: {
+        double number = strtod(text, &end);
+        if (end == text || *end != '\0' || !isfinite(number))
+            return "not a number";
+        if (number < key->min || number > key->max)
+            return "out of range";
+        *(double *)field = number;
+        return NULL;
+    }
+    case CONFIG_BOOL:
+        if (strcmp(text, "1") == 0 || strcasecmp(text, "yes") == 0 || strcasecmp(text, "true") == 0 ||
+            strcasecmp(text, "on") == 0) {
+            *(int *)field = 1;
+        } else if (strcmp(text, "0") == 0 || strcasecmp(text, "no") == 0 || strcasecmp(text, "false") == 0 ||
+                   strcasecmp(text, "off") == 0) {
+            *(int *)field = 0;
+        } else {
+            return "expected yes or no";
+        }
+        return NULL;
+    case CONFIG_LOG_LEVEL:
+        for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_ERROR; level++) {
+            if (strcasecmp(text, LOG_LEVEL_NAMES[level]) == 0) {
+                *(int *)field = level;
+                return NULL;
+            }
         }
+        return "expected debug, info, warn or error";
+    case CONFIG_STRING: {
+        if (*text == '\0')
+            return "empty value";
+        char *copy = strdup(text);
+        if (!copy)
+            return "out of memory";
+        *(char **)field = copy;
+        return NULL;
     }
-    
-    json_object_set_new(root, "proxies", proxies_array);
-    //* Write JSON file
-    FILE *json_file = fopen("proxies.json", "w");
-    if (json_file) {
-        json_dumpf(root, json_file, JSON_INDENT(2) | JSON_PRESERVE_ORDER);
-        fclose(json_file);
-        log_message("Saved %d proxies to proxies.json", saved_count);
     }
-    
-    json_decref(root);
-    //* Write simple text file (tg:// URLs only)
-    FILE *simple_file = fopen("proxies.txt", "w");
-    if (simple_file) {
-        fprintf(simple_file, "# MTPROTO PROXY LIST\n");
-        fprintf(simple_file, "# Updated: %s\n", time_string);
-        fprintf(simple_file, "# Total proxies: %d\n", current_total);
-        fprintf(simple_file, "# Sources: %u URLs processed\n", atomic_load(&stats.processed_urls));
-        fprintf(simple_file, "# Unique proxies: %u\n\n", atomic_load(&stats.unique_proxies));
+    return "unsupported type";
+}
+
+//* Reads `path` over `options`: keys the file sets replace the value, the others keep it.
+//* Reports every bad line with its number and returns how many there were (-1 when the file
+//* cannot be read). String values are heap copies; see config_adopt_strings().
+int config_load_file(const char *path, RunOptions *options, int startup) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        config_report(startup, "Cannot read config file %s: %s", path, strerror(errno));
+        return -1;
+    }
+    char line[CONFIG_LINE_SIZE];
+    int line_number = 0;
+    int errors = 0;
+    unsigned char assigned[CONFIG_KEY_COUNT] = {0};
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        if (!strchr(line, '\n') && !feof(file)) {
+            config_report(startup, "%s:%d: line longer than %d bytes", path, line_number, CONFIG_LINE_SIZE - 2);
+            errors++;
+            int c;
+            while ((c = fgetc(file)) != EOF && c != '\n')
+                ;
+            continue;
+        }
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        char *key_text = config_trim(line);
+        if (*key_text == '\0')
+            continue;
+        char *equals = strchr(key_text, '=');
+        if (!equals) {
+            config_report(startup, "%s:%d: expected key = value", path, line_number);
+            errors++;
+            continue;
+        }
+        *equals = '\0';
+        char *value = config_trim(equals + 1);
+        key_text = config_trim(key_text);
+        size_t value_length = strlen(value);
+        if (value_length >= 2 && value[0] == '"' && value[value_length - 1] == '"') {
+            value[value_length - 1] = '\0';
+            value++;
+        }
         
-        int txt_saved = 0;
-        for (int i = 0; i < current_total; i++) {
-            if (proxy_storage[i].active) {
-                fprintf(simple_file, "%s\n", proxy_storage[i].connection_url);
-                txt_saved++;
-            }
+        int k = 0;
+        while (k < CONFIG_KEY_COUNT && strcmp(CONFIG_KEYS[k].key, key_text) != 0)
+            k++;
+        if (k == CONFIG_KEY_COUNT) {
+            config_report(startup, "%s:%d: unknown key '%s'", path, line_number, key_text);
+            errors++;
+            continue;
         }
-        fclose(simple_file);
-        log_message("Saved %d proxies to proxies.txt", txt_saved);
+        const ConfigKey *key = &CONFIG_KEYS[k];
+        char *repeated = key->type == CONFIG_STRING && assigned[k] ? *(char **)((char *)options + key->offset) : NULL;
+        const char *problem = config_parse_value(key, value, options);
+        if (problem) {
+            if (key->type == CONFIG_INT || key->type == CONFIG_DOUBLE)
+                config_report(startup, "%s:%d: %s = %s: %s (%g..%g)", path, line_number, key->key, value, problem,
+                              key->min, key->max);
+            else
+                config_report(startup, "%s:%d: %s = %s: %s", path, line_number, key->key, value, problem);
+            errors++;
+            continue;
+        }
+        free(repeated); //* A key given twice: the last line wins
+        assigned[k] = 1;
     }
-    
-    pthread_mutex_unlock(&file_mutex);
+    fclose(file);
+    return errors;
 }
-//* =============== CONSOLE: REAL-TIME STATS ===============
-//* Prints current performance metrics
-void display_statistics() {
-    time_t uptime = time(NULL) - stats.initialization_time;
-    int hours = uptime / 3600;
-    int minutes = (uptime % 3600) / 60;
-    int seconds = uptime % 60;
+
+static int config_value_equal(const ConfigKey *key, const RunOptions *a, const RunOptions *b) {
+    const void *field_a = (const char *)a + key->offset;
+    const void *field_b = (const char *)b + key->offset;
+    if (key->type == CONFIG_DOUBLE)
+        return *(const double *)field_a == *(const double *)field_b;
+    if (key->type == CONFIG_STRING) {
+        const char *text_a = *(const char *const *)field_a;
+        const char *text_b = *(const char *const *)field_b;
+        return text_a == text_b || (text_a && text_b && strcmp(text_a, text_b) == 0);
+    }
+    return *(const int *)field_a == *(const int *)field_b;
+}
+
+static void config_format_value(const ConfigKey *key, const RunOptions *options, char *text, size_t size) {
+    const void *field = (const char *)options + key->offset;
+    if (key->type == CONFIG_DOUBLE)
+        snprintf(text, size, "%g", *(const double *)field);
+    else if (key->type == CONFIG_STRING)
+        snprintf(text, size, "%s", *(const char *const *)field ? *(const char *const *)field : "(unset)");
+    else if (key->type == CONFIG_LOG_LEVEL)
+        snprintf(text, size, "%s", LOG_LEVEL_NAMES[*(const int *)field]);
+    else
+        snprintf(text, size, "%d", *(const int *)field);
+}
+
+//* Settles string ownership once `after` replaces `before`: a copy nobody uses is freed,
+//* and the previous config copy goes when its field takes a new value
+static void config_adopt_strings(const RunOptions *before, RunOptions *after) {
+    for (int k = 0; k < CONFIG_KEY_COUNT; k++) {
+        if (CONFIG_KEYS[k].type != CONFIG_STRING)
+            continue;
+        const char **old_field = (const char **)((char *)before + CONFIG_KEYS[k].offset);
+        char **new_field = (char **)((char *)after + CONFIG_KEYS[k].offset);
+        if (*new_field == *old_field)
+            continue;
+        if (config_value_equal(&CONFIG_KEYS[k], before, after)) {
+            free(*new_field);
+            *new_field = (char *)*old_field;
+            continue;
+        }
+        if (config_strings[k] && config_strings[k] == *old_field)
+            free(config_strings[k]);
+        config_strings[k] = *new_field;
+    }
+}
+
+//* Frees the copies a rejected reload made
+static void config_discard_strings(const RunOptions *current, RunOptions *rejected) {
+    for (int k = 0; k < CONFIG_KEY_COUNT; k++) {
+        if (CONFIG_KEYS[k].type != CONFIG_STRING)
+            continue;
+        char **field = (char **)((char *)rejected + CONFIG_KEYS[k].offset);
+        if (*field != *(char *const *)((const char *)current + CONFIG_KEYS[k].offset))
+            free(*field);
+    }
+}
+
+//* Startup: the file fills in run_options before any flag is parsed
+int config_load_startup(const char *path) {
+    RunOptions before = run_options;
+    int errors = config_load_file(path, &run_options, 1);
+    if (errors != 0) {
+        if (errors > 0)
+            fprintf(stderr, "%s: %d invalid line%s\n", path, errors, errors == 1 ? "" : "s");
+        return 0;
+    }
+    config_adopt_strings(&before, &run_options);
+    run_options.config_path = path;
+    return 1;
+}
+
+//* Re-reads the config file and applies what changed. Called at a quiescent point only.
+void config_reload() {
+    if (!run_options.config_path) {
+        log_message(LOG_LEVEL_INFO, "SIGHUP: no --config file to reload");
+        return;
+    }
+    RunOptions next = run_options;
+    int errors = config_load_file(run_options.config_path, &next, 0);
+    if (errors != 0) {
+        config_discard_strings(&run_options, &next);
+        if (errors < 0)
+            log_message(LOG_LEVEL_WARN, "Configuration not reloaded; keeping the running settings");
+        else
+            log_message(LOG_LEVEL_WARN, "Configuration %s has %d invalid line%s; keeping the running settings",
+                        run_options.config_path, errors, errors == 1 ? "" : "s");
+        return;
+    }
+    pin_run_mode(&next);
+    //* The shard and sync keys are checked as they will apply, command-line values included
+    RunOptions effective = next;
+    if (config_flag_set_for("shard_nodes"))
+        effective.shard_nodes = run_options.shard_nodes;
+    if (config_flag_set_for("shard_node"))
+        effective.shard_node = run_options.shard_node;
+    if (config_flag_set_for("sync_peers"))
+        effective.sync_peers = run_options.sync_peers;
+    const char *problem = shard_validate(&effective);
+    if (!problem)
+        problem = sync_validate(&effective);
+    if (problem) {
+        config_discard_strings(&run_options, &next);
+        log_message(LOG_LEVEL_WARN, "Configuration %s: %s; keeping the running settings", run_options.config_path,
+                    problem);
+        return;
+    }
     
-    double mb_processed = atomic_load(&stats.total_bytes) / (1024.0 * 1024.0);
+    int changed = 0;
+    for (int k = 0; k < CONFIG_KEY_COUNT; k++) {
+        const ConfigKey *key = &CONFIG_KEYS[k];
+        if (config_value_equal(key, &run_options, &next))
+            continue;
+        char before[128], after[128];
+        config_format_value(key, &run_options, before, sizeof(before));
+        config_format_value(key, &next, after, sizeof(after));
+        if (!key->reloadable || config_flag_set[k]) {
+            if (config_flag_set[k])
+                log_message(LOG_LEVEL_INFO, "Config: %s stays %s (set on the command line)", key->key, before);
+            else
+                log_message(LOG_LEVEL_WARN, "Config: %s %s -> %s takes effect after a restart", key->key, before, after);
+            char *field = (char *)&next + key->offset;
+            if (key->type == CONFIG_STRING)
+                free(*(char **)field);
+            memcpy(field, (const char *)&run_options + key->offset,
+                   key->type == CONFIG_DOUBLE ? sizeof(double) : key->type == CONFIG_STRING ? sizeof(char *) : sizeof(int));
+            continue;
+        }
+        log_message(LOG_LEVEL_INFO, "Config: %s %s -> %s", key->key, before, after);
+        changed++;
+    }
+    config_adopt_strings(&run_options, &next);
     
-    printf("\n=== SYSTEM STATISTICS ===\n");
-    printf("Uptime: %02d:%02d:%02d\n", hours, minutes, seconds);
-    printf("Total proxies: %u\n", atomic_load(&stats.total_proxies));
-    printf("Unique proxies: %u\n", atomic_load(&stats.unique_proxies));
-    printf("Successful proxies: %u\n", atomic_load(&stats.successful_proxies));
-    printf("URLs processed: %u/%u\n", atomic_load(&stats.processed_urls), atomic_load(&stats.total_requests));
-    printf("Data processed: %.2f MB\n", mb_processed);
-    printf("Completed cycles: %u\n", atomic_load(&stats.completed_cycles));
-    printf("Network errors: %u\n", atomic_load(&stats.network_errors));
-    printf("Active workers: %d\n", atomic_load(&stats.active_workers));
-    printf("Last cycle: +%u proxies\n", atomic_load(&stats.last_cycle_proxies));
-    printf("=========================\n\n");
+    int resize = next.concurrency != run_options.concurrency || next.decode_threads != run_options.decode_threads ||
+                 next.extract_threads != run_options.extract_threads || next.commit_threads != run_options.commit_threads ||
+                 next.queue_depth != run_options.queue_depth;
+    run_options = next;
+    config_apply_live();
+    if (resize && pipeline_started && !pipeline_configure())
+        log_message(LOG_LEVEL_ERROR, "Pipeline resize left a stage without threads");
+    shard_update();
+    sync_update();
+    log_message(LOG_LEVEL_INFO, "Configuration reloaded from %s: %d setting%s changed", run_options.config_path,
+                changed, changed == 1 ? "" : "s");
+}
+
+//* Cycle boundary and pause hook: applies SIGHUPs that arrived since the last call
+void config_poll_reload() {
+    if (!reload_signal_pending())
+        return;
+    if (pipeline_started)
+        pipeline_wait_export(); //* The export thread reads run_options too
+    daemon_reopen_log();
+    config_reload();
 }
 
 void autonomous_operation() {
-    log_message("STARTING ADVANCED PROXY PARSER v2.0");
+    log_message(LOG_LEVEL_INFO, "STARTING ADVANCED PROXY PARSER v2.0");
+    PROFILED_LOCK(&log_mutex);
+    log_drain_locked();
     printf("==========================================\n");
     printf("🚀 ADVANCED MTPROTO PROXY PARSER v2.0\n");
-    printf("Capacity: %d proxies, %d URLs, %d patterns\n", PROXY_CAPACITY, URL_CAPACITY, MAX_PATTERNS);
-    printf("Threads: %d workers, %d concurrent\n", MAX_THREAD_COUNT, CONCURRENT_DOWNLOADS);
+    printf("Capacity: %d proxies, %d URLs, %d patterns\n", run_options.proxy_capacity, URL_CAPACITY, MAX_PATTERNS);
+    printf("Threads: %d workers, %d concurrent\n", MAX_THREAD_COUNT, run_options.concurrency);
     printf("Output: JSON + Text formats\n");
-    printf("Save interval: %d seconds\n", SAVE_INTERVAL);
+    printf("Save interval: %d seconds\n", run_options.save_interval);
+    if (run_options.config_path)
+        printf("Config: %s (send SIGHUP to reload)\n", run_options.config_path);
     printf("==========================================\n");
+    fflush(stdout);
+    PROFILED_UNLOCK(&log_mutex);
     
-    stats.initialization_time = time(NULL);
-    time_t last_save = time(NULL);
-    time_t last_stats = time(NULL);
+    stats.initialization_time = mtp_time();
+    start_metrics_server();
+    start_sync_server();
+    if (!virtual_clock_enabled && !pipeline_start()) {
+        log_message(LOG_LEVEL_ERROR, "Cannot start the fetch pipeline, stopping");
+        atomic_store(&program_active, 0);
+    }
+    time_t last_save = mtp_time();
+    time_t last_stats = mtp_time();
     int cycle_number = 0;
+    uint64_t run_start_ns = monotonic_ns();
+    trace_set_thread_label("main");
+    shard_update();
+    sync_update();
     
     save_proxies_to_json();
     
     while (atomic_load(&program_active)) {
+        config_poll_reload();
+        sync_poll(); //* Before fetching, so a node joining late starts from its peers' stores
         cycle_number++;
-        atomic_store(&stats.completed_cycles, cycle_number);
-        atomic_store(&stats.last_cycle_proxies, 0);
+        stats_add(STAT_COMPLETED_CYCLES, 1);
+        atomic_store(&stats.cycle_start_unique, stats_total(STAT_UNIQUE_PROXIES));
+        atomic_store(&current_cycle, cycle_number);
+        atomic_store(&current_cycle_start_ns, mtp_monotonic_ns());
+        trace_checkpoint(cycle_number, 1);
+        TRACE_BEGIN("cycle", TRACE_ARG_CYCLE, cycle_number);
         
-        log_message("Starting cycle #%d", cycle_number);
+        log_message(LOG_LEVEL_INFO, "Starting cycle #%d", cycle_number);
         
         int url_count = 0;
         while (url_count < URL_CAPACITY && TARGET_URLS[url_count] != NULL) {
@@ -922,90 +6838,114 @@ void autonomous_operation() {
         }
         
         int initial_proxy_count = atomic_load(&stats.total_proxies);
+        StatsSnapshot cycle_start_snapshot;
+        stats_snapshot(&cycle_start_snapshot);
+        uint64_t cycle_start_ns = mtp_monotonic_ns();
         
-        pthread_t workers[MAX_THREAD_COUNT];
-        int workers_launched = 0;
-        int current_url_index = 0;
+        int schedule[URL_CAPACITY];
+        int scheduled_count = build_fetch_schedule(cycle_number, url_count, schedule);
+        int owned_count = shard_owned_count(url_count);
+        if (scheduled_count < owned_count) {
+            log_message(LOG_LEVEL_INFO, "Scheduler: %d/%d sources due this cycle", scheduled_count, owned_count);
+        }
         
-        while (current_url_index < url_count && atomic_load(&program_active)) {
-            int batch_size = MIN(CONCURRENT_DOWNLOADS, url_count - current_url_index);
-            
-            for (int i = 0; i < batch_size && current_url_index < url_count; i++, current_url_index++) {
-                DownloadTask *task = malloc(sizeof(DownloadTask));
-                if (!task) continue;
-                
-                task->url = strdup(TARGET_URLS[current_url_index]);
-                if (!task->url) {
-                    free(task);
-                    continue;
-                }
-                
-                task->retry_count = 0;
-                task->priority = 1;
-                task->use_proxy = 0;
-                
-                atomic_fetch_add(&stats.active_workers, 1);
-                if (pthread_create(&workers[workers_launched], NULL, url_worker, task) == 0) {
-                    workers_launched++;
-                } else {
-                    if (task->url) free(task->url);
-                    free(task);
-                    atomic_fetch_sub(&stats.active_workers, 1);
-                }
-                
-                usleep(10000 + (rand() % 15000));
-            }
-            
-            for (int i = 0; i < workers_launched; i++) {
-                pthread_join(workers[i], NULL);
-            }
-            workers_launched = 0;
-            
-            if (!atomic_load(&program_active)) 
-                break;
+        if (pipeline_started)
+            pipeline_run_cycle(schedule, scheduled_count);
+        else
+            run_simulated_cycle(schedule, scheduled_count);
+        
+        if (atomic_load(&program_active) && run_options.probe_budget > 0) {
+            TRACE_BEGIN("verification", TRACE_ARG_NONE, 0);
+            if (pipeline_started)
+                pipeline_wait_export(); //* Probes update fields the export reads without storage_mutex
+            run_verification_pass(url_count);
+            TRACE_END("verification", TRACE_ARG_NONE, 0);
         }
         
-        time_t now = time(NULL);
-        if (difftime(now, last_save) >= SAVE_INTERVAL) {
-            save_proxies_to_json();
+        time_t now = mtp_time();
+        int saved = 0;
+        if (difftime(now, last_save) >= run_options.save_interval) {
+            if (pipeline_started) {
+                saved = pipeline_request_export(); //* Overlaps the next cycle
+            } else {
+                save_proxies_to_json();
+                saved = 1;
+            }
             last_save = now;
         }
+        if (run_options.cycle_report) {
+            StatsSnapshot cycle_end_snapshot;
+            stats_snapshot(&cycle_end_snapshot);
+            write_cycle_report(cycle_number, scheduled_count, mtp_monotonic_ns() - cycle_start_ns,
+                               &cycle_start_snapshot, &cycle_end_snapshot, saved);
+        }
         
-        if (difftime(now, last_stats) >= 30) {
+        if (difftime(now, last_stats) >= run_options.stats_interval) {
             display_statistics();
             last_stats = now;
         }
         
         int new_proxies = atomic_load(&stats.total_proxies) - initial_proxy_count;
         if (new_proxies > 0) {
-            log_message("Cycle #%d: +%d new proxies", cycle_number, new_proxies);
+            log_message(LOG_LEVEL_INFO, "Cycle #%d: +%d new proxies", cycle_number, new_proxies);
         } else {
-            log_message("Cycle #%d: No new proxies found", cycle_number);
+            log_message(LOG_LEVEL_INFO, "Cycle #%d: No new proxies found", cycle_number);
+        }
+        
+        if (run_options.max_cycles > 0 && cycle_number >= run_options.max_cycles) {
+            log_message(LOG_LEVEL_INFO, "Completed %d cycles, stopping", cycle_number);
+            atomic_store(&program_active, 0);
+        }
+        if (virtual_clock_enabled && mtp_monotonic_ns() >= simulation_end_ns) {
+            log_message(LOG_LEVEL_INFO, "Simulated %.1f hours in %d cycles, stopping", run_options.simulate_hours, cycle_number);
+            atomic_store(&program_active, 0);
         }
         
-        log_message("Pausing for 8 seconds before next cycle...");
-        for (int i = 0; i < 8 && atomic_load(&program_active); i++) {
-            sleep(1);
+        if (run_options.cycle_pause > 0 && atomic_load(&program_active))
+            log_message(LOG_LEVEL_INFO, "Pausing for %d seconds before next cycle...", run_options.cycle_pause);
+        TRACE_BEGIN("sleep", TRACE_ARG_NONE, 0);
+        for (int i = 0; i < run_options.cycle_pause && atomic_load(&program_active); i++) {
+            mtp_sleep_ns(1000000000ULL);
+            config_poll_reload(); //* cycle_pause itself may change here
         }
+        TRACE_END("sleep", TRACE_ARG_NONE, 0);
+        TRACE_END("cycle", TRACE_ARG_CYCLE, cycle_number);
+        if (pipeline_started && TRACE_ENABLED())
+            pipeline_wait_export(); //* A dump frees the trace buffers of every thread
+        trace_checkpoint(cycle_number, 0);
     }
+    if (virtual_clock_enabled)
+        log_message(LOG_LEVEL_INFO, "Simulation: %.2f virtual hours, %d cycles, %.2f seconds of real time",
+                    mtp_monotonic_ns() / 3.6e12, cycle_number, (monotonic_ns() - run_start_ns) / 1e9);
+    if (pipeline_started && TRACE_ENABLED())
+        pipeline_wait_export();
+    trace_shutdown();
 }
 
 void cleanup_resources() {
     atomic_store(&program_active, 0);
-    log_message("Cleaning up resources...");
+    log_message(LOG_LEVEL_INFO, "Cleaning up resources...");
     
     int wait_count = 0;
     while (atomic_load(&stats.active_workers) > 0 && wait_count < 30) {
-        log_message("Waiting for %d workers to finish...", atomic_load(&stats.active_workers));
+        log_message(LOG_LEVEL_INFO, "Waiting for %d workers to finish...", atomic_load(&stats.active_workers));
         sleep(1);
         wait_count++;
     }
     
+    pipeline_stop(); //* Runs a save that was still queued
+    stop_metrics_server();
+    stop_sync_server();
+    daemon_cleanup();
     save_proxies_to_json();
     
-    pthread_mutex_destroy(&storage_mutex);
-    pthread_mutex_destroy(&file_mutex);
-    pthread_mutex_destroy(&log_mutex);
+    pthread_mutex_destroy(&storage_mutex.mutex);
+    pthread_mutex_destroy(&file_mutex.mutex);
+    
+    free_probe_histories();
+    capture_close();
+    free_replay_records();
+    release_thread_extractor();
     
     if (proxy_storage) {
         free(proxy_storage);
@@ -1014,12 +6954,328 @@ void cleanup_resources() {
     
     curl_global_cleanup();
     
-    log_message("Cleanup completed. Total proxies found: %u", atomic_load(&stats.total_proxies));
+    log_message(LOG_LEVEL_INFO, "Cleanup completed. Total proxies found: %u", atomic_load(&stats.total_proxies));
+    log_message(LOG_LEVEL_INFO, "Log writer stopping (%llu messages dropped)", atomic_load(&log_dropped));
+    stop_log_writer();
+    pthread_mutex_destroy(&log_mutex.mutex);
+}
+
+//* =============== COMMAND LINE ===============
+//* Optional flags; with none the parser runs exactly as before
+
+void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --config FILE          Read settings from FILE (key = value; see README); SIGHUP re-reads it\n");
+    printf("  --daemon               Detach from the terminal; output goes to --log-file\n");
+    printf("  --log-file PATH        Daemon stdout/stderr (default %s; reopened on SIGHUP)\n", DAEMON_LOG_FILE);
+    printf("  --pid-file PATH        Write the daemon's pid here\n");
+    printf("  --trace-cycles N[-M]   Record a Chrome trace of cycles N..M\n");
+    printf("  --trace-window S-E     Record a Chrome trace from S to E seconds after start\n");
+    printf("  --trace-file PATH      Trace output (default %s)\n", TRACE_DEFAULT_FILE);
+    printf("  --memory-budget MB     Throttle transfers and exports to stay under MB (0 = off)\n");
+    printf("  --hw-counters          Record perf hardware counters per pattern/stage/source to %s\n", HW_COUNTERS_FILE);
+    printf("  --sources FILE         Fetch the URLs listed in FILE (one per line) instead of the built-in list\n");
+    printf("  --shard-nodes LIST     Split the sources by consistent hashing among these comma-separated nodes\n");
+    printf("  --shard-node NAME      This instance's name in the shard list; it fetches only its share\n");
+    printf("  --shard-dir DIR        Publish this node's store as DIR/NAME.json on every save (for mtp_merge)\n");
+    printf("  --shard-plan           Print the owning node of every source and exit\n");
+    printf("  --sync-port N          Answer set reconciliation requests from peer instances on N (0 = off)\n");
+    printf("  --sync-bind-address A  Listen for peers on address A (default %s; peers get no authentication)\n",
+           SYNC_BIND_ADDRESS);
+    printf("  --sync-peers LIST      Reconcile the store with these comma-separated host:port instances\n");
+    printf("  --sync-interval S      Seconds between reconciliations (default %d)\n", SYNC_INTERVAL);
+    printf("  --cycles N             Stop after N cycles (0 = run until interrupted)\n");
+    printf("  --concurrency N        Fetch threads (default %d, max %d)\n", CONCURRENT_DOWNLOADS, MAX_THREAD_COUNT);
+    printf("  --decode-threads N     Threads inflating compressed bodies (default %d)\n", PIPELINE_DECODE_THREADS);
+    printf("  --extract-threads N    Pattern matching threads (default: one per online CPU)\n");
+    printf("  --commit-threads N     Store commit threads (default %d)\n", PIPELINE_COMMIT_THREADS);
+    printf("  --cycle-pause S        Seconds between cycles (default %d)\n", CYCLE_PAUSE_SECONDS);
+    printf("  --probe-budget N       Proxies probed per cycle (default %d, max %d, 0 = no probing)\n", PROBE_BUDGET,
+           PROBE_BUDGET_LIMIT);
+    printf("  --no-throttle          Skip the random per-request delays (local sources only)\n");
+    printf("  --cycle-report PATH    Append per-cycle timings and counters as JSON lines\n");
+    printf("  --capture PATH         Record every transfer (body, status, headers, timing) to a gzip archive\n");
+    printf("  --replay PATH          Run the archive's cycles offline through the same pipeline, at full speed\n");
+    printf("  --replay-timing        With --replay: reproduce recorded start offsets and transfer durations\n");
+    printf("  --simulate MODEL       No network: fetch modelled sources (see MODEL format in the README) on a virtual clock\n");
+    printf("  --sim-hours H          With --simulate: virtual hours to run (default %d, max %d)\n", SIMULATION_HOURS,
+           SIMULATION_MAX_HOURS);
+    printf("  --sim-seed N           With --simulate: seed for every modelled draw (default 1)\n");
+    printf("  --help                 Show this help\n");
+}
+
+//* Parses "A" or "A-B" into a range; returns 0 on malformed input
+static int parse_range(const char *text, long *first, long *last) {
+    char *end = NULL;
+    *first = strtol(text, &end, 10);
+    if (end == text || *first < 0)
+        return 0;
+    *last = *first;
+    if (*end == '-') {
+        const char *second = end + 1;
+        *last = strtol(second, &end, 10);
+        if (end == second || *last < *first)
+            return 0;
+    }
+    return *end == '\0';
+}
+
+//* Returns 1 to run, 0 to exit successfully (--help), -1 on a usage error
+int parse_command_line(int argc, char *argv[]) {
+    int shard_plan = 0;
+    //* The config file goes first wherever --config appears, so every flag overrides it
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0) {
+            if (!config_load_startup(argv[i + 1]))
+                return -1;
+            break;
+        }
+    }
+    
+    for (int i = 1; i < argc; i++) {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        long first, last;
+
+        if (strcmp(option, "--help") == 0 || strcmp(option, "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (strcmp(option, "--trace-cycles") == 0 && value) {
+            if (!parse_range(value, &first, &last) || first == 0) {
+                fprintf(stderr, "Invalid --trace-cycles value: %s\n", value);
+                return -1;
+            }
+            trace_options.first_cycle = (int)first;
+            trace_options.last_cycle = (int)last;
+            i++;
+        } else if (strcmp(option, "--trace-window") == 0 && value) {
+            if (!parse_range(value, &first, &last) || first == last) {
+                fprintf(stderr, "Invalid --trace-window value: %s\n", value);
+                return -1;
+            }
+            trace_options.window_start = first;
+            trace_options.window_end = last;
+            i++;
+        } else if (strcmp(option, "--trace-file") == 0 && value) {
+            trace_options.output_path = value;
+            i++;
+        } else if (strcmp(option, "--hw-counters") == 0) {
+            atomic_store(&hw_counters_enabled, 1);
+        } else if (strcmp(option, "--config") == 0 && value) {
+            i++; //* Already loaded
+        } else if (strcmp(option, "--daemon") == 0) {
+            run_options.daemonize = 1;
+            config_mark_flag("daemon");
+        } else if ((strcmp(option, "--sources") == 0 || strcmp(option, "--log-file") == 0 ||
+                    strcmp(option, "--pid-file") == 0) && value) {
+            if (strcmp(option, "--sources") == 0) {
+                run_options.sources_path = value;
+                config_mark_flag("sources");
+            } else if (strcmp(option, "--log-file") == 0) {
+                run_options.log_file = value;
+                config_mark_flag("log_file");
+            } else {
+                run_options.pid_file = value;
+                config_mark_flag("pid_file");
+            }
+            i++;
+        } else if ((strcmp(option, "--shard-nodes") == 0 || strcmp(option, "--shard-node") == 0 ||
+                    strcmp(option, "--shard-dir") == 0) && value) {
+            if (strcmp(option, "--shard-nodes") == 0) {
+                run_options.shard_nodes = value;
+                config_mark_flag("shard_nodes");
+            } else if (strcmp(option, "--shard-node") == 0) {
+                run_options.shard_node = value;
+                config_mark_flag("shard_node");
+            } else {
+                run_options.shard_dir = value;
+                config_mark_flag("shard_dir");
+            }
+            i++;
+        } else if (strcmp(option, "--shard-plan") == 0) {
+            shard_plan = 1;
+        } else if (strcmp(option, "--sync-peers") == 0 && value) {
+            run_options.sync_peers = value;
+            config_mark_flag("sync_peers");
+            i++;
+        } else if (strcmp(option, "--sync-bind-address") == 0 && value) {
+            run_options.sync_bind_address = value;
+            config_mark_flag("sync_bind_address");
+            i++;
+        } else if ((strcmp(option, "--sync-port") == 0 || strcmp(option, "--sync-interval") == 0) && value) {
+            char *end = NULL;
+            long number = strtol(value, &end, 10);
+            int is_port = strcmp(option, "--sync-port") == 0;
+            if (end == value || *end != '\0' || number < (is_port ? 0 : 1) || number > (is_port ? 65535 : 86400)) {
+                fprintf(stderr, "Invalid %s value: %s\n", option, value);
+                return -1;
+            }
+            if (is_port)
+                run_options.sync_port = (int)number;
+            else
+                run_options.sync_interval = (int)number;
+            config_mark_flag(is_port ? "sync_port" : "sync_interval");
+            i++;
+        } else if ((strcmp(option, "--cycles") == 0 || strcmp(option, "--concurrency") == 0 ||
+                    strcmp(option, "--cycle-pause") == 0 || strcmp(option, "--probe-budget") == 0 ||
+                    strcmp(option, "--decode-threads") == 0 || strcmp(option, "--extract-threads") == 0 ||
+                    strcmp(option, "--commit-threads") == 0) && value) {
+            char *end = NULL;
+            long number = strtol(value, &end, 10);
+            int is_concurrency = strcmp(option, "--concurrency") == 0;
+            int is_thread_count = is_concurrency || strstr(option, "-threads") != NULL;
+            long limit = is_thread_count ? MAX_THREAD_COUNT : strcmp(option, "--probe-budget") == 0 ? PROBE_BUDGET_LIMIT : INT_MAX;
+            if (end == value || *end != '\0' || number < (is_thread_count ? 1 : 0) || number > limit) {
+                fprintf(stderr, "Invalid %s value: %s\n", option, value);
+                return -1;
+            }
+            if (strcmp(option, "--cycles") == 0)
+                run_options.max_cycles = (int)number;
+            else if (is_concurrency)
+                run_options.concurrency = (int)number;
+            else if (strcmp(option, "--decode-threads") == 0)
+                run_options.decode_threads = (int)number;
+            else if (strcmp(option, "--extract-threads") == 0)
+                run_options.extract_threads = (int)number;
+            else if (strcmp(option, "--commit-threads") == 0)
+                run_options.commit_threads = (int)number;
+            else if (strcmp(option, "--cycle-pause") == 0)
+                run_options.cycle_pause = (int)number;
+            else
+                run_options.probe_budget = (int)number;
+            //* "--cycle-pause" -> "cycle_pause"
+            char key[32];
+            snprintf(key, sizeof(key), "%s", option + 2);
+            for (char *dash = strchr(key, '-'); dash; dash = strchr(dash, '-'))
+                *dash = '_';
+            config_mark_flag(key);
+            i++;
+        } else if (strcmp(option, "--no-throttle") == 0) {
+            run_options.throttle = 0;
+            config_mark_flag("throttle");
+        } else if (strcmp(option, "--cycle-report") == 0 && value) {
+            run_options.cycle_report = value;
+            config_mark_flag("cycle_report");
+            i++;
+        } else if (strcmp(option, "--capture") == 0 && value) {
+            run_options.capture_path = value;
+            i++;
+        } else if (strcmp(option, "--replay") == 0 && value) {
+            run_options.replay_path = value;
+            i++;
+        } else if (strcmp(option, "--replay-timing") == 0) {
+            run_options.replay_timing = 1;
+        } else if (strcmp(option, "--simulate") == 0 && value) {
+            run_options.simulate_path = value;
+            i++;
+        } else if (strcmp(option, "--sim-hours") == 0 && value) {
+            char *end = NULL;
+            errno = 0;
+            double hours = strtod(value, &end);
+            if (end == value || *end != '\0' || errno == ERANGE || !isfinite(hours) || hours <= 0 ||
+                hours > SIMULATION_MAX_HOURS) {
+                fprintf(stderr, "Invalid --sim-hours value: %s (expected 0 < H <= %d)\n", value, SIMULATION_MAX_HOURS);
+                return -1;
+            }
+            run_options.simulate_hours = hours;
+            i++;
+        } else if (strcmp(option, "--sim-seed") == 0 && value) {
+            char *end = NULL;
+            errno = 0;
+            unsigned long long seed = strtoull(value, &end, 10);
+            //* strtoull() accepts a sign and negates, so "-1" would wrap to the largest seed
+            if (end == value || *end != '\0' || errno == ERANGE || !isdigit((unsigned char)value[0])) {
+                fprintf(stderr, "Invalid --sim-seed value: %s\n", value);
+                return -1;
+            }
+            run_options.simulate_seed = seed;
+            i++;
+        } else if (strcmp(option, "--memory-budget") == 0 && value) {
+            char *end = NULL;
+            long long megabytes = strtoll(value, &end, 10);
+            if (end == value || *end != '\0' || megabytes < 0 || megabytes > (1 << 20)) {
+                fprintf(stderr, "Invalid --memory-budget value: %s\n", value);
+                return -1;
+            }
+            run_options.memory_budget_mb = (int)megabytes;
+            config_mark_flag("memory_budget_mb");
+            i++;
+        } else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", option);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    
+    if (run_options.sources_path && load_source_list(run_options.sources_path) <= 0) {
+        fprintf(stderr, "No sources loaded from %s\n", run_options.sources_path);
+        return -1;
+    }
+    
+    if (run_options.simulate_path) {
+        if (run_options.capture_path || run_options.replay_path) {
+            fprintf(stderr, "--simulate cannot be combined with --capture or --replay\n");
+            return -1;
+        }
+        if (simulation_load(run_options.simulate_path) <= 0) {
+            fprintf(stderr, "Cannot simulate %s: missing file or no source models\n", run_options.simulate_path);
+            return -1;
+        }
+    } else if (run_options.replay_path) {
+        if (run_options.capture_path) {
+            fprintf(stderr, "--capture and --replay cannot be combined\n");
+            return -1;
+        }
+        replay_cycles_loaded = replay_load(run_options.replay_path);
+        if (replay_cycles_loaded <= 0) {
+            fprintf(stderr, "Cannot replay %s: missing, empty or not a capture archive\n", run_options.replay_path);
+            return -1;
+        }
+    } else if (run_options.capture_path) {
+        if (!capture_open(run_options.capture_path)) {
+            fprintf(stderr, "Cannot write capture archive %s\n", run_options.capture_path);
+            return -1;
+        }
+        printf("Capturing transfers to %s\n", run_options.capture_path);
+    }
+    if (shard_plan) {
+        const char *problem = "shard_nodes is not set (config file or --shard-nodes)";
+        if (!run_options.shard_nodes || shard_parse_nodes(run_options.shard_nodes, shard_names, &problem) < 0) {
+            fprintf(stderr, "--shard-plan: %s\n", problem);
+            return -1;
+        }
+        int url_count = 0;
+        while (url_count < URL_CAPACITY && TARGET_URLS[url_count] != NULL)
+            url_count++;
+        shard_build(url_count);
+        shard_print_plan(stdout, url_count);
+        return 0;
+    }
+    const char *shard_problem = shard_validate(&run_options);
+    if (shard_problem) {
+        fprintf(stderr, "Invalid shard settings: %s\n", shard_problem);
+        return -1;
+    }
+    const char *sync_problem = sync_validate(&run_options);
+    if (sync_problem) {
+        fprintf(stderr, "Invalid sync_peers: %s\n", sync_problem);
+        return -1;
+    }
+    pin_run_mode(&run_options);
+    config_apply_live();
+    return 1;
 }
 
-//* Main
+//* Main (omitted with -DMTP_NO_MAIN when a bench or tool includes this file)
 
+#ifndef MTP_NO_MAIN
 int main(int argc, char *argv[]) {
+    int command_line = parse_command_line(argc, argv);
+    if (command_line <= 0)
+        return command_line == 0 ? 0 : 2;
+    if (run_options.daemonize && !daemonize_process())
+        return 1;
+    
     printf("🚀 ADVANCED MTPROTO PROXY PARSER v2.0\n");
     printf("==========================================\n");
     
@@ -1035,46 +7291,55 @@ int main(int argc, char *argv[]) {
     
     printf("URL sources: %d\n", url_count);
     printf("Parse patterns: %d\n", pattern_count);
-    printf("Proxy capacity: %d\n", PROXY_CAPACITY);
+    printf("Proxy capacity: %d\n", run_options.proxy_capacity);
     printf("Thread workers: %d\n", MAX_THREAD_COUNT);
-    printf("Concurrent downloads: %d\n", CONCURRENT_DOWNLOADS);
+    printf("Concurrent downloads: %d\n", run_options.concurrency);
     printf("Output format: JSON + Text\n");
     printf("==========================================\n");
     
     signal(SIGINT, handle_interrupt);
     signal(SIGTERM, handle_interrupt);
+    reload_signal_init(); //* Before the first thread, so every thread inherits the mask
     
-    srand(time(NULL));
+    srand(virtual_clock_enabled ? (unsigned)run_options.simulate_seed : (unsigned)time(NULL));
     
     if (curl_global_init(CURL_GLOBAL_ALL) != CURLE_OK) {
         fprintf(stderr, "CURL initialization failed\n");
         return 1;
     }
     
-    proxy_storage = calloc(PROXY_CAPACITY, sizeof(ProxyRecord));
+    proxy_storage = calloc(run_options.proxy_capacity, sizeof(ProxyRecord));
     if (!proxy_storage) {
         fprintf(stderr, "Memory allocation failed for proxy storage\n");
         curl_global_cleanup();
         return 1;
     }
     
-    if (pthread_mutex_init(&storage_mutex, NULL) != 0 ||
-        pthread_mutex_init(&file_mutex, NULL) != 0 ||
-        pthread_mutex_init(&log_mutex, NULL) != 0) {
+    if (pthread_mutex_init(&storage_mutex.mutex, NULL) != 0 ||
+        pthread_mutex_init(&file_mutex.mutex, NULL) != 0 ||
+        pthread_mutex_init(&log_mutex.mutex, NULL) != 0) {
         fprintf(stderr, "Mutex initialization failed\n");
         if (proxy_storage) free(proxy_storage);
         curl_global_cleanup();
         return 1;
     }
     
+    if (!start_log_writer()) {
+        fprintf(stderr, "Log ring allocation failed; continuing without logs\n");
+    }
+    
+    if (!virtual_clock_enabled)
+        load_probe_histories(); //* A simulation starts from an empty world every time
+    
     autonomous_operation();
     
     cleanup_resources();
     
     printf("\n🎉 PARSER COMPLETED SUCCESSFULLY!\n");
     printf("Total proxies found: %u\n", atomic_load(&stats.total_proxies));
-    printf("Unique proxies: %u\n", atomic_load(&stats.unique_proxies));
+    printf("Unique proxies: %llu\n", (unsigned long long)stats_total(STAT_UNIQUE_PROXIES));
     printf("Check proxies.json and proxies.txt for results.\n");
     
     return 0;
-}
\ No newline at end of file
+}
+#endif //* MTP_NO_MAIN
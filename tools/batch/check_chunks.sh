@@ -0,0 +1,56 @@
+#!/bin/sh
+# Checks that mtp_batch finds the same proxies however an input is split into chunks.
+# The input is one long line, like minified JSON or HTML, so chunk ends cannot move
+# to a line break. Proxies straddle the first few 1 MiB chunk edges at different
+# offsets. Every --chunk-mb 1 run must match the single-chunk run: no proxy may go
+# missing, and no truncated tail of one may show up as a proxy of its own.
+#
+# Usage: tools/batch/check_chunks.sh [mtp_batch-binary]
+#   (run from the repository root after `make batch`)
+set -eu
+
+BATCH=${1:-./mtp_batch}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+#* 3.5 MiB of '{"id":N},' records on one line; before each of the first three MiB
+#* boundaries a proxy starts 10, 30 and 50 bytes short of it
+awk 'BEGIN {
+    size = 3.5 * 1048576
+    written = 0
+    edge = 1048576
+    n = 0
+    while (written < size) {
+        if (edge <= 3 * 1048576 && written >= edge - 60) {
+            lead = edge - written - 10 * (2 * (edge / 1048576) - 1)
+            pad = lead > 0 ? sprintf("%" lead "s", "") : ""
+            token = sprintf("%s proxyhost%d.example.com:443:ee00112233445566778899aabbccdd%04x ", pad, edge / 1048576, edge / 1048576)
+            printf "%s", token
+            written += length(token)
+            edge += 1048576
+            continue
+        }
+        record = sprintf("{\"id\":%d},", n++)
+        printf "%s", record
+        written += length(record)
+    }
+}' > "$WORK/line.txt"
+
+"$BATCH" --quiet --chunk-mb 4096 "$WORK/line.txt" | sort > "$WORK/single.links"
+expected=$(wc -l < "$WORK/single.links")
+if [ "$expected" -ne 3 ]; then
+    echo "chunks: expected 3 proxies from the single-chunk run, got $expected"
+    exit 1
+fi
+status=0
+for threads in 1 2 4; do
+    "$BATCH" --quiet --chunk-mb 1 --threads "$threads" "$WORK/line.txt" | sort > "$WORK/split.links"
+    if cmp -s "$WORK/single.links" "$WORK/split.links"; then
+        echo "chunks: --chunk-mb 1 --threads $threads finds the same $expected proxies"
+    else
+        echo "chunks: MISMATCH with --chunk-mb 1 --threads $threads"
+        diff "$WORK/single.links" "$WORK/split.links" || true
+        status=1
+    fi
+done
+exit "$status"
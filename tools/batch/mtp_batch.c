@@ -0,0 +1,641 @@
+/**
+ * @file mtp_batch.c
+ * @brief One-shot batch extraction over local files, directories and stdin: maps
+ *        every input, scans it in parallel chunks with libmtparse, deduplicates
+ *        across all inputs and writes one JSON or text export.
+ *
+ * Build (from the repository root; also `make batch`):
+ *   gcc -O2 -std=gnu11 tools/batch/mtp_batch.c lib/mtparse.c data/data.c -o mtp_batch -lpthread -lpcre2-8
+ *
+ *   ./mtp_batch dumps/ chat_export.html > proxies.txt
+ *   zcat archive.gz | ./mtp_batch --format json --output proxies.json
+ *
+ * Inputs are taken in command-line order, directories recursively in name order.
+ * Each file is mapped once and split into --chunk-mb chunks that end at a line break
+ * when one is near. A worker scans from BATCH_CHUNK_OVERLAP bytes before its chunk to
+ * BATCH_CHUNK_OVERLAP bytes past it and keeps the matches that start inside its own:
+ * the lead-in lets a match that begins in the previous chunk consume its tail, so a
+ * chunk that starts mid-token (a long line without breaks) does not report the token's
+ * suffix as a proxy of its own. Like the library's stream mode, a match longer than
+ * the overlap that straddles a chunk edge can be missed. Chunks are
+ * merged into one MtpStore in input order, so the output order (first appearance)
+ * and the `reports` counts (chunks carrying the proxy) do not depend on the thread
+ * count.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../../headers/mtparse.h"
+
+#define BATCH_MAX_THREADS 256 //** Ceiling of --threads
+#define BATCH_CHUNK_MB 16 //** Default chunk size; big enough to amortize a pass, small enough to spread one file over every core
+#define BATCH_CHUNK_OVERLAP MTP_DEFAULT_STREAM_OVERLAP //** Bytes scanned before and past a chunk for matches that cross its edges
+#define BATCH_LINE_SEARCH 65536 //** A chunk end moves to the next line break within this many bytes, else stays put
+#define BATCH_WINDOW_PER_THREAD 4 //** Chunks a worker may finish ahead of the merge before it waits
+#define BATCH_CANDIDATE_BYTES 32 //** One accepted candidate per this many chunk bytes sizes the extractor's dedup set
+#define BATCH_STDIN_BLOCK (1 << 20) //** Read size while buffering a non-seekable stdin
+#define BATCH_OUTPUT_BUFFER (1 << 20) //** stdio buffer of the export stream
+
+//* =============== INPUTS ===============
+
+/**
+ * @brief One file (or stdin) to extract from. `data` is mapped, or malloc'd for a
+ *        piped stdin, when its first chunk is handed out, and released with its last.
+ */
+typedef struct {
+    char *path;           //* "-" for stdin
+    size_t size;
+    const char *data;
+    int mapped;          //* data came from mmap (else malloc)
+    int chunks;
+    int remaining;      //* Chunks not yet scanned; the data goes when it reaches 0
+} BatchInput;
+
+static BatchInput *inputs;
+static int input_count;
+static int input_capacity;
+static int input_errors;
+
+static int add_input(const char *path, size_t size) {
+    if (input_count == input_capacity) {
+        int capacity = input_capacity ? input_capacity * 2 : 64;
+        BatchInput *grown = realloc(inputs, (size_t)capacity * sizeof(BatchInput));
+        if (!grown)
+            return 0;
+        inputs = grown;
+        input_capacity = capacity;
+    }
+    BatchInput *input = &inputs[input_count];
+    memset(input, 0, sizeof(*input));
+    input->path = strdup(path);
+    input->size = size;
+    if (!input->path)
+        return 0;
+    input_count++;
+    return 1;
+}
+
+//* Reads a pipe or terminal to the end; a regular file on stdin is mapped like any other
+static int buffer_stdin(BatchInput *input) {
+    size_t length = 0, capacity = 0;
+    char *buffer = NULL;
+    for (;;) {
+        if (capacity - length < BATCH_STDIN_BLOCK) {
+            capacity = capacity ? capacity * 2 : 4 * BATCH_STDIN_BLOCK;
+            char *grown = realloc(buffer, capacity);
+            if (!grown) {
+                free(buffer);
+                return 0;
+            }
+            buffer = grown;
+        }
+        ssize_t got = read(STDIN_FILENO, buffer + length, capacity - length);
+        if (got == 0)
+            break;
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            free(buffer);
+            return 0;
+        }
+        length += (size_t)got;
+    }
+    input->data = buffer;
+    input->size = length;
+    return 1;
+}
+
+//* Symlinked directories are not followed inside a walk, so a link loop cannot recurse forever
+static void collect_path(const char *path, int top_level) {
+    struct stat info;
+    if (strcmp(path, "-") == 0) {
+        for (int i = 0; i < input_count; i++) {
+            if (strcmp(inputs[i].path, "-") == 0)
+                return;
+        }
+        if (fstat(STDIN_FILENO, &info) == 0 && S_ISREG(info.st_mode)) {
+            add_input(path, (size_t)info.st_size);
+        } else if (add_input(path, 0) && !buffer_stdin(&inputs[input_count - 1])) {
+            fprintf(stderr, "Cannot read stdin: %s\n", strerror(errno));
+            input_errors++;
+        }
+        return;
+    }
+    if (stat(path, &info) != 0) {
+        fprintf(stderr, "Cannot stat %s: %s\n", path, strerror(errno));
+        input_errors++;
+        return;
+    }
+    if (S_ISREG(info.st_mode)) {
+        if (info.st_size > 0 && !add_input(path, (size_t)info.st_size)) {
+            fprintf(stderr, "Out of memory listing inputs\n");
+            input_errors++;
+        }
+        return;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        if (top_level)
+            fprintf(stderr, "Skipping %s: not a regular file or directory\n", path);
+        return;
+    }
+    if (!top_level && lstat(path, &info) == 0 && S_ISLNK(info.st_mode))
+        return;
+
+    struct dirent **entries = NULL;
+    int count = scandir(path, &entries, NULL, alphasort);
+    if (count < 0) {
+        fprintf(stderr, "Cannot read directory %s: %s\n", path, strerror(errno));
+        input_errors++;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        const char *name = entries[i]->d_name;
+        if (strcmp(name, ".") != 0 && strcmp(name, "..") != 0) {
+            size_t length = strlen(path) + strlen(name) + 2;
+            char *child = malloc(length);
+            if (child) {
+                snprintf(child, length, "%s%s%s", path, path[strlen(path) - 1] == '/' ? "" : "/", name);
+                collect_path(child, 0);
+                free(child);
+            }
+        }
+        free(entries[i]);
+    }
+    free(entries);
+}
+
+static int map_input(BatchInput *input) {
+    if (input->data)
+        return 1; //* Buffered stdin
+    int fd = strcmp(input->path, "-") == 0 ? dup(STDIN_FILENO) : open(input->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    void *data = mmap(NULL, input->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+    madvise(data, input->size, MADV_SEQUENTIAL);
+    input->data = data;
+    input->mapped = 1;
+    return 1;
+}
+
+static void release_input(BatchInput *input) {
+    if (input->mapped)
+        munmap((void *)input->data, input->size);
+    else
+        free((void *)input->data);
+    input->data = NULL;
+}
+
+//* =============== CHUNK RESULTS ===============
+
+/**
+ * @brief A candidate copied out of a chunk: the three fields sit back to back in
+ *        the chunk's arena, since the mapping is gone by the time it is merged.
+ */
+typedef struct {
+    uint64_t hash;
+    size_t offset;          //* server, then port, then secret in the arena
+    uint16_t server_length;
+    uint16_t port_length;
+    uint16_t secret_length;
+    int is_ip;
+} BatchEntry;
+
+/**
+ * @brief What one worker found in one chunk, waiting for its turn in the merge.
+ */
+typedef struct {
+    BatchEntry *entries;
+    size_t count;
+    size_t capacity;
+    char *arena;
+    size_t arena_length;
+    size_t arena_capacity;
+    uint64_t lead;     //* Matches starting before this offset belong to the previous chunk
+    uint64_t owned;   //* Matches starting at or past lead + owned belong to the next chunk
+    size_t bytes;
+    int failed;
+    int ready;
+} ChunkResult;
+
+static int arena_append(ChunkResult *result, MtpSpan span) {
+    if (result->arena_capacity - result->arena_length < span.length) {
+        size_t capacity = result->arena_capacity ? result->arena_capacity * 2 : 64 * 1024;
+        while (capacity - result->arena_length < span.length)
+            capacity *= 2;
+        char *grown = realloc(result->arena, capacity);
+        if (!grown)
+            return 0;
+        result->arena = grown;
+        result->arena_capacity = capacity;
+    }
+    memcpy(result->arena + result->arena_length, span.data, span.length);
+    result->arena_length += span.length;
+    return 1;
+}
+
+static int on_candidate(void *user, const MtpCandidate *candidate) {
+    ChunkResult *result = user;
+    if (candidate->match_offset < result->lead || candidate->match_offset - result->lead >= result->owned)
+        return 0;
+    if (result->count == result->capacity) {
+        size_t capacity = result->capacity ? result->capacity * 2 : 1024;
+        BatchEntry *grown = realloc(result->entries, capacity * sizeof(BatchEntry));
+        if (!grown) {
+            result->failed = 1;
+            return 1;
+        }
+        result->entries = grown;
+        result->capacity = capacity;
+    }
+    BatchEntry *entry = &result->entries[result->count];
+    entry->hash = candidate->hash;
+    entry->offset = result->arena_length;
+    entry->server_length = (uint16_t)candidate->server.length;
+    entry->port_length = (uint16_t)candidate->port.length;
+    entry->secret_length = (uint16_t)candidate->secret.length;
+    entry->is_ip = candidate->is_ip;
+    if (!arena_append(result, candidate->server) || !arena_append(result, candidate->port) ||
+        !arena_append(result, candidate->secret)) {
+        result->failed = 1;
+        return 1;
+    }
+    result->count++;
+    return 0;
+}
+
+static void chunk_result_free(ChunkResult *result) {
+    free(result->entries);
+    free(result->arena);
+    memset(result, 0, sizeof(*result));
+}
+
+//* =============== SCHEDULER ===============
+
+/**
+ * @brief Hands out chunks in input order and keeps at most `window` of them
+ *        between the next chunk to merge and the next one to scan.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t issue_cond;  //* Workers: a window slot was merged
+    pthread_cond_t merge_cond; //* Merger: a chunk finished or the plan ran out
+    int cursor_input;
+    int cursor_chunk;
+    int plan_done;
+    uint64_t issued;
+    uint64_t merged;
+    int window;
+    ChunkResult *slots;       //* Indexed by chunk sequence % window
+} BatchScheduler;
+
+/**
+ * @brief A chunk handed to a worker.
+ */
+typedef struct {
+    int input;
+    int chunk;
+    uint64_t sequence;
+} BatchTask;
+
+static BatchScheduler scheduler = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .issue_cond = PTHREAD_COND_INITIALIZER,
+    .merge_cond = PTHREAD_COND_INITIALIZER
+};
+static size_t chunk_size = (size_t)BATCH_CHUNK_MB << 20;
+static int max_candidates;
+
+//* Takes the next chunk under the scheduler mutex. The first chunk of an input maps it
+//* here: mmap only reserves address space, so holding the lock for it is cheap.
+static int next_task(BatchTask *task) {
+    while (scheduler.cursor_input < input_count) {
+        BatchInput *input = &inputs[scheduler.cursor_input];
+        if (scheduler.cursor_chunk == 0) {
+            input->chunks = input->size ? (int)((input->size + chunk_size - 1) / chunk_size) : 0;
+            input->remaining = input->chunks;
+            if (input->chunks > 0 && !map_input(input)) {
+                fprintf(stderr, "Cannot map %s: %s\n", input->path, strerror(errno));
+                input_errors++;
+                input->chunks = 0;
+            }
+        }
+        if (scheduler.cursor_chunk < input->chunks) {
+            task->input = scheduler.cursor_input;
+            task->chunk = scheduler.cursor_chunk++;
+            task->sequence = scheduler.issued++;
+            return 1;
+        }
+        scheduler.cursor_input++;
+        scheduler.cursor_chunk = 0;
+    }
+    scheduler.plan_done = 1;
+    pthread_cond_broadcast(&scheduler.merge_cond);
+    return 0;
+}
+
+//* Chunk k ends (and k + 1 starts) just past the first line break at or after its
+//* nominal end; both neighbours compute the same position from the same bytes
+static size_t chunk_boundary(const BatchInput *input, size_t nominal) {
+    if (nominal == 0 || nominal >= input->size)
+        return nominal < input->size ? nominal : input->size;
+    size_t span = input->size - (nominal - 1);
+    if (span > BATCH_LINE_SEARCH)
+        span = BATCH_LINE_SEARCH;
+    const char *newline = memchr(input->data + nominal - 1, '\n', span);
+    return newline ? (size_t)(newline - input->data) + 1 : nominal;
+}
+
+static void scan_chunk(MtpExtractor *extractor, const BatchTask *task, ChunkResult *result) {
+    const BatchInput *input = &inputs[task->input];
+    size_t start = chunk_boundary(input, (size_t)task->chunk * chunk_size);
+    size_t end = chunk_boundary(input, (size_t)(task->chunk + 1) * chunk_size);
+    if (end <= start)
+        return;
+    size_t scan_start = start > BATCH_CHUNK_OVERLAP ? start - BATCH_CHUNK_OVERLAP : 0;
+    size_t scan_end = input->size - end > BATCH_CHUNK_OVERLAP ? end + BATCH_CHUNK_OVERLAP : input->size;
+    if (input->mapped) {
+        //* Start readahead for the whole chunk now, so page-ins overlap across workers
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t aligned = scan_start & ~(page - 1);
+        madvise((void *)(input->data + aligned), scan_end - aligned, MADV_WILLNEED);
+    }
+    result->lead = start - scan_start;
+    result->owned = end - start;
+    result->bytes = end - start;
+    mtp_extractor_set_user(extractor, result);
+    if (mtp_extract_buffer(extractor, input->data + scan_start, scan_end - scan_start) < 0)
+        result->failed = 1;
+}
+
+static void *batch_worker(void *arg) {
+    (void)arg;
+    MtpOptions options = {0};
+    options.on_candidate = on_candidate;
+    options.max_candidates = max_candidates;
+    MtpExtractor *extractor = mtp_extractor_create(&options);
+
+    pthread_mutex_lock(&scheduler.mutex);
+    for (;;) {
+        while (!scheduler.plan_done && scheduler.issued >= scheduler.merged + (uint64_t)scheduler.window)
+            pthread_cond_wait(&scheduler.issue_cond, &scheduler.mutex);
+        BatchTask task;
+        if (!next_task(&task))
+            break;
+        pthread_mutex_unlock(&scheduler.mutex);
+
+        ChunkResult result = {0};
+        if (extractor)
+            scan_chunk(extractor, &task, &result);
+        else
+            result.failed = 1;
+
+        pthread_mutex_lock(&scheduler.mutex);
+        BatchInput *input = &inputs[task.input];
+        if (--input->remaining == 0)
+            release_input(input);
+        if (result.failed) {
+            fprintf(stderr, "Extraction failed in %s (chunk %d)\n", input->path, task.chunk);
+            input_errors++;
+        }
+        result.ready = 1;
+        scheduler.slots[task.sequence % (uint64_t)scheduler.window] = result;
+        pthread_cond_broadcast(&scheduler.merge_cond);
+    }
+    pthread_mutex_unlock(&scheduler.mutex);
+    mtp_extractor_free(extractor);
+    return NULL;
+}
+
+//* =============== MERGE + EXPORT ===============
+
+/**
+ * @brief Totals for the closing summary line.
+ */
+typedef struct {
+    uint64_t bytes;
+    uint64_t chunks;
+    uint64_t candidates;
+} BatchTotals;
+
+static int merge_chunk(MtpStore *store, const ChunkResult *result, BatchTotals *totals) {
+    totals->bytes += result->bytes;
+    totals->chunks++;
+    totals->candidates += result->count;
+    for (size_t i = 0; i < result->count; i++) {
+        const BatchEntry *entry = &result->entries[i];
+        const char *fields = result->arena + entry->offset;
+        MtpCandidate candidate = {0};
+        candidate.server = (MtpSpan){ fields, entry->server_length };
+        candidate.port = (MtpSpan){ fields + entry->server_length, entry->port_length };
+        candidate.secret = (MtpSpan){ fields + entry->server_length + entry->port_length, entry->secret_length };
+        candidate.hash = entry->hash;
+        candidate.is_ip = entry->is_ip;
+        if (mtp_store_add(store, &candidate) < 0)
+            return 0;
+    }
+    return 1;
+}
+
+//* Runs on the main thread: takes finished chunks strictly in sequence
+static int merge_all(MtpStore *store, BatchTotals *totals) {
+    int ok = 1;
+    pthread_mutex_lock(&scheduler.mutex);
+    for (;;) {
+        ChunkResult *slot = &scheduler.slots[scheduler.merged % (uint64_t)scheduler.window];
+        while (!slot->ready && !(scheduler.plan_done && scheduler.merged == scheduler.issued))
+            pthread_cond_wait(&scheduler.merge_cond, &scheduler.mutex);
+        if (!slot->ready)
+            break;
+        ChunkResult result = *slot;
+        memset(slot, 0, sizeof(*slot));
+        pthread_mutex_unlock(&scheduler.mutex);
+
+        if (ok && !merge_chunk(store, &result, totals)) {
+            fprintf(stderr, "Out of memory merging results\n");
+            ok = 0;
+        }
+        chunk_result_free(&result);
+
+        pthread_mutex_lock(&scheduler.mutex);
+        scheduler.merged++;
+        pthread_cond_broadcast(&scheduler.issue_cond);
+    }
+    pthread_mutex_unlock(&scheduler.mutex);
+    return ok;
+}
+
+//* --output goes through a temporary file, so a failed run leaves the old export in place
+static int write_export(const MtpStore *store, const char *format, const char *output_path) {
+    char tmp_path[PATH_MAX];
+    FILE *out = stdout;
+    if (output_path) {
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", output_path);
+        out = fopen(tmp_path, "w");
+        if (!out) {
+            fprintf(stderr, "Cannot write %s: %s\n", tmp_path, strerror(errno));
+            return 0;
+        }
+    }
+    setvbuf(out, NULL, _IOFBF, BATCH_OUTPUT_BUFFER);
+    long written = strcmp(format, "json") == 0 ? mtp_store_write_json(store, out) : mtp_store_write_text(store, out);
+    int ok = written >= 0;
+    if (output_path) {
+        ok = fclose(out) == 0 && ok && rename(tmp_path, output_path) == 0;
+        if (!ok)
+            unlink(tmp_path);
+    } else {
+        ok = fflush(out) == 0 && ok;
+    }
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", output_path ? output_path : "stdout");
+    return ok;
+}
+
+//* =============== MAIN ===============
+
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+//* Parses a whole decimal argument within [min, max]; reports and returns 0 otherwise
+static int parse_number_flag(const char *flag, const char *value, long min, long max, long *out) {
+    char *end = NULL;
+    errno = 0;
+    long number = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || number < min || number > max) {
+        fprintf(stderr, "Invalid %s value: %s (expected %ld..%ld)\n", flag, value, min, max);
+        return 0;
+    }
+    *out = number;
+    return 1;
+}
+
+static void batch_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options] [FILE|DIR|-]...\n"
+            "  --format txt|json  Export format (default txt: one tg:// link per line)\n"
+            "  --output PATH      Write the export here instead of stdout\n"
+            "  --threads N        Extraction threads (default: one per online CPU, max %d)\n"
+            "  --chunk-mb N       Split files into chunks of about N MiB (default %d)\n"
+            "  --quiet            No summary line on stderr\n"
+            "Directories are read recursively; '-' or no path at all reads stdin.\n",
+            program, BATCH_MAX_THREADS, BATCH_CHUNK_MB);
+}
+
+int main(int argc, char *argv[]) {
+    const char *format = "txt", *output_path = NULL;
+    int threads = 0, quiet = 0, path_count = 0;
+    long chunk_mb = BATCH_CHUNK_MB;
+    char **paths = calloc((size_t)argc + 1, sizeof(char *));
+    if (!paths)
+        return 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            batch_usage(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = 1;
+        } else if (strcmp(argv[i], "--") == 0) {
+            while (++i < argc)
+                paths[path_count++] = argv[i];
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            if (!value) {
+                batch_usage(argv[0]);
+                return 2;
+            }
+            if (strcmp(argv[i], "--format") == 0 && (strcmp(value, "txt") == 0 || strcmp(value, "json") == 0)) {
+                format = value, i++;
+            } else if (strcmp(argv[i], "--output") == 0) {
+                output_path = value, i++;
+            } else if (strcmp(argv[i], "--threads") == 0) {
+                long number = 0;
+                if (!parse_number_flag(argv[i], value, 0, BATCH_MAX_THREADS, &number))
+                    return 2;
+                threads = (int)number, i++;
+            } else if (strcmp(argv[i], "--chunk-mb") == 0) {
+                if (!parse_number_flag(argv[i], value, 1, 4096, &chunk_mb))
+                    return 2;
+                i++;
+            } else {
+                batch_usage(argv[0]);
+                return 2;
+            }
+        } else {
+            paths[path_count++] = argv[i];
+        }
+    }
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online < 1 ? 1 : online > BATCH_MAX_THREADS ? BATCH_MAX_THREADS : (int)online;
+    }
+    chunk_size = (size_t)chunk_mb << 20;
+    size_t candidates = chunk_size / BATCH_CANDIDATE_BYTES;
+    max_candidates = candidates < MTP_DEFAULT_MAX_CANDIDATES ? MTP_DEFAULT_MAX_CANDIDATES
+                   : candidates > INT_MAX / 4 ? INT_MAX / 4 : (int)candidates;
+
+    double started = monotonic_seconds();
+    if (path_count == 0)
+        paths[path_count++] = "-";
+    for (int i = 0; i < path_count; i++)
+        collect_path(paths[i], 1);
+    free(paths);
+
+    scheduler.window = threads * BATCH_WINDOW_PER_THREAD;
+    scheduler.slots = calloc((size_t)scheduler.window, sizeof(ChunkResult));
+    MtpStore *store = mtp_store_create(0);
+    if (!scheduler.slots || !store) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    pthread_t workers[BATCH_MAX_THREADS];
+    int started_threads = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, batch_worker, NULL) != 0)
+            break;
+        started_threads++;
+    }
+    if (started_threads == 0) {
+        fprintf(stderr, "Cannot start worker threads\n");
+        return 1;
+    }
+    BatchTotals totals = {0};
+    int ok = merge_all(store, &totals);
+    for (int i = 0; i < started_threads; i++)
+        pthread_join(workers[i], NULL);
+    double scanned = monotonic_seconds() - started;
+
+    ok = ok && write_export(store, format, output_path);
+    if (!quiet) {
+        fprintf(stderr, "%d inputs, %.1f MiB in %llu chunks, %llu candidates, %zu unique proxies; "
+                "%.2f s on %d threads (%.1f MiB/s)\n",
+                input_count, (double)totals.bytes / (1 << 20), (unsigned long long)totals.chunks,
+                (unsigned long long)totals.candidates, mtp_store_count(store), scanned, started_threads,
+                scanned > 0 ? (double)totals.bytes / (1 << 20) / scanned : 0.0);
+    }
+
+    mtp_store_free(store);
+    free(scheduler.slots);
+    for (int i = 0; i < input_count; i++)
+        free(inputs[i].path);
+    free(inputs);
+    return !ok ? 1 : input_errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file fuzz_extract.c
+ * @brief Coverage-guided harness for extract_proxies_from_content() and the field
+ *        normalizers. Crashes and sanitizer reports are findings as usual; so is any
+ *        input whose extraction time exceeds the slow threshold (it aborts with
+ *        "mtp-fuzz: slow input" so the fuzzer saves and can minimize it).
+ *
+ * libFuzzer:
+ *   clang -O1 -g -std=gnu11 -fsanitize=fuzzer,address,undefined tools/fuzz/fuzz_extract.c lib/mtparse.c data/data.c \
+ *       -o fuzz_extract -lpthread -lcurl -lpcre2-8 -ljansson -lz -lm
+ * AFL++ (same source, libFuzzer-compatible driver):
+ *   afl-clang-fast -O1 -g -std=gnu11 -fsanitize=fuzzer tools/fuzz/fuzz_extract.c lib/mtparse.c data/data.c \
+ *       -o fuzz_extract_afl -lpthread -lcurl -lpcre2-8 -ljansson -lz -lm
+ * Plain replay of saved inputs (any compiler, no fuzzing engine):
+ *   gcc -O2 -std=gnu11 -DMTP_FUZZ_STANDALONE tools/fuzz/fuzz_extract.c lib/mtparse.c data/data.c \
+ *       -o fuzz_extract_replay -lpthread -lcurl -lpcre2-8 -ljansson -lz -lm
+ *
+ * Environment:
+ *   MTP_FUZZ_SLOW_NS_PER_BYTE  Slow when extraction takes longer than this per input byte (default 2000)
+ *   MTP_FUZZ_SLOW_FLOOR_MS     ...and longer than this in total (default 25; covers the first call's pattern compiles)
+ *   MTP_FUZZ_NO_SLOW           Set to report timings without treating slow inputs as findings
+ *
+ * tools/fuzz/run_fuzz.sh drives a campaign and promotes minimized slow inputs into bench/corpus/.
+ */
+
+#define MTP_NO_MAIN
+#include "../../mtproto_parser.c"
+
+#define FUZZ_CONFIRM_RUNS 3 //** A slow first run is re-measured; the fastest of these must still be slow
+
+static double slow_ns_per_byte = 2000.0;
+static double slow_floor_ns = 25e6;
+static int slow_findings_enabled = 1;
+
+static double env_number(const char *name, double fallback) {
+    const char *value = getenv(name);
+    return value && *value ? atof(value) : fallback;
+}
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void)argc;
+    (void)argv;
+    atomic_store(&log_threshold, LOG_LEVEL_ERROR + 1);
+    proxy_storage = calloc(PROXY_CAPACITY, sizeof(ProxyRecord));
+    if (!proxy_storage)
+        abort();
+    slow_ns_per_byte = env_number("MTP_FUZZ_SLOW_NS_PER_BYTE", slow_ns_per_byte);
+    slow_floor_ns = env_number("MTP_FUZZ_SLOW_FLOOR_MS", slow_floor_ns / 1e6) * 1e6;
+    slow_findings_enabled = getenv("MTP_FUZZ_NO_SLOW") == NULL;
+    return 0;
+}
+
+//* One extraction into an empty store; returns elapsed nanoseconds
+static uint64_t fuzz_extract_once(const char *content, size_t size) {
+    atomic_store(&stats.total_proxies, 0);
+    uint64_t start = monotonic_ns();
+    extract_proxies_from_content(content, size, "fuzz://input", -1);
+    return monotonic_ns() - start;
+}
+
+//* Feeds the first three lines straight to the per-field normalizers and validators
+static void fuzz_normalizers(const char *content, size_t size) {
+    char fields[3][512];
+    size_t limits[3] = { 256, 16, 512 };
+    const char *cursor = content, *end = content + size;
+    for (int f = 0; f < 3; f++) {
+        const char *newline = memchr(cursor, '\n', end - cursor);
+        size_t length = (newline ? newline : end) - cursor;
+        if (length >= limits[f])
+            length = limits[f] - 1;
+        memcpy(fields[f], cursor, length);
+        fields[f][length] = '\0';
+        cursor = newline ? newline + 1 : end;
+    }
+    for (int f = 0; f < 3; f++)
+        sanitize_string(fields[f]);
+    if (validate_proxy(fields[0], fields[1], fields[2]))
+        (void)compute_hash(fields[0], fields[1], fields[2]);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char *content = malloc(size + 1); //* Extraction expects a NUL-terminated body, like write_callback builds
+    if (!content)
+        return 0;
+    memcpy(content, data, size);
+    content[size] = '\0';
+
+    fuzz_normalizers(content, size);
+    uint64_t elapsed = fuzz_extract_once(content, size);
+
+    double limit = slow_ns_per_byte * (double)size;
+    if (limit < slow_floor_ns)
+        limit = slow_floor_ns;
+    if (slow_findings_enabled && elapsed > limit) {
+        for (int run = 1; run < FUZZ_CONFIRM_RUNS; run++) {
+            uint64_t again = fuzz_extract_once(content, size);
+            if (again < elapsed)
+                elapsed = again;
+        }
+        if (elapsed > limit) {
+            fprintf(stderr, "mtp-fuzz: slow input: %zu bytes in %.2f ms (%.0f ns/byte, limit %.2f ms)\n",
+                    size, elapsed / 1e6, size ? elapsed / (double)size : 0.0, limit / 1e6);
+            abort();
+        }
+    }
+    free(content);
+    return 0;
+}
+
+#ifdef MTP_FUZZ_STANDALONE
+//* Runs each file argument once and prints its timing; exits like the fuzzer would on findings
+int main(int argc, char *argv[]) {
+    LLVMFuzzerInitialize(&argc, &argv);
+    for (int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+        if (!file) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            return 1;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        uint8_t *data = malloc(size > 0 ? size : 1);
+        if (!data || (size > 0 && fread(data, 1, size, file) != (size_t)size)) {
+            fclose(file);
+            free(data);
+            return 1;
+        }
+        fclose(file);
+        uint64_t start = monotonic_ns();
+        LLVMFuzzerTestOneInput(data, size);
+        fprintf(stderr, "%s: %ld bytes, %.2f ms\n", argv[i], size, (monotonic_ns() - start) / 1e6);
+        free(data);
+    }
+    return 0;
+}
+#endif
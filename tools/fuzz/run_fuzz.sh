@@ -0,0 +1,84 @@
+#!/bin/sh
+# Fuzzes the extraction engine for a fixed time, then minimizes every slow-input finding
+# (harness slow aborts, libFuzzer timeouts and slow units) and promotes it into
+# bench/corpus/ so bench_extract (--corpus-dir bench/corpus) keeps measuring it. Crashes,
+# sanitizer reports and out-of-memory findings stay in the findings directory, and the
+# script then exits with status 1.
+#
+# Usage: tools/fuzz/run_fuzz.sh [seconds] [fuzzer-binary]
+#   (run from the repository root; build the binary as described in fuzz_extract.c)
+set -eu
+
+SECONDS_TO_RUN=${1:-600}
+FUZZER=${2:-./fuzz_extract}
+WORK=${MTP_FUZZ_WORKDIR:-fuzz-work}
+CORPUS_OUT=bench/corpus
+
+mkdir -p "$WORK/corpus" "$WORK/seeds" "$WORK/findings" "$CORPUS_OUT"
+
+# Seed with the synthetic benchmark corpus (small documents) plus anything already promoted
+if [ -x ./bench_extract ]; then
+    ./bench_extract --write-corpus "$WORK/seeds" --size 4 >/dev/null 2>&1 || true
+fi
+cp "$CORPUS_OUT"/slow-* "$WORK/seeds/" 2>/dev/null || true
+
+# Keep going after findings so one slow page does not end the campaign
+"$FUZZER" "$WORK/corpus" "$WORK/seeds" -max_total_time="$SECONDS_TO_RUN" -max_len=65536 \
+    -timeout=10 -fork=1 -ignore_crashes=1 -artifact_prefix="$WORK/findings/" || true
+
+# Copies a slow input into the benchmark corpus under a content-derived name
+promote() {
+    name="slow-$(sha1sum "$1" | cut -c1-12).txt"
+    if [ ! -e "$CORPUS_OUT/$name" ]; then
+        cp "$1" "$CORPUS_OUT/$name"
+        promoted=$((promoted + 1))
+        echo "promoted $CORPUS_OUT/$name ($(wc -c < "$1") bytes)"
+    fi
+}
+
+promoted=0
+unresolved=0
+for artifact in "$WORK"/findings/*; do
+    [ -e "$artifact" ] || continue
+    case "$(basename "$artifact")" in
+    *.min)
+        continue
+        ;;
+    crash-*)
+        if ! "$FUZZER" "$artifact" 2>&1 | grep -q "mtp-fuzz: slow input"; then
+            echo "crash/sanitizer finding kept in place: $artifact"
+            unresolved=$((unresolved + 1))
+            continue
+        fi
+        minimized="$artifact.min"
+        "$FUZZER" -minimize_crash=1 -runs=2000 -exact_artifact_path="$minimized" "$artifact" >/dev/null 2>&1 || true
+        [ -s "$minimized" ] || cp "$artifact" "$minimized"
+        # Minimization may shrink the input below the slow threshold; keep the original then
+        if ! "$FUZZER" "$minimized" 2>&1 | grep -q "mtp-fuzz: slow input"; then
+            cp "$artifact" "$minimized"
+        fi
+        promote "$minimized"
+        ;;
+    timeout-*)
+        # Past -timeout, so slow by any threshold; minimizing keeps only inputs that still time out
+        minimized="$artifact.min"
+        "$FUZZER" -minimize_crash=1 -runs=2000 -timeout=10 -exact_artifact_path="$minimized" "$artifact" \
+            >/dev/null 2>&1 || true
+        [ -s "$minimized" ] || cp "$artifact" "$minimized"
+        promote "$minimized"
+        ;;
+    slow-unit-*)
+        promote "$artifact"
+        ;;
+    *)
+        # oom-*, leak-* and anything else libFuzzer saves
+        echo "finding kept in place: $artifact"
+        unresolved=$((unresolved + 1))
+        ;;
+    esac
+done
+echo "slow inputs promoted: $promoted"
+if [ "$unresolved" -gt 0 ]; then
+    echo "findings needing attention: $unresolved (in $WORK/findings/)"
+    exit 1
+fi
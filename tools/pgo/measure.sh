@@ -0,0 +1,31 @@
+#!/bin/sh
+# Replays each archive through BINARY (single download slot, so runs are comparable)
+# RUNS times and prints the median of the summed cycle time in seconds.
+#
+# Usage: tools/pgo/measure.sh BINARY RUNS ARCHIVE...
+set -eu
+
+BINARY=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+RUNS=$2
+shift 2
+
+totals=""
+run=0
+while [ "$run" -lt "$RUNS" ]; do
+    total=0
+    for archive in "$@"; do
+        archive_path=$(cd "$(dirname "$archive")" && pwd)/$(basename "$archive")
+        scratch=$(mktemp -d)
+        (cd "$scratch" && "$BINARY" --replay "$archive_path" --concurrency 1 \
+            --cycle-report cycles.jsonl >/dev/null 2>&1) || true
+        ns=$(sed -n 's/.*"duration_ns":\([0-9]*\).*/\1/p' "$scratch/cycles.jsonl" 2>/dev/null |
+             awk '{ sum += $1 } END { printf "%d", sum }')
+        total=$((total + ${ns:-0}))
+        rm -rf "$scratch"
+    done
+    totals="$totals $total"
+    run=$((run + 1))
+done
+
+echo "$totals" | tr ' ' '\n' | sed '/^$/d' | sort -n |
+    awk '{ v[NR] = $1 } END { m = (NR % 2) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2; printf "%.6f\n", m / 1e9 }'
@@ -0,0 +1,336 @@
+/**
+ * @file mtp_merge.c
+ * @brief Merges the partial stores that sharded parser nodes publish (shard_dir/<node>.json)
+ *        into one proxies.json and proxies.txt, deduplicated by proxy hash.
+ *
+ * Build (from the repository root; also `make shard`):
+ *   gcc -O2 -std=gnu11 tools/shard/mtp_merge.c -o mtp_merge -ljansson
+ *
+ * Run:
+ *   ./mtp_merge shards/                        # every *.json in the directory
+ *   ./mtp_merge --output-dir public/ --max-age 600 shards/node-a.json shards/node-b.json
+ *
+ * Partials are merged in node-name order, so the output is the same whatever order the
+ * files are listed in. The membership is the "nodes" list of the most recently published
+ * partial: a node that has left it still has its file on disk, and that file is skipped
+ * (--all-nodes keeps it). A proxy reported by several nodes keeps its earliest discovery
+ * time and source, and the probe results (last_verified, speed_score, uptime) of the
+ * node that verified it last. Coverage compares the union of the owned sources with the
+ * size of the source list and warns when a node has not published yet.
+ *
+ * Exit status: 0 merged, 1 no usable partial or an output could not be written, 2 usage error.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <jansson.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MERGE_MAX_PARTIALS 256 //** Partial stores per run (one per node, plus strays)
+#define MERGE_TIME_FORMAT "%Y-%m-%d %H:%M:%S" //** Same timestamps as the parser's exports
+
+/**
+ * @brief One partial store as loaded from disk.
+ */
+typedef struct {
+    char path[PATH_MAX];
+    char node[64];         //* shard.node, or the file name for an unsharded proxies.json
+    json_t *root;
+    json_t *shard;        //* Borrowed from root; NULL when the file has no "shard" object
+    long long published; //* shard.published, 0 when unknown
+} Partial;
+
+static Partial partials[MERGE_MAX_PARTIALS];
+static int partial_count = 0;
+
+static const char* string_field(const json_t *object, const char *key) {
+    const char *value = json_string_value(json_object_get(object, key));
+    return value ? value : "";
+}
+
+static void load_partial(const char *path) {
+    if (partial_count == MERGE_MAX_PARTIALS) {
+        fprintf(stderr, "Skipping %s: more than %d partials\n", path, MERGE_MAX_PARTIALS);
+        return;
+    }
+    json_error_t error;
+    json_t *root = json_load_file(path, 0, &error);
+    if (!root || !json_is_array(json_object_get(root, "proxies"))) {
+        fprintf(stderr, "Skipping %s: %s\n", path, root ? "no \"proxies\" array" : error.text);
+        json_decref(root);
+        return;
+    }
+    Partial *partial = &partials[partial_count++];
+    snprintf(partial->path, sizeof(partial->path), "%s", path);
+    partial->root = root;
+    partial->shard = json_object_get(root, "shard");
+    if (!json_is_object(partial->shard))
+        partial->shard = NULL;
+    const char *node = partial->shard ? string_field(partial->shard, "node") : "";
+    if (!*node) {
+        const char *slash = strrchr(path, '/');
+        node = slash ? slash + 1 : path;
+    }
+    snprintf(partial->node, sizeof(partial->node), "%s", node);
+    partial->published = partial->shard ? json_integer_value(json_object_get(partial->shard, "published")) : 0;
+}
+
+static int is_json_name(const struct dirent *entry) {
+    size_t length = strlen(entry->d_name);
+    return length > 5 && entry->d_name[0] != '.' && strcmp(entry->d_name + length - 5, ".json") == 0;
+}
+
+static void load_path(const char *path) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        fprintf(stderr, "Cannot stat %s: %s\n", path, strerror(errno));
+        return;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        load_partial(path);
+        return;
+    }
+    struct dirent **entries = NULL;
+    int count = scandir(path, &entries, is_json_name, alphasort);
+    for (int i = 0; i < count; i++) {
+        char child[PATH_MAX];
+        snprintf(child, sizeof(child), "%s/%s", path, entries[i]->d_name);
+        load_partial(child);
+        free(entries[i]);
+    }
+    free(entries);
+}
+
+static int compare_partials(const void *a, const void *b) {
+    const Partial *partial_a = a, *partial_b = b;
+    int order = strcmp(partial_a->node, partial_b->node);
+    return order ? order : strcmp(partial_a->path, partial_b->path);
+}
+
+//* "nodes" of the newest partial that has one
+static const json_t* current_membership(void) {
+    const Partial *newest = NULL;
+    for (int i = 0; i < partial_count; i++) {
+        if (partials[i].shard && json_is_array(json_object_get(partials[i].shard, "nodes")) &&
+            (!newest || partials[i].published > newest->published))
+            newest = &partials[i];
+    }
+    return newest ? json_object_get(newest->shard, "nodes") : NULL;
+}
+
+static int is_member(const json_t *membership, const char *node) {
+    size_t index;
+    json_t *value;
+    json_array_foreach(membership, index, value) {
+        if (strcmp(json_string_value(value) ? json_string_value(value) : "", node) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+//* Folds `incoming` into `kept`, both records of the same proxy
+static void merge_record(json_t *kept, json_t *incoming) {
+    const char *kept_discovered = string_field(kept, "discovered");
+    const char *incoming_discovered = string_field(incoming, "discovered");
+    if (*incoming_discovered && (!*kept_discovered || strcmp(incoming_discovered, kept_discovered) < 0)) {
+        json_object_set(kept, "discovered", json_object_get(incoming, "discovered"));
+        json_object_set(kept, "source", json_object_get(incoming, "source"));
+    }
+    if (strcmp(string_field(incoming, "last_verified"), string_field(kept, "last_verified")) > 0) {
+        static const char *const PROBE_FIELDS[] = {"last_verified", "speed_score", "uptime"};
+        for (size_t f = 0; f < sizeof(PROBE_FIELDS) / sizeof(PROBE_FIELDS[0]); f++) {
+            json_t *value = json_object_get(incoming, PROBE_FIELDS[f]);
+            if (value)
+                json_object_set(kept, PROBE_FIELDS[f], value);
+        }
+    }
+}
+
+static int write_atomically(const char *path, int (*writer)(FILE *, const void *), const void *data) {
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *out = fopen(tmp_path, "w");
+    if (!out) {
+        fprintf(stderr, "Cannot write %s: %s\n", tmp_path, strerror(errno));
+        return 0;
+    }
+    int ok = writer(out, data);
+    ok = fclose(out) == 0 && ok && rename(tmp_path, path) == 0;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        unlink(tmp_path);
+    }
+    return ok;
+}
+
+static int write_json(FILE *out, const void *data) {
+    return json_dumpf((const json_t *)data, out, JSON_INDENT(2) | JSON_PRESERVE_ORDER) == 0;
+}
+
+//* Same header as the parser's proxies.txt
+static int write_text(FILE *out, const void *data) {
+    const json_t *root = data;
+    const json_t *proxies = json_object_get(root, "proxies");
+    fprintf(out, "# MTPROTO PROXY LIST\n");
+    fprintf(out, "# Updated: %s\n", string_field(root, "updated"));
+    fprintf(out, "# Total proxies: %lld\n", (long long)json_integer_value(json_object_get(root, "total_proxies")));
+    fprintf(out, "# Sources: %lld URLs processed\n", (long long)json_integer_value(json_object_get(root, "sources_processed")));
+    fprintf(out, "# Unique proxies: %lld\n", (long long)json_integer_value(json_object_get(root, "unique_proxies")));
+    fprintf(out, "# Merged from %lld shard stores\n\n", (long long)json_array_size(json_object_get(root, "shards")));
+    size_t index;
+    json_t *proxy;
+    json_array_foreach(proxies, index, proxy)
+        fprintf(out, "%s\n", string_field(proxy, "url"));
+    return !ferror(out);
+}
+
+static void merge_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options] FILE|DIR...\n"
+            "  --output-dir DIR  Write proxies.json and proxies.txt here (default .)\n"
+            "  --max-age S       Skip partials published more than S seconds ago\n"
+            "  --all-nodes       Also merge partials of nodes no longer in the membership\n",
+            program);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output_dir = ".";
+    long long max_age = 0;
+    int all_nodes = 0, path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--all-nodes") == 0) {
+            all_nodes = 1;
+        } else if (strcmp(argv[i], "--output-dir") == 0 && value) {
+            output_dir = value, i++;
+        } else if (strcmp(argv[i], "--max-age") == 0 && value) {
+            char *end = NULL;
+            errno = 0;
+            max_age = strtoll(value, &end, 10);
+            if (end == value || *end != '\0' || errno == ERANGE || max_age < 0) {
+                fprintf(stderr, "Invalid --max-age value: %s (expected seconds, 0 or more)\n", value);
+                return 2;
+            }
+            i++;
+        } else if (argv[i][0] == '-') {
+            merge_usage(argv[0]);
+            return 2;
+        } else {
+            path_count++;
+        }
+    }
+    if (path_count == 0) {
+        merge_usage(argv[0]);
+        return 2;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--output-dir") == 0 || strcmp(argv[i], "--max-age") == 0)
+            i++;
+        else if (argv[i][0] != '-')
+            load_path(argv[i]);
+    }
+    qsort(partials, partial_count, sizeof(Partial), compare_partials);
+
+    const json_t *membership = all_nodes ? NULL : current_membership();
+    time_t now = time(NULL);
+    json_t *merged = json_array();
+    json_t *index = json_object();   //* hash -> position in `merged`
+    json_t *shards = json_array();
+    json_t *covered = json_object(); //* Owned source URLs seen in any merged partial
+    long long sources_processed = 0, source_total = 0, reports = 0;
+    int used = 0;
+
+    for (int p = 0; p < partial_count; p++) {
+        Partial *partial = &partials[p];
+        if (membership && partial->shard && !is_member(membership, partial->node)) {
+            fprintf(stderr, "Skipping %s: node %s is not in the current membership\n", partial->path, partial->node);
+            continue;
+        }
+        if (max_age > 0 && partial->published > 0 && now - partial->published > max_age) {
+            fprintf(stderr, "Skipping %s: published %llds ago\n", partial->path, (long long)(now - partial->published));
+            continue;
+        }
+        json_t *proxies = json_object_get(partial->root, "proxies");
+        size_t position;
+        json_t *proxy;
+        json_array_foreach(proxies, position, proxy) {
+            const char *hash = string_field(proxy, "hash");
+            if (!*hash)
+                continue;
+            reports++;
+            json_t *seen = json_object_get(index, hash);
+            if (seen) {
+                merge_record(json_array_get(merged, (size_t)json_integer_value(seen)), proxy);
+                continue;
+            }
+            json_object_set_new(index, hash, json_integer((json_int_t)json_array_size(merged)));
+            json_array_append_new(merged, json_deep_copy(proxy));
+        }
+        sources_processed += json_integer_value(json_object_get(partial->root, "sources_processed"));
+        json_t *shard = json_object();
+        json_object_set_new(shard, "node", json_string(partial->node));
+        json_object_set_new(shard, "file", json_string(partial->path));
+        json_object_set_new(shard, "proxies", json_integer((json_int_t)json_array_size(proxies)));
+        if (partial->shard) {
+            json_t *owned = json_object_get(partial->shard, "owned");
+            json_t *url;
+            json_array_foreach(owned, position, url) {
+                if (json_string_value(url))
+                    json_object_set_new(covered, json_string_value(url), json_true());
+            }
+            long long sources = json_integer_value(json_object_get(partial->shard, "sources"));
+            if (sources > source_total)
+                source_total = sources;
+            json_object_set_new(shard, "owned_sources", json_integer((json_int_t)json_array_size(owned)));
+            json_object_set_new(shard, "published", json_integer(partial->published));
+        }
+        json_array_append_new(shards, shard);
+        used++;
+    }
+    if (used == 0) {
+        fprintf(stderr, "No partial store to merge\n");
+        return 1;
+    }
+
+    char updated[64];
+    strftime(updated, sizeof(updated), MERGE_TIME_FORMAT, localtime(&now));
+    json_t *root = json_object();
+    json_object_set_new(root, "version", json_string("2.0"));
+    json_object_set_new(root, "updated", json_string(updated));
+    json_object_set_new(root, "total_proxies", json_integer((json_int_t)json_array_size(merged)));
+    json_object_set_new(root, "unique_proxies", json_integer((json_int_t)json_array_size(merged)));
+    json_object_set_new(root, "sources_processed", json_integer(sources_processed));
+    json_object_set_new(root, "shards", shards);
+    if (source_total > 0) {
+        json_t *coverage = json_object();
+        json_object_set_new(coverage, "sources", json_integer(source_total));
+        json_object_set_new(coverage, "owned", json_integer((json_int_t)json_object_size(covered)));
+        json_object_set_new(root, "coverage", coverage);
+        if ((long long)json_object_size(covered) < source_total)
+            fprintf(stderr, "Coverage: %zu of %lld sources owned by the merged nodes (has every node published?)\n",
+                    json_object_size(covered), source_total);
+    }
+    json_object_set_new(root, "proxies", merged);
+
+    char json_path[PATH_MAX], text_path[PATH_MAX];
+    snprintf(json_path, sizeof(json_path), "%s/proxies.json", output_dir);
+    snprintf(text_path, sizeof(text_path), "%s/proxies.txt", output_dir);
+    int ok = write_atomically(json_path, write_json, root) && write_atomically(text_path, write_text, root);
+    fprintf(stderr, "Merged %d partial%s: %lld records, %zu unique proxies\n", used, used == 1 ? "" : "s", reports,
+            json_array_size(json_object_get(root, "proxies")));
+
+    json_decref(root);
+    json_decref(index);
+    json_decref(covered);
+    for (int p = 0; p < partial_count; p++)
+        json_decref(partials[p].root);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#!/bin/sh
+# Runs a sharded cluster of NODES parser processes on this machine and checks it
+# against one unsharded run of the same replay archive:
+#   1. the merged store of the nodes holds exactly the proxies of the single run;
+#   2. adding one more node moves only sources to that node (checked with --shard-plan).
+# Every node gets its own working directory and shares one config file, the way
+# separate machines would share it.
+#
+# Usage: tools/shard/run_local.sh [nodes] [archive]
+#   (run from the repository root after `make` and `make shard`; the archive defaults
+#   to the PGO training corpus, `make build/pgo/train.mtpa.gz`)
+set -eu
+
+NODES=${1:-3}
+ARCHIVE=${2:-build/pgo/train.mtpa.gz}
+PARSER=$(pwd)/mtproto_parser
+MERGER=$(pwd)/mtp_merge
+ARCHIVE=$(cd "$(dirname "$ARCHIVE")" && pwd)/$(basename "$ARCHIVE")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+members=""
+n=1
+while [ "$n" -le "$NODES" ]; do
+    members="${members:+$members,}node$n"
+    n=$((n + 1))
+done
+
+mkdir -p "$WORK/shards" "$WORK/single" "$WORK/merged"
+cat > "$WORK/shared.conf" <<EOF
+shard_nodes = "$members"
+shard_dir = "$WORK/shards"
+metrics_port = 0
+EOF
+echo "metrics_port = 0" > "$WORK/single.conf"
+
+(cd "$WORK/single" && "$PARSER" --replay "$ARCHIVE" --config ../single.conf >parser.log 2>&1)
+
+pids=""
+n=1
+while [ "$n" -le "$NODES" ]; do
+    mkdir -p "$WORK/node$n"
+    (cd "$WORK/node$n" && exec "$PARSER" --replay "$ARCHIVE" --config ../shared.conf --shard-node "node$n" \
+        >parser.log 2>&1) &
+    pids="$pids $!"
+    n=$((n + 1))
+done
+for pid in $pids; do
+    wait "$pid"
+done
+grep -h "Shard: node" "$WORK"/node*/parser.log || true
+
+"$MERGER" --output-dir "$WORK/merged" "$WORK/shards"
+grep -v '^#' "$WORK/single/proxies.txt" | sed '/^$/d' | sort > "$WORK/single.links"
+grep -v '^#' "$WORK/merged/proxies.txt" | sed '/^$/d' | sort > "$WORK/merged.links"
+status=0
+if cmp -s "$WORK/single.links" "$WORK/merged.links"; then
+    echo "merge: $(wc -l < "$WORK/merged.links") proxies from $NODES nodes, identical to the unsharded run"
+else
+    echo "merge: MISMATCH against the unsharded run"
+    diff "$WORK/single.links" "$WORK/merged.links" | head -20
+    status=1
+fi
+
+# Membership change: every source whose owner changes must move to the new node
+next="node$((NODES + 1))"
+"$PARSER" --replay "$ARCHIVE" --shard-nodes "$members" --shard-plan | grep "$(printf '\t')" > "$WORK/before.plan"
+"$PARSER" --replay "$ARCHIVE" --shard-nodes "$members,$next" --shard-plan | grep "$(printf '\t')" > "$WORK/after.plan"
+paste "$WORK/before.plan" "$WORK/after.plan" | awk -F '\t' -v next_node="$next" '
+    $1 != $3 { moved++; if ($3 != next_node) stray++ }
+    END {
+        printf "join: adding %s moves %d of %d sources, %d to other nodes\n", next_node, moved, NR, stray
+        exit stray > 0
+    }' || status=1
+
+exit "$status"
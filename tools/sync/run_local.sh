@@ -0,0 +1,88 @@
+#!/bin/sh
+# Runs two parser instances on this machine that reconcile with each other over loopback.
+# Node a fetches sources 1-4 and node b sources 3-6 of a generated set served by a local
+# HTTP server, then:
+#   1. both stores must converge on the union of all six sources (counted by mtp_batch);
+#   2. a few proxies are appended to a source only node a fetches, and the exchange that
+#      carries them must cost less than sending the store's hash list would.
+#
+# Usage: tools/sync/run_local.sh [proxies-per-source]
+#   (run from the repository root after `make`; the HTTP server needs python3)
+set -eu
+
+PER_SOURCE=${1:-2000}
+ADDED=5
+HTTP_PORT=${HTTP_PORT:-18480}
+PORT_A=${PORT_A:-18481}
+PORT_B=${PORT_B:-18482}
+PARSER=$(pwd)/mtproto_parser
+BATCH=$(pwd)/mtp_batch
+WORK=$(mktemp -d)
+pids=""
+server=""
+trap 'kill $pids $server 2>/dev/null || true; rm -rf "$WORK"' EXIT
+
+#* Source f<n> lists proxies on 10.<n>.x.y, so the six sources are disjoint. The trailing
+#* comma ends each secret; the loose ip:port:secret patterns also take whitespace into it
+generate() {
+    awk -v n="$1" -v from="$2" -v to="$3" 'BEGIN {
+        for (i = from; i < to; i++)
+            printf "10.%d.%d.%d:443:ee%032x,\n", n, int(i / 256), i % 256, n * 1000000 + i
+    }'
+}
+mkdir -p "$WORK/www" "$WORK/a" "$WORK/b"
+for n in 1 2 3 4 5 6; do
+    generate "$n" 0 "$PER_SOURCE" > "$WORK/www/f$n.txt"
+done
+for n in 1 2 3 4; do echo "http://127.0.0.1:$HTTP_PORT/f$n.txt"; done > "$WORK/a/sources.txt"
+for n in 3 4 5 6; do echo "http://127.0.0.1:$HTTP_PORT/f$n.txt"; done > "$WORK/b/sources.txt"
+echo "metrics_port = 0" > "$WORK/shared.conf"
+
+python3 -m http.server "$HTTP_PORT" --bind 127.0.0.1 --directory "$WORK/www" >/dev/null 2>&1 &
+server=$!
+sleep 1
+
+start_node() {
+    (cd "$WORK/$1" && exec "$PARSER" --config ../shared.conf --sources sources.txt --no-throttle --probe-budget 0 \
+        --cycle-pause 1 --sync-port "$2" --sync-peers "127.0.0.1:$3" --sync-interval 2 >parser.log 2>&1) &
+    pids="$pids $!"
+}
+start_node a "$PORT_A" "$PORT_B"
+start_node b "$PORT_B" "$PORT_A"
+sleep 10
+
+generate 1 "$PER_SOURCE" $((PER_SOURCE + ADDED)) >> "$WORK/www/f1.txt"
+sleep 8
+kill -INT $pids
+for pid in $pids; do
+    wait "$pid" || true
+done
+pids=""
+
+expected=$(cat "$WORK"/www/*.txt | "$BATCH" 2>/dev/null | sort -u | wc -l)
+if [ "$expected" -eq 0 ]; then
+    echo "converge: mtp_batch found no proxies in the generated sources"
+    exit 1
+fi
+status=0
+for node in a b; do
+    grep -v '^#' "$WORK/$node/proxies.txt" | sed '/^$/d' | sort > "$WORK/$node.links"
+done
+if [ "$(wc -l < "$WORK/a.links")" -eq "$expected" ] && cmp -s "$WORK/a.links" "$WORK/b.links"; then
+    echo "converge: both nodes hold all $expected proxies"
+else
+    echo "converge: MISMATCH (a $(wc -l < "$WORK/a.links"), b $(wc -l < "$WORK/b.links"), expected $expected)"
+    status=1
+fi
+
+#* The exchange that moved the appended proxies, from whichever side started it
+grep -h "; $ADDED new here\|, $ADDED new there" "$WORK"/a/parser.log "$WORK"/b/parser.log | head -1 |
+    awk -v store="$expected" -v added="$ADDED" '
+        { for (i = 1; i < NF; i++) if ($(i + 1) == "bytes" || $(i + 1) == "received;") bytes += $i; found = 1 }
+        END {
+            if (!found) { print "delta: no exchange carried the added proxies"; exit 1 }
+            printf "delta: %d new proxies reconciled in %d bytes (hash list alone: %d bytes)\n", added, bytes, store * 8
+            exit bytes >= store * 8
+        }' || status=1
+
+exit "$status"